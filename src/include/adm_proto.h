@@ -56,6 +56,7 @@ int krb5_klog_syslog(int, const char *, ...)
 #endif
     ;
 void krb5_klog_reopen (krb5_context);
+unsigned long krb5_klog_get_dropped(void);
 
 /* alt_prof.c */
 krb5_error_code krb5_aprof_init(char *, char *, krb5_pointer *);
@@ -209,6 +209,9 @@
 #define svc_getreqset		gssrpc_svc_getreqset
 #define svc_getreqset2		gssrpc_svc_getreqset2
 #define svc_run			gssrpc_svc_run
+#define svc_getreq_fd		gssrpc_svc_getreq_fd
+#define svc_fd_xprt		gssrpc_svc_fd_xprt
+#define svc_set_xprt_notify	gssrpc_svc_set_xprt_notify
 
 #define svcraw_create		gssrpc_svcraw_create
 
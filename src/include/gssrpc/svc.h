@@ -304,6 +304,18 @@ extern void	svc_getreqset(int *);
 #endif
 extern void	svc_run(void); 	 /* never returns */
 
+/*
+ * Scalable dispatching.  svc_getreq_fd services a single descriptor of any
+ * number, and svc_fd_xprt returns the transport registered for a
+ * descriptor.  A notify function set with svc_set_xprt_notify is called
+ * each time a transport is registered (active is TRUE) or unregistered, so
+ * that the caller can watch new connections without scanning svc_fdset.
+ */
+typedef void (*svc_xprt_notify_fn)(SVCXPRT *xprt, bool_t active, void *data);
+extern void	svc_getreq_fd(int);
+extern SVCXPRT	*svc_fd_xprt(int);
+extern void	svc_set_xprt_notify(svc_xprt_notify_fn, void *);
+
 /*
  * Socket to use on svcxxx_create call to get default socket
  */
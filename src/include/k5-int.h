@@ -181,8 +181,12 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_ACL_FILE                     "acl_file"
 #define KRB5_CONF_ADMIN_SERVER                 "admin_server"
 #define KRB5_CONF_ALLOW_WEAK_CRYPTO            "allow_weak_crypto"
+#define KRB5_CONF_ASYNC                        "async"
+#define KRB5_CONF_ASYNC_BUFFER_SIZE            "async_buffer_size"
+#define KRB5_CONF_ASYNC_OVERFLOW               "async_overflow"
 #define KRB5_CONF_AUTH_TO_LOCAL                "auth_to_local"
 #define KRB5_CONF_AUTH_TO_LOCAL_NAMES          "auth_to_local_names"
+#define KRB5_CONF_CACHE_SIZE                   "cache_size"
 #define KRB5_CONF_CANONICALIZE                 "canonicalize"
 #define KRB5_CONF_CCACHE_TYPE                  "ccache_type"
 #define KRB5_CONF_CLOCKSKEW                    "clockskew"
@@ -232,15 +236,24 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_K5LOGIN_AUTHORITATIVE        "k5login_authoritative"
 #define KRB5_CONF_K5LOGIN_DIRECTORY            "k5login_directory"
 #define KRB5_CONF_KADMIND_LISTEN               "kadmind_listen"
+#define KRB5_CONF_KADMIND_MAX_CONNECTIONS      "kadmind_max_connections"
 #define KRB5_CONF_KADMIND_PORT                 "kadmind_port"
 #define KRB5_CONF_KCM_MACH_SERVICE             "kcm_mach_service"
 #define KRB5_CONF_KCM_SOCKET                   "kcm_socket"
 #define KRB5_CONF_KDC                          "kdc"
+#define KRB5_CONF_KDC_ADDRESS_PREFIX_LENGTH    "kdc_address_prefix_length"
+#define KRB5_CONF_KDC_ADDRESS_RATE_BURST       "kdc_address_rate_burst"
+#define KRB5_CONF_KDC_ADDRESS_RATE_LIMIT       "kdc_address_rate_limit"
+#define KRB5_CONF_KDC_ADDRESS6_PREFIX_LENGTH   "kdc_address6_prefix_length"
 #define KRB5_CONF_KDCDEFAULTS                  "kdcdefaults"
 #define KRB5_CONF_KDC_DEFAULT_OPTIONS          "kdc_default_options"
 #define KRB5_CONF_KDC_LISTEN                   "kdc_listen"
 #define KRB5_CONF_KDC_MAX_DGRAM_REPLY_SIZE     "kdc_max_dgram_reply_size"
+#define KRB5_CONF_KDC_METRICS_SOCKET           "kdc_metrics_socket"
 #define KRB5_CONF_KDC_PORTS                    "kdc_ports"
+#define KRB5_CONF_KDC_PRINCIPAL_RATE_BURST     "kdc_principal_rate_burst"
+#define KRB5_CONF_KDC_PRINCIPAL_RATE_LIMIT     "kdc_principal_rate_limit"
+#define KRB5_CONF_KDC_RATE_LIMIT_ACTION        "kdc_rate_limit_action"
 #define KRB5_CONF_KDC_TCP_PORTS                "kdc_tcp_ports"
 #define KRB5_CONF_KDC_TCP_LISTEN               "kdc_tcp_listen"
 #define KRB5_CONF_KDC_TCP_LISTEN_BACKLOG       "kdc_tcp_listen_backlog"
@@ -262,6 +275,9 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_LDAP_KDC_SASL_MECH           "ldap_kdc_sasl_mech"
 #define KRB5_CONF_LDAP_KDC_SASL_REALM          "ldap_kdc_sasl_realm"
 #define KRB5_CONF_LDAP_KERBEROS_CONTAINER_DN   "ldap_kerberos_container_dn"
+#define KRB5_CONF_LDAP_PRINCIPAL_CACHE_LIFETIME "ldap_principal_cache_lifetime"
+#define KRB5_CONF_LDAP_PRINCIPAL_CACHE_STAMP_FILE \
+    "ldap_principal_cache_stamp_file"
 #define KRB5_CONF_LDAP_SERVERS                 "ldap_servers"
 #define KRB5_CONF_LDAP_SERVICE_PASSWORD_FILE   "ldap_service_password_file"
 #define KRB5_CONF_LIBDEFAULTS                  "libdefaults"
@@ -273,10 +289,12 @@ typedef unsigned char   u_char;
 #define KRB5_CONF_MAX_LIFE                     "max_life"
 #define KRB5_CONF_MAX_READERS                  "max_readers"
 #define KRB5_CONF_MAX_RENEWABLE_LIFE           "max_renewable_life"
+#define KRB5_CONF_MEM_RCACHE_LIMIT             "mem_rcache_limit"
 #define KRB5_CONF_MODULE                       "module"
 #define KRB5_CONF_NOADDRESSES                  "noaddresses"
 #define KRB5_CONF_NOSYNC                       "nosync"
 #define KRB5_CONF_NO_HOST_REFERRAL             "no_host_referral"
+#define KRB5_CONF_PAGE_SIZE                    "page_size"
 #define KRB5_CONF_PERMITTED_ENCTYPES           "permitted_enctypes"
 #define KRB5_CONF_PLUGINS                      "plugins"
 #define KRB5_CONF_PLUGIN_BASE_DIR              "plugin_base_dir"
@@ -630,6 +648,9 @@ struct derived_key {
 /* Internal structure of an opaque key identifier */
 struct krb5_key_st {
     krb5_keyblock keyblock;
+    /* The crypto library's enctype table entry for keyblock.enctype, or NULL
+     * if the enctype is not supported. */
+    const struct krb5_keytypes *ktp;
     int refcount;
     struct derived_key *derived;
     /*
@@ -649,6 +670,11 @@ krb5int_arcfour_gsscrypt(const krb5_keyblock *keyblock, krb5_keyusage usage,
                          const krb5_data *kd_data, krb5_crypto_iov *data,
                          size_t num_data);
 
+/* Number of krb5_crypto_iov entries which the crypto and GSSAPI libraries keep
+ * on the stack when copying or translating an iov array.  This covers the
+ * usual message layouts without allocating. */
+#define K5_CRYPTO_IOV_STACK_COUNT 16
+
 #define K5_SHA256_HASHLEN (256 / 8)
 
 /* Write the SHA-256 hash of in (containing n elements) to out. */
@@ -1620,6 +1646,31 @@ decode_krb5_as_req(const krb5_data *output, krb5_kdc_req **rep);
 krb5_error_code
 decode_krb5_tgs_req(const krb5_data *output, krb5_kdc_req **rep);
 
+/*
+ * Arena variants of the AP-REQ, AS-REQ, and TGS-REQ decoders.  The result is
+ * normally a single allocation, and its strings point into output, which must
+ * remain valid and unmodified until the result is freed.  The result's magic
+ * field is set to K5_ASN1_ARENA_MAGIC; krb5_free_ap_req() and
+ * krb5_free_kdc_req() release it with k5_asn1_free_arena(), along with the
+ * parts which may be filled in on the heap after decoding: the AP-REQ
+ * ticket's enc_part2, and the request's unenc_authdata and each second
+ * ticket's enc_part2.  Other parts of the result must not be freed or
+ * replaced individually.
+ */
+#define K5_ASN1_ARENA_MAGIC 0x4B354152 /* "K5AR" */
+
+krb5_error_code
+decode_krb5_ap_req_arena(const krb5_data *output, krb5_ap_req **rep);
+
+krb5_error_code
+decode_krb5_as_req_arena(const krb5_data *output, krb5_kdc_req **rep);
+
+krb5_error_code
+decode_krb5_tgs_req_arena(const krb5_data *output, krb5_kdc_req **rep);
+
+void
+k5_asn1_free_arena(void *rep);
+
 krb5_error_code
 decode_krb5_kdc_req_body(const krb5_data *output, krb5_kdc_req **rep);
 
@@ -2070,6 +2121,20 @@ typedef struct _krb5_kt_ops {
 extern krb5_error_code
 krb5int_c_mandatory_cksumtype(krb5_context, krb5_enctype, krb5_cksumtype *);
 
+/*
+ * Derive keys[i] from string for each of n enctypes, using salts[i] and
+ * params[i] (params may be NULL).  Equivalent to calling
+ * krb5_c_string_to_key_with_params() for each enctype, but derivations which
+ * share work are performed once and independent ones are performed
+ * concurrently where possible.  On error, no keys are allocated.
+ */
+krb5_error_code
+krb5int_c_string_to_key_multi(krb5_context context, size_t n,
+                              const krb5_enctype *enctypes,
+                              const krb5_data *string, const krb5_data *salts,
+                              const krb5_data *const *params,
+                              krb5_keyblock *keys);
+
 /*
  * Referral definitions and subfunctions.
  */
@@ -2098,6 +2163,10 @@ krb5_error_code KRB5_CALLCONV krb5_decrypt_tkt_part(krb5_context,
                                                     const krb5_keyblock *,
                                                     krb5_ticket * );
 
+krb5_error_code k5_copy_enc_tkt_part(krb5_context context,
+                                     const krb5_enc_tkt_part *partfrom,
+                                     krb5_enc_tkt_part **partto);
+
 krb5_error_code krb5_get_cred_via_tkt(krb5_context, krb5_creds *, krb5_flags,
                                       krb5_address *const *, krb5_creds *,
                                       krb5_creds **);
@@ -2170,6 +2239,17 @@ krb5_error_code krb5_rd_req_decoded_anyflag(krb5_context, krb5_auth_context *,
                                             krb5_const_principal, krb5_keytab,
                                             krb5_flags *, krb5_ticket **);
 
+/*
+ * Like krb5_rd_req_decoded_anyflag(), but use the ticket part already present
+ * in req->ticket->enc_part2 instead of decrypting the ticket.  The caller is
+ * responsible for having obtained enc_part2 by decrypting req->ticket with
+ * the correct key.
+ */
+krb5_error_code k5_rd_req_decoded_decrypted(krb5_context context,
+                                            krb5_auth_context *auth_context,
+                                            const krb5_ap_req *req,
+                                            krb5_const_principal server);
+
 krb5_error_code KRB5_CALLCONV
 krb5_cc_register(krb5_context, const krb5_cc_ops *, krb5_boolean );
 
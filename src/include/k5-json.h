@@ -215,4 +215,37 @@ long long k5_json_number_value(k5_json_number number);
 int k5_json_encode(k5_json_value val, char **json_out);
 int k5_json_decode(const char *str, k5_json_value *val_out);
 
+/*
+ * Streaming encoder
+ *
+ * A writer appends JSON text directly to a caller-supplied k5buf, producing
+ * the same output as k5_json_encode() would for the equivalent value tree
+ * without allocating the tree.  The caller is responsible for emitting a
+ * well-formed sequence of calls (a key before each object member, matching
+ * begin and end calls), and for checking k5_buf_status() afterwards.
+ */
+
+struct k5buf;
+
+typedef struct k5_json_writer_st {
+    struct k5buf *buf;
+    int need_comma;
+} k5_json_writer;
+
+void k5_json_writer_init(k5_json_writer *w, struct k5buf *buf);
+
+void k5_json_write_begin_object(k5_json_writer *w);
+void k5_json_write_end_object(k5_json_writer *w);
+void k5_json_write_begin_array(k5_json_writer *w);
+void k5_json_write_end_array(k5_json_writer *w);
+void k5_json_write_key(k5_json_writer *w, const char *key);
+void k5_json_write_null(k5_json_writer *w);
+void k5_json_write_bool(k5_json_writer *w, int b);
+void k5_json_write_number(k5_json_writer *w, long long number);
+/* Write the string str, or the first len bytes of data, stopping at the first
+ * zero byte as k5_json_string_create_len() would. */
+void k5_json_write_string(k5_json_writer *w, const char *str);
+void k5_json_write_string_len(k5_json_writer *w, const void *data,
+                              size_t len);
+
 #endif /* K5_JSON_H */
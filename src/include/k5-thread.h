@@ -393,6 +393,65 @@ static inline void k5_mutex_unlock(k5_mutex_t *m)
 #define k5_assert_locked        k5_mutex_assert_locked
 #define k5_assert_unlocked      k5_mutex_assert_unlocked
 
+/* Reader/writer locks, layered the same way as mutexes.  Where POSIX
+   rwlocks are unavailable, an rwlock is an ordinary mutex and readers
+   exclude each other.  */
+
+#if defined(ENABLE_THREADS) && defined(HAVE_PTHREAD) && \
+    defined(HAVE_PTHREAD_RWLOCK_INIT)
+
+typedef pthread_rwlock_t k5_os_rwlock;
+
+#ifdef USE_CONDITIONAL_PTHREADS
+int k5_os_rwlock_init(k5_os_rwlock *l);
+int k5_os_rwlock_destroy(k5_os_rwlock *l);
+int k5_os_rwlock_rdlock(k5_os_rwlock *l);
+int k5_os_rwlock_wrlock(k5_os_rwlock *l);
+int k5_os_rwlock_unlock(k5_os_rwlock *l);
+#else
+# define k5_os_rwlock_init(L)           pthread_rwlock_init((L), 0)
+# define k5_os_rwlock_destroy(L)        pthread_rwlock_destroy(L)
+# define k5_os_rwlock_rdlock(L)         pthread_rwlock_rdlock(L)
+# define k5_os_rwlock_wrlock(L)         pthread_rwlock_wrlock(L)
+# define k5_os_rwlock_unlock(L)         pthread_rwlock_unlock(L)
+#endif
+
+#else
+
+typedef k5_os_mutex k5_os_rwlock;
+# define k5_os_rwlock_init              k5_os_mutex_init
+# define k5_os_rwlock_destroy           k5_os_mutex_destroy
+# define k5_os_rwlock_rdlock            k5_os_mutex_lock
+# define k5_os_rwlock_wrlock            k5_os_mutex_lock
+# define k5_os_rwlock_unlock            k5_os_mutex_unlock
+
+#endif
+
+typedef k5_os_rwlock k5_rwlock_t;
+static inline int k5_rwlock_init(k5_rwlock_t *l)
+{
+    return k5_os_rwlock_init(l);
+}
+#define k5_rwlock_destroy(L)            (k5_os_rwlock_destroy(L))
+
+static inline void k5_rwlock_rdlock(k5_rwlock_t *l)
+{
+    int r = k5_os_rwlock_rdlock(l);
+    assert(r == 0);
+}
+
+static inline void k5_rwlock_wrlock(k5_rwlock_t *l)
+{
+    int r = k5_os_rwlock_wrlock(l);
+    assert(r == 0);
+}
+
+static inline void k5_rwlock_unlock(k5_rwlock_t *l)
+{
+    int r = k5_os_rwlock_unlock(l);
+    assert(r == 0);
+}
+
 /* Thread-specific data; implemented in a support file, because we'll
    need to keep track of some global data for cleanup purposes.
 
@@ -404,6 +463,7 @@ typedef enum {
     K5_KEY_GSS_KRB5_CCACHE_NAME,
     K5_KEY_GSS_KRB5_ERROR_MESSAGE,
     K5_KEY_GSS_SPNEGO_STATUS,
+    K5_KEY_KRB5_TRACE,
 #if defined(__MACH__) && defined(__APPLE__)
     K5_KEY_IPC_CONNECTION_INFO,
 #endif
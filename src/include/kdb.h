@@ -390,6 +390,44 @@ krb5_error_code krb5_db_iterate ( krb5_context kcontext,
                                   int (*func) (krb5_pointer, krb5_db_entry *),
                                   krb5_pointer func_arg, krb5_flags iterflags );
 
+/*
+ * Online migration.  If the realm's database module section has a migrate_to
+ * relation naming another [dbmodules] section, krb5_db_open() also opens that
+ * database as a migration target (except for the KDC), and principal and
+ * policy changes made through this library are applied to both databases.
+ */
+#define KRB5_DB_MIGRATE_PRINCIPAL       1
+#define KRB5_DB_MIGRATE_POLICY          2
+
+/*
+ * Progress callback for krb5_db_migrate() and krb5_db_verify_migration(),
+ * invoked for each principal or policy processed.  count is the number of
+ * objects of that type processed so far in the current pass.  mismatch is
+ * true if verification found the object to differ between the databases, or
+ * to be present in the target only.  name may be NULL if the principal name
+ * cannot be displayed.
+ */
+typedef void (*krb5_db_migrate_fn)(void *arg, int type, const char *name,
+                                   unsigned long count, krb5_boolean mismatch);
+
+/* Create the migration target database.  The primary need not be open. */
+krb5_error_code krb5_db_create_migration_target(krb5_context kcontext);
+
+/*
+ * Copy all policies and principals from the open primary database to the
+ * migration target, and remove objects which the primary does not have.
+ * Each principal is copied with the primary locked, so concurrent changes by
+ * other processes are not overwritten with older data.
+ */
+krb5_error_code krb5_db_migrate(krb5_context kcontext,
+                                krb5_db_migrate_fn func, void *arg);
+
+/* Compare the primary database with the migration target, setting
+ * *mismatches_out to the number of objects which differ. */
+krb5_error_code krb5_db_verify_migration(krb5_context kcontext,
+                                         krb5_db_migrate_fn func, void *arg,
+                                         unsigned long *mismatches_out);
+
 
 krb5_error_code krb5_db_store_master_key  ( krb5_context kcontext,
                                             char *keyfile,
@@ -747,6 +785,33 @@ void krb5_db_free_authdata_info(krb5_context context, void *ad_info);
 void
 krb5_dbe_sort_key_data(krb5_key_data *key_data, size_t key_data_length);
 
+/**
+ * Increment the change count stored in the file @a path, creating the file
+ * with a count of 0 first if it does not exist.  The file is locked
+ * exclusively during the update, so increments made at the same time by
+ * different processes are not lost.  Database modules can use a change count
+ * to tell other processes when to discard data they have cached.
+ *
+ * @param path
+ *     The name of the change count file.
+ */
+krb5_error_code
+krb5_db_incr_change_count(krb5_context context, const char *path);
+
+/**
+ * Read the change count stored in the file @a path into @a count_out.  Return
+ * ENOENT if the file does not exist, or KRB5_KDB_DB_CORRUPT if it does not
+ * contain a count.
+ *
+ * @param path
+ *     The name of the change count file.
+ * @param count_out
+ *     The change count.
+ */
+krb5_error_code
+krb5_db_read_change_count(krb5_context context, const char *path,
+                          uint64_t *count_out);
+
 /* default functions. Should not be directly called */
 /*
  *   Default functions prototype
@@ -881,6 +946,7 @@ krb5_error_code krb5_db_register_keytab(krb5_context context);
 #define KDB_MODULE_DEF_SECTION          "dbdefaults"
 #define KDB_MODULE_SECTION              "dbmodules"
 #define KDB_LIB_POINTER                 "db_library"
+#define KDB_MIGRATE_POINTER             "migrate_to"
 #define KDB_DATABASE_CONF_FILE          DEFAULT_SECURE_PROFILE_PATH
 #define KDB_DATABASE_ENV_PROF           KDC_PROFILE_ENV
 
@@ -63,6 +63,17 @@ typedef struct krad_client_st krad_client;
 typedef unsigned char krad_code;
 typedef unsigned char krad_attr;
 
+/* Request and latency statistics for a remote RADIUS server. */
+typedef struct krad_remote_stats_st {
+    size_t sockets;                     /* Open source sockets */
+    size_t in_flight;                   /* Requests awaiting a response */
+    unsigned long long requests;        /* Requests sent */
+    unsigned long long responses;       /* Responses received */
+    unsigned long long timeouts;        /* Requests which ran out of time */
+    unsigned long long latency_total;   /* Sum of response times (us) */
+    unsigned long long latency_max;     /* Longest response time (us) */
+} krad_remote_stats;
+
 /* Called when a response is received or the request times out. */
 typedef void
 (*krad_cb)(krb5_error_code retval, const krad_packet *request,
@@ -235,6 +246,28 @@ krad_client_new(krb5_context kctx, verto_ctx *vctx, krad_client **client);
 void
 krad_client_free(krad_client *client);
 
+/*
+ * Set the maximum number of source sockets the client may open to a single
+ * remote host.  Each socket has its own space of 256 RADIUS packet
+ * identifiers, so this bounds the number of requests which may be outstanding
+ * to one server at a time.  Additional sockets are only opened once the
+ * identifiers of the existing ones are exhausted.  The default is 1; a value
+ * of 0 is treated as 1.
+ */
+void
+krad_client_set_max_sockets(krad_client *rc, size_t max_sockets);
+
+/*
+ * Get the statistics for the remote host, specified in any of the formats
+ * accepted by krad_client_send().  If the host resolves to several addresses
+ * or is used with several secrets, the statistics are summed and
+ * latency_max is the largest among them.  Return ENOENT if the client has not
+ * sent any requests to the host.
+ */
+krb5_error_code
+krad_client_get_stats(krad_client *rc, const char *remote,
+                      krad_remote_stats *stats);
+
 /*
  * Send a request to a radius server.
  *
@@ -253,6 +253,10 @@ typedef krb5_error_code
  *
  * The end method may be invoked without a preceding authorization method in
  * some cases; the module must be prepared to ignore such calls.
+ *
+ * When kadmind runs with worker threads, calls into a module are serialized,
+ * but KDB methods for other operations may be invoked between an
+ * authorization method and the end invocation.
  */
 typedef void
 (*kadm5_auth_end_fn)(krb5_context context, kadm5_auth_moddata data);
@@ -107,6 +107,15 @@
  */
 #define PA_TYPED_E_DATA 0x00000100
 
+/*
+ * Indicates that the result of this mechanism's edata method depends only on
+ * the client principal entry, its long-term key selected for the request, and
+ * whether the request is FAST-armored, so the KDC may reuse it for later
+ * requests from the same client.  Mechanisms which include per-request
+ * randomness in their hints must not set this flag.
+ */
+#define PA_CACHEABLE_HINT 0x00000200
+
 /* Abstract type for a KDC callback data handle. */
 typedef struct krb5_kdcpreauth_rock_st *krb5_kdcpreauth_rock;
 
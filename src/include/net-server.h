@@ -66,6 +66,13 @@ krb5_error_code loop_add_rpc_service(int default_port, const char *addresses,
                                      u_long prognum, u_long versnum,
                                      void (*dispatchfn)());
 
+/*
+ * Set the number of TCP and RPC connections to keep open at once.  When a new
+ * connection would exceed it, the oldest connection is closed.  The default
+ * is 45.
+ */
+void loop_set_max_connections(int max);
+
 krb5_error_code loop_setup_network(verto_ctx *ctx, void *handle,
                                    const char *progname,
                                    int tcp_listen_backlog);
@@ -73,6 +80,16 @@ krb5_error_code loop_setup_signals(verto_ctx *ctx, void *handle,
                                    void (*reset)());
 void loop_free(verto_ctx *ctx);
 
+/*
+ * Stop or resume reading requests from the RPC connection on fd.  A dispatch
+ * function which answers a request after it returns (for instance from
+ * another thread) holds the connection until the reply is sent, so that the
+ * transport is not read from or destroyed in the meantime.  A held
+ * connection is not dropped to make room for new connections.
+ */
+void loop_hold_rpc_connection(int fd);
+void loop_release_rpc_connection(int fd);
+
 /* to be supplied by the server application */
 
 /*
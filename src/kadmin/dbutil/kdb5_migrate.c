@@ -0,0 +1,211 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kadmin/dbutil/kdb5_migrate.c - Online migration to another KDB module */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * kdb5_util migrate copies the realm's database to the migration target named
+ * by the migrate_to relation in its [dbmodules] section, and compares the two.
+ * Administrative programs keep the target up to date with changes made while
+ * the copy runs, so the realm can switch to the target without an outage.
+ */
+
+#include "k5-int.h"
+#include <kadm5/admin.h>
+#include <sys/time.h>
+#include "kdb5_util.h"
+
+/* Seconds between progress reports. */
+#define PROGRESS_INTERVAL 5
+
+struct progress {
+    const char *verb;           /* "Copied" or "Verified" */
+    struct timeval start;       /* start of the current pass */
+    time_t last;                /* time of the last report */
+    int type;                   /* object type of the current pass */
+    unsigned long count;        /* objects processed in the current pass */
+};
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval now;
+    double secs;
+
+    gettimeofday(&now, NULL);
+    secs = (now.tv_sec - start->tv_sec) +
+        (now.tv_usec - start->tv_usec) / 1000000.0;
+    return (secs > 0) ? secs : 1e-6;
+}
+
+static const char *
+type_name(int type, unsigned long count)
+{
+    if (type == KRB5_DB_MIGRATE_POLICY)
+        return (count == 1) ? "policy" : "policies";
+    return (count == 1) ? "principal" : "principals";
+}
+
+/* Report the totals for the pass in progress, if any. */
+static void
+end_pass(struct progress *p)
+{
+    double secs;
+
+    if (p->type == 0)
+        return;
+    secs = elapsed(&p->start);
+    printf(_("%s %lu %s in %.1f s (%.0f/s)\n"), p->verb, p->count,
+           type_name(p->type, p->count), secs, p->count / secs);
+    p->type = 0;
+    p->count = 0;
+}
+
+static void
+progress_cb(void *arg, int type, const char *name, unsigned long count,
+            krb5_boolean mismatch)
+{
+    struct progress *p = arg;
+    time_t now;
+    double secs;
+
+    if (type != p->type) {
+        end_pass(p);
+        p->type = type;
+        gettimeofday(&p->start, NULL);
+        p->last = p->start.tv_sec;
+    }
+    p->count = count;
+
+    if (mismatch) {
+        printf(_("Mismatch: %s %s\n"), type_name(type, 1),
+               (name != NULL) ? name : _("(unparseable name)"));
+    }
+
+    now = time(NULL);
+    if (now - p->last >= PROGRESS_INTERVAL) {
+        secs = elapsed(&p->start);
+        printf(_("%s %lu %s so far (%.0f/s)\n"), p->verb, p->count,
+               type_name(type, p->count), p->count / secs);
+        fflush(stdout);
+        p->last = now;
+    }
+}
+
+static int
+verify(struct progress *p)
+{
+    krb5_error_code ret;
+    unsigned long mismatches;
+
+    p->verb = _("Verified");
+    p->type = 0;
+    ret = krb5_db_verify_migration(util_context, progress_cb, p, &mismatches);
+    end_pass(p);
+    if (ret == KRB5_KDB_DBNOTINITED) {
+        com_err(progname, 0, _("No migration target is configured"));
+        return 1;
+    }
+    if (ret) {
+        com_err(progname, ret, _("while verifying migration target"));
+        return 1;
+    }
+    if (mismatches > 0) {
+        printf(_("%lu objects differ between the database and the migration "
+                 "target\n"), mismatches);
+        return 1;
+    }
+    printf(_("Database and migration target match\n"));
+    return 0;
+}
+
+void
+kdb5_migrate(int argc, char **argv)
+{
+    krb5_error_code ret;
+    struct progress p;
+    int optchar, create = 0, verify_only = 0;
+
+    optind = 1;
+    while ((optchar = getopt(argc, argv, "cv")) != -1) {
+        switch (optchar) {
+        case 'c':
+            create = 1;
+            break;
+        case 'v':
+            verify_only = 1;
+            break;
+        default:
+            usage();
+            return;
+        }
+    }
+    if (optind != argc || (create && verify_only)) {
+        usage();
+        return;
+    }
+
+    if (create) {
+        ret = krb5_db_create_migration_target(util_context);
+        if (ret) {
+            com_err(progname, ret, _("while creating migration target"));
+            exit_status++;
+        }
+        return;
+    }
+
+    ret = krb5_db_open(util_context, db5util_db_args,
+                       KRB5_KDB_OPEN_RW | KRB5_KDB_SRV_TYPE_ADMIN);
+    if (ret) {
+        com_err(progname, ret, _("while initializing database"));
+        exit_status++;
+        return;
+    }
+    dbactive = TRUE;
+
+    memset(&p, 0, sizeof(p));
+    if (!verify_only) {
+        p.verb = _("Copied");
+        ret = krb5_db_migrate(util_context, progress_cb, &p);
+        end_pass(&p);
+        if (ret == KRB5_KDB_DBNOTINITED) {
+            com_err(progname, 0, _("No migration target is configured"));
+            exit_status++;
+            return;
+        }
+        if (ret) {
+            com_err(progname, ret, _("while copying to migration target"));
+            exit_status++;
+            return;
+        }
+    }
+    if (verify(&p))
+        exit_status++;
+}
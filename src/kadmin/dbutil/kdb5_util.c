@@ -55,6 +55,7 @@
 
 #include <k5-int.h>
 #include <kadm5/admin.h>
+#include <kadm5/server_internal.h>
 #include <locale.h>
 #include <adm_proto.h>
 #include <time.h>
@@ -99,6 +100,8 @@ void usage()
             _("\tupdate_princ_encryption [-f] [-n] [-v] [princ-pattern]\n"
               "\tpurge_mkeys [-f] [-n] [-v]\n"
               "\ttabdump [-H] [-c] [-e] [-n] [-o outfile] dumptype\n"
+              "\tcompile_dict [-f fp_rate] wordfile outfile\n"
+              "\tmigrate [-c|-v]\n"
               "\nwhere,\n\t[-x db_args]* - any number of database specific "
               "arguments.\n"
               "\t\t\tLook at each database documentation for supported "
@@ -120,6 +123,7 @@ krb5_boolean dbactive = FALSE;
 static int open_db_and_mkey(void);
 
 static void add_random_key(int, char **);
+static void compile_dict(int, char **);
 
 typedef void (*cmd_func)(int, char **);
 
@@ -140,6 +144,8 @@ struct _cmd_table {
     {"update_princ_encryption", kdb5_update_princ_encryption, 1},
     {"purge_mkeys", kdb5_purge_mkeys, 1},
     {"tabdump", tabdump, 1},
+    {"compile_dict", compile_dict, 0},
+    {"migrate", kdb5_migrate, 0},
     {NULL, NULL, 0},
 };
 
@@ -609,3 +615,38 @@ add_random_key(argc, argv)
     }
     printf(_("%s changed\n"), pr_str);
 }
+
+static void
+compile_dict(int argc, char *argv[])
+{
+    krb5_error_code ret;
+    char *me = progname, *end;
+    double fp_rate = 0;
+    int ch;
+
+    optind = 1;
+    while ((ch = getopt(argc, argv, "f:")) != -1) {
+        switch (ch) {
+        case 'f':
+            fp_rate = strtod(optarg, &end);
+            if (*end != '\0' || fp_rate <= 0 || fp_rate >= 1) {
+                com_err(me, EINVAL, _("invalid false positive rate %s"),
+                        optarg);
+                exit_status++;
+                return;
+            }
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind != 2)
+        usage();
+
+    ret = k5_pwdict_compile(argv[optind], argv[optind + 1], fp_rate);
+    if (ret) {
+        com_err(me, ret, _("while compiling dictionary %s"), argv[optind]);
+        exit_status++;
+        return;
+    }
+}
@@ -35,9 +35,17 @@
 #include <krb5/kadm5_auth_plugin.h>
 #include "auth.h"
 
+/*
+ * kadmind may call into modules from several worker threads at once.  The
+ * built-in modules only read their data after initialization; calls into other
+ * modules are serialized with a per-module lock, since the kadm5_auth
+ * interface does not require modules to be thread-safe.
+ */
 typedef struct {
     struct kadm5_auth_vtable_st vt;
     kadm5_auth_moddata data;
+    krb5_boolean serialize;
+    k5_mutex_t lock;
 } *auth_handle;
 
 static auth_handle *handles;
@@ -53,6 +61,8 @@ auth_fini(krb5_context context)
         h = *hp;
         if (h->vt.fini != NULL)
             h->vt.fini(context, h->data);
+        if (h->serialize)
+            k5_mutex_destroy(&h->lock);
         free(h);
     }
     free(handles);
@@ -112,6 +122,16 @@ auth_init(krb5_context context, const char *acl_file)
                 goto cleanup;
             }
         }
+        h->serialize = (*mod != kadm5_auth_acl_initvt &&
+                        *mod != kadm5_auth_self_initvt);
+        if (h->serialize) {
+            ret = k5_mutex_init(&h->lock);
+            if (ret) {
+                if (h->vt.fini != NULL)
+                    h->vt.fini(context, h->data);
+                goto cleanup;
+            }
+        }
         handles[count++] = h;
         handles[count] = NULL;
         h = NULL;
@@ -127,6 +147,20 @@ cleanup:
     return ret;
 }
 
+static inline void
+lock_module(auth_handle h)
+{
+    if (h->serialize)
+        k5_mutex_lock(&h->lock);
+}
+
+static inline void
+unlock_module(auth_handle h)
+{
+    if (h->serialize)
+        k5_mutex_unlock(&h->lock);
+}
+
 /* Invoke the appropriate method from h->vt for opcode, passing client and the
  * correct subset of p1, p2, s1, s2, polent, and mask for the method. */
 static krb5_error_code
@@ -188,8 +222,10 @@ auth(krb5_context context, int opcode, krb5_const_principal client,
     for (hp = handles; *hp != NULL; hp++) {
         h = *hp;
 
+        lock_module(h);
         ret = call_module(context, h, opcode, client, p1, p2, s1, s2,
                           polent, mask);
+        unlock_module(h);
         if (!ret)
             authorized = TRUE;
         else if (ret != KRB5_PLUGIN_NO_HANDLE)
@@ -278,6 +314,8 @@ auth_restrict(krb5_context context, int opcode, krb5_const_principal client,
 
         ret = KRB5_PLUGIN_NO_HANDLE;
         rs = NULL;
+        rs_ret = 0;
+        lock_module(h);
         if (opcode == OP_ADDPRINC && h->vt.addprinc != NULL) {
             ret = h->vt.addprinc(context, h->data, client, target, ent, *mask,
                                  &rs);
@@ -289,9 +327,10 @@ auth_restrict(krb5_context context, int opcode, krb5_const_principal client,
             rs_ret = impose_restrictions(context, rs, ent, mask);
             if (h->vt.free_restrictions != NULL)
                 h->vt.free_restrictions(context, h->data, rs);
-            if (rs_ret)
-                return FALSE;
         }
+        unlock_module(h);
+        if (rs_ret)
+            return FALSE;
         if (!ret)
             authorized = TRUE;
         else if (ret != KRB5_PLUGIN_NO_HANDLE)
@@ -308,7 +347,10 @@ auth_end(krb5_context context)
 
     for (hp = handles; *hp != NULL; hp++) {
         h = *hp;
-        if (h->vt.end != NULL)
+        if (h->vt.end != NULL) {
+            lock_module(h);
             h->vt.end(context, h->data);
+            unlock_module(h);
+        }
     }
 }
@@ -13,6 +13,7 @@
 #include <kadm5/admin.h>
 #include <adm_proto.h>
 #include "misc.h"
+#include "workers.h"
 #include "kadm5/server_internal.h"
 
 extern void *global_server_handle;
@@ -20,26 +21,20 @@ extern void *global_server_handle;
 static int check_rpcsec_auth(struct svc_req *);
 
 /*
- * Function: kadm_1
- *
- * Purpose: RPC processing procedure.
- *	    originally generated from rpcgen
- *
- * Arguments:
- *	rqstp		    (input) rpc request structure
- *	transp		    (input) rpc transport structure
- *	(input/output)
- *	<return value>
- *
- * Requires:
- * Effects:
- * Modifies:
+ * A decoded request.  If worker threads are running, RPCSEC_GSS requests are
+ * run on a worker while their connection is held, and the reply is sent from
+ * the main loop once the worker is done; other requests are processed before
+ * kadm_1 returns.
  */
-
-void kadm_1(rqstp, transp)
-   struct svc_req *rqstp;
-   SVCXPRT *transp;
-{
+struct kadm_call {
+     struct worker_job job;	/* must be first */
+     struct svc_req rqst;
+     SVCXPRT *transp;
+     SVCAUTH *auth;
+     int held;
+     bool_t (*xdr_argument)(), (*xdr_result)();
+     bool_t (*local)();
+     bool_t retval;
      union {
 	  cprinc_arg create_principal_2_arg;
 	  dprinc_arg delete_principal_2_arg;
@@ -72,7 +67,106 @@ void kadm_1(rqstp, transp)
 	  gstrings_ret get_string_2_ret;
 	  getpkeys_ret get_principal_keys_ret;
      } result;
-     bool_t retval;
+};
+
+/* Return true if proc does not modify the database. */
+static int
+read_only_proc(rpcproc_t proc)
+{
+     switch (proc) {
+     case GET_PRINCIPAL:
+     case GET_PRINCS:
+     case GET_POLICY:
+     case GET_POLS:
+     case GET_PRIVS:
+     case INIT:
+     case GET_STRINGS:
+     case EXTRACT_KEYS:
+	  return 1;
+     default:
+	  return 0;
+     }
+}
+
+/* Run the server stub for call.  This may be called on a worker thread. */
+static void
+run_call(struct worker_job *job)
+{
+     struct kadm_call *call = (struct kadm_call *)job;
+
+     call->retval = (*call->local)(&call->argument, &call->result,
+				   &call->rqst);
+}
+
+/* Send the reply for call and free it.  This is always called on the main
+ * loop thread. */
+static void
+finish_call(struct worker_job *job)
+{
+     struct kadm_call *call = (struct kadm_call *)job;
+     SVCXPRT *transp = call->transp;
+     SVCAUTH *auth;
+
+     /* Reply with the authentication state of this request, which the
+      * transport may have dropped once kadm_1 returned. */
+     auth = transp->xp_auth;
+     transp->xp_auth = call->auth;
+     if (call->retval &&
+	 !svc_sendreply(transp, call->xdr_result, (void *)&call->result)) {
+	  krb5_klog_syslog(LOG_ERR, "WARNING! Unable to send function results, "
+		 "continuing.");
+	  svcerr_systemerr(transp);
+     }
+     if (!svc_freeargs(transp, call->xdr_argument, &call->argument)) {
+	  krb5_klog_syslog(LOG_ERR, "WARNING! Unable to free arguments, "
+		 "continuing.");
+     }
+     if (!svc_freeargs(transp, call->xdr_result, &call->result)) {
+	  krb5_klog_syslog(LOG_ERR, "WARNING! Unable to free results, "
+		 "continuing.");
+     }
+     transp->xp_auth = auth;
+
+     if (call->held)
+	  loop_release_rpc_connection(transp->xp_sock);
+     free(call);
+}
+
+/*
+ * Return true if call can be run on a worker thread.  Only RPCSEC_GSS requests
+ * qualify, as their authentication state belongs to the transport, and only if
+ * no further request is already buffered on the connection.
+ */
+static int
+can_defer(struct kadm_call *call)
+{
+     return workers_running() &&
+	  call->rqst.rq_cred.oa_flavor == RPCSEC_GSS &&
+	  SVC_STAT(call->transp) == XPRT_IDLE;
+}
+
+/*
+ * Function: kadm_1
+ *
+ * Purpose: RPC processing procedure.
+ *	    originally generated from rpcgen
+ *
+ * Arguments:
+ *	rqstp		    (input) rpc request structure
+ *	transp		    (input) rpc transport structure
+ *	(input/output)
+ *	<return value>
+ *
+ * Requires:
+ * Effects:
+ * Modifies:
+ */
+
+void kadm_1(rqstp, transp)
+   struct svc_req *rqstp;
+   SVCXPRT *transp;
+{
+     struct kadm_call *call;
      bool_t (*xdr_argument)(), (*xdr_result)();
      bool_t (*local)();
 
@@ -247,27 +341,38 @@ void kadm_1(rqstp, transp)
 	  svcerr_noproc(transp);
 	  return;
      }
-     memset(&argument, 0, sizeof(argument));
-     if (!svc_getargs(transp, xdr_argument, &argument)) {
-	  svcerr_decode(transp);
-	  return;
-     }
-     memset(&result, 0, sizeof(result));
-     retval = (*local)(&argument, &result, rqstp);
-     if (retval && !svc_sendreply(transp, xdr_result, (void *)&result)) {
-	  krb5_klog_syslog(LOG_ERR, "WARNING! Unable to send function results, "
-		 "continuing.");
+     call = calloc(1, sizeof(*call));
+     if (call == NULL) {
 	  svcerr_systemerr(transp);
+	  return;
      }
-     if (!svc_freeargs(transp, xdr_argument, &argument)) {
-	  krb5_klog_syslog(LOG_ERR, "WARNING! Unable to free arguments, "
-		 "continuing.");
+     call->job.run = run_call;
+     call->job.done = finish_call;
+     call->job.exclusive = !read_only_proc(rqstp->rq_proc);
+     call->rqst = *rqstp;
+     call->transp = transp;
+     call->xdr_argument = xdr_argument;
+     call->xdr_result = xdr_result;
+     call->local = local;
+     if (!svc_getargs(transp, xdr_argument, &call->argument)) {
+	  svcerr_decode(transp);
+	  free(call);
+	  return;
      }
-     if (!svc_freeargs(transp, xdr_result, &result)) {
-	  krb5_klog_syslog(LOG_ERR, "WARNING! Unable to free results, "
-		 "continuing.");
+     call->auth = transp->xp_auth;
+
+     if (can_defer(call)) {
+	  /* The raw credentials are freed after we return; RPCSEC_GSS stubs
+	   * use only rq_clntname and rq_svccred. */
+	  call->rqst.rq_clntcred = NULL;
+	  call->held = 1;
+	  loop_hold_rpc_connection(transp->xp_sock);
+	  workers_submit(&call->job);
+	  return;
      }
-     return;
+
+     workers_run(&call->job);
+     finish_call(&call->job);
 }
 
 static int
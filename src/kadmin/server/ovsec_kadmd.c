@@ -58,6 +58,7 @@
 
 #include "misc.h"
 #include "auth.h"
+#include "workers.h"
 
 #if defined(NEED_DAEMON_PROTO)
 int daemon(int, int);
@@ -87,6 +88,7 @@ usage()
                       "[-port port-number]\n"
                       "\t\t[-proponly] [-p path-to-kdb5_util] [-F dump-file]\n"
                       "\t\t[-K path-to-kprop] [-k kprop-port] [-P pid_file]\n"
+                      "\t\t[-w numworkers]\n"
                       "\nwhere,\n\t[-x db_args]* - any number of database "
                       "specific arguments.\n"
                       "\t\t\tLook at each database documentation for "
@@ -140,10 +142,17 @@ setup_loop(kadm5_config_params *params, int proponly, verto_ctx **ctx_out)
 {
     krb5_error_code ret;
     verto_ctx *ctx;
+    int max_conns;
 
     *ctx_out = ctx = loop_init(VERTO_EV_TYPE_SIGNAL);
     if (ctx == NULL)
         return ENOMEM;
+    ret = profile_get_integer(context->profile, KRB5_CONF_REALMS,
+                              params->realm, KRB5_CONF_KADMIND_MAX_CONNECTIONS,
+                              0, &max_conns);
+    if (ret)
+        return ret;
+    loop_set_max_connections(max_conns);
     ret = loop_setup_signals(ctx, &global_server_handle, NULL);
     if (ret)
         return ret;
@@ -354,6 +363,7 @@ main(int argc, char *argv[])
     char **db_args = NULL, **tmpargs;
     const char *acl_file;
     int ret, i, db_args_size = 0, strong_random = 1, proponly = 0;
+    int nworkers = 0;
 
     setlocale(LC_ALL, "");
     setvbuf(stderr, NULL, _IONBF, 0);
@@ -417,6 +427,13 @@ main(int argc, char *argv[])
             pid_file = *argv;
         } else if (strcmp(*argv, "-W") == 0) {
             strong_random = 0;
+        } else if (strcmp(*argv, "-w") == 0) {
+            argc--, argv++;
+            if (!argc)
+                usage();
+            nworkers = atoi(*argv);
+            if (nworkers < 0)
+                usage();
         } else if (strcmp(*argv, "-p") == 0) {
             argc--, argv++;
             if (!argc)
@@ -549,6 +566,12 @@ main(int argc, char *argv[])
         }
     }
 
+    if (nworkers > 0) {
+        ret = workers_start(context, vctx, nworkers, &params, db_args);
+        if (ret)
+            fail_to_start(ret, _("starting worker threads"));
+    }
+
     if (kprop_port == NULL)
         kprop_port = getenv("KPROP_PORT");
 
@@ -560,6 +583,7 @@ main(int argc, char *argv[])
     krb5_klog_syslog(LOG_INFO, _("finished, exiting"));
 
     /* Clean up memory, etc */
+    workers_stop();
     svcauth_gssapi_unset_names();
     kadm5_destroy(global_server_handle);
     loop_free(vctx);
@@ -9,6 +9,7 @@
 #include "kadm5/server_internal.h" /* XXX for kadm5_server_handle_t */
 
 #include "misc.h"
+#include "workers.h"
 
 #ifndef GETSOCKNAME_ARG3_TYPE
 #define GETSOCKNAME_ARG3_TYPE int
@@ -208,9 +209,11 @@ process_chpw_request(krb5_context context, void *server_handle, char *realm,
     /* change the password */
 
     ptr = k5memdup0(clear.data, clear.length, &ret);
+    workers_lock_exclusive();
     ret = schpw_util_wrapper(server_handle, client, target,
                              (ticket->enc_part2->flags & TKT_FLG_INITIAL) != 0,
                              ptr, NULL, strresult, sizeof(strresult));
+    workers_unlock_exclusive();
     if (ret)
         errmsg = krb5_get_error_message(context, ret);
 
@@ -16,10 +16,10 @@
 #include <adm_proto.h>  /* krb5_klog_syslog */
 #include "misc.h"
 #include "auth.h"
+#include "workers.h"
 
 extern gss_name_t                       gss_changepw_name;
 extern gss_name_t                       gss_oldchangepw_name;
-extern void *                           global_server_handle;
 
 #define CHANGEPW_SERVICE(rqstp)                                         \
     (cmp_gss_names_rel_1(acceptor_name(rqstp->rq_svccred), gss_changepw_name) | \
@@ -114,7 +114,7 @@ static kadm5_ret_t new_server_handle(krb5_ui_4 api_version,
            malloc(sizeof(*handle))))
         return ENOMEM;
 
-    *handle = *(kadm5_server_handle_t)global_server_handle;
+    *handle = *(kadm5_server_handle_t)thread_server_handle();
     handle->api_version = api_version;
 
     if (! gss_to_krb5_name(handle, rqst2name(rqstp),
@@ -143,21 +143,28 @@ static void free_server_handle(kadm5_server_handle_t handle)
     free(handle);
 }
 
-/* Result is stored in a static buffer and is invalidated by the next call. */
+/* Result is stored in a static (or per-worker) buffer and is invalidated by the
+ * next call on the same thread. */
 const char *
 client_addr(SVCXPRT *xprt)
 {
-    static char abuf[128];
+    static char main_abuf[CLIENT_ADDR_BUFSIZE];
+    char *abuf = thread_addr_buf();
     struct sockaddr_storage ss;
     socklen_t len = sizeof(ss);
     const char *p = NULL;
 
+    if (abuf == NULL)
+        abuf = main_abuf;
+
     if (getpeername(xprt->xp_sock, ss2sa(&ss), &len) != 0)
         return "(unknown)";
     if (ss2sa(&ss)->sa_family == AF_INET)
-        p = inet_ntop(AF_INET, &ss2sin(&ss)->sin_addr, abuf, sizeof(abuf));
+        p = inet_ntop(AF_INET, &ss2sin(&ss)->sin_addr, abuf,
+                      CLIENT_ADDR_BUFSIZE);
     else if (ss2sa(&ss)->sa_family == AF_INET6)
-        p = inet_ntop(AF_INET6, &ss2sin6(&ss)->sin6_addr, abuf, sizeof(abuf));
+        p = inet_ntop(AF_INET6, &ss2sin6(&ss)->sin6_addr, abuf,
+                      CLIENT_ADDR_BUFSIZE);
     return (p == NULL) ? "(unknown)" : p;
 }
 
@@ -0,0 +1,452 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kadmin/server/workers.c - kadmind worker thread pool */
+/*
+ * Copyright (C) 2021 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * With kadmind -w, RPC requests are decoded on the main loop thread and then
+ * run on a pool of worker threads, so that one slow request (a string-to-key
+ * over many enctypes, a dictionary check, a kadm5_hook module calling out) does
+ * not hold up every other client.  Each worker has its own krb5 context and
+ * kadm5 server handle, and so its own KDB and update log handles.  Jobs which
+ * modify the database run one at a time under write_lock, with the KDB module
+ * and the update log providing their usual locking against other processes and
+ * against concurrent reads; read-only jobs run in parallel.  A finished job is
+ * put on the done list, and the main loop is woken through a pipe to send the
+ * reply, so that all gssrpc transport operations stay on the main thread.
+ */
+
+#include <k5-int.h>
+#include <gssrpc/rpc.h>
+#include <gssapi/gssapi.h>
+#include <kadm5/admin.h>
+#include <kdb.h>
+#include <kdb_log.h>
+#include <adm_proto.h>
+#include <syslog.h>
+#include "misc.h"
+#include "workers.h"
+
+extern void *global_server_handle;
+
+#if defined(ENABLE_THREADS) && defined(HAVE_PTHREAD)
+
+/*
+ * KDB file locks exclude other handles in the same process only if they are
+ * open file description locks.  Without them, read-only jobs must be
+ * serialized along with writes.
+ */
+#ifdef F_OFD_SETLK
+#define PARALLEL_READS 1
+#else
+#define PARALLEL_READS 0
+#endif
+
+struct worker {
+    pthread_t thread;
+    krb5_context context;
+    void *server_handle;
+    char addrbuf[CLIENT_ADDR_BUFSIZE];
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_mutex_t write_lock;
+    struct worker *workers;
+    int nworkers;
+    int nstarted;
+    krb5_boolean stopping;
+    struct worker_job *queue_head, *queue_tail;
+    struct worker_job *done_head, *done_tail;
+    int pipefds[2];
+    verto_ev *ev;
+} pool = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, FALSE, NULL, NULL, NULL, NULL,
+    { -1, -1 }, NULL
+};
+
+static pthread_key_t worker_key;
+static krb5_boolean worker_key_created;
+
+/* Append job to the list given by head and tail. */
+static void
+append_job(struct worker_job **head, struct worker_job **tail,
+           struct worker_job *job)
+{
+    job->next = NULL;
+    if (*tail != NULL)
+        (*tail)->next = job;
+    else
+        *head = job;
+    *tail = job;
+}
+
+void
+workers_run(struct worker_job *job)
+{
+    krb5_boolean serialize = job->exclusive || !PARALLEL_READS;
+
+    if (serialize)
+        pthread_mutex_lock(&pool.write_lock);
+    job->run(job);
+    if (serialize)
+        pthread_mutex_unlock(&pool.write_lock);
+}
+
+static void *
+worker_main(void *arg)
+{
+    struct worker *w = arg;
+    struct worker_job *job;
+    krb5_boolean wake;
+    ssize_t nwritten;
+
+    (void)pthread_setspecific(worker_key, w);
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (pool.queue_head == NULL && !pool.stopping)
+            pthread_cond_wait(&pool.cond, &pool.lock);
+        job = pool.queue_head;
+        if (job == NULL)
+            break;
+        pool.queue_head = job->next;
+        if (pool.queue_head == NULL)
+            pool.queue_tail = NULL;
+        pthread_mutex_unlock(&pool.lock);
+
+        workers_run(job);
+
+        /* Wake the main loop if it isn't already due to collect jobs. */
+        pthread_mutex_lock(&pool.lock);
+        wake = (pool.done_head == NULL);
+        append_job(&pool.done_head, &pool.done_tail, job);
+        if (wake) {
+            nwritten = write(pool.pipefds[1], "", 1);
+            (void)nwritten;
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+/* Call the done function of each finished job, on the main loop thread. */
+static void
+finish_jobs(void)
+{
+    struct worker_job *job, *next;
+    char buf[64];
+
+    while (read(pool.pipefds[0], buf, sizeof(buf)) > 0);
+
+    pthread_mutex_lock(&pool.lock);
+    job = pool.done_head;
+    pool.done_head = pool.done_tail = NULL;
+    pthread_mutex_unlock(&pool.lock);
+
+    for (; job != NULL; job = next) {
+        next = job->next;
+        job->done(job);
+    }
+}
+
+static void
+process_done(verto_ctx *ctx, verto_ev *ev)
+{
+    finish_jobs();
+}
+
+/* Return true if the realm's KDB module can be opened more than once in a
+ * process.  LMDB environments cannot. */
+static krb5_boolean
+kdb_allows_workers(krb5_context context, const char *realm)
+{
+    profile_t profile = NULL;
+    char *module = NULL, *lib = NULL;
+    krb5_boolean ok = TRUE;
+
+    if (krb5_get_profile(context, &profile) != 0)
+        return TRUE;
+    if (profile_get_string(profile, KDB_REALM_SECTION, realm,
+                           KDB_MODULE_POINTER, realm, &module) == 0 &&
+        profile_get_string(profile, KDB_MODULE_SECTION, module,
+                           KDB_LIB_POINTER, "db2", &lib) == 0)
+        ok = (strcmp(lib, "klmdb") != 0);
+    profile_release_string(module);
+    profile_release_string(lib);
+    profile_release(profile);
+    return ok;
+}
+
+/* Create the krb5 context and server handle for w. */
+static krb5_error_code
+init_worker(struct worker *w, kadm5_config_params *params, char **db_args)
+{
+    krb5_error_code ret;
+
+    ret = kadm5_init_krb5_context(&w->context);
+    if (ret)
+        return ret;
+    ret = kadm5_init(w->context, "kadmind", NULL, NULL, params,
+                     KADM5_STRUCT_VERSION, KADM5_API_VERSION_4, db_args,
+                     &w->server_handle);
+    if (ret)
+        return ret;
+    if (params->iprop_enabled) {
+        ulog_set_role(w->context, IPROP_PRIMARY);
+        ret = ulog_map(w->context, params->iprop_logfile,
+                       params->iprop_ulogsize);
+        if (ret)
+            return ret;
+    }
+    return 0;
+}
+
+krb5_error_code
+workers_start(krb5_context context, verto_ctx *vctx, int nworkers,
+              kadm5_config_params *params, char **db_args)
+{
+    krb5_error_code ret;
+    const char *emsg;
+    int i;
+
+    if (params->mkey_from_kbd) {
+        k5_setmsg(context, EINVAL, _("Worker threads cannot be used when the "
+                                     "master key is read from the keyboard"));
+        return EINVAL;
+    }
+    if (!kdb_allows_workers(context, params->realm)) {
+        k5_setmsg(context, EINVAL, _("Worker threads cannot be used with the "
+                                     "LMDB database module"));
+        return EINVAL;
+    }
+
+    if (!worker_key_created) {
+        ret = pthread_key_create(&worker_key, NULL);
+        if (ret)
+            return ret;
+        worker_key_created = TRUE;
+    }
+
+    if (pipe(pool.pipefds) != 0)
+        return errno;
+    (void)fcntl(pool.pipefds[0], F_SETFL, O_NONBLOCK);
+    (void)fcntl(pool.pipefds[1], F_SETFL, O_NONBLOCK);
+    set_cloexec_fd(pool.pipefds[0]);
+    set_cloexec_fd(pool.pipefds[1]);
+    pool.ev = verto_add_io(vctx, VERTO_EV_FLAG_IO_READ | VERTO_EV_FLAG_PERSIST,
+                           process_done, pool.pipefds[0]);
+    if (pool.ev == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+
+    pool.workers = calloc(nworkers, sizeof(*pool.workers));
+    if (pool.workers == NULL) {
+        ret = ENOMEM;
+        goto fail;
+    }
+    pool.nworkers = nworkers;
+    for (i = 0; i < nworkers; i++) {
+        ret = init_worker(&pool.workers[i], params, db_args);
+        if (ret) {
+            if (pool.workers[i].context != NULL) {
+                emsg = krb5_get_error_message(pool.workers[i].context, ret);
+                k5_setmsg(context, ret, "%s", emsg);
+                krb5_free_error_message(pool.workers[i].context, emsg);
+            }
+            goto fail;
+        }
+    }
+    for (i = 0; i < nworkers; i++) {
+        ret = pthread_create(&pool.workers[i].thread, NULL, worker_main,
+                             &pool.workers[i]);
+        if (ret)
+            goto fail;
+        pool.nstarted++;
+    }
+
+    krb5_klog_syslog(LOG_INFO, _("started %d worker threads"), nworkers);
+    return 0;
+
+fail:
+    workers_stop();
+    return ret;
+}
+
+krb5_boolean
+workers_running(void)
+{
+    return pool.nstarted > 0;
+}
+
+void
+workers_submit(struct worker_job *job)
+{
+    pthread_mutex_lock(&pool.lock);
+    append_job(&pool.queue_head, &pool.queue_tail, job);
+    pthread_cond_signal(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+void
+workers_stop(void)
+{
+    struct worker *w;
+    int i;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.stopping = TRUE;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+    for (i = 0; i < pool.nstarted; i++)
+        pthread_join(pool.workers[i].thread, NULL);
+    pool.nstarted = 0;
+
+    /* Send the replies for anything the workers finished. */
+    if (pool.pipefds[0] != -1)
+        finish_jobs();
+
+    for (i = 0; i < pool.nworkers; i++) {
+        w = &pool.workers[i];
+        if (w->server_handle != NULL)
+            kadm5_destroy(w->server_handle);
+        if (w->context != NULL)
+            krb5_free_context(w->context);
+    }
+    free(pool.workers);
+    pool.workers = NULL;
+    pool.nworkers = 0;
+
+    if (pool.ev != NULL)
+        verto_del(pool.ev);
+    pool.ev = NULL;
+    if (pool.pipefds[0] != -1) {
+        close(pool.pipefds[0]);
+        close(pool.pipefds[1]);
+    }
+    pool.pipefds[0] = pool.pipefds[1] = -1;
+    pool.stopping = FALSE;
+}
+
+void
+workers_lock_exclusive(void)
+{
+    pthread_mutex_lock(&pool.write_lock);
+}
+
+void
+workers_unlock_exclusive(void)
+{
+    pthread_mutex_unlock(&pool.write_lock);
+}
+
+static struct worker *
+current_worker(void)
+{
+    return worker_key_created ? pthread_getspecific(worker_key) : NULL;
+}
+
+void *
+thread_server_handle(void)
+{
+    struct worker *w = current_worker();
+
+    return (w != NULL) ? w->server_handle : global_server_handle;
+}
+
+char *
+thread_addr_buf(void)
+{
+    struct worker *w = current_worker();
+
+    return (w != NULL) ? w->addrbuf : NULL;
+}
+
+#else /* !(ENABLE_THREADS && HAVE_PTHREAD) */
+
+krb5_error_code
+workers_start(krb5_context context, verto_ctx *vctx, int nworkers,
+              kadm5_config_params *params, char **db_args)
+{
+    k5_setmsg(context, EINVAL,
+              _("Worker threads are not supported in this build"));
+    return EINVAL;
+}
+
+krb5_boolean
+workers_running(void)
+{
+    return FALSE;
+}
+
+void
+workers_run(struct worker_job *job)
+{
+    job->run(job);
+}
+
+void
+workers_submit(struct worker_job *job)
+{
+    job->run(job);
+    job->done(job);
+}
+
+void
+workers_stop(void)
+{
+}
+
+void
+workers_lock_exclusive(void)
+{
+}
+
+void
+workers_unlock_exclusive(void)
+{
+}
+
+void *
+thread_server_handle(void)
+{
+    return global_server_handle;
+}
+
+char *
+thread_addr_buf(void)
+{
+    return NULL;
+}
+
+#endif /* !(ENABLE_THREADS && HAVE_PTHREAD) */
@@ -0,0 +1,85 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kadmin/server/workers.h - kadmind worker thread pool */
+/*
+ * Copyright (C) 2021 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <verto.h>
+
+/*
+ * A unit of work for the pool.  run() is called on a worker thread and done()
+ * is called afterwards on the main loop thread.  Jobs with exclusive set run
+ * one at a time; other jobs may run concurrently with each other and with an
+ * exclusive job, relying on KDB locking.
+ */
+struct worker_job {
+    void (*run)(struct worker_job *job);
+    void (*done)(struct worker_job *job);
+    krb5_boolean exclusive;
+    struct worker_job *next;
+};
+
+/* Start nworkers threads, each with its own kadm5 server handle created from
+ * params and db_args, and watch for finished jobs in vctx. */
+krb5_error_code workers_start(krb5_context context, verto_ctx *vctx,
+                              int nworkers, kadm5_config_params *params,
+                              char **db_args);
+
+/* Return true if the worker pool has been started. */
+krb5_boolean workers_running(void);
+
+/* Run job on the calling thread, serialized with other jobs as it would be on
+ * a worker thread. */
+void workers_run(struct worker_job *job);
+
+/* Queue job for a worker thread. */
+void workers_submit(struct worker_job *job);
+
+/* Finish all queued jobs, stop the worker threads, and release their server
+ * handles. */
+void workers_stop(void);
+
+/* Take or release the lock serializing exclusive jobs, for database writes
+ * made on the main loop thread. */
+void workers_lock_exclusive(void);
+void workers_unlock_exclusive(void);
+
+/* Return the kadm5 server handle to use on the calling thread: the worker's
+ * own handle on a worker thread, or global_server_handle otherwise. */
+void *thread_server_handle(void);
+
+/* Return a per-worker buffer of CLIENT_ADDR_BUFSIZE bytes for client_addr(),
+ * or NULL if the calling thread is not a worker. */
+#define CLIENT_ADDR_BUFSIZE 128
+char *thread_addr_buf(void);
+
+#endif /* WORKERS_H */
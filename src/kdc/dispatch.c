@@ -45,6 +45,8 @@ struct dispatch_state {
     int is_tcp;
     kdc_realm_t *active_realm;
     krb5_context kdc_err_context;
+    uint64_t start;
+    enum kdc_metrics_phase phase;
 };
 
 static void
@@ -65,6 +67,8 @@ finish_dispatch(struct dispatch_state *state, krb5_error_code code,
                              "KRB_ERR_RESPONSE_TOO_BIG error: %s",
                              error_message(code));
     }
+    if (kdc_active_realm != NULL)
+        kdc_metrics_record(kdc_context, state->phase, state->start);
 
     free(state);
     (*oldrespond)(oldarg, code, response);
@@ -90,6 +94,19 @@ finish_dispatch_cache(void *arg, krb5_error_code code, krb5_data *response)
     finish_dispatch(state, code, response);
 }
 
+/* Drop a throttled request, or answer it with an error telling the client to
+ * try another KDC. */
+static void
+finish_throttled(struct dispatch_state *state, kdc_realm_t *realm)
+{
+    krb5_data *response;
+
+    if (kdc_make_throttle_error(realm, &response) != 0 || response == NULL)
+        finish_dispatch(state, KRB5KDC_ERR_DISCARD, NULL);
+    else
+        finish_dispatch(state, 0, response);
+}
+
 static void
 reseed_random(krb5_context kdc_err_context)
 {
@@ -127,6 +144,7 @@ dispatch(void *cb, const krb5_fulladdr *local_addr,
     krb5_kdc_req *req = NULL;
     krb5_data *response = NULL;
     struct dispatch_state *state;
+    kdc_realm_t *realm;
     struct server_handle *handle = cb;
     krb5_context kdc_err_context = handle->kdc_err_context;
 
@@ -140,6 +158,15 @@ dispatch(void *cb, const krb5_fulladdr *local_addr,
     state->request = pkt;
     state->is_tcp = is_tcp;
     state->kdc_err_context = kdc_err_context;
+    state->start = kdc_metrics_now();
+
+    /* Shed requests from sources over their rate limit before doing any other
+     * work. */
+    if (kdc_throttle_address(remote_addr->address)) {
+        kdc_metrics_throttle(FALSE);
+        finish_throttled(state, handle->kdc_realmlist[0]);
+        return;
+    }
 
     /* decode incoming packet, and dispatch */
 
@@ -150,6 +177,7 @@ dispatch(void *cb, const krb5_fulladdr *local_addr,
         const char *name = 0;
         char buf[46];
 
+        kdc_metrics_lookaside(TRUE);
         name = inet_ntop(ADDRTYPE2FAMILY(remote_addr->address->addrtype),
                          remote_addr->address->contents, buf, sizeof(buf));
         if (name == 0)
@@ -170,14 +198,18 @@ dispatch(void *cb, const krb5_fulladdr *local_addr,
 
     /* Insert a NULL entry into the lookaside to indicate that this request
      * is currently being processed. */
+    kdc_metrics_lookaside(FALSE);
     kdc_insert_lookaside(kdc_err_context, pkt, NULL);
 #endif
     reseed_random(kdc_err_context);
 
     /* try TGS_REQ first; they are more common! */
 
+    /* TGS requests are processed synchronously while pkt is still valid, and
+     * do not replace parts of the request, so decode them into an arena.  AS
+     * request processing may replace the client principal. */
     if (krb5_is_tgs_req(pkt))
-        retval = decode_krb5_tgs_req(pkt, &req);
+        retval = decode_krb5_tgs_req_arena(pkt, &req);
     else if (krb5_is_as_req(pkt))
         retval = decode_krb5_as_req(pkt, &req);
     else
@@ -185,12 +217,28 @@ dispatch(void *cb, const krb5_fulladdr *local_addr,
     if (retval)
         goto done;
 
-    state->active_realm = setup_server_realm(handle, req->server);
-    if (state->active_realm == NULL) {
+    realm = setup_server_realm(handle, req->server);
+    if (realm == NULL) {
         retval = KRB5KDC_ERR_WRONG_REALM;
         goto done;
     }
 
+    /* Shed AS requests for client principals over their rate limit before
+     * looking up the client or verifying preauth. */
+    if (krb5_is_as_req(pkt) && req->client != NULL &&
+        kdc_throttle_principal(realm->realm_context, req->client)) {
+        kdc_metrics_throttle(TRUE);
+#ifndef NOCACHE
+        kdc_remove_lookaside(kdc_err_context, pkt);
+#endif
+        krb5_free_kdc_req(kdc_err_context, req);
+        finish_throttled(state, realm);
+        return;
+    }
+    state->active_realm = realm;
+
+    state->phase = krb5_is_tgs_req(pkt) ? KDC_METRICS_TGS_REQ :
+        KDC_METRICS_AS_REQ;
     if (krb5_is_tgs_req(pkt)) {
         /* process_tgs_req frees the request */
         retval = process_tgs_req(req, pkt, remote_addr, state->active_realm,
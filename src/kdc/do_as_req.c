@@ -91,20 +91,19 @@ get_key_exp(krb5_db_entry *entry)
 }
 
 /*
- * Find the key in client for the most preferred enctype in req_enctypes.  Fill
- * in *kb_out with the decrypted keyblock (which the caller must free) and set
- * *kd_out to an alias to that key data entry.  Set *kd_out to NULL and leave
- * *kb_out zeroed if no key is found for any of the requested enctypes.
- * kb_out->enctype may differ from the enctype of *kd_out for DES enctypes; in
- * this case, kb_out->enctype is the requested enctype used to match the key
- * data entry.
+ * Find the key in client for the most preferred enctype in req_enctypes.  Set
+ * *kd_out to an alias to that key data entry and kb_out->enctype to the
+ * matching request enctype, leaving the rest of *kb_out zeroed; the key is
+ * decrypted later by load_client_key(), only if it is needed.  Set *kd_out to
+ * NULL and leave *kb_out zeroed if no key is found for any of the requested
+ * enctypes.  kb_out->enctype may differ from the enctype of *kd_out for DES
+ * enctypes.
  */
-static krb5_error_code
+static void
 select_client_key(krb5_context context, krb5_db_entry *client,
                   krb5_enctype *req_enctypes, int n_req_enctypes,
                   krb5_keyblock *kb_out, krb5_key_data **kd_out)
 {
-    krb5_error_code ret;
     krb5_key_data *kd;
     krb5_enctype etype;
     int i;
@@ -117,36 +116,34 @@ select_client_key(krb5_context context, krb5_db_entry *client,
         if (!krb5_c_valid_enctype(etype))
             continue;
         if (krb5_dbe_find_enctype(context, client, etype, -1, 0, &kd) == 0) {
-            /* Decrypt the client key data and set its enctype to the request
-             * enctype (which may differ from the key data enctype for DES). */
-            ret = krb5_dbe_decrypt_key_data(context, NULL, kd, kb_out, NULL);
-            if (ret)
-                return ret;
             kb_out->enctype = etype;
             *kd_out = kd;
-            return 0;
+            return;
         }
     }
-    return 0;
 }
 
 static krb5_error_code
 lookup_client(krb5_context context, krb5_kdc_req *req, unsigned int flags,
               krb5_db_entry **entry_out)
 {
+    krb5_error_code ret;
     krb5_pa_data *pa;
     krb5_data cert;
+    uint64_t start = kdc_metrics_now();
 
     *entry_out = NULL;
     pa = krb5int_find_pa_data(context, req->padata, KRB5_PADATA_S4U_X509_USER);
     if (pa != NULL && pa->length != 0 &&
         req->client->type == KRB5_NT_X500_PRINCIPAL) {
         cert = make_data(pa->contents, pa->length);
-        return krb5_db_get_s4u_x509_principal(context, &cert, req->client,
-                                              flags, entry_out);
+        ret = krb5_db_get_s4u_x509_principal(context, &cert, req->client,
+                                             flags, entry_out);
     } else {
-        return krb5_db_get_principal(context, req->client, flags, entry_out);
+        ret = krb5_db_get_principal(context, req->client, flags, entry_out);
     }
+    kdc_metrics_record(context, KDC_METRICS_KDB, start);
+    return ret;
 }
 
 struct as_req_state {
@@ -200,6 +197,7 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
     void *oldarg;
     kdc_realm_t *kdc_active_realm = state->active_realm;
     krb5_audit_state *au_state = state->au_state;
+    uint64_t start;
 
     assert(state);
     oldrespond = state->respond;
@@ -242,6 +240,12 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
     state->reply_encpart.caddrs = state->enc_tkt_reply.caddrs;
     state->reply_encpart.enc_padata = NULL;
 
+    errcode = load_client_key(kdc_context, &state->rock);
+    if (errcode) {
+        state->status = "DECRYPT_CLIENT_KEY";
+        goto egress;
+    }
+
     /* Fetch the padata info to be returned (do this before
      *  authdata to handle possible replacement of reply key
      */
@@ -281,8 +285,10 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
         goto egress;
     }
 
+    start = kdc_metrics_now();
     errcode = krb5_encrypt_tkt_part(kdc_context, &state->server_keyblock,
                                     &state->ticket_reply);
+    kdc_metrics_record(kdc_context, KDC_METRICS_CRYPTO, start);
     if (errcode)
         goto egress;
 
@@ -317,10 +323,12 @@ finish_process_as_req(struct as_req_state *state, krb5_error_code errcode)
 
     if (kdc_fast_hide_client(state->rstate))
         state->reply.client = (krb5_principal)krb5_anonymous_principal();
+    start = kdc_metrics_now();
     errcode = krb5_encode_kdc_rep(kdc_context, KRB5_AS_REP,
                                   &state->reply_encpart, 0,
                                   as_encrypting_key,
                                   &state->reply, &response);
+    kdc_metrics_record(kdc_context, KDC_METRICS_CRYPTO, start);
     if (state->client_key != NULL)
         state->reply.enc_part.kvno = state->client_key->key_data_kvno;
     if (errcode)
@@ -478,6 +486,7 @@ process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
     krb5_enctype useenctype;
     struct as_req_state *state;
     krb5_audit_state *au_state = NULL;
+    uint64_t start;
 
     state = k5alloc(sizeof(*state), &errcode);
     if (state == NULL) {
@@ -606,8 +615,10 @@ process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
     if (isflagset(state->request->kdc_options, KDC_OPT_CANONICALIZE)) {
         setflag(s_flags, KRB5_KDB_FLAG_CANONICALIZE);
     }
+    start = kdc_metrics_now();
     errcode = krb5_db_get_principal(kdc_context, state->request->server,
                                     s_flags, &state->server);
+    kdc_metrics_record(kdc_context, KDC_METRICS_KDB, start);
     if (errcode == KRB5_KDB_CANTLOCK_DB)
         errcode = KRB5KDC_ERR_SVC_UNAVAILABLE;
     if (errcode == KRB5_KDB_NOENTRY) {
@@ -749,13 +760,9 @@ process_as_req(krb5_kdc_req *request, krb5_data *req_pkt,
         setflag(state->client->attributes, KRB5_KDB_REQUIRES_PRE_AUTH);
     }
 
-    errcode = select_client_key(kdc_context, state->client,
-                                state->request->ktype, state->request->nktypes,
-                                &state->client_keyblock, &state->client_key);
-    if (errcode) {
-        state->status = "DECRYPT_CLIENT_KEY";
-        goto errout;
-    }
+    select_client_key(kdc_context, state->client, state->request->ktype,
+                      state->request->nktypes, &state->client_keyblock,
+                      &state->client_key);
     if (state->client_key != NULL) {
         state->rock.client_key = state->client_key;
         state->rock.client_keyblock = &state->client_keyblock;
@@ -138,6 +138,7 @@ process_tgs_req(krb5_kdc_req *request, krb5_data *pkt,
     krb5_kvno ticket_kvno = 0;
     struct kdc_request_state *state = NULL;
     krb5_pa_data *pa_tgs_req; /*points into request*/
+    uint64_t start;
     krb5_data scratch;
     krb5_pa_data **e_data = NULL;
     krb5_audit_state *au_state = NULL;
@@ -673,8 +674,10 @@ process_tgs_req(krb5_kdc_req *request, krb5_data *pkt,
         ticket_kvno = current_kvno(server);
     }
 
+    start = kdc_metrics_now();
     errcode = krb5_encrypt_tkt_part(kdc_context, encrypting_key,
                                     &ticket_reply);
+    kdc_metrics_record(kdc_context, KDC_METRICS_CRYPTO, start);
     if (errcode)
         goto cleanup;
     ticket_reply.enc_part.kvno = ticket_kvno;
@@ -745,10 +748,12 @@ process_tgs_req(krb5_kdc_req *request, krb5_data *pkt,
 
     if (kdc_fast_hide_client(state))
         reply.client = (krb5_principal)krb5_anonymous_principal();
+    start = kdc_metrics_now();
     errcode = krb5_encode_kdc_rep(kdc_context, KRB5_TGS_REP, &reply_encpart,
                                   subkey ? 1 : 0,
                                   reply_key,
                                   &reply, response);
+    kdc_metrics_record(kdc_context, KDC_METRICS_CRYPTO, start);
     if (!errcode)
         status = "ISSUE";
 
@@ -928,6 +933,7 @@ decrypt_2ndtkt(kdc_realm_t *kdc_active_realm, krb5_kdc_req *req,
     krb5_db_entry *server = NULL;
     krb5_kvno kvno;
     krb5_ticket *stkt;
+    uint64_t start;
 
     if (!(req->kdc_options & STKT_OPTIONS))
         return 0;
@@ -939,8 +945,10 @@ decrypt_2ndtkt(kdc_realm_t *kdc_active_realm, krb5_kdc_req *req,
         *status = "2ND_TKT_SERVER";
         goto cleanup;
     }
+    start = kdc_metrics_now();
     retval = krb5_decrypt_tkt_part(kdc_context, *key_out,
                                    req->second_ticket[0]);
+    kdc_metrics_record(kdc_context, KDC_METRICS_CRYPTO, start);
     if (retval != 0) {
         *status = "2ND_TKT_DECRYPT";
         goto cleanup;
@@ -1180,8 +1188,10 @@ db_get_svc_princ(krb5_context ctx, krb5_principal princ,
                  const char **status)
 {
     krb5_error_code ret;
+    uint64_t start = kdc_metrics_now();
 
     ret = krb5_db_get_principal(ctx, princ, flags, server);
+    kdc_metrics_record(ctx, KDC_METRICS_KDB, start);
     if (ret == KRB5_KDB_CANTLOCK_DB)
         ret = KRB5KDC_ERR_SVC_UNAVAILABLE;
     if (ret != 0) {
@@ -69,6 +69,9 @@ log_as_req(krb5_context context,
     const char *cname2 = cname ? cname : "<unknown client>";
     const char *sname2 = sname ? sname : "<unknown server>";
 
+    kdc_metrics_request(context, KDC_METRICS_AS_REQ,
+                        (status == NULL) ? 0 : errcode);
+
     fromstring = inet_ntop(ADDRTYPE2FAMILY(remote_addr->address->addrtype),
                            remote_addr->address->contents,
                            fromstringbuf, sizeof(fromstringbuf));
@@ -131,6 +134,9 @@ log_tgs_req(krb5_context ctx, const krb5_fulladdr *from,
     char *cname = NULL, *sname = NULL, *altcname = NULL;
     char *logcname = NULL, *logsname = NULL, *logaltcname = NULL;
 
+    kdc_metrics_request(ctx, KDC_METRICS_TGS_REQ,
+                        (status == NULL) ? 0 : errcode);
+
     fromstring = inet_ntop(ADDRTYPE2FAMILY(from->address->addrtype),
                            from->address->contents,
                            fromstringbuf, sizeof(fromstringbuf));
@@ -0,0 +1,656 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kdc/kdc_metrics.c - KDC request counters and latency histograms */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The KDC keeps per-realm request and error counters, preauth type counts,
+ * lookaside and preauth hint cache hit counts, counts of requests shed by rate
+ * limits, and latency histograms for whole requests and for the principal
+ * lookup, crypto, and preauth verification phases.  When kdc_metrics_socket
+ * is set, these live in an anonymous shared mapping created before the worker
+ * processes are forked, with a separate slot for each worker so that updates
+ * need no locking.  Any worker may accept a connection on the metrics socket;
+ * it sums the slots and writes the totals in the Prometheus text exposition
+ * format, then closes the connection.  Counters from other workers are read
+ * without synchronization, so a value may be a single update behind.
+ *
+ * Latencies are recorded in microseconds into log-linear buckets in the style
+ * of HDR histograms: each power of two is divided into eight sub-buckets, so
+ * a bucket's width is at most an eighth of its value.  Histograms are exported
+ * with power-of-two bucket bounds, which coincide with sub-bucket bounds, so
+ * the exported counts are exact.
+ */
+
+#include "k5-int.h"
+#include "kdc_util.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define SUB_BITS 3
+#define SUB_COUNT (1 << SUB_BITS)
+#define MAX_EXPONENT 31
+#define LINEAR_COUNT (2 * SUB_COUNT)
+#define NBUCKETS (LINEAR_COUNT + (MAX_EXPONENT - SUB_BITS) * SUB_COUNT)
+
+#define NERRORS (KRB_ERR_MAX + 1)
+#define NPREAUTH 16
+
+struct histogram {
+    uint64_t buckets[NBUCKETS];
+    uint64_t count;
+    uint64_t sum_us;
+};
+
+struct preauth_count {
+    krb5_preauthtype type;
+    uint64_t count;
+};
+
+struct realm_counters {
+    uint64_t requests[2];
+    uint64_t errors[2][NERRORS];
+    struct preauth_count preauth[NPREAUTH];
+    uint64_t preauth_other;
+    struct histogram phases[KDC_METRICS_NPHASES];
+};
+
+struct slot {
+    uint64_t lookaside_hits;
+    uint64_t lookaside_misses;
+    uint64_t hint_hits;
+    uint64_t hint_misses;
+    uint64_t throttled[2];
+    /* Followed by nrealms realm_counters structures. */
+};
+
+static const char *const phase_names[KDC_METRICS_NPHASES] = {
+    "as_req", "tgs_req", "kdb", "crypto", "preauth"
+};
+
+static const char *const req_names[2] = { "as", "tgs" };
+
+static void *region;
+static size_t region_size, slot_size;
+static int nslots, nrealms, myslot;
+static char **realm_names;
+static krb5_context *realm_contexts;
+static verto_ev *listen_ev;
+
+static struct slot *
+get_slot(int n)
+{
+    return (struct slot *)((char *)region + n * slot_size);
+}
+
+static struct realm_counters *
+slot_realm(struct slot *slot, int n)
+{
+    return (struct realm_counters *)(slot + 1) + n;
+}
+
+/* Return the counters for the realm whose context is context in this
+ * process's slot, or NULL if metrics are not enabled. */
+static struct realm_counters *
+find_counters(krb5_context context)
+{
+    int i;
+
+    if (region == NULL)
+        return NULL;
+    for (i = 0; i < nrealms; i++) {
+        if (realm_contexts[i] == context)
+            return slot_realm(get_slot(myslot), i);
+    }
+    return NULL;
+}
+
+/* Return the histogram bucket index for a value of us microseconds. */
+static int
+bucket_index(uint64_t us)
+{
+    int e = 0;
+
+    if (us < LINEAR_COUNT)
+        return us;
+    while ((us >> e) >= SUB_COUNT * 2)
+        e++;
+    if (e + SUB_BITS > MAX_EXPONENT)
+        return NBUCKETS - 1;
+    return LINEAR_COUNT + (e - 1) * SUB_COUNT + ((us >> e) & (SUB_COUNT - 1));
+}
+
+/* Return the lowest value in bucket i. */
+static uint64_t
+bucket_low(int i)
+{
+    int e;
+
+    if (i < LINEAR_COUNT)
+        return i;
+    e = (i - LINEAR_COUNT) / SUB_COUNT + 1;
+    return (uint64_t)(SUB_COUNT + (i - LINEAR_COUNT) % SUB_COUNT) << e;
+}
+
+uint64_t
+kdc_metrics_now(void)
+{
+    struct timespec ts;
+
+    if (region == NULL || clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void
+kdc_metrics_record(krb5_context context, enum kdc_metrics_phase phase,
+                   uint64_t start)
+{
+    struct realm_counters *rc;
+    struct histogram *h;
+    uint64_t now, us;
+
+    if (start == 0)
+        return;
+    rc = find_counters(context);
+    now = kdc_metrics_now();
+    if (rc == NULL || now == 0)
+        return;
+    us = (now > start) ? now - start : 0;
+    h = &rc->phases[phase];
+    h->buckets[bucket_index(us)]++;
+    h->count++;
+    h->sum_us += us;
+}
+
+void
+kdc_metrics_request(krb5_context context, enum kdc_metrics_phase type,
+                    krb5_error_code code)
+{
+    struct realm_counters *rc;
+    int t = (type == KDC_METRICS_TGS_REQ) ? 1 : 0;
+
+    rc = find_counters(context);
+    if (rc == NULL)
+        return;
+    rc->requests[t]++;
+    if (code != 0) {
+        code -= ERROR_TABLE_BASE_krb5;
+        if (code < 0 || code > KRB_ERR_MAX)
+            code = KRB_ERR_GENERIC;
+        rc->errors[t][code]++;
+    }
+}
+
+void
+kdc_metrics_preauth(krb5_context context, krb5_preauthtype type)
+{
+    struct realm_counters *rc;
+    int i;
+
+    rc = find_counters(context);
+    if (rc == NULL)
+        return;
+    for (i = 0; i < NPREAUTH; i++) {
+        if (rc->preauth[i].count == 0)
+            rc->preauth[i].type = type;
+        if (rc->preauth[i].type == type) {
+            rc->preauth[i].count++;
+            return;
+        }
+    }
+    rc->preauth_other++;
+}
+
+void
+kdc_metrics_lookaside(krb5_boolean hit)
+{
+    struct slot *slot;
+
+    if (region == NULL)
+        return;
+    slot = get_slot(myslot);
+    if (hit)
+        slot->lookaside_hits++;
+    else
+        slot->lookaside_misses++;
+}
+
+void
+kdc_metrics_hint_cache(krb5_boolean hit)
+{
+    struct slot *slot;
+
+    if (region == NULL)
+        return;
+    slot = get_slot(myslot);
+    if (hit)
+        slot->hint_hits++;
+    else
+        slot->hint_misses++;
+}
+
+void
+kdc_metrics_throttle(krb5_boolean principal)
+{
+    if (region == NULL)
+        return;
+    get_slot(myslot)->throttled[principal ? 1 : 0]++;
+}
+
+/* Add s to buf as a label value, escaping as the exposition format
+ * requires. */
+static void
+add_label(struct k5buf *buf, const char *s)
+{
+    for (; *s != '\0'; s++) {
+        if (*s == '\\' || *s == '"')
+            k5_buf_add_fmt(buf, "\\%c", *s);
+        else if (*s == '\n')
+            k5_buf_add(buf, "\\n");
+        else
+            k5_buf_add_len(buf, s, 1);
+    }
+}
+
+static void
+add_header(struct k5buf *buf, const char *name, const char *type,
+           const char *help)
+{
+    k5_buf_add_fmt(buf, "# HELP %s %s\n# TYPE %s %s\n", name, help, name,
+                   type);
+}
+
+/* Add the start of a sample line for metric name in realm r. */
+static void
+add_sample(struct k5buf *buf, const char *name, int r)
+{
+    k5_buf_add_fmt(buf, "%s{realm=\"", name);
+    add_label(buf, realm_names[r]);
+    k5_buf_add(buf, "\"");
+}
+
+/* Sum the realm r counters of every slot into *sum. */
+static void
+sum_realm(int r, struct realm_counters *sum)
+{
+    struct realm_counters *rc;
+    int s, i, j, t, p;
+
+    memset(sum, 0, sizeof(*sum));
+    for (s = 0; s < nslots; s++) {
+        rc = slot_realm(get_slot(s), r);
+        for (t = 0; t < 2; t++) {
+            sum->requests[t] += rc->requests[t];
+            for (i = 0; i < NERRORS; i++)
+                sum->errors[t][i] += rc->errors[t][i];
+        }
+        sum->preauth_other += rc->preauth_other;
+        for (i = 0; i < NPREAUTH && rc->preauth[i].count > 0; i++) {
+            for (j = 0; j < NPREAUTH; j++) {
+                if (sum->preauth[j].count == 0)
+                    sum->preauth[j].type = rc->preauth[i].type;
+                if (sum->preauth[j].type == rc->preauth[i].type)
+                    break;
+            }
+            if (j < NPREAUTH)
+                sum->preauth[j].count += rc->preauth[i].count;
+            else
+                sum->preauth_other += rc->preauth[i].count;
+        }
+        for (p = 0; p < KDC_METRICS_NPHASES; p++) {
+            sum->phases[p].count += rc->phases[p].count;
+            sum->phases[p].sum_us += rc->phases[p].sum_us;
+            for (i = 0; i < NBUCKETS; i++)
+                sum->phases[p].buckets[i] += rc->phases[p].buckets[i];
+        }
+    }
+}
+
+static void
+add_histogram(struct k5buf *buf, int r, int phase, const struct histogram *h)
+{
+    uint64_t cum = 0;
+    int i, e;
+
+    /* Emit a bucket at each power of two from 16us up. */
+    i = 0;
+    for (e = SUB_BITS + 1; e <= MAX_EXPONENT; e++) {
+        for (; i < NBUCKETS && bucket_low(i) < ((uint64_t)1 << e); i++)
+            cum += h->buckets[i];
+        add_sample(buf, "kdc_phase_duration_seconds_bucket", r);
+        k5_buf_add_fmt(buf, ",phase=\"%s\",le=\"%g\"} %llu\n",
+                       phase_names[phase], ((uint64_t)1 << e) / 1e6,
+                       (unsigned long long)cum);
+    }
+    add_sample(buf, "kdc_phase_duration_seconds_bucket", r);
+    k5_buf_add_fmt(buf, ",phase=\"%s\",le=\"+Inf\"} %llu\n",
+                   phase_names[phase], (unsigned long long)h->count);
+    add_sample(buf, "kdc_phase_duration_seconds_sum", r);
+    k5_buf_add_fmt(buf, ",phase=\"%s\"} %.6f\n", phase_names[phase],
+                   h->sum_us / 1e6);
+    add_sample(buf, "kdc_phase_duration_seconds_count", r);
+    k5_buf_add_fmt(buf, ",phase=\"%s\"} %llu\n", phase_names[phase],
+                   (unsigned long long)h->count);
+}
+
+/* Format the summed metrics of all slots into buf. */
+static void
+format_metrics(struct k5buf *buf)
+{
+    struct realm_counters *sums;
+    uint64_t hits = 0, misses = 0, hint_hits = 0, hint_misses = 0;
+    uint64_t throttled[2] = { 0, 0 };
+    int s, r, t, i, p;
+
+    for (s = 0; s < nslots; s++) {
+        hits += get_slot(s)->lookaside_hits;
+        misses += get_slot(s)->lookaside_misses;
+        hint_hits += get_slot(s)->hint_hits;
+        hint_misses += get_slot(s)->hint_misses;
+        throttled[0] += get_slot(s)->throttled[0];
+        throttled[1] += get_slot(s)->throttled[1];
+    }
+    add_header(buf, "kdc_lookaside_hits_total", "counter",
+               "Requests answered from the lookaside cache.");
+    k5_buf_add_fmt(buf, "kdc_lookaside_hits_total %llu\n",
+                   (unsigned long long)hits);
+    add_header(buf, "kdc_lookaside_misses_total", "counter",
+               "Requests not found in the lookaside cache.");
+    k5_buf_add_fmt(buf, "kdc_lookaside_misses_total %llu\n",
+                   (unsigned long long)misses);
+    add_header(buf, "kdc_hint_cache_hits_total", "counter",
+               "Preauth hint lists built from the hint cache.");
+    k5_buf_add_fmt(buf, "kdc_hint_cache_hits_total %llu\n",
+                   (unsigned long long)hint_hits);
+    add_header(buf, "kdc_hint_cache_misses_total", "counter",
+               "Preauth hint lists not found in the hint cache.");
+    k5_buf_add_fmt(buf, "kdc_hint_cache_misses_total %llu\n",
+                   (unsigned long long)hint_misses);
+    add_header(buf, "kdc_throttled_requests_total", "counter",
+               "Requests shed by address or client principal rate limits.");
+    k5_buf_add_fmt(buf, "kdc_throttled_requests_total{limit=\"address\"} "
+                   "%llu\n", (unsigned long long)throttled[0]);
+    k5_buf_add_fmt(buf, "kdc_throttled_requests_total{limit=\"principal\"} "
+                   "%llu\n", (unsigned long long)throttled[1]);
+
+    sums = calloc(nrealms, sizeof(*sums));
+    if (sums == NULL) {
+        k5_buf_free(buf);
+        return;
+    }
+    for (r = 0; r < nrealms; r++)
+        sum_realm(r, &sums[r]);
+
+    add_header(buf, "kdc_requests_total", "counter",
+               "Requests processed, by realm and type.");
+    for (r = 0; r < nrealms; r++) {
+        for (t = 0; t < 2; t++) {
+            add_sample(buf, "kdc_requests_total", r);
+            k5_buf_add_fmt(buf, ",type=\"%s\"} %llu\n", req_names[t],
+                           (unsigned long long)sums[r].requests[t]);
+        }
+    }
+
+    add_header(buf, "kdc_errors_total", "counter",
+               "Error replies, by realm, type, and protocol error code.");
+    for (r = 0; r < nrealms; r++) {
+        for (t = 0; t < 2; t++) {
+            for (i = 0; i < NERRORS; i++) {
+                if (sums[r].errors[t][i] == 0)
+                    continue;
+                add_sample(buf, "kdc_errors_total", r);
+                k5_buf_add_fmt(buf, ",type=\"%s\",code=\"%d\"} %llu\n",
+                               req_names[t], i,
+                               (unsigned long long)sums[r].errors[t][i]);
+            }
+        }
+    }
+
+    add_header(buf, "kdc_preauth_total", "counter",
+               "Successful preauth verifications, by realm and padata "
+               "type.");
+    for (r = 0; r < nrealms; r++) {
+        for (i = 0; i < NPREAUTH && sums[r].preauth[i].count > 0; i++) {
+            add_sample(buf, "kdc_preauth_total", r);
+            k5_buf_add_fmt(buf, ",padata_type=\"%d\"} %llu\n",
+                           (int)sums[r].preauth[i].type,
+                           (unsigned long long)sums[r].preauth[i].count);
+        }
+        if (sums[r].preauth_other > 0) {
+            add_sample(buf, "kdc_preauth_total", r);
+            k5_buf_add_fmt(buf, ",padata_type=\"other\"} %llu\n",
+                           (unsigned long long)sums[r].preauth_other);
+        }
+    }
+
+    add_header(buf, "kdc_phase_duration_seconds", "histogram",
+               "Time spent in whole requests and in request phases.");
+    for (r = 0; r < nrealms; r++) {
+        for (p = 0; p < KDC_METRICS_NPHASES; p++)
+            add_histogram(buf, r, p, &sums[r].phases[p]);
+    }
+    free(sums);
+}
+
+/* How long a worker waits for a metrics client to drain the socket buffer
+ * before giving up on it. */
+#define WRITE_TIMEOUT_MS 100
+
+/* Write len bytes of data to the non-blocking socket fd, giving up if the
+ * peer does not keep up. */
+static void
+write_all(int fd, const char *data, size_t len)
+{
+    struct pollfd pfd;
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, data, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            if (poll(&pfd, 1, WRITE_TIMEOUT_MS) <= 0)
+                return;
+            continue;
+        }
+        if (n <= 0)
+            return;
+        data += n;
+        len -= n;
+    }
+}
+
+static void
+accept_metrics(verto_ctx *ctx, verto_ev *ev)
+{
+    struct k5buf buf;
+    int fd;
+
+    /* Another worker may have accepted the connection first. */
+    fd = accept(verto_get_fd(ev), NULL, NULL);
+    if (fd < 0)
+        return;
+    set_cloexec_fd(fd);
+    /* Accepted sockets do not inherit O_NONBLOCK on all platforms. */
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        close(fd);
+        return;
+    }
+
+    k5_buf_init_dynamic(&buf);
+    format_metrics(&buf);
+    if (k5_buf_status(&buf) == 0)
+        write_all(fd, buf.data, buf.len);
+    k5_buf_free(&buf);
+    close(fd);
+}
+
+/* Create and listen on a UNIX socket at path. */
+static krb5_error_code
+open_socket(const char *path, int *fd_out)
+{
+    krb5_error_code ret;
+    struct sockaddr_un sun;
+    int fd;
+
+    *fd_out = -1;
+    if (strlen(path) >= sizeof(sun.sun_path))
+        return ENAMETOOLONG;
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strlcpy(sun.sun_path, path, sizeof(sun.sun_path));
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return errno;
+    set_cloexec_fd(fd);
+    (void)unlink(path);
+    if (bind(fd, (struct sockaddr *)&sun, sizeof(sun)) != 0 ||
+        chmod(path, S_IRUSR | S_IWUSR) != 0 || listen(fd, 5) != 0 ||
+        fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        ret = errno;
+        close(fd);
+        return ret;
+    }
+    *fd_out = fd;
+    return 0;
+}
+
+krb5_error_code
+kdc_metrics_init(krb5_context context, verto_ctx *ctx, const char *path,
+                 kdc_realm_t **realms, int numrealms, int nworkers)
+{
+    krb5_error_code ret;
+    int i, fd = -1;
+
+    if (path == NULL)
+        return 0;
+
+    nrealms = numrealms;
+    nslots = (nworkers > 0) ? nworkers : 1;
+    slot_size = sizeof(struct slot) + nrealms * sizeof(struct realm_counters);
+    region_size = nslots * slot_size;
+
+    realm_names = k5calloc(nrealms, sizeof(*realm_names), &ret);
+    if (realm_names == NULL)
+        goto error;
+    realm_contexts = k5calloc(nrealms, sizeof(*realm_contexts), &ret);
+    if (realm_contexts == NULL)
+        goto error;
+    for (i = 0; i < nrealms; i++) {
+        realm_names[i] = strdup(realms[i]->realm_name);
+        if (realm_names[i] == NULL) {
+            ret = ENOMEM;
+            goto error;
+        }
+    }
+
+    ret = open_socket(path, &fd);
+    if (ret) {
+        k5_setmsg(context, ret, _("Cannot listen on metrics socket %s"),
+                  path);
+        goto error;
+    }
+    /* Keep the listener across verto_reinitialize() in worker processes. */
+    listen_ev = verto_add_io(ctx, VERTO_EV_FLAG_PERSIST |
+                             VERTO_EV_FLAG_IO_READ |
+                             VERTO_EV_FLAG_IO_CLOSE_FD |
+                             VERTO_EV_FLAG_REINITIABLE, accept_metrics, fd);
+    if (listen_ev == NULL) {
+        close(fd);
+        ret = ENOMEM;
+        goto error;
+    }
+
+    region = mmap(NULL, region_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        region = NULL;
+        ret = errno;
+        goto error;
+    }
+    return 0;
+
+error:
+    kdc_metrics_fini();
+    return ret;
+}
+
+void
+kdc_metrics_set_worker(int worker)
+{
+    myslot = worker;
+}
+
+void
+kdc_metrics_bind_realms(kdc_realm_t **realms, int numrealms)
+{
+    int i, j;
+
+    for (i = 0; i < nrealms && realm_contexts != NULL; i++) {
+        realm_contexts[i] = NULL;
+        for (j = 0; j < numrealms; j++) {
+            if (strcmp(realms[j]->realm_name, realm_names[i]) == 0)
+                realm_contexts[i] = realms[j]->realm_context;
+        }
+    }
+}
+
+void
+kdc_metrics_fini(void)
+{
+    int i;
+
+    if (listen_ev != NULL)
+        verto_del(listen_ev);
+    listen_ev = NULL;
+    if (region != NULL)
+        munmap(region, region_size);
+    region = NULL;
+    for (i = 0; i < nrealms && realm_names != NULL; i++)
+        free(realm_names[i]);
+    free(realm_names);
+    free(realm_contexts);
+    realm_names = NULL;
+    realm_contexts = NULL;
+    nrealms = 0;
+}
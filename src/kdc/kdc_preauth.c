@@ -77,6 +77,8 @@
  */
 
 #include "k5-int.h"
+#include "k5-queue.h"
+#include "k5-hashtab.h"
 #include "kdc_util.h"
 #include "extern.h"
 #include <stdio.h>
@@ -107,6 +109,34 @@ typedef struct preauth_system_st {
 static preauth_system *preauth_systems;
 static size_t n_preauth_systems;
 
+/*
+ * Nearly every AS exchange begins with a PREAUTH_REQUIRED error, so the KDC
+ * caches the parts of the hint list which are stable for a client key: the
+ * PA-FX-FAST advertisement, etype-info, and the edata of modules flagged with
+ * PA_CACHEABLE_HINT.  An entry is keyed by the client principal, the selected
+ * key's enctype, kvno, and salt, and the request properties which affect the
+ * hint list, so entries for retired keys are no longer reachable and age out
+ * of the cache.  Other modules are asked for edata on every request, and
+ * freshness tokens are always generated per request.
+ */
+struct hint_entry {
+    K5_TAILQ_ENTRY(hint_entry) links;
+    krb5_data key;
+    size_t size;
+    krb5_pa_data **prefix;      /* PA-FX-FAST and etype-info elements */
+    krb5_pa_data **hints;       /* one slot per preauth system, or NULL */
+};
+
+#ifndef HINT_CACHE_MAX_SIZE
+#define HINT_CACHE_MAX_SIZE (4 * 1024 * 1024)
+#endif
+
+K5_TAILQ_HEAD(hint_queue, hint_entry);
+
+static struct k5_hashtab *hint_table;
+static struct hint_queue hint_lru;
+static size_t hint_cache_size;
+
 static krb5_error_code
 make_etype_info(krb5_context context, krb5_boolean etype_info2,
                 krb5_principal client, krb5_key_data *client_key,
@@ -180,6 +210,192 @@ get_realm_names(struct server_handle *handle, const char ***list_out)
     return 0;
 }
 
+/* Free an array of n pa-data elements, any of which may be null. */
+static void
+free_hint_slots(krb5_pa_data **hints, size_t n)
+{
+    size_t i;
+
+    if (hints == NULL)
+        return;
+    for (i = 0; i < n; i++)
+        k5_free_pa_data_element(hints[i]);
+    free(hints);
+}
+
+static krb5_error_code
+copy_pa_data(const krb5_pa_data *pa, krb5_pa_data **pa_out)
+{
+    krb5_error_code ret;
+
+    ret = k5_alloc_pa_data(pa->pa_type, pa->length, pa_out);
+    if (ret)
+        return ret;
+    if (pa->length > 0)
+        memcpy((*pa_out)->contents, pa->contents, pa->length);
+    return 0;
+}
+
+/* Remove entry from the hint cache and free it. */
+static void
+discard_hint_entry(struct hint_entry *entry)
+{
+    hint_cache_size -= entry->size;
+    k5_hashtab_remove(hint_table, entry->key.data, entry->key.length);
+    K5_TAILQ_REMOVE(&hint_lru, entry, links);
+    free(entry->key.data);
+    krb5_free_pa_data(NULL, entry->prefix);
+    free_hint_slots(entry->hints, n_preauth_systems);
+    free(entry);
+}
+
+/* Create the hint cache with a random hash seed. */
+static krb5_error_code
+init_hint_cache(krb5_context context)
+{
+    krb5_error_code ret;
+    uint8_t seed[K5_HASH_SEED_LEN];
+    krb5_data d = make_data(seed, sizeof(seed));
+
+    ret = krb5_c_random_make_octets(context, &d);
+    if (ret)
+        return ret;
+    ret = k5_hashtab_create(seed, 1024, &hint_table);
+    if (ret)
+        return ret;
+    K5_TAILQ_INIT(&hint_lru);
+    hint_cache_size = 0;
+    return 0;
+}
+
+static void
+free_hint_cache(void)
+{
+    struct hint_entry *e, *next;
+
+    if (hint_table == NULL)
+        return;
+    K5_TAILQ_FOREACH_SAFE(e, &hint_lru, links, next)
+        discard_hint_entry(e);
+    k5_hashtab_free(hint_table);
+    hint_table = NULL;
+}
+
+/*
+ * If the hint cache has an entry for key, set *pa_list_out to a copy of its
+ * prefix elements and *hints_out to a copy of its module hints, and return
+ * true.  Return false if there is no entry or it cannot be copied.
+ */
+static krb5_boolean
+check_hint_cache(const krb5_data *key, krb5_pa_data ***pa_list_out,
+                 krb5_pa_data ***hints_out)
+{
+    struct hint_entry *e;
+    krb5_pa_data **list = NULL, **hints = NULL, *pa;
+    size_t i;
+
+    *pa_list_out = *hints_out = NULL;
+
+    e = k5_hashtab_get(hint_table, key->data, key->length);
+    if (e == NULL)
+        return FALSE;
+
+    for (i = 0; e->prefix != NULL && e->prefix[i] != NULL; i++) {
+        if (copy_pa_data(e->prefix[i], &pa) != 0)
+            goto fail;
+        if (k5_add_pa_data_element(&list, &pa) != 0) {
+            k5_free_pa_data_element(pa);
+            goto fail;
+        }
+    }
+    hints = calloc(n_preauth_systems, sizeof(*hints));
+    if (hints == NULL)
+        goto fail;
+    for (i = 0; i < n_preauth_systems; i++) {
+        if (e->hints[i] != NULL && copy_pa_data(e->hints[i], &hints[i]) != 0)
+            goto fail;
+    }
+
+    /* Move the entry to the tail of the LRU queue. */
+    K5_TAILQ_REMOVE(&hint_lru, e, links);
+    K5_TAILQ_INSERT_TAIL(&hint_lru, e, links);
+    *pa_list_out = list;
+    *hints_out = hints;
+    return TRUE;
+
+fail:
+    krb5_free_pa_data(NULL, list);
+    free_hint_slots(hints, n_preauth_systems);
+    return FALSE;
+}
+
+/*
+ * Remember the first nprefix elements of pa_list and the module hints in
+ * hints under key, taking ownership of key->data and hints.  Discard entries
+ * from the head of the LRU queue to limit the total size of the cache.  Can
+ * fail silently on memory exhaustion.
+ */
+static void
+insert_hint_cache(krb5_data *key, krb5_pa_data **pa_list, size_t nprefix,
+                  krb5_pa_data **hints)
+{
+    struct hint_entry *e, *next;
+    krb5_pa_data *pa;
+    size_t i, esize;
+
+    esize = sizeof(*e) + key->length;
+    for (i = 0; i < nprefix; i++)
+        esize += sizeof(*pa) + pa_list[i]->length;
+    for (i = 0; i < n_preauth_systems; i++) {
+        if (hints[i] != NULL)
+            esize += sizeof(*pa) + hints[i]->length;
+    }
+
+    /* Replace any existing entry for the same key. */
+    e = k5_hashtab_get(hint_table, key->data, key->length);
+    if (e != NULL)
+        discard_hint_entry(e);
+
+    K5_TAILQ_FOREACH_SAFE(e, &hint_lru, links, next) {
+        if (hint_cache_size + esize <= HINT_CACHE_MAX_SIZE)
+            break;
+        discard_hint_entry(e);
+    }
+
+    e = calloc(1, sizeof(*e));
+    if (e == NULL)
+        goto error;
+    for (i = 0; i < nprefix; i++) {
+        if (copy_pa_data(pa_list[i], &pa) != 0)
+            goto error;
+        if (k5_add_pa_data_element(&e->prefix, &pa) != 0) {
+            k5_free_pa_data_element(pa);
+            goto error;
+        }
+    }
+    e->key = *key;
+    *key = empty_data();
+    e->hints = hints;
+    hints = NULL;
+    e->size = esize;
+    if (k5_hashtab_add(hint_table, e->key.data, e->key.length, e) != 0)
+        goto error;
+    K5_TAILQ_INSERT_TAIL(&hint_lru, e, links);
+    hint_cache_size += esize;
+    return;
+
+error:
+    free(key->data);
+    *key = empty_data();
+    free_hint_slots(hints, n_preauth_systems);
+    if (e != NULL) {
+        free(e->key.data);
+        krb5_free_pa_data(NULL, e->prefix);
+        free_hint_slots(e->hints, n_preauth_systems);
+        free(e);
+    }
+}
+
 void
 load_preauth_plugins(struct server_handle *handle, krb5_context context,
                      verto_ctx *ctx)
@@ -255,6 +471,13 @@ load_preauth_plugins(struct server_handle *handle, krb5_context context,
     preauth_systems[n_systems].name = "[end]";
     preauth_systems[n_systems].type = -1;
 
+    ret = init_hint_cache(context);
+    if (ret) {
+        emsg = krb5_get_error_message(context, ret);
+        krb5_klog_syslog(LOG_ERR, _("preauth hint cache disabled: %s"), emsg);
+        krb5_free_error_message(context, emsg);
+    }
+
 cleanup:
     free(vtables);
     free(realm_names);
@@ -265,6 +488,7 @@ unload_preauth_plugins(krb5_context context)
 {
     size_t i;
 
+    free_hint_cache();
     for (i = 0; i < n_preauth_systems; i++) {
         if (preauth_systems[i].fini)
             preauth_systems[i].fini(context, preauth_systems[i].moddata);
@@ -446,9 +670,38 @@ have_client_keys(krb5_context context, krb5_kdcpreauth_rock rock)
     return FALSE;
 }
 
+/*
+ * Decrypt the client long-term key selected for the request into
+ * rock->client_keyblock, if that has not already been done.  The key is
+ * selected when the request is processed but only decrypted when it is first
+ * needed, so that PREAUTH_REQUIRED errors built from the hint cache do not
+ * decrypt it at all.
+ */
+krb5_error_code
+load_client_key(krb5_context context, krb5_kdcpreauth_rock rock)
+{
+    krb5_error_code ret;
+    krb5_enctype enctype;
+
+    if (rock->client_key == NULL || rock->client_keyblock->contents != NULL)
+        return 0;
+
+    /* Keep the request enctype, which may differ from the key data enctype
+     * for DES. */
+    enctype = rock->client_keyblock->enctype;
+    ret = krb5_dbe_decrypt_key_data(context, NULL, rock->client_key,
+                                    rock->client_keyblock, NULL);
+    if (ret)
+        return ret;
+    rock->client_keyblock->enctype = enctype;
+    return 0;
+}
+
 static const krb5_keyblock *
 client_keyblock(krb5_context context, krb5_kdcpreauth_rock rock)
 {
+    if (load_client_key(context, rock) != 0)
+        return NULL;
     return rock->client_keyblock;
 }
 
@@ -865,8 +1118,76 @@ struct hint_state {
     preauth_system *ap;
     krb5_pa_data **pa_data;
     krb5_preauthtype pa_type;
+
+    /* Hint cache state.  hints is null if the result will not be cached. */
+    krb5_data cache_key;
+    krb5_boolean cache_hit;
+    size_t nprefix;
+    krb5_pa_data **hints;
 };
 
+static void
+free_hint_state(krb5_context context, struct hint_state *state)
+{
+    krb5_free_pa_data(context, state->pa_data);
+    free(state->cache_key.data);
+    free_hint_slots(state->hints, n_preauth_systems);
+    free(state);
+}
+
+/* Add the 32-bit length of d and its contents to buf. */
+static void
+add_counted(struct k5buf *buf, const krb5_data *d)
+{
+    k5_buf_add_uint32_be(buf, d->length);
+    k5_buf_add_len(buf, d->data, d->length);
+}
+
+/*
+ * Build the hint cache key for the request in rock into *key_out.  The key
+ * covers everything the cacheable parts of the hint list depend on: whether
+ * the request indicates etype-info2 support or uses FAST, whether the client
+ * requires hardware preauth, the selected client key (enctype, kvno, and
+ * salt), and the client principal name.
+ */
+static krb5_error_code
+make_hint_key(krb5_kdcpreauth_rock rock, int hw_only, krb5_data *key_out)
+{
+    krb5_principal princ = rock->client->princ;
+    krb5_key_data *kd = rock->client_key;
+    struct k5buf buf;
+    uint32_t flags;
+    int i;
+
+    *key_out = empty_data();
+
+    flags = (requires_info2(rock->request) ? 1 : 0) |
+        (rock->rstate->armor_key != NULL ? 2 : 0) | (hw_only ? 4 : 0) |
+        (kd != NULL ? 8 : 0);
+    k5_buf_init_dynamic(&buf);
+    k5_buf_add_uint32_be(&buf, flags);
+    if (kd != NULL) {
+        k5_buf_add_uint32_be(&buf, rock->client_keyblock->enctype);
+        k5_buf_add_uint32_be(&buf, kd->key_data_type[0]);
+        k5_buf_add_uint32_be(&buf, kd->key_data_kvno);
+        if (kd->key_data_ver > 1) {
+            k5_buf_add_uint32_be(&buf, kd->key_data_type[1]);
+            k5_buf_add_uint32_be(&buf, kd->key_data_length[1]);
+            k5_buf_add_len(&buf, kd->key_data_contents[1],
+                           kd->key_data_length[1]);
+        } else {
+            k5_buf_add_uint32_be(&buf, KRB5_KDB_SALTTYPE_NORMAL);
+        }
+    }
+    add_counted(&buf, &princ->realm);
+    for (i = 0; i < princ->length; i++)
+        add_counted(&buf, &princ->data[i]);
+    if (k5_buf_status(&buf) != 0)
+        return ENOMEM;
+    *key_out = make_data(buf.data, buf.len);
+    return 0;
+}
+
 static void
 hint_list_finish(struct hint_state *state, krb5_error_code code)
 {
@@ -874,6 +1195,13 @@ hint_list_finish(struct hint_state *state, krb5_error_code code)
     void *oldarg = state->arg;
     kdc_realm_t *kdc_active_realm = state->realm;
 
+    /* Remember the cacheable parts of a newly built hint list. */
+    if (!code && !state->cache_hit && state->hints != NULL) {
+        insert_hint_cache(&state->cache_key, state->pa_data, state->nprefix,
+                          state->hints);
+        state->hints = NULL;
+    }
+
     /* Add a freshness token if a preauth module requested it and the client
      * request indicates support for it. */
     if (!code)
@@ -890,8 +1218,7 @@ hint_list_finish(struct hint_state *state, krb5_error_code code)
         state->pa_data = NULL;
     }
 
-    krb5_free_pa_data(kdc_context, state->pa_data);
-    free(state);
+    free_hint_state(kdc_context, state);
     (*oldrespond)(oldarg);
 }
 
@@ -910,6 +1237,13 @@ finish_get_edata(void *arg, krb5_error_code code, krb5_pa_data *pa)
             if (ret)
                 goto error;
         }
+        if (state->hints != NULL && (state->ap->flags & PA_CACHEABLE_HINT)) {
+            /* Keep a copy for the hint cache, or give up on caching. */
+            if (copy_pa_data(pa, &state->hints[state->ap - preauth_systems])) {
+                free_hint_slots(state->hints, n_preauth_systems);
+                state->hints = NULL;
+            }
+        }
         ret = k5_add_pa_data_element(&state->pa_data, &pa);
         k5_free_pa_data_element(pa);
         if (ret)
@@ -927,8 +1261,10 @@ error:
 static void
 hint_list_next(struct hint_state *state)
 {
+    krb5_error_code ret;
     preauth_system *ap = state->ap;
     kdc_realm_t *kdc_active_realm = state->realm;
+    krb5_pa_data **slot;
 
     if (ap->type == -1) {
         hint_list_finish(state, 0);
@@ -940,6 +1276,19 @@ hint_list_next(struct hint_state *state)
     if (ap->flags & PA_PSEUDO)
         goto next;
 
+    if (state->cache_hit && (ap->flags & PA_CACHEABLE_HINT)) {
+        /* Use the cached hint if the module supplied one. */
+        slot = &state->hints[ap - preauth_systems];
+        if (*slot != NULL) {
+            ret = k5_add_pa_data_element(&state->pa_data, slot);
+            if (ret) {
+                hint_list_finish(state, ret);
+                return;
+            }
+        }
+        goto next;
+    }
+
     state->pa_type = ap->type;
     if (ap->get_edata) {
         ap->get_edata(kdc_context, state->request, &callbacks, state->rock,
@@ -978,20 +1327,33 @@ get_preauth_hint_list(krb5_kdc_req *request, krb5_kdcpreauth_rock rock,
     state->pa_data = NULL;
     state->ap = preauth_systems;
 
-    /* Add an empty PA-FX-FAST element to advertise FAST support. */
-    if (k5_add_empty_pa_data(&state->pa_data, KRB5_PADATA_FX_FAST) != 0)
-        goto error;
+    if (hint_table != NULL &&
+        make_hint_key(rock, state->hw_only, &state->cache_key) == 0) {
+        state->cache_hit = check_hint_cache(&state->cache_key,
+                                            &state->pa_data, &state->hints);
+        kdc_metrics_hint_cache(state->cache_hit);
+        if (!state->cache_hit)
+            state->hints = calloc(n_preauth_systems, sizeof(*state->hints));
+    }
 
-    if (add_etype_info(kdc_context, rock, &state->pa_data) != 0)
-        goto error;
+    if (!state->cache_hit) {
+        /* Add an empty PA-FX-FAST element to advertise FAST support. */
+        if (k5_add_empty_pa_data(&state->pa_data, KRB5_PADATA_FX_FAST) != 0)
+            goto error;
+
+        if (add_etype_info(kdc_context, rock, &state->pa_data) != 0)
+            goto error;
+
+        while (state->pa_data[state->nprefix] != NULL)
+            state->nprefix++;
+    }
 
     hint_list_next(state);
     return;
 
 error:
     if (state != NULL)
-        krb5_free_pa_data(kdc_context, state->pa_data);
-    free(state);
+        free_hint_state(kdc_context, state);
     (*respond)(arg);
 }
 
@@ -1064,6 +1426,7 @@ struct padata_state {
     krb5_boolean typed_e_data_flag;
     int pa_ok;
     krb5_error_code saved_code;
+    uint64_t start;
 
     krb5_pa_data ***e_data_out;
     krb5_boolean *typed_e_data_out;
@@ -1202,6 +1565,7 @@ finish_verify_padata(void *arg, krb5_error_code code,
 
     assert(state);
     *state->modreq_ptr = modreq;
+    kdc_metrics_record(state->context, KDC_METRICS_PREAUTH, state->start);
 
     if (code) {
         emsg = krb5_get_error_message(state->context, code);
@@ -1258,6 +1622,7 @@ finish_verify_padata(void *arg, krb5_error_code code,
             free(authz_data);
         }
 
+        kdc_metrics_preauth(state->context, (*state->padata)->pa_type);
         state->pa_ok = 1;
         if (state->pa_sys->flags & PA_SUFFICIENT) {
             finish_check_padata(state, state->saved_code);
@@ -1296,6 +1661,7 @@ next_padata(struct padata_state *state)
         goto next;
 
     state->pa_found++;
+    state->start = kdc_metrics_now();
     state->pa_sys->verify_padata(state->context, state->req_pkt,
                                  state->request, state->enc_tkt_reply,
                                  *state->padata, &callbacks, state->rock,
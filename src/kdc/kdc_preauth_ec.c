@@ -33,6 +33,12 @@
 #include <krb5/kdcpreauth_plugin.h>
 #include "kdc_util.h"
 
+static int
+ec_flags(krb5_context context, krb5_preauthtype pa_type)
+{
+    return PA_CACHEABLE_HINT;
+}
+
 static void
 ec_edata(krb5_context context, krb5_kdc_req *request,
          krb5_kdcpreauth_callbacks cb, krb5_kdcpreauth_rock rock,
@@ -218,6 +224,7 @@ kdcpreauth_encrypted_challenge_initvt(krb5_context context, int maj_ver,
     vt = (krb5_kdcpreauth_vtable)vtable;
     vt->name = "encrypted_challenge";
     vt->pa_type_list = ec_types;
+    vt->flags = ec_flags;
     vt->edata = ec_edata;
     vt->verify = ec_verify;
     vt->return_padata = ec_return;
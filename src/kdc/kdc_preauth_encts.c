@@ -28,6 +28,12 @@
 #include <krb5/kdcpreauth_plugin.h>
 #include "kdc_util.h"
 
+static int
+enc_ts_flags(krb5_context context, krb5_preauthtype pa_type)
+{
+    return PA_CACHEABLE_HINT;
+}
+
 static void
 enc_ts_get(krb5_context context, krb5_kdc_req *request,
            krb5_kdcpreauth_callbacks cb, krb5_kdcpreauth_rock rock,
@@ -132,6 +138,7 @@ kdcpreauth_encrypted_timestamp_initvt(krb5_context context, int maj_ver,
     vt = (krb5_kdcpreauth_vtable)vtable;
     vt->name = "encrypted_timestamp";
     vt->pa_type_list = enc_ts_types;
+    vt->flags = enc_ts_flags;
     vt->edata = enc_ts_get;
     vt->verify = enc_ts_verify;
     return 0;
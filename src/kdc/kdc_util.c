@@ -303,6 +303,7 @@ kdc_rd_ap_req(kdc_realm_t *kdc_active_realm,
     krb5_boolean        match_enctype = 1;
     krb5_kvno           kvno;
     size_t              tries = 3;
+    uint64_t            start;
 
     /*
      * When we issue tickets we use the first key in the principals' highest
@@ -330,20 +331,38 @@ kdc_rd_ap_req(kdc_realm_t *kdc_active_realm,
         if (retval)
             continue;
 
+#ifndef NOCACHE
+        /* Skip decrypting the ticket if we recently did so with this key. */
+        retval = kdc_check_tgt_cache(kdc_context, *tgskey, apreq->ticket,
+                                     &apreq->ticket->enc_part2);
+        if (retval)
+            return retval;
+        if (apreq->ticket->enc_part2 != NULL) {
+            return k5_rd_req_decoded_decrypted(kdc_context, &auth_context,
+                                               apreq, apreq->ticket->server);
+        }
+#endif
+
         /* Make the TGS key available to krb5_rd_req_decoded_anyflag() */
         retval = krb5_auth_con_setuseruserkey(kdc_context, auth_context,
                                               *tgskey);
         if (retval)
             return retval;
 
+        start = kdc_metrics_now();
         retval = krb5_rd_req_decoded_anyflag(kdc_context, &auth_context, apreq,
                                              apreq->ticket->server,
                                              kdc_active_realm->realm_keytab,
                                              NULL, NULL);
+        kdc_metrics_record(kdc_context, KDC_METRICS_CRYPTO, start);
 
         /* If the ticket was decrypted, don't try any more keys. */
-        if (apreq->ticket->enc_part2 != NULL)
+        if (apreq->ticket->enc_part2 != NULL) {
+#ifndef NOCACHE
+            kdc_insert_tgt_cache(kdc_context, *tgskey, apreq->ticket);
+#endif
             break;
+        }
 
     } while (retval && apreq->ticket->enc_part.kvno == 0 && kvno-- > 1 &&
              --tries > 0);
@@ -369,6 +388,7 @@ kdc_get_server_key(krb5_context context,
     krb5_db_entry       * server = NULL;
     krb5_enctype          search_enctype = -1;
     krb5_kvno             search_kvno = -1;
+    uint64_t              start;
 
     if (match_enctype)
         search_enctype = ticket->enc_part.enctype;
@@ -377,8 +397,10 @@ kdc_get_server_key(krb5_context context,
 
     *server_ptr = NULL;
 
+    start = kdc_metrics_now();
     retval = krb5_db_get_principal(context, ticket->server, flags,
                                    &server);
+    kdc_metrics_record(context, KDC_METRICS_KDB, start);
     if (retval == KRB5_KDB_NOENTRY) {
         char *sname;
         if (!krb5_unparse_name(context, ticket->server, &sname)) {
@@ -493,6 +515,7 @@ get_local_tgt(krb5_context context, const krb5_data *realm,
     krb5_error_code ret;
     krb5_principal princ;
     krb5_db_entry *storage = NULL, *tgt;
+    uint64_t start;
 
     *alias_out = NULL;
     *storage_out = NULL;
@@ -505,7 +528,9 @@ get_local_tgt(krb5_context context, const krb5_data *realm,
         goto cleanup;
 
     if (!krb5_principal_compare(context, candidate->princ, princ)) {
+        start = kdc_metrics_now();
         ret = krb5_db_get_principal(context, princ, 0, &storage);
+        kdc_metrics_record(context, KDC_METRICS_KDB, start);
         if (ret)
             goto cleanup;
         tgt = storage;
@@ -175,6 +175,8 @@ void
 get_preauth_hint_list(krb5_kdc_req *request,
                       krb5_kdcpreauth_rock rock, krb5_pa_data ***e_data_out,
                       kdc_hint_respond_fn respond, void *arg);
+krb5_error_code
+load_client_key(krb5_context context, krb5_kdcpreauth_rock rock);
 void
 load_preauth_plugins(struct server_handle * handle, krb5_context context,
                      verto_ctx *ctx);
@@ -245,6 +247,59 @@ void kdc_insert_lookaside (krb5_context, krb5_data *, krb5_data *);
 void kdc_remove_lookaside (krb5_context kcontext, krb5_data *);
 void kdc_free_lookaside(krb5_context);
 
+/* tgtcache.c */
+krb5_error_code kdc_init_tgt_cache(krb5_context context);
+krb5_error_code kdc_check_tgt_cache(krb5_context context,
+                                    const krb5_keyblock *tgskey,
+                                    const krb5_ticket *ticket,
+                                    krb5_enc_tkt_part **enc_tkt_out);
+void kdc_insert_tgt_cache(krb5_context context, const krb5_keyblock *tgskey,
+                          const krb5_ticket *ticket);
+void kdc_free_tgt_cache(krb5_context context);
+
+/* kdc_metrics.c */
+enum kdc_metrics_phase {
+    KDC_METRICS_AS_REQ,
+    KDC_METRICS_TGS_REQ,
+    KDC_METRICS_KDB,
+    KDC_METRICS_CRYPTO,
+    KDC_METRICS_PREAUTH,
+    KDC_METRICS_NPHASES
+};
+krb5_error_code kdc_metrics_init(krb5_context context, verto_ctx *ctx,
+                                 const char *path, kdc_realm_t **realms,
+                                 int nrealms, int nworkers);
+void kdc_metrics_set_worker(int worker);
+void kdc_metrics_bind_realms(kdc_realm_t **realms, int nrealms);
+void kdc_metrics_fini(void);
+uint64_t kdc_metrics_now(void);
+void kdc_metrics_record(krb5_context context, enum kdc_metrics_phase phase,
+                        uint64_t start);
+void kdc_metrics_request(krb5_context context, enum kdc_metrics_phase type,
+                         krb5_error_code code);
+void kdc_metrics_preauth(krb5_context context, krb5_preauthtype type);
+void kdc_metrics_lookaside(krb5_boolean hit);
+void kdc_metrics_hint_cache(krb5_boolean hit);
+void kdc_metrics_throttle(krb5_boolean principal);
+
+/* ratelimit.c */
+struct kdc_rate_limits {
+    int address_rate;
+    int address_burst;
+    int address_prefix4;
+    int address_prefix6;
+    int principal_rate;
+    int principal_burst;
+    krb5_boolean send_error;
+};
+krb5_error_code kdc_init_rate_limits(krb5_context context,
+                                     const struct kdc_rate_limits *rl);
+krb5_boolean kdc_throttle_address(const krb5_address *addr);
+krb5_boolean kdc_throttle_principal(krb5_context context,
+                                    krb5_const_principal client);
+krb5_error_code kdc_make_throttle_error(kdc_realm_t *realm, krb5_data **out);
+void kdc_free_rate_limits(void);
+
 /* kdc_util.c */
 void reset_for_hangup(void *);
 
@@ -62,6 +62,8 @@ static int nofork = 0;
 static int workers = 0;
 static int time_offset = 0;
 static const char *pid_file = NULL;
+static char *metrics_socket = NULL;
+static struct kdc_rate_limits rate_limits;
 static int rkey_init_done = 0;
 static volatile int signal_received = 0;
 static volatile int sighup_received = 0;
@@ -548,6 +550,7 @@ create_workers(verto_ctx *ctx, int num)
                 exit(0);
 
             /* Return control to main() in the new worker process. */
+            kdc_metrics_set_worker(i);
             return 0;
         }
         if (pid == -1) {
@@ -616,6 +619,40 @@ usage(char *name)
     exit(1);
 }
 
+/* Read the [kdcdefaults] rate limiting variables from aprof into rl. */
+static void
+get_rate_limits(krb5_pointer aprof, struct kdc_rate_limits *rl)
+{
+    const char *hierarchy[3];
+    char *action;
+
+    hierarchy[0] = KRB5_CONF_KDCDEFAULTS;
+    hierarchy[2] = NULL;
+    hierarchy[1] = KRB5_CONF_KDC_ADDRESS_RATE_LIMIT;
+    if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &rl->address_rate))
+        rl->address_rate = 0;
+    hierarchy[1] = KRB5_CONF_KDC_ADDRESS_RATE_BURST;
+    if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &rl->address_burst))
+        rl->address_burst = 0;
+    hierarchy[1] = KRB5_CONF_KDC_ADDRESS_PREFIX_LENGTH;
+    if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &rl->address_prefix4))
+        rl->address_prefix4 = 32;
+    hierarchy[1] = KRB5_CONF_KDC_ADDRESS6_PREFIX_LENGTH;
+    if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &rl->address_prefix6))
+        rl->address_prefix6 = 64;
+    hierarchy[1] = KRB5_CONF_KDC_PRINCIPAL_RATE_LIMIT;
+    if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &rl->principal_rate))
+        rl->principal_rate = 0;
+    hierarchy[1] = KRB5_CONF_KDC_PRINCIPAL_RATE_BURST;
+    if (krb5_aprof_get_int32(aprof, hierarchy, TRUE, &rl->principal_burst))
+        rl->principal_burst = 0;
+    hierarchy[1] = KRB5_CONF_KDC_RATE_LIMIT_ACTION;
+    rl->send_error = FALSE;
+    if (!krb5_aprof_get_string(aprof, hierarchy, TRUE, &action)) {
+        rl->send_error = (strcasecmp(action, "error") == 0);
+        free(action);
+    }
+}
 
 static void
 initialize_realms(krb5_context kcontext, int argc, char **argv,
@@ -664,6 +701,11 @@ initialize_realms(krb5_context kcontext, int argc, char **argv,
             if (krb5_aprof_get_int32(aprof, hierarchy, TRUE,
                                      tcp_listen_backlog_out))
                 *tcp_listen_backlog_out = DEFAULT_TCP_LISTEN_BACKLOG;
+            hierarchy[1] = KRB5_CONF_KDC_METRICS_SOCKET;
+            if (krb5_aprof_get_string(aprof, hierarchy, TRUE,
+                                      &metrics_socket))
+                metrics_socket = NULL;
+            get_rate_limits(aprof, &rate_limits);
         }
         hierarchy[1] = KRB5_CONF_RESTRICT_ANONYMOUS_TO_TGT;
         if (krb5_aprof_get_boolean(aprof, hierarchy, TRUE, &def_restrict_anon))
@@ -975,7 +1017,19 @@ int main(int argc, char **argv)
         finish_realms();
         return 1;
     }
+    retval = kdc_init_tgt_cache(kcontext);
+    if (retval) {
+        kdc_err(kcontext, retval, _("while initializing TGT cache"));
+        finish_realms();
+        return 1;
+    }
 #endif
+    retval = kdc_init_rate_limits(kcontext, &rate_limits);
+    if (retval) {
+        kdc_err(kcontext, retval, _("while initializing rate limits"));
+        finish_realms();
+        return 1;
+    }
 
     ctx = loop_init(VERTO_EV_TYPE_NONE);
     if (!ctx) {
@@ -1025,6 +1079,14 @@ int main(int argc, char **argv)
         finish_realms();
         return 1;
     }
+    retval = kdc_metrics_init(kcontext, ctx, metrics_socket,
+                              shandle.kdc_realmlist, shandle.kdc_numrealms,
+                              workers);
+    if (retval) {
+        kdc_err(kcontext, retval, _("while initializing metrics"));
+        finish_realms();
+        return 1;
+    }
 
     /* Clean up realms for now and reinitialize them after daemonizing, since
      * some KDB modules are not fork-safe. */
@@ -1051,6 +1113,7 @@ int main(int argc, char **argv)
     }
 
     initialize_realms(kcontext, argc, argv, NULL);
+    kdc_metrics_bind_realms(shandle.kdc_realmlist, shandle.kdc_numrealms);
 
     /* Initialize audit system and audit KDC startup. */
     retval = load_audit_modules(kcontext);
@@ -1065,6 +1128,7 @@ int main(int argc, char **argv)
     kau_kdc_start(kcontext, TRUE);
 
     verto_run(ctx);
+    kdc_metrics_fini();
     loop_free(ctx);
     kau_kdc_stop(kcontext, TRUE);
     krb5_klog_syslog(LOG_INFO, _("shutting down"));
@@ -1078,7 +1142,10 @@ int main(int argc, char **argv)
         free(shandle.kdc_realmlist);
 #ifndef NOCACHE
     kdc_free_lookaside(kcontext);
+    kdc_free_tgt_cache(kcontext);
 #endif
+    kdc_free_rate_limits();
     krb5_free_context(kcontext);
+    free(metrics_socket);
     return errout;
 }
@@ -0,0 +1,376 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kdc/ratelimit.c - Per-address and per-principal admission control */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The KDC can limit the rate of requests it accepts from each source address
+ * prefix, and the rate of AS requests it accepts for each client principal, so
+ * that a single host or a script looping over a bad password cannot consume
+ * most of its capacity.  Each limit is a token bucket per key: a key may make
+ * up to burst requests at once, and its bucket refills at rate requests per
+ * second.  The address limit is applied before a request is looked up in the
+ * lookaside cache or decoded; the principal limit is applied once an AS
+ * request has been decoded, before any database lookup or preauth work.  A
+ * throttled request is dropped, or answered with a KDC_ERR_SVC_UNAVAILABLE
+ * error so that the client tries another KDC.  The error is encoded at most
+ * once per second for each realm and copied for each reply.
+ *
+ * Buckets live in a hash table with an LRU queue, and each limit keeps at most
+ * RATE_LIMIT_MAX_BUCKETS of them.  A bucket which has refilled completely is
+ * equivalent to a missing one, so such buckets are discarded from the head of
+ * the queue as new keys arrive.  When the KDC runs with worker processes,
+ * each worker keeps its own buckets.
+ */
+
+#include "k5-int.h"
+#include "k5-queue.h"
+#include "k5-hashtab.h"
+#include "kdc_util.h"
+#include "extern.h"
+#include "adm_proto.h"
+#include "realm_data.h"
+#include <syslog.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <time.h>
+
+#ifndef RATE_LIMIT_MAX_BUCKETS
+#define RATE_LIMIT_MAX_BUCKETS 65536
+#endif
+
+struct bucket {
+    K5_TAILQ_ENTRY(bucket) links;
+    krb5_data key;
+    uint64_t last;              /* Time of the last refill in microseconds */
+    double tokens;
+    krb5_boolean throttled;
+};
+
+K5_TAILQ_HEAD(bucket_queue, bucket);
+
+struct limit {
+    double rate;
+    double burst;
+    struct k5_hashtab *table;
+    struct bucket_queue lru;
+    size_t count;
+};
+
+static struct limit address_limit, principal_limit;
+static int prefix4, prefix6;
+static krb5_boolean send_error;
+
+/* The most recently encoded throttling error. */
+static char *error_realm;
+static krb5_timestamp error_time;
+static krb5_data error_reply;
+
+static uint64_t
+now_us(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static krb5_error_code
+init_limit(struct limit *lim, const uint8_t *seed, int rate, int burst)
+{
+    if (rate <= 0)
+        return 0;
+    lim->rate = rate;
+    lim->burst = (burst > 0) ? burst : 2 * rate;
+    K5_TAILQ_INIT(&lim->lru);
+    return k5_hashtab_create(seed, 1024, &lim->table);
+}
+
+/* Remove b from the hash table and LRU queue of lim, and free it. */
+static void
+discard_bucket(struct limit *lim, struct bucket *b)
+{
+    k5_hashtab_remove(lim->table, b->key.data, b->key.length);
+    K5_TAILQ_REMOVE(&lim->lru, b, links);
+    lim->count--;
+    free(b->key.data);
+    free(b);
+}
+
+/* Add the tokens earned by b since it was last refilled. */
+static void
+refill(struct limit *lim, struct bucket *b, uint64_t now)
+{
+    if (now > b->last) {
+        b->tokens += (double)(now - b->last) * lim->rate / 1000000;
+        if (b->tokens > lim->burst)
+            b->tokens = lim->burst;
+    }
+    b->last = now;
+}
+
+/*
+ * Take a token from the bucket for key in lim, creating the bucket if
+ * necessary.  Return true if the bucket is empty and the request should be
+ * throttled.  In that case set *first_out if the previous request for the key
+ * was admitted.  Fail open on memory exhaustion.
+ */
+static krb5_boolean
+take_token(struct limit *lim, const void *key, size_t len,
+           krb5_boolean *first_out)
+{
+    krb5_error_code ret;
+    struct bucket *b, *next;
+    uint64_t now = now_us();
+
+    *first_out = FALSE;
+    b = k5_hashtab_get(lim->table, key, len);
+    if (b != NULL) {
+        /* Move the bucket to the tail of the LRU queue. */
+        K5_TAILQ_REMOVE(&lim->lru, b, links);
+        K5_TAILQ_INSERT_TAIL(&lim->lru, b, links);
+        refill(lim, b, now);
+        if (b->tokens < 1) {
+            *first_out = !b->throttled;
+            b->throttled = TRUE;
+            return TRUE;
+        }
+        b->tokens -= 1;
+        b->throttled = FALSE;
+        return FALSE;
+    }
+
+    /* Discard full buckets from the head of the queue, and the least recently
+     * used bucket if the table is at its limit. */
+    K5_TAILQ_FOREACH_SAFE(b, &lim->lru, links, next) {
+        refill(lim, b, now);
+        if (b->tokens < lim->burst && lim->count < RATE_LIMIT_MAX_BUCKETS)
+            break;
+        discard_bucket(lim, b);
+    }
+
+    b = calloc(1, sizeof(*b));
+    if (b == NULL)
+        return FALSE;
+    b->key.data = k5memdup(key, len, &ret);
+    if (b->key.data == NULL) {
+        free(b);
+        return FALSE;
+    }
+    b->key.length = len;
+    b->last = now;
+    b->tokens = lim->burst - 1;
+    if (k5_hashtab_add(lim->table, b->key.data, len, b) != 0) {
+        free(b->key.data);
+        free(b);
+        return FALSE;
+    }
+    K5_TAILQ_INSERT_TAIL(&lim->lru, b, links);
+    lim->count++;
+    return FALSE;
+}
+
+krb5_error_code
+kdc_init_rate_limits(krb5_context context, const struct kdc_rate_limits *rl)
+{
+    krb5_error_code ret;
+    uint8_t seed[K5_HASH_SEED_LEN];
+    krb5_data d = make_data(seed, sizeof(seed));
+
+    if (rl->address_rate <= 0 && rl->principal_rate <= 0)
+        return 0;
+    ret = krb5_c_random_make_octets(context, &d);
+    if (ret)
+        return ret;
+    ret = init_limit(&address_limit, seed, rl->address_rate,
+                     rl->address_burst);
+    if (ret)
+        return ret;
+    ret = init_limit(&principal_limit, seed, rl->principal_rate,
+                     rl->principal_burst);
+    if (ret)
+        return ret;
+    prefix4 = (rl->address_prefix4 > 0 && rl->address_prefix4 <= 32) ?
+        rl->address_prefix4 : 32;
+    prefix6 = (rl->address_prefix6 > 0 && rl->address_prefix6 <= 128) ?
+        rl->address_prefix6 : 64;
+    send_error = rl->send_error;
+    return 0;
+}
+
+/* Return true if a request from addr exceeds the address rate limit. */
+krb5_boolean
+kdc_throttle_address(const krb5_address *addr)
+{
+    const uint8_t *contents = addr->contents;
+    uint8_t key[17];
+    char name[INET6_ADDRSTRLEN];
+    krb5_boolean first, throttled;
+    int family, nbits;
+    size_t len;
+
+    if (address_limit.table == NULL)
+        return FALSE;
+
+    if (addr->addrtype == ADDRTYPE_INET && addr->length == 4) {
+        family = AF_INET;
+    } else if (addr->addrtype == ADDRTYPE_INET6 && addr->length == 16) {
+        /* Limit IPv4-mapped addresses as IPv4 addresses. */
+        if (IN6_IS_ADDR_V4MAPPED((const struct in6_addr *)contents)) {
+            family = AF_INET;
+            contents += 12;
+        } else {
+            family = AF_INET6;
+        }
+    } else {
+        return FALSE;
+    }
+
+    /* The key is the family followed by the address masked to the prefix
+     * length. */
+    nbits = (family == AF_INET) ? prefix4 : prefix6;
+    len = (nbits + 7) / 8;
+    key[0] = family;
+    memcpy(key + 1, contents, len);
+    if (nbits % 8 != 0)
+        key[len] &= 0xFF << (8 - nbits % 8);
+
+    throttled = take_token(&address_limit, key, len + 1, &first);
+    if (first && inet_ntop(family, contents, name, sizeof(name)) != NULL) {
+        krb5_klog_syslog(LOG_NOTICE, _("Throttling requests from %s/%d"),
+                         name, nbits);
+    }
+    return throttled;
+}
+
+/* Return true if an AS request for client exceeds the principal rate
+ * limit. */
+krb5_boolean
+kdc_throttle_principal(krb5_context context, krb5_const_principal client)
+{
+    struct k5buf buf;
+    krb5_boolean first, throttled;
+    char *name;
+    int i;
+
+    if (principal_limit.table == NULL)
+        return FALSE;
+
+    /* The key is the realm and each component, each followed by a zero
+     * byte. */
+    k5_buf_init_dynamic(&buf);
+    k5_buf_add_len(&buf, client->realm.data, client->realm.length);
+    k5_buf_add_len(&buf, "", 1);
+    for (i = 0; i < client->length; i++) {
+        k5_buf_add_len(&buf, client->data[i].data, client->data[i].length);
+        k5_buf_add_len(&buf, "", 1);
+    }
+    if (k5_buf_status(&buf) != 0)
+        return FALSE;
+
+    throttled = take_token(&principal_limit, buf.data, buf.len, &first);
+    k5_buf_free(&buf);
+    if (first && krb5_unparse_name(context, client, &name) == 0) {
+        krb5_klog_syslog(LOG_NOTICE, _("Throttling AS requests for %s"),
+                         name);
+        krb5_free_unparsed_name(context, name);
+    }
+    return throttled;
+}
+
+/*
+ * Set *out to the reply for a throttled request to realm: a copy of a cached
+ * KDC_ERR_SVC_UNAVAILABLE error, or NULL if throttled requests are to be
+ * dropped.
+ */
+krb5_error_code
+kdc_make_throttle_error(kdc_realm_t *realm, krb5_data **out)
+{
+    krb5_error_code ret;
+    krb5_context context = realm->realm_context;
+    krb5_error errpkt;
+    krb5_timestamp now;
+    krb5_data reply;
+    char *name;
+
+    *out = NULL;
+    if (!send_error)
+        return 0;
+
+    ret = krb5_timeofday(context, &now);
+    if (ret)
+        return ret;
+    if (error_realm == NULL || strcmp(error_realm, realm->realm_name) != 0 ||
+        error_time != now) {
+        memset(&errpkt, 0, sizeof(errpkt));
+        errpkt.stime = now;
+        errpkt.error = KDC_ERR_SVC_UNAVAILABLE;
+        errpkt.server = realm->realm_tgsprinc;
+        ret = krb5_mk_error(context, &errpkt, &reply);
+        if (ret)
+            return ret;
+        name = strdup(realm->realm_name);
+        if (name == NULL) {
+            krb5_free_data_contents(context, &reply);
+            return ENOMEM;
+        }
+        free(error_realm);
+        krb5_free_data_contents(context, &error_reply);
+        error_realm = name;
+        error_time = now;
+        error_reply = reply;
+    }
+    return krb5_copy_data(context, &error_reply, out);
+}
+
+static void
+free_limit(struct limit *lim)
+{
+    struct bucket *b, *next;
+
+    if (lim->table == NULL)
+        return;
+    K5_TAILQ_FOREACH_SAFE(b, &lim->lru, links, next)
+        discard_bucket(lim, b);
+    k5_hashtab_free(lim->table);
+    lim->table = NULL;
+}
+
+/* Free all rate limiting state. */
+void
+kdc_free_rate_limits(void)
+{
+    free_limit(&address_limit);
+    free_limit(&principal_limit);
+    free(error_realm);
+    error_realm = NULL;
+    krb5_free_data_contents(NULL, &error_reply);
+}
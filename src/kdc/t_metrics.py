@@ -0,0 +1,84 @@
+from k5test import *
+import re
+import socket
+
+def read_metrics(path):
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(path)
+    out = b''
+    while True:
+        data = s.recv(4096)
+        if not data:
+            break
+        out += data
+    s.close()
+    return out.decode()
+
+def get_value(text, sample):
+    m = re.search('^' + re.escape(sample) + r' (\S+)$', text, re.MULTILINE)
+    if m is None:
+        return 0
+    return float(m.group(1))
+
+def check(text, sample, expected, atleast=False):
+    val = get_value(text, sample)
+    if (val < expected) if atleast else (val != expected):
+        fail('Expected %s %s, got %s' % (sample, expected, val))
+
+def run_requests(realm):
+    realm.kinit(realm.user_princ, password('user'))
+    realm.run([kvno, realm.host_princ])
+    realm.run([kvno, 'nonexistent@KRBTEST.COM'], expected_code=1)
+    realm.kinit(realm.user_princ, 'wrongpw', expected_code=1)
+
+def check_metrics(realm, path):
+    text = read_metrics(path)
+    r = 'realm="KRBTEST.COM"'
+    # Each kinit makes an unauthenticated request and then a request with
+    # encrypted timestamp preauth.  The first fails with PREAUTH_REQUIRED
+    # (25), and the second with PREAUTH_FAILED (24) for the wrong password.
+    check(text, 'kdc_requests_total{%s,type="as"}' % r, 4)
+    check(text, 'kdc_errors_total{%s,type="as",code="25"}' % r, 2)
+    check(text, 'kdc_errors_total{%s,type="as",code="24"}' % r, 1)
+    check(text, 'kdc_preauth_total{%s,padata_type="2"}' % r, 1)
+    # The unknown service fails with S_PRINCIPAL_UNKNOWN (7), possibly
+    # more than once as the client retries.
+    check(text, 'kdc_requests_total{%s,type="tgs"}' % r, 2, atleast=True)
+    check(text, 'kdc_errors_total{%s,type="tgs",code="7"}' % r, 1,
+          atleast=True)
+    check(text, 'kdc_lookaside_misses_total', 6, atleast=True)
+    # Both PREAUTH_REQUIRED errors and the PREAUTH_FAILED error carry a hint
+    # list; within one process only the first is built from scratch.
+    hints = (get_value(text, 'kdc_hint_cache_hits_total') +
+             get_value(text, 'kdc_hint_cache_misses_total'))
+    if hints != 3:
+        fail('Expected 3 hint lists, got %d' % hints)
+    for phase in ('as_req', 'tgs_req'):
+        pr = '%s,phase="%s"' % (r, phase)
+        count = get_value(text, 'kdc_phase_duration_seconds_count{%s}' % pr)
+        inf = get_value(text, 'kdc_phase_duration_seconds_bucket{%s,'
+                        'le="+Inf"}' % pr)
+        if count != inf or count == 0:
+            fail('Bad %s histogram' % phase)
+    for phase in ('kdb', 'crypto', 'preauth'):
+        check(text, 'kdc_phase_duration_seconds_count{%s,phase="%s"}' %
+              (r, phase), 1, atleast=True)
+    return text
+
+conf = {'kdcdefaults': {'kdc_metrics_socket': '$testdir/metrics.sock'}}
+realm = K5Realm(kdc_conf=conf, create_host=True, get_creds=False)
+realm.run([kadminl, 'modprinc', '+requires_preauth', realm.user_princ])
+path = os.path.join(realm.testdir, 'metrics.sock')
+if os.stat(path).st_mode & 0o777 != 0o600:
+    fail('Metrics socket has wrong permissions')
+run_requests(realm)
+text = check_metrics(realm, path)
+check(text, 'kdc_hint_cache_hits_total', 2)
+
+mark('worker processes')
+realm.stop_kdc()
+realm.start_kdc(['-w', '2'])
+run_requests(realm)
+text = check_metrics(realm, path)
+
+success('KDC metrics')
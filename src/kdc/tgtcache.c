@@ -0,0 +1,243 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* kdc/tgtcache.c - Cache of decrypted TGT contents for the TGS path */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Clients present the same TGT in every TGS request they make during its
+ * lifetime, so the KDC keeps the decrypted contents of recently seen TGTs.
+ * An entry is keyed by the ticket ciphertext together with the enctype and a
+ * digest of the key which decrypted it, so a lookup can only succeed for a
+ * ticket which would decrypt to the same plaintext under the key the caller
+ * has selected.  Entries under retired keys are no longer reachable once the
+ * key changes, and age out of the cache; entries are also discarded when the
+ * ticket expires.  The authenticator is still decrypted and checked for every
+ * request.
+ */
+
+#include "k5-int.h"
+#include "k5-queue.h"
+#include "k5-hashtab.h"
+#include "kdc_util.h"
+#include "extern.h"
+
+#ifndef NOCACHE
+
+struct entry {
+    K5_TAILQ_ENTRY(entry) links;
+    krb5_timestamp endtime;
+    krb5_data key;
+    krb5_enc_tkt_part *enc_tkt;
+};
+
+#ifndef TGT_CACHE_MAX_SIZE
+#define TGT_CACHE_MAX_SIZE (16 * 1024 * 1024)
+#endif
+
+/* The hash key is the enctype, the key digest, and the ticket ciphertext. */
+#define KEY_HDRLEN (4 + K5_SHA256_HASHLEN)
+
+K5_TAILQ_HEAD(entry_queue, entry);
+
+static struct k5_hashtab *hash_table;
+static struct entry_queue lru_queue;
+static size_t total_size = 0;
+
+/* Return the rough memory footprint of an entry.  The decoded ticket part is
+ * assumed to be about the size of its encoding. */
+static size_t
+entry_size(const krb5_data *key)
+{
+    return sizeof(struct entry) + key->length * 2;
+}
+
+/* Build the hash key for ticket decrypted with tgskey into *key_out. */
+static krb5_error_code
+make_key(const krb5_keyblock *tgskey, const krb5_ticket *ticket,
+         krb5_data *key_out)
+{
+    krb5_error_code ret;
+    krb5_data keydata = make_data(tgskey->contents, tgskey->length);
+    const krb5_data *ctext = &ticket->enc_part.ciphertext;
+    uint8_t *p;
+
+    ret = alloc_data(key_out, KEY_HDRLEN + ctext->length);
+    if (ret)
+        return ret;
+    p = (uint8_t *)key_out->data;
+    store_32_be(tgskey->enctype, p);
+    ret = k5_sha256(&keydata, 1, p + 4);
+    if (ret) {
+        krb5_free_data_contents(NULL, key_out);
+        return ret;
+    }
+    if (ctext->length > 0)
+        memcpy(p + KEY_HDRLEN, ctext->data, ctext->length);
+    return 0;
+}
+
+/* Remove entry from the hash table and the LRU queue, and free it. */
+static void
+discard_entry(krb5_context context, struct entry *entry)
+{
+    total_size -= entry_size(&entry->key);
+    k5_hashtab_remove(hash_table, entry->key.data, entry->key.length);
+    K5_TAILQ_REMOVE(&lru_queue, entry, links);
+    krb5_free_data_contents(context, &entry->key);
+    krb5_free_enc_tkt_part(context, entry->enc_tkt);
+    free(entry);
+}
+
+/* Initialize the TGT cache structures and randomize the hash seed. */
+krb5_error_code
+kdc_init_tgt_cache(krb5_context context)
+{
+    krb5_error_code ret;
+    uint8_t seed[K5_HASH_SEED_LEN];
+    krb5_data d = make_data(seed, sizeof(seed));
+
+    ret = krb5_c_random_make_octets(context, &d);
+    if (ret)
+        return ret;
+    ret = k5_hashtab_create(seed, 4096, &hash_table);
+    if (ret)
+        return ret;
+    K5_TAILQ_INIT(&lru_queue);
+    return 0;
+}
+
+/*
+ * If ticket has previously been decrypted with tgskey, set *enc_tkt_out to a
+ * copy of the decrypted ticket part.  Otherwise set *enc_tkt_out to NULL.
+ */
+krb5_error_code
+kdc_check_tgt_cache(krb5_context context, const krb5_keyblock *tgskey,
+                    const krb5_ticket *ticket,
+                    krb5_enc_tkt_part **enc_tkt_out)
+{
+    krb5_error_code ret;
+    struct entry *e;
+    krb5_data key;
+    krb5_timestamp now;
+
+    *enc_tkt_out = NULL;
+
+    ret = make_key(tgskey, ticket, &key);
+    if (ret)
+        return ret;
+    e = k5_hashtab_get(hash_table, key.data, key.length);
+    krb5_free_data_contents(context, &key);
+    if (e == NULL)
+        return 0;
+
+    ret = krb5_timeofday(context, &now);
+    if (ret)
+        return ret;
+    if (ts_after(now, e->endtime)) {
+        discard_entry(context, e);
+        return 0;
+    }
+
+    /* Move the entry to the tail of the LRU queue. */
+    K5_TAILQ_REMOVE(&lru_queue, e, links);
+    K5_TAILQ_INSERT_TAIL(&lru_queue, e, links);
+    return k5_copy_enc_tkt_part(context, e->enc_tkt, enc_tkt_out);
+}
+
+/*
+ * Remember the decrypted part of ticket, which was obtained using tgskey.  Can
+ * fail silently on memory exhaustion.  Also discard expired entries from the
+ * head of the LRU queue and limit the total size of the entries.
+ */
+void
+kdc_insert_tgt_cache(krb5_context context, const krb5_keyblock *tgskey,
+                     const krb5_ticket *ticket)
+{
+    struct entry *e, *next;
+    krb5_timestamp now;
+    krb5_data key;
+    size_t esize;
+
+    if (ticket->enc_part2 == NULL || krb5_timeofday(context, &now) != 0)
+        return;
+    if (ts_after(now, ticket->enc_part2->times.endtime))
+        return;
+    if (make_key(tgskey, ticket, &key) != 0)
+        return;
+    esize = entry_size(&key);
+
+    /* Replace any existing entry for the same ticket. */
+    e = k5_hashtab_get(hash_table, key.data, key.length);
+    if (e != NULL)
+        discard_entry(context, e);
+
+    K5_TAILQ_FOREACH_SAFE(e, &lru_queue, links, next) {
+        if (!ts_after(now, e->endtime) &&
+            total_size + esize <= TGT_CACHE_MAX_SIZE)
+            break;
+        discard_entry(context, e);
+    }
+
+    e = calloc(1, sizeof(*e));
+    if (e == NULL)
+        goto error;
+    e->endtime = ticket->enc_part2->times.endtime;
+    e->key = key;
+    key = empty_data();
+    if (k5_copy_enc_tkt_part(context, ticket->enc_part2, &e->enc_tkt) != 0)
+        goto error;
+    if (k5_hashtab_add(hash_table, e->key.data, e->key.length, e) != 0)
+        goto error;
+    K5_TAILQ_INSERT_TAIL(&lru_queue, e, links);
+    total_size += esize;
+    return;
+
+error:
+    krb5_free_data_contents(context, &key);
+    if (e != NULL) {
+        krb5_free_data_contents(context, &e->key);
+        krb5_free_enc_tkt_part(context, e->enc_tkt);
+        free(e);
+    }
+}
+
+/* Free all entries in the TGT cache. */
+void
+kdc_free_tgt_cache(krb5_context context)
+{
+    struct entry *e, *next;
+
+    K5_TAILQ_FOREACH_SAFE(e, &lru_queue, links, next) {
+        discard_entry(context, e);
+    }
+    k5_hashtab_free(hash_table);
+}
+
+#endif /* NOCACHE */
@@ -70,6 +70,25 @@
 static int tcp_or_rpc_data_counter;
 static int max_tcp_or_rpc_data_connections = 45;
 
+/*
+ * The built-in verto module waits with poll() where it is available and
+ * reliable, and otherwise with select(), which can only watch descriptors
+ * below FD_SETSIZE.  (On Windows FD_SETSIZE is a count, not a limit.)
+ */
+#if defined(_WIN32) || \
+    (defined(HAVE_POLL_H) && !defined(__APPLE__) && !defined(__FreeBSD__))
+#define FD_TOO_HIGH(fd) 0
+#else
+#define FD_TOO_HIGH(fd) ((fd) >= FD_SETSIZE)
+#endif
+
+void
+loop_set_max_connections(int max)
+{
+    if (max > 0)
+        max_tcp_or_rpc_data_connections = max;
+}
+
 static int
 setreuseaddr(int sock, int value)
 {
@@ -163,6 +182,7 @@ struct connection {
     /* RPC-specific fields */
     SVCXPRT *transp;
     int rpc_force_close;
+    int rpc_held;
 };
 
 #define SET(TYPE) struct { TYPE *data; size_t n, max; }
@@ -216,6 +236,14 @@ struct bind_address {
 static SET(verto_ev *) events;
 static SET(struct bind_address) bind_addresses;
 
+/* Events for RPC data connections, indexed by descriptor. */
+static verto_ev **rpc_events;
+static size_t rpc_events_size;
+
+/* Descriptors of RPC connections accepted while servicing a listener. */
+static SET(int) new_rpc_fds;
+static krb5_boolean accepting_rpc;
+
 verto_ctx *
 loop_init(verto_ev_type types)
 {
@@ -482,7 +510,6 @@ static void
 free_socket(verto_ctx *ctx, verto_ev *ev)
 {
     struct connection *conn = NULL;
-    fd_set fds;
     int fd;
 
     remove_event_from_set(ev);
@@ -499,11 +526,12 @@ free_socket(verto_ctx *ctx, verto_ev *ev)
     if (conn) {
         switch (conn->type) {
         case CONN_RPC:
+            if (fd >= 0 && (size_t)fd < rpc_events_size &&
+                rpc_events[fd] == ev)
+                rpc_events[fd] = NULL;
             if (conn->rpc_force_close) {
-                FD_ZERO(&fds);
-                FD_SET(fd, &fds);
-                svc_getreqset(&fds);
-                if (FD_ISSET(fd, &svc_fdset)) {
+                svc_getreq_fd(fd);
+                if (svc_fd_xprt(fd) != NULL) {
                     krb5_klog_syslog(LOG_ERR,
                                      _("descriptor %d closed but still "
                                        "in svc_fdset"),
@@ -554,12 +582,10 @@ add_fd(int sock, enum conn_type conntype, verto_ev_flag flags, void *handle,
 
     *ev_out = NULL;
 
-#ifndef _WIN32
-    if (sock >= FD_SETSIZE) {
+    if (FD_TOO_HIGH(sock)) {
         com_err(prog, 0, _("file descriptor number %d too high"), sock);
         return EMFILE;
     }
-#endif
     newconn = malloc(sizeof(*newconn));
     if (newconn == NULL) {
         com_err(prog, ENOMEM,
@@ -581,6 +607,7 @@ static void process_tcp_connection_read(verto_ctx *ctx, verto_ev *ev);
 static void process_tcp_connection_write(verto_ctx *ctx, verto_ev *ev);
 static void accept_rpc_connection(verto_ctx *ctx, verto_ev *ev);
 static void process_rpc_connection(verto_ctx *ctx, verto_ev *ev);
+static void rpc_xprt_notify(SVCXPRT *xprt, bool_t active, void *data);
 
 /*
  * Create a socket and bind it to addr.  Ensure the socket will work with
@@ -604,14 +631,12 @@ create_server_socket(struct sockaddr *addr, int type, const char *prog,
     }
     set_cloexec_fd(sock);
 
-#ifndef _WIN32                  /* Windows FD_SETSIZE is a count. */
-    if (sock >= FD_SETSIZE) {
+    if (FD_TOO_HIGH(sock)) {
         close(sock);
         com_err(prog, 0, _("TCP socket fd number %d (for %s) too high"),
                 sock, paddr(addr));
         return EMFILE;
     }
-#endif
 
     if (setreuseaddr(sock, 1) < 0)
         com_err(prog, errno, _("Cannot enable SO_REUSEADDR on fd %d"), sock);
@@ -762,6 +787,7 @@ setup_socket(struct bind_address *ba, struct sockaddr *sock_address,
     }
 
     if (ba->type == RPC) {
+        svc_set_xprt_notify(rpc_xprt_notify, NULL);
         conn = verto_get_private(ev);
         conn->transp = svctcp_create(sock, 0, 0);
         if (conn->transp == NULL) {
@@ -1115,6 +1141,8 @@ kill_lru_tcp_or_rpc_connection(void *handle, verto_ev *newev)
             continue;
         if (c->type != CONN_TCP && c->type != CONN_RPC)
             continue;
+        if (c->rpc_held)
+            continue;
         if (oldest_c == NULL
             || oldest_c->start_time > c->start_time) {
             oldest_ev = ev;
@@ -1149,12 +1177,10 @@ accept_tcp_connection(verto_ctx *ctx, verto_ev *ev)
     if (s < 0)
         return;
     set_cloexec_fd(s);
-#ifndef _WIN32
-    if (s >= FD_SETSIZE) {
+    if (FD_TOO_HIGH(s)) {
         close(s);
         return;
     }
-#endif
     setnbio(s), setnolinger(s), setkeepalive(s);
 
     flags = VERTO_EV_FLAG_IO_READ | VERTO_EV_FLAG_PERSIST;
@@ -1420,99 +1446,161 @@ loop_free(verto_ctx *ctx)
         free(val.address);
     FREE_SET_DATA(bind_addresses);
     FREE_SET_DATA(events);
+
+    svc_set_xprt_notify(NULL, NULL);
+    free(rpc_events);
+    rpc_events = NULL;
+    rpc_events_size = 0;
+    FREE_SET_DATA(new_rpc_fds);
 }
 
-static int
-have_event_for_fd(int fd)
+/* Remember connections accepted by an RPC listener, so that
+ * accept_rpc_connection() can add events for them. */
+static void
+rpc_xprt_notify(SVCXPRT *xprt, bool_t active, void *data)
 {
-    verto_ev *ev;
-    int i;
+    void *tmp;
 
-    FOREACH_ELT(events, i, ev) {
-        if (verto_get_fd(ev) == fd)
-            return 1;
-    }
+    if (active && accepting_rpc)
+        (void)ADD(new_rpc_fds, xprt->xp_sock, tmp);
+}
 
+/* Record ev as the event for the RPC connection on fd. */
+static krb5_error_code
+set_rpc_event(int fd, verto_ev *ev)
+{
+    verto_ev **newtab;
+    size_t newsize;
+
+    if ((size_t)fd >= rpc_events_size) {
+        newsize = (rpc_events_size == 0) ? 64 : rpc_events_size;
+        while (newsize <= (size_t)fd)
+            newsize *= 2;
+        newtab = realloc(rpc_events, newsize * sizeof(*rpc_events));
+        if (newtab == NULL)
+            return ENOMEM;
+        memset(newtab + rpc_events_size, 0,
+               (newsize - rpc_events_size) * sizeof(*rpc_events));
+        rpc_events = newtab;
+        rpc_events_size = newsize;
+    }
+    rpc_events[fd] = ev;
     return 0;
 }
 
+/* Add an event for the newly accepted RPC connection on s. */
 static void
-accept_rpc_connection(verto_ctx *ctx, verto_ev *ev)
+add_rpc_data_connection(verto_ctx *ctx, struct connection *conn, int s)
 {
+    struct sockaddr_storage addr_s;
+    struct sockaddr *addr = (struct sockaddr *)&addr_s;
+    socklen_t addrlen = sizeof(addr_s);
+    struct connection *newconn;
+    char tmpbuf[10];
     verto_ev_flag flags;
-    struct connection *conn;
-    fd_set fds;
-    int s;
+    verto_ev *newev;
 
-    conn = verto_get_private(ev);
+    flags = VERTO_EV_FLAG_IO_READ | VERTO_EV_FLAG_PERSIST;
+    if (add_fd(s, CONN_RPC, flags, conn->handle, conn->prog, ctx,
+               process_rpc_connection, &newev) != 0)
+        return;
+    if (set_rpc_event(s, newev) != 0) {
+        verto_del(newev);
+        return;
+    }
+    newconn = verto_get_private(newev);
 
-    /* Service the woken RPC listener descriptor. */
-    FD_ZERO(&fds);
-    FD_SET(verto_get_fd(ev), &fds);
-    svc_getreqset(&fds);
-
-    /* Scan svc_fdset for any new connections. */
-    for (s = 0; s < FD_SETSIZE; s++) {
-        struct sockaddr_storage addr_s;
-        struct sockaddr *addr = (struct sockaddr *) &addr_s;
-        socklen_t addrlen = sizeof(addr_s);
-        struct connection *newconn;
-        char tmpbuf[10];
-        verto_ev *newev;
-
-        /* If we already have this fd, continue. */
-        if (!FD_ISSET(s, &svc_fdset) || have_event_for_fd(s))
-            continue;
+    set_cloexec_fd(s);
 
-        flags = VERTO_EV_FLAG_IO_READ | VERTO_EV_FLAG_PERSIST;
-        if (add_fd(s, CONN_RPC, flags, conn->handle, conn->prog, ctx,
-                   process_rpc_connection, &newev) != 0)
-            continue;
-        newconn = verto_get_private(newev);
-
-        set_cloexec_fd(s);
-
-        if (getpeername(s, addr, &addrlen) ||
-            getnameinfo(addr, addrlen,
-                        newconn->addrbuf,
-                        sizeof(newconn->addrbuf),
-                        tmpbuf, sizeof(tmpbuf),
-                        NI_NUMERICHOST | NI_NUMERICSERV)) {
-            strlcpy(newconn->addrbuf, "???",
-                    sizeof(newconn->addrbuf));
-        } else {
-            char *p, *end;
-            p = newconn->addrbuf;
-            end = p + sizeof(newconn->addrbuf);
-            p += strlen(p);
-            if ((size_t)(end - p) > 2 + strlen(tmpbuf)) {
-                *p++ = '.';
-                strlcpy(p, tmpbuf, end - p);
-            }
+    if (getpeername(s, addr, &addrlen) ||
+        getnameinfo(addr, addrlen,
+                    newconn->addrbuf,
+                    sizeof(newconn->addrbuf),
+                    tmpbuf, sizeof(tmpbuf),
+                    NI_NUMERICHOST | NI_NUMERICSERV)) {
+        strlcpy(newconn->addrbuf, "???",
+                sizeof(newconn->addrbuf));
+    } else {
+        char *p, *end;
+        p = newconn->addrbuf;
+        end = p + sizeof(newconn->addrbuf);
+        p += strlen(p);
+        if ((size_t)(end - p) > 2 + strlen(tmpbuf)) {
+            *p++ = '.';
+            strlcpy(p, tmpbuf, end - p);
         }
+    }
 
-        newconn->addr_s = addr_s;
-        newconn->addrlen = addrlen;
-        newconn->start_time = time(0);
+    newconn->addr_s = addr_s;
+    newconn->addrlen = addrlen;
+    newconn->start_time = time(0);
 
-        if (++tcp_or_rpc_data_counter > max_tcp_or_rpc_data_connections)
-            kill_lru_tcp_or_rpc_connection(newconn->handle, newev);
+    if (++tcp_or_rpc_data_counter > max_tcp_or_rpc_data_connections)
+        kill_lru_tcp_or_rpc_connection(newconn->handle, newev);
 
-        newconn->remote_addr.address = &newconn->remote_addr_buf;
-        init_addr(&newconn->remote_addr, ss2sa(&newconn->addr_s));
-    }
+    newconn->remote_addr.address = &newconn->remote_addr_buf;
+    init_addr(&newconn->remote_addr, ss2sa(&newconn->addr_s));
 }
 
 static void
-process_rpc_connection(verto_ctx *ctx, verto_ev *ev)
+accept_rpc_connection(verto_ctx *ctx, verto_ev *ev)
 {
-    fd_set fds;
+    struct connection *conn = verto_get_private(ev);
+    size_t i;
+
+    /* Service the woken RPC listener descriptor, noting any connections it
+     * accepts. */
+    accepting_rpc = TRUE;
+    svc_getreq_fd(verto_get_fd(ev));
+    accepting_rpc = FALSE;
 
-    FD_ZERO(&fds);
-    FD_SET(verto_get_fd(ev), &fds);
-    svc_getreqset(&fds);
+    for (i = 0; i < new_rpc_fds.n; i++)
+        add_rpc_data_connection(ctx, conn, new_rpc_fds.data[i]);
+    new_rpc_fds.n = 0;
+}
+
+/* Return the event for the RPC connection on fd, or NULL if there is none. */
+static verto_ev *
+find_rpc_connection(int fd)
+{
+    if (fd < 0 || (size_t)fd >= rpc_events_size)
+        return NULL;
+    return rpc_events[fd];
+}
+
+void
+loop_hold_rpc_connection(int fd)
+{
+    verto_ev *ev = find_rpc_connection(fd);
+    struct connection *conn;
+
+    if (ev == NULL)
+        return;
+    conn = verto_get_private(ev);
+    conn->rpc_held = 1;
+    verto_set_flags(ev, VERTO_EV_FLAG_PERSIST);
+}
+
+void
+loop_release_rpc_connection(int fd)
+{
+    verto_ev *ev = find_rpc_connection(fd);
+    struct connection *conn;
+
+    if (ev == NULL)
+        return;
+    conn = verto_get_private(ev);
+    conn->rpc_held = 0;
+    verto_set_flags(ev, VERTO_EV_FLAG_IO_READ | VERTO_EV_FLAG_PERSIST);
+}
+
+static void
+process_rpc_connection(verto_ctx *ctx, verto_ev *ev)
+{
+    int fd = verto_get_fd(ev);
 
-    if (!FD_ISSET(verto_get_fd(ev), &svc_fdset))
+    svc_getreq_fd(fd);
+    if (svc_fd_xprt(fd) == NULL)
         verto_del(ev);
 }
 
@@ -53,9 +53,10 @@ krb5int_hmac_keyblock(const struct krb5_hash_provider *hash,
                       const krb5_crypto_iov *data, size_t num_data,
                       krb5_data *output)
 {
-    unsigned char *xorkey = NULL, *ihash = NULL;
+    unsigned char xorkey[MAX_HASH_BLOCKSIZE], ihash[MAX_HASH_SIZE];
     unsigned int i;
-    krb5_crypto_iov *ihash_iov = NULL, ohash_iov[2];
+    krb5_crypto_iov iov_buf[K5_CRYPTO_IOV_STACK_COUNT], ohash_iov[2];
+    krb5_crypto_iov *ihash_iov = iov_buf;
     krb5_data hashout;
     krb5_error_code ret;
 
@@ -63,17 +64,15 @@ krb5int_hmac_keyblock(const struct krb5_hash_provider *hash,
         return KRB5_CRYPTO_INTERNAL;
     if (output->length < hash->hashsize)
         return KRB5_BAD_MSIZE;
+    if (hash->blocksize > sizeof(xorkey) || hash->hashsize > sizeof(ihash))
+        return KRB5_CRYPTO_INTERNAL;
 
-    /* Allocate space for the xor key, hash input vector, and inner hash */
-    xorkey = k5alloc(hash->blocksize, &ret);
-    if (xorkey == NULL)
-        goto cleanup;
-    ihash = k5alloc(hash->hashsize, &ret);
-    if (ihash == NULL)
-        goto cleanup;
-    ihash_iov = k5calloc(num_data + 1, sizeof(krb5_crypto_iov), &ret);
-    if (ihash_iov == NULL)
-        goto cleanup;
+    /* Only allocate the hash input vector if it doesn't fit on the stack. */
+    if (num_data + 1 > K5_CRYPTO_IOV_STACK_COUNT) {
+        ihash_iov = k5calloc(num_data + 1, sizeof(krb5_crypto_iov), &ret);
+        if (ihash_iov == NULL)
+            return ret;
+    }
 
     /* Create the inner padded key. */
     memset(xorkey, 0x36, hash->blocksize);
@@ -105,9 +104,10 @@ krb5int_hmac_keyblock(const struct krb5_hash_provider *hash,
         memset(output->data, 0, output->length);
 
 cleanup:
-    zapfree(xorkey, hash->blocksize);
-    zapfree(ihash, hash->hashsize);
-    free(ihash_iov);
+    zap(xorkey, hash->blocksize);
+    zap(ihash, hash->hashsize);
+    if (ihash_iov != iov_buf)
+        free(ihash_iov);
     return ret;
 }
 
@@ -0,0 +1,144 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/crypto/crypto_tests/t_s2kperf.c - Batched string-to-key benchmark */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program measures the time taken to derive keys from one password for
+ * several enctypes, as the KDB does when a principal is created or its
+ * password is changed, using krb5_c_string_to_key() once per enctype and
+ * using krb5int_c_string_to_key_multi().  It also checks that the two methods
+ * produce the same keys.  Usage:
+ *
+ *     ./t_s2kperf count [enctype ...]
+ *
+ * If no enctypes are given, the PBKDF2-based enctypes are used.
+ */
+
+#include "k5-int.h"
+#include <sys/time.h>
+
+static const char *default_enctypes[] = {
+    "aes256-cts-hmac-sha1-96", "aes128-cts-hmac-sha1-96",
+    "aes256-cts-hmac-sha384-192", "aes128-cts-hmac-sha256-128",
+    "camellia256-cts-cmac", "camellia128-cts-cmac", NULL
+};
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_error_code ret;
+    krb5_enctype *enctypes;
+    krb5_keyblock *serial, *batch;
+    krb5_data pass = string2data("correct horse battery staple");
+    krb5_data *salts;
+    const char **names;
+    struct timeval start;
+    double serial_time, batch_time;
+    int count, n, i, j;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: t_s2kperf count [enctype ...]\n");
+        exit(1);
+    }
+    count = atoi(argv[1]);
+    if (argc > 2) {
+        names = (const char **)argv + 2;
+        n = argc - 2;
+    } else {
+        names = default_enctypes;
+        for (n = 0; names[n] != NULL; n++);
+    }
+
+    enctypes = calloc(n, sizeof(*enctypes));
+    salts = calloc(n, sizeof(*salts));
+    serial = calloc(n, sizeof(*serial));
+    batch = calloc(n, sizeof(*batch));
+    assert(enctypes != NULL && salts != NULL && serial != NULL &&
+           batch != NULL);
+    for (i = 0; i < n; i++) {
+        ret = krb5_string_to_enctype((char *)names[i], &enctypes[i]);
+        assert(!ret);
+        salts[i] = string2data("ATHENA.MIT.EDUraeburn");
+    }
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < n; j++) {
+            if (i > 0)
+                krb5_free_keyblock_contents(NULL, &serial[j]);
+            ret = krb5_c_string_to_key(NULL, enctypes[j], &pass, &salts[j],
+                                       &serial[j]);
+            assert(!ret);
+        }
+    }
+    serial_time = elapsed(&start);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < count; i++) {
+        if (i > 0) {
+            for (j = 0; j < n; j++)
+                krb5_free_keyblock_contents(NULL, &batch[j]);
+        }
+        ret = krb5int_c_string_to_key_multi(NULL, n, enctypes, &pass, salts,
+                                            NULL, batch);
+        assert(!ret);
+    }
+    batch_time = elapsed(&start);
+
+    for (j = 0; j < n; j++) {
+        if (serial[j].length != batch[j].length ||
+            memcmp(serial[j].contents, batch[j].contents,
+                   serial[j].length) != 0) {
+            fprintf(stderr, "Key mismatch for %s\n", names[j]);
+            exit(1);
+        }
+        krb5_free_keyblock_contents(NULL, &serial[j]);
+        krb5_free_keyblock_contents(NULL, &batch[j]);
+    }
+
+    printf("%d enctypes x %d: serial %.3f s, batched %.3f s\n", n, count,
+           serial_time, batch_time);
+    free(enctypes);
+    free(salts);
+    free(serial);
+    free(batch);
+    return 0;
+}
@@ -104,3 +104,24 @@ const struct krb5_cksumtypes krb5int_cksumtypes_list[] = {
 
 const size_t krb5int_cksumtypes_length =
     sizeof(krb5int_cksumtypes_list) / sizeof(struct krb5_cksumtypes);
+
+/* Map checksum type numbers to the entries above; see find_cksumtype().  Any
+ * entry added to the list must also be added here. */
+#define C(ctype, i) \
+    [(ctype) & CKSUMTYPE_INDEX_MASK] = &krb5int_cksumtypes_list[i]
+const struct krb5_cksumtypes *const
+krb5int_cksumtypes_index[CKSUMTYPE_INDEX_MASK + 1] = {
+    C(CKSUMTYPE_RSA_MD4, 0),
+    C(CKSUMTYPE_RSA_MD5, 1),
+    C(CKSUMTYPE_NIST_SHA, 2),
+    C(CKSUMTYPE_HMAC_SHA1_DES3, 3),
+    C(CKSUMTYPE_HMAC_MD5_ARCFOUR, 4),
+    C(CKSUMTYPE_HMAC_SHA1_96_AES128, 5),
+    C(CKSUMTYPE_HMAC_SHA1_96_AES256, 6),
+    C(CKSUMTYPE_MD5_HMAC_ARCFOUR, 7),
+    C(CKSUMTYPE_CMAC_CAMELLIA128, 8),
+    C(CKSUMTYPE_CMAC_CAMELLIA256, 9),
+    C(CKSUMTYPE_HMAC_SHA256_128_AES128, 10),
+    C(CKSUMTYPE_HMAC_SHA384_192_AES256, 11),
+};
+#undef C
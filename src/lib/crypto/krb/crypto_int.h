@@ -60,6 +60,11 @@ struct krb5_enc_provider {
     void (*key_cleanup)(krb5_key key);
 };
 
+/* Upper bounds on hashsize and blocksize over all hash providers, so that
+ * per-message hash outputs and HMAC pads can live on the stack. */
+#define MAX_HASH_SIZE 64
+#define MAX_HASH_BLOCKSIZE 128
+
 struct krb5_hash_provider {
     char hash_name[8];
     size_t hashsize, blocksize;
@@ -126,6 +131,16 @@ struct krb5_keytypes {
 extern const struct krb5_keytypes krb5int_enctypes_list[];
 extern const int krb5int_enctypes_length;
 
+/*
+ * krb5int_enctypes_index maps the low bits of an enctype number to the list
+ * entry for that enctype, or to NULL.  The numbers of the enctypes in the list
+ * must be distinct in their low bits; if one is added which collides, the mask
+ * must be widened.
+ */
+#define ENCTYPE_INDEX_MASK 0x1f
+extern const struct krb5_keytypes *const
+krb5int_enctypes_index[ENCTYPE_INDEX_MASK + 1];
+
 /*** RFC 3961 checksum types table ***/
 
 struct krb5_cksumtypes;
@@ -177,6 +192,13 @@ struct krb5_cksumtypes {
 extern const struct krb5_cksumtypes krb5int_cksumtypes_list[];
 extern const size_t krb5int_cksumtypes_length;
 
+/* Map the low bits of a checksum type number to its list entry, as for
+ * krb5int_enctypes_index.  The two Microsoft types (-137 and -138) map to
+ * slots not used by the positive checksum type numbers. */
+#define CKSUMTYPE_INDEX_MASK 0x1f
+extern const struct krb5_cksumtypes *const
+krb5int_cksumtypes_index[CKSUMTYPE_INDEX_MASK + 1];
+
 /*** Prototypes for enctype table functions ***/
 
 /* Length */
@@ -273,6 +295,19 @@ krb5_error_code krb5int_aes2_string_to_key(const struct krb5_keytypes *enc,
                                            const krb5_data *params,
                                            krb5_keyblock *key);
 
+/*
+ * Batch form of the three PBKDF2-based functions above, deriving keys[i] from
+ * one password for ktps[i] with salts[i] and params[i] (which may be NULL).
+ * keys[i] must be allocated with the enctype's key length.  On error, the
+ * contents of all of the keys are zeroed.
+ */
+krb5_error_code
+krb5int_pbkdf2_string_to_key_multi(const struct krb5_keytypes *const *ktps,
+                                   size_t n, const krb5_data *string,
+                                   const krb5_data *salts,
+                                   const krb5_data *const *params,
+                                   krb5_keyblock *keys);
+
 /* Random to key */
 krb5_error_code k5_rand2key_direct(const krb5_data *randombits,
                                    krb5_keyblock *keyblock);
@@ -470,6 +505,25 @@ krb5_error_code krb5int_pbkdf2_hmac(const struct krb5_hash_provider *hash,
                                     const krb5_data *password,
                                     const krb5_data *salt);
 
+/* One derivation within a krb5int_pbkdf2_hmac_multi() batch. */
+struct pbkdf2_job {
+    const struct krb5_hash_provider *hash;
+    krb5_data salt;
+    unsigned long count;
+    krb5_data out;              /* Caller-allocated */
+    krb5_error_code ret;        /* Result of this derivation */
+};
+
+/*
+ * Compute a batch of PBKDF2 derivations of password at once.  Jobs which
+ * differ only in output length are computed once, and independent jobs are
+ * divided among up to one thread per online CPU where threads are available.
+ * Return the first error in jobs, if any.
+ */
+krb5_error_code krb5int_pbkdf2_hmac_multi(const krb5_data *password,
+                                          struct pbkdf2_job *jobs,
+                                          size_t njobs);
+
 /* The following are used by test programs and are just handler functions from
  * the AES and Camellia enc providers. */
 krb5_error_code krb5int_aes_encrypt(krb5_key key, const krb5_data *ivec,
@@ -535,32 +589,35 @@ krb5_boolean k5_get_os_entropy(unsigned char *buf, size_t len, int strong);
 static inline const struct krb5_keytypes *
 find_enctype(krb5_enctype enctype)
 {
-    int i;
-
-    for (i = 0; i < krb5int_enctypes_length; i++) {
-        if (krb5int_enctypes_list[i].etype == enctype)
-            break;
-    }
+    const struct krb5_keytypes *ktp;
 
-    if (i == krb5int_enctypes_length)
-        return NULL;
-    return &krb5int_enctypes_list[i];
+    ktp = krb5int_enctypes_index[enctype & ENCTYPE_INDEX_MASK];
+    return (ktp != NULL && ktp->etype == enctype) ? ktp : NULL;
 }
 
 /* Find a checksum type by number in the cksumtypes table. */
 static inline const struct krb5_cksumtypes *
 find_cksumtype(krb5_cksumtype ctype)
 {
-    size_t i;
+    const struct krb5_cksumtypes *ctp;
 
-    for (i = 0; i < krb5int_cksumtypes_length; i++) {
-        if (krb5int_cksumtypes_list[i].ctype == ctype)
-            break;
-    }
+    ctp = krb5int_cksumtypes_index[ctype & CKSUMTYPE_INDEX_MASK];
+    return (ctp != NULL && ctp->ctype == ctype) ? ctp : NULL;
+}
 
-    if (i == krb5int_cksumtypes_length)
-        return NULL;
-    return &krb5int_cksumtypes_list[i];
+/*
+ * Return the enctypes table entry for key, or NULL if its enctype is not
+ * supported.  The entry is looked up when the key is created, but some callers
+ * (such as the GSSAPI DES3 code, which switches keys to des3-cbc-raw) change
+ * the keyblock enctype afterwards, so look it up again if it no longer
+ * matches.
+ */
+static inline const struct krb5_keytypes *
+key_keytype(krb5_key key)
+{
+    if (key->ktp == NULL || key->ktp->etype != key->keyblock.enctype)
+        return find_enctype(key->keyblock.enctype);
+    return key->ktp;
 }
 
 /* Verify that a key is appropriate for a checksum type. */
@@ -569,7 +626,7 @@ verify_key(const struct krb5_cksumtypes *ctp, krb5_key key)
 {
     const struct krb5_keytypes *ktp;
 
-    ktp = key ? find_enctype(key->keyblock.enctype) : NULL;
+    ktp = key ? key_keytype(key) : NULL;
     if (ctp->enc != NULL && (!ktp || ktp->enc != ctp->enc))
         return KRB5_BAD_ENCTYPE;
     if (key && (!ktp || key->keyblock.length != ktp->enc->keylength))
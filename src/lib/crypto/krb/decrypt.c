@@ -38,7 +38,7 @@ krb5_k_decrypt(krb5_context context, krb5_key key,
     unsigned int header_len, trailer_len, plain_len;
     char *scratch = NULL;
 
-    ktp = find_enctype(key->keyblock.enctype);
+    ktp = key_keytype(key);
     if (ktp == NULL)
         return KRB5_BAD_ENCTYPE;
 
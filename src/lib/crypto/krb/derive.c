@@ -221,15 +221,12 @@ k5_sp800_108_counter_hmac(const struct krb5_hash_provider *hash,
     krb5_crypto_iov iov[5];
     krb5_error_code ret;
     krb5_data prf;
-    unsigned char ibuf[4], lbuf[4];
+    unsigned char ibuf[4], lbuf[4], prfbuf[MAX_HASH_SIZE];
 
-    if (hash == NULL || outrnd->length > hash->hashsize)
+    if (hash == NULL || outrnd->length > hash->hashsize ||
+        hash->hashsize > sizeof(prfbuf))
         return KRB5_CRYPTO_INTERNAL;
-
-    /* Allocate encryption data buffer. */
-    ret = alloc_data(&prf, hash->hashsize);
-    if (ret)
-        return ret;
+    prf = make_data(prfbuf, hash->hashsize);
 
     /* [i]2: four-byte big-endian binary string giving the block counter (1) */
     iov[0].flags = KRB5_CRYPTO_TYPE_DATA;
@@ -252,7 +249,7 @@ k5_sp800_108_counter_hmac(const struct krb5_hash_provider *hash,
     ret = krb5int_hmac(hash, inkey, iov, 5, &prf);
     if (!ret)
         memcpy(outrnd->data, prf.data, outrnd->length);
-    zapfree(prf.data, prf.length);
+    zap(prfbuf, sizeof(prfbuf));
     return ret;
 }
 
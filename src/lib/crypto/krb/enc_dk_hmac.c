@@ -79,7 +79,7 @@ krb5int_dk_encrypt(const struct krb5_keytypes *ktp, krb5_key key,
     krb5_key ke = NULL, ki = NULL;
     size_t i;
     unsigned int blocksize, hmacsize, plainlen = 0, padsize = 0;
-    unsigned char *cksum = NULL;
+    unsigned char cksum[MAX_HASH_SIZE];
 
     /* E(Confounder | Plaintext | Pad) | Checksum */
 
@@ -118,9 +118,8 @@ krb5int_dk_encrypt(const struct krb5_keytypes *ktp, krb5_key key,
         padding->data.length = padsize;
     }
 
-    cksum = k5alloc(hash->hashsize, &ret);
-    if (ret != 0)
-        goto cleanup;
+    if (hash->hashsize > sizeof(cksum))
+        return KRB5_CRYPTO_INTERNAL;
 
     /* Derive the keys. */
 
@@ -171,7 +170,6 @@ krb5int_dk_encrypt(const struct krb5_keytypes *ktp, krb5_key key,
 cleanup:
     krb5_k_free_key(NULL, ke);
     krb5_k_free_key(NULL, ki);
-    free(cksum);
     return ret;
 }
 
@@ -190,7 +188,7 @@ krb5int_dk_decrypt(const struct krb5_keytypes *ktp, krb5_key key,
     size_t i;
     unsigned int blocksize; /* enc block size, not confounder len */
     unsigned int hmacsize, cipherlen = 0;
-    unsigned char *cksum = NULL;
+    unsigned char cksum[MAX_HASH_SIZE];
 
     /* E(Confounder | Plaintext | Pad) | Checksum */
 
@@ -219,9 +217,8 @@ krb5int_dk_decrypt(const struct krb5_keytypes *ktp, krb5_key key,
     if (trailer == NULL || trailer->data.length != hmacsize)
         return KRB5_BAD_MSIZE;
 
-    cksum = k5alloc(hash->hashsize, &ret);
-    if (ret != 0)
-        goto cleanup;
+    if (hash->hashsize > sizeof(cksum))
+        return KRB5_CRYPTO_INTERNAL;
 
     /* Derive the keys. */
 
@@ -264,6 +261,5 @@ krb5int_dk_decrypt(const struct krb5_keytypes *ktp, krb5_key key,
 cleanup:
     krb5_k_free_key(NULL, ke);
     krb5_k_free_key(NULL, ki);
-    free(cksum);
     return ret;
 }
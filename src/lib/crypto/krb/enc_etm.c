@@ -50,18 +50,18 @@ krb5int_aes2_crypto_length(const struct krb5_keytypes *ktp,
     }
 }
 
-/* Derive encryption and integrity keys for CMAC-using enctypes. */
+/* Derive encryption and integrity keys for CMAC-using enctypes.  ki must
+ * have space for half of the hash size; its length is set on success. */
 static krb5_error_code
 derive_keys(const struct krb5_keytypes *ktp, krb5_key key,
-            krb5_keyusage usage, krb5_key *ke_out, krb5_data *ki_out)
+            krb5_keyusage usage, krb5_key *ke_out, krb5_data *ki)
 {
     krb5_error_code ret;
     uint8_t label[5];
-    krb5_data label_data = make_data(label, 5), ki = empty_data();
+    krb5_data label_data = make_data(label, 5);
     krb5_key ke = NULL;
 
     *ke_out = NULL;
-    *ki_out = empty_data();
 
     /* Derive the encryption key. */
     store_32_be(usage, label);
@@ -73,27 +73,22 @@ derive_keys(const struct krb5_keytypes *ktp, krb5_key key,
 
     /* Derive the integrity key. */
     label[4] = 0x55;
-    ret = alloc_data(&ki, ktp->hash->hashsize / 2);
-    if (ret)
-        goto cleanup;
-    ret = krb5int_derive_random(NULL, ktp->hash, key, &ki, &label_data,
+    ki->length = ktp->hash->hashsize / 2;
+    ret = krb5int_derive_random(NULL, ktp->hash, key, ki, &label_data,
                                 DERIVE_SP800_108_HMAC);
     if (ret)
         goto cleanup;
 
     *ke_out = ke;
     ke = NULL;
-    *ki_out = ki;
-    ki = empty_data();
 
 cleanup:
     krb5_k_free_key(NULL, ke);
-    zapfree(ki.data, ki.length);
     return ret;
 }
 
-/* Compute an HMAC checksum over the cipher state and data.  Allocate enough
- * space in *out for the checksum. */
+/* Compute an HMAC checksum over the cipher state and data.  out must have
+ * space for the full hash size. */
 static krb5_error_code
 hmac_ivec_data(const struct krb5_keytypes *ktp, const krb5_data *ki,
                const krb5_data *ivec, krb5_crypto_iov *data, size_t num_data,
@@ -101,7 +96,7 @@ hmac_ivec_data(const struct krb5_keytypes *ktp, const krb5_data *ki,
 {
     krb5_error_code ret;
     krb5_data zeroivec = empty_data();
-    krb5_crypto_iov *iovs = NULL;
+    krb5_crypto_iov iov_buf[K5_CRYPTO_IOV_STACK_COUNT], *iovs = iov_buf;
     krb5_keyblock kb = { 0 };
 
     if (ivec == NULL) {
@@ -112,16 +107,16 @@ hmac_ivec_data(const struct krb5_keytypes *ktp, const krb5_data *ki,
     }
 
     /* Make a copy of data with an extra iov at the beginning for the ivec. */
-    iovs = k5calloc(num_data + 1, sizeof(*iovs), &ret);
-    if (iovs == NULL)
-        goto cleanup;
+    if (num_data + 1 > K5_CRYPTO_IOV_STACK_COUNT) {
+        iovs = k5calloc(num_data + 1, sizeof(*iovs), &ret);
+        if (iovs == NULL)
+            goto cleanup;
+    }
     iovs[0].flags = KRB5_CRYPTO_TYPE_DATA;
     iovs[0].data = *ivec;
     memcpy(iovs + 1, data, num_data * sizeof(*iovs));
 
-    ret = alloc_data(out, ktp->hash->hashsize);
-    if (ret)
-        goto cleanup;
+    out->length = ktp->hash->hashsize;
     kb.length = ki->length;
     kb.contents = (uint8_t *)ki->data;
     ret = krb5int_hmac_keyblock(ktp->hash, &kb, iovs, num_data + 1, out);
@@ -129,7 +124,8 @@ hmac_ivec_data(const struct krb5_keytypes *ktp, const krb5_data *ki,
 cleanup:
     if (zeroivec.data != NULL)
         ktp->enc->free_state(&zeroivec);
-    free(iovs);
+    if (iovs != iov_buf)
+        free(iovs);
     return ret;
 }
 
@@ -140,10 +136,12 @@ krb5int_etm_encrypt(const struct krb5_keytypes *ktp, krb5_key key,
 {
     const struct krb5_enc_provider *enc = ktp->enc;
     krb5_error_code ret;
-    krb5_data ivcopy = empty_data(), cksum = empty_data();
+    uint8_t kibuf[MAX_HASH_SIZE / 2], cksumbuf[MAX_HASH_SIZE];
+    krb5_data ivcopy = empty_data();
+    krb5_data cksum = make_data(cksumbuf, sizeof(cksumbuf));
     krb5_crypto_iov *header, *trailer, *padding;
     krb5_key ke = NULL;
-    krb5_data ki = empty_data();
+    krb5_data ki = make_data(kibuf, sizeof(kibuf));
     unsigned int trailer_len;
 
     /* E(Confounder | Plaintext) | Checksum(IV | ciphertext) */
@@ -200,8 +198,7 @@ krb5int_etm_encrypt(const struct krb5_keytypes *ktp, krb5_key key,
 
 cleanup:
     krb5_k_free_key(NULL, ke);
-    zapfree(ki.data, ki.length);
-    free(cksum.data);
+    zap(kibuf, sizeof(kibuf));
     zapfree(ivcopy.data, ivcopy.length);
     return ret;
 }
@@ -213,10 +210,11 @@ krb5int_etm_decrypt(const struct krb5_keytypes *ktp, krb5_key key,
 {
     const struct krb5_enc_provider *enc = ktp->enc;
     krb5_error_code ret;
-    krb5_data cksum = empty_data();
+    uint8_t kibuf[MAX_HASH_SIZE / 2], cksumbuf[MAX_HASH_SIZE];
+    krb5_data cksum = make_data(cksumbuf, sizeof(cksumbuf));
     krb5_crypto_iov *header, *trailer;
     krb5_key ke = NULL;
-    krb5_data ki = empty_data();
+    krb5_data ki = make_data(kibuf, sizeof(kibuf));
     unsigned int trailer_len;
 
     trailer_len = ktp->crypto_length(ktp, KRB5_CRYPTO_TYPE_TRAILER);
@@ -251,7 +249,7 @@ krb5int_etm_decrypt(const struct krb5_keytypes *ktp, krb5_key key,
 
 cleanup:
     krb5_k_free_key(NULL, ke);
-    zapfree(ki.data, ki.length);
-    zapfree(cksum.data, cksum.length);
+    zap(kibuf, sizeof(kibuf));
+    zap(cksumbuf, sizeof(cksumbuf));
     return ret;
 }
@@ -37,7 +37,7 @@ krb5_k_encrypt(krb5_context context, krb5_key key,
     krb5_error_code ret;
     unsigned int header_len, padding_len, trailer_len, total_len;
 
-    ktp = find_enctype(key->keyblock.enctype);
+    ktp = key_keytype(key);
     if (ktp == NULL)
         return KRB5_BAD_ENCTYPE;
 
@@ -33,7 +33,7 @@ krb5_k_encrypt_iov(krb5_context context, krb5_key key, krb5_keyusage usage,
 {
     const struct krb5_keytypes *ktp;
 
-    ktp = find_enctype(key->keyblock.enctype);
+    ktp = key_keytype(key);
     if (ktp == NULL)
         return KRB5_BAD_ENCTYPE;
 
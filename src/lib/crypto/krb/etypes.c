@@ -27,11 +27,8 @@
 
 #include "crypto_int.h"
 
-/* these will be linear searched.  if they ever get big, a binary
-   search or hash table would be better, which means these would need
-   to be sorted.  An array would be more efficient, but that assumes
-   that the keytypes are all near each other.  I'd rather not make
-   that assumption. */
+/* Lookups by number go through krb5int_enctypes_index below, so any entry
+ * added here must also be added there. */
 
 /* Deprecations come from RFC 6649 and RFC 8249. */
 const struct krb5_keytypes krb5int_enctypes_list[] = {
@@ -150,3 +147,21 @@ const struct krb5_keytypes krb5int_enctypes_list[] = {
 
 const int krb5int_enctypes_length =
     sizeof(krb5int_enctypes_list) / sizeof(struct krb5_keytypes);
+
+/* Map enctype numbers to the entries above; see find_enctype(). */
+#define E(etype, i) \
+    [(etype) & ENCTYPE_INDEX_MASK] = &krb5int_enctypes_list[i]
+const struct krb5_keytypes *const
+krb5int_enctypes_index[ENCTYPE_INDEX_MASK + 1] = {
+    E(ENCTYPE_DES3_CBC_RAW, 0),
+    E(ENCTYPE_DES3_CBC_SHA1, 1),
+    E(ENCTYPE_ARCFOUR_HMAC, 2),
+    E(ENCTYPE_ARCFOUR_HMAC_EXP, 3),
+    E(ENCTYPE_AES128_CTS_HMAC_SHA1_96, 4),
+    E(ENCTYPE_AES256_CTS_HMAC_SHA1_96, 5),
+    E(ENCTYPE_CAMELLIA128_CTS_CMAC, 6),
+    E(ENCTYPE_CAMELLIA256_CTS_CMAC, 7),
+    E(ENCTYPE_AES128_CTS_HMAC_SHA256_128, 8),
+    E(ENCTYPE_AES256_CTS_HMAC_SHA384_192, 9),
+};
+#undef E
@@ -50,6 +50,7 @@ krb5_k_create_key(krb5_context context, const krb5_keyblock *key_data,
     if (code)
         goto cleanup;
 
+    key->ktp = find_enctype(key->keyblock.enctype);
     key->refcount = 1;
     key->derived = NULL;
     key->cache = NULL;
@@ -87,7 +88,7 @@ krb5_k_free_key(krb5_context context, krb5_key key)
     }
     krb5int_c_free_keyblock_contents(context, &key->keyblock);
     if (key->cache) {
-        ktp = find_enctype(key->keyblock.enctype);
+        ktp = key_keytype(key);
         if (ktp && ktp->enc->key_cleanup)
             ktp->enc->key_cleanup(key);
     }
@@ -37,6 +37,7 @@ krb5_k_make_checksum_iov(krb5_context context,
     krb5_error_code ret;
     krb5_data cksum_data;
     krb5_crypto_iov *checksum;
+    char buf[MAX_HASH_SIZE];
     const struct krb5_cksumtypes *ctp;
 
     if (cksumtype == 0) {
@@ -57,9 +58,13 @@ krb5_k_make_checksum_iov(krb5_context context,
     if (checksum == NULL || checksum->data.length < ctp->output_size)
         return(KRB5_BAD_MSIZE);
 
-    ret = alloc_data(&cksum_data, ctp->compute_size);
-    if (ret != 0)
-        return ret;
+    if (ctp->compute_size <= sizeof(buf)) {
+        cksum_data = make_data(buf, ctp->compute_size);
+    } else {
+        ret = alloc_data(&cksum_data, ctp->compute_size);
+        if (ret != 0)
+            return ret;
+    }
 
     ret = ctp->checksum(ctp, key, usage, data, num_data, &cksum_data);
     if (ret != 0)
@@ -69,7 +74,10 @@ krb5_k_make_checksum_iov(krb5_context context,
     checksum->data.length = ctp->output_size;
 
 cleanup:
-    zapfree(cksum_data.data, ctp->compute_size);
+    if (cksum_data.data == buf)
+        zap(buf, ctp->compute_size);
+    else
+        zapfree(cksum_data.data, ctp->compute_size);
     return ret;
 }
 
@@ -0,0 +1,203 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/crypto/krb/pbkdf2_multi.c - Batched PBKDF2 derivations */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Compute several independent PBKDF2 derivations of one password.  Two
+ * optimizations apply to a batch which cannot be made one derivation at a
+ * time:
+ *
+ * - PBKDF2 output is a concatenation of independently computed hash-sized
+ *   blocks, so a shorter derivation with the same PRF, salt, and iteration
+ *   count is a prefix of a longer one.  (aes128-cts and aes256-cts with the
+ *   same salt are the common case.)  Such jobs are computed only once.
+ *
+ * - The remaining derivations do not share any state, so when threads are
+ *   available they are divided among up to one thread per online CPU, with
+ *   the calling thread taking a share.  On a single CPU, or if a thread
+ *   cannot be created, the work is done in the calling thread.
+ */
+
+#include "crypto_int.h"
+
+#if defined(ENABLE_THREADS) && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#define PBKDF2_THREADS
+#endif
+
+/* A share of a batch: every stride-th job of jobs, starting at first. */
+struct pbkdf2_worker {
+    const krb5_data *password;
+    struct pbkdf2_job **jobs;
+    size_t njobs;
+    size_t first;
+    size_t stride;
+#ifdef PBKDF2_THREADS
+    pthread_t tid;
+    krb5_boolean started;
+#endif
+};
+
+static void
+run_share(struct pbkdf2_worker *w)
+{
+    struct pbkdf2_job *job;
+    size_t i;
+
+    for (i = w->first; i < w->njobs; i += w->stride) {
+        job = w->jobs[i];
+        job->ret = krb5int_pbkdf2_hmac(job->hash, &job->out, job->count,
+                                       w->password, &job->salt);
+    }
+}
+
+#ifdef PBKDF2_THREADS
+static void *
+worker_thread(void *arg)
+{
+    run_share(arg);
+    return NULL;
+}
+#endif
+
+/* Return the number of threads to divide njobs derivations among. */
+static size_t
+count_workers(size_t njobs)
+{
+#if defined(PBKDF2_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (ncpus > 1)
+        return ((size_t)ncpus < njobs) ? (size_t)ncpus : njobs;
+#endif
+    return (njobs > 0) ? 1 : 0;
+}
+
+/* Return true if a and b differ only in output length. */
+static krb5_boolean
+same_inputs(const struct pbkdf2_job *a, const struct pbkdf2_job *b)
+{
+    return a->hash == b->hash && a->count == b->count &&
+        data_eq(a->salt, b->salt);
+}
+
+krb5_error_code
+krb5int_pbkdf2_hmac_multi(const krb5_data *password, struct pbkdf2_job *jobs,
+                          size_t njobs)
+{
+    krb5_error_code ret = 0;
+    struct pbkdf2_worker *workers = NULL;
+    struct pbkdf2_job **leads = NULL, *lead;
+    size_t *leader = NULL, i, j, k, nleads = 0, nworkers;
+
+    leader = k5calloc(njobs, sizeof(*leader), &ret);
+    if (leader == NULL)
+        goto cleanup;
+    leads = k5calloc(njobs, sizeof(*leads), &ret);
+    if (leads == NULL)
+        goto cleanup;
+
+    /* Assign each job to the longest job with the same inputs. */
+    for (i = 0; i < njobs; i++) {
+        leader[i] = i;
+        for (j = 0; j < i; j++) {
+            if (leader[j] != j || !same_inputs(&jobs[i], &jobs[j]))
+                continue;
+            if (jobs[i].out.length > jobs[j].out.length) {
+                for (k = 0; k < i; k++) {
+                    if (leader[k] == j)
+                        leader[k] = i;
+                }
+            } else {
+                leader[i] = j;
+            }
+            break;
+        }
+    }
+    for (i = 0; i < njobs; i++) {
+        if (leader[i] == i)
+            leads[nleads++] = &jobs[i];
+    }
+
+    nworkers = count_workers(nleads);
+    workers = k5calloc(nworkers > 0 ? nworkers : 1, sizeof(*workers), &ret);
+    if (workers == NULL)
+        goto cleanup;
+    for (i = 0; i < nworkers; i++) {
+        workers[i].password = password;
+        workers[i].jobs = leads;
+        workers[i].njobs = nleads;
+        workers[i].first = i;
+        workers[i].stride = nworkers;
+    }
+
+    /* Run the first share in this thread and the rest concurrently if
+     * possible, falling back to running them here. */
+#ifdef PBKDF2_THREADS
+    for (i = 1; i < nworkers; i++) {
+        if (pthread_create(&workers[i].tid, NULL, worker_thread,
+                           &workers[i]) == 0)
+            workers[i].started = TRUE;
+    }
+#endif
+    for (i = 0; i < nworkers; i++) {
+#ifdef PBKDF2_THREADS
+        if (workers[i].started)
+            continue;
+#endif
+        run_share(&workers[i]);
+    }
+#ifdef PBKDF2_THREADS
+    for (i = 1; i < nworkers; i++) {
+        if (workers[i].started)
+            (void)pthread_join(workers[i].tid, NULL);
+    }
+#endif
+
+    /* Fill in the shorter derivations from their leaders. */
+    for (i = 0; i < njobs; i++) {
+        if (leader[i] == i)
+            continue;
+        lead = &jobs[leader[i]];
+        jobs[i].ret = lead->ret;
+        if (lead->ret == 0)
+            memcpy(jobs[i].out.data, lead->out.data, jobs[i].out.length);
+    }
+
+    for (i = 0; i < njobs && ret == 0; i++)
+        ret = jobs[i].ret;
+
+cleanup:
+    free(leader);
+    free(leads);
+    free(workers);
+    return ret;
+}
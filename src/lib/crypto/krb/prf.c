@@ -55,7 +55,7 @@ krb5_k_prf(krb5_context context, krb5_key key,
     assert(input && output);
     assert(output->data);
 
-    ktp = find_enctype(key->keyblock.enctype);
+    ktp = key_keytype(key);
     if (ktp == NULL)
         return KRB5_BAD_ENCTYPE;
     if (ktp->prf == NULL)
@@ -105,19 +105,49 @@ cleanup:
 
 krb5_boolean k5_allow_weak_pbkdf2iter = FALSE;
 
+/* Return the PBKDF2 parameters for ktp, which uses one of the PBKDF2
+ * string-to-key functions below. */
+static void
+pbkdf2_s2k_params(const struct krb5_keytypes *ktp, krb5_boolean *use_pepper,
+                  unsigned long *def_iter_count)
+{
+    if (ktp->str2key == krb5int_aes_string_to_key) {
+        *use_pepper = FALSE;
+        *def_iter_count = 4096;
+    } else {
+        *use_pepper = TRUE;
+        *def_iter_count = 32768;
+    }
+}
+
+/* Return the key derivation algorithm used to finish ktp's string-to-key. */
+static enum deriv_alg
+pbkdf2_s2k_deriv_alg(const struct krb5_keytypes *ktp)
+{
+    if (ktp->str2key == krb5int_aes_string_to_key)
+        return DERIVE_RFC3961;
+    else if (ktp->str2key == krb5int_camellia_string_to_key)
+        return DERIVE_SP800_108_CMAC;
+    else
+        return DERIVE_SP800_108_HMAC;
+}
+
+/*
+ * Validate the string-to-key inputs for ktp and fill in job with the PBKDF2
+ * inputs, using key->contents as the output buffer.  job->salt is allocated
+ * and must be freed by the caller.
+ */
 static krb5_error_code
-pbkdf2_string_to_key(const struct krb5_keytypes *ktp, const krb5_data *string,
-                     const krb5_data *salt, const krb5_data *pepper,
-                     const krb5_data *params, krb5_keyblock *key,
-                     enum deriv_alg deriv_alg, unsigned long def_iter_count)
+pbkdf2_s2k_prep(const struct krb5_keytypes *ktp, const krb5_data *salt,
+                const krb5_data *params, krb5_keyblock *key,
+                struct pbkdf2_job *job)
 {
-    const struct krb5_hash_provider *hash;
-    unsigned long iter_count;
-    krb5_data out;
-    static const krb5_data usage = { KV5M_DATA, 8, "kerberos" };
-    krb5_key tempkey = NULL;
     krb5_error_code err;
-    krb5_data sandp = empty_data();
+    krb5_boolean use_pepper;
+    unsigned long iter_count, def_iter_count;
+    krb5_data pepper = empty_data();
+
+    pbkdf2_s2k_params(ktp, &use_pepper, &def_iter_count);
 
     if (params) {
         unsigned char *p = (unsigned char *) params->data;
@@ -140,43 +170,113 @@ pbkdf2_string_to_key(const struct krb5_keytypes *ktp, const krb5_data *string,
         return KRB5_ERR_BAD_S2K_PARAMS;
 
     /* Use the output keyblock contents for temporary space. */
-    out.data = (char *) key->contents;
-    out.length = key->length;
-    if (out.length != 16 && out.length != 32)
+    job->out.data = (char *) key->contents;
+    job->out.length = key->length;
+    if (job->out.length != 16 && job->out.length != 32)
         return KRB5_CRYPTO_INTERNAL;
 
-    if (pepper != NULL) {
-        err = alloc_data(&sandp, pepper->length + 1 + salt->length);
-        if (err)
-            return err;
+    if (use_pepper)
+        pepper = string2data(ktp->name);
+    err = alloc_data(&job->salt, pepper.length + use_pepper + salt->length);
+    if (err)
+        return err;
+    if (pepper.length > 0)
+        memcpy(job->salt.data, pepper.data, pepper.length);
+    if (use_pepper)
+        job->salt.data[pepper.length] = '\0';
+    if (salt->length > 0)
+        memcpy(&job->salt.data[pepper.length + use_pepper], salt->data,
+               salt->length);
 
-        if (pepper->length > 0)
-            memcpy(sandp.data, pepper->data, pepper->length);
-        sandp.data[pepper->length] = '\0';
-        if (salt->length > 0)
-            memcpy(&sandp.data[pepper->length + 1], salt->data, salt->length);
+    job->hash = (ktp->hash != NULL) ? ktp->hash : &krb5int_hash_sha1;
+    job->count = iter_count;
+    job->ret = 0;
+    return 0;
+}
 
-        salt = &sandp;
-    }
+/* Derive the final key from the PBKDF2 output in key. */
+static krb5_error_code
+pbkdf2_s2k_finish(const struct krb5_keytypes *ktp, krb5_keyblock *key)
+{
+    static const krb5_data usage = { KV5M_DATA, 8, "kerberos" };
+    krb5_key tempkey = NULL;
+    krb5_error_code err;
 
-    hash = (ktp->hash != NULL) ? ktp->hash : &krb5int_hash_sha1;
-    err = krb5int_pbkdf2_hmac(hash, &out, iter_count, string, salt);
+    err = krb5_k_create_key (NULL, key, &tempkey);
     if (err)
-        goto cleanup;
+        return err;
 
-    err = krb5_k_create_key (NULL, key, &tempkey);
+    err = krb5int_derive_keyblock(ktp->enc, ktp->hash, tempkey, key, &usage,
+                                  pbkdf2_s2k_deriv_alg(ktp));
+    krb5_k_free_key (NULL, tempkey);
+    return err;
+}
+
+static krb5_error_code
+pbkdf2_string_to_key(const struct krb5_keytypes *ktp, const krb5_data *string,
+                     const krb5_data *salt, const krb5_data *params,
+                     krb5_keyblock *key)
+{
+    struct pbkdf2_job job = { 0 };
+    krb5_error_code err;
+
+    err = pbkdf2_s2k_prep(ktp, salt, params, key, &job);
+    if (err)
+        return err;
+
+    err = krb5int_pbkdf2_hmac(job.hash, &job.out, job.count, string,
+                              &job.salt);
     if (err)
         goto cleanup;
 
-    err = krb5int_derive_keyblock(ktp->enc, ktp->hash, tempkey, key, &usage,
-                                  deriv_alg);
+    err = pbkdf2_s2k_finish(ktp, key);
 
 cleanup:
-    if (sandp.data)
-        free(sandp.data);
+    free(job.salt.data);
     if (err)
-        memset (out.data, 0, out.length);
-    krb5_k_free_key (NULL, tempkey);
+        memset (job.out.data, 0, job.out.length);
+    return err;
+}
+
+krb5_error_code
+krb5int_pbkdf2_string_to_key_multi(const struct krb5_keytypes *const *ktps,
+                                   size_t n, const krb5_data *string,
+                                   const krb5_data *salts,
+                                   const krb5_data *const *params,
+                                   krb5_keyblock *keys)
+{
+    struct pbkdf2_job *jobs;
+    krb5_error_code err;
+    size_t i;
+
+    jobs = k5calloc(n, sizeof(*jobs), &err);
+    if (jobs == NULL)
+        return err;
+
+    for (i = 0; i < n; i++) {
+        err = pbkdf2_s2k_prep(ktps[i], &salts[i], params[i], &keys[i],
+                              &jobs[i]);
+        if (err)
+            goto cleanup;
+    }
+
+    err = krb5int_pbkdf2_hmac_multi(string, jobs, n);
+    if (err)
+        goto cleanup;
+
+    for (i = 0; i < n; i++) {
+        err = pbkdf2_s2k_finish(ktps[i], &keys[i]);
+        if (err)
+            goto cleanup;
+    }
+
+cleanup:
+    for (i = 0; i < n; i++) {
+        free(jobs[i].salt.data);
+        if (err)
+            zap(keys[i].contents, keys[i].length);
+    }
+    free(jobs);
     return err;
 }
 
@@ -187,8 +287,7 @@ krb5int_aes_string_to_key(const struct krb5_keytypes *ktp,
                           const krb5_data *params,
                           krb5_keyblock *key)
 {
-    return pbkdf2_string_to_key(ktp, string, salt, NULL, params, key,
-                                DERIVE_RFC3961, 4096);
+    return pbkdf2_string_to_key(ktp, string, salt, params, key);
 }
 
 krb5_error_code
@@ -198,10 +297,7 @@ krb5int_camellia_string_to_key(const struct krb5_keytypes *ktp,
                                const krb5_data *params,
                                krb5_keyblock *key)
 {
-    krb5_data pepper = string2data(ktp->name);
-
-    return pbkdf2_string_to_key(ktp, string, salt, &pepper, params, key,
-                                DERIVE_SP800_108_CMAC, 32768);
+    return pbkdf2_string_to_key(ktp, string, salt, params, key);
 }
 
 krb5_error_code
@@ -209,8 +305,5 @@ krb5int_aes2_string_to_key(const struct krb5_keytypes *ktp,
                            const krb5_data *string, const krb5_data *salt,
                            const krb5_data *params, krb5_keyblock *key)
 {
-    krb5_data pepper = string2data(ktp->name);
-
-    return pbkdf2_string_to_key(ktp, string, salt, &pepper, params, key,
-                                DERIVE_SP800_108_HMAC, 32768);
+    return pbkdf2_string_to_key(ktp, string, salt, params, key);
 }
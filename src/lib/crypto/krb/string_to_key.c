@@ -77,3 +77,96 @@ krb5_c_string_to_key_with_params(krb5_context context, krb5_enctype enctype,
 
     return ret;
 }
+
+static krb5_boolean
+is_pbkdf2_s2k(const struct krb5_keytypes *ktp)
+{
+    return ktp->str2key == krb5int_aes_string_to_key ||
+        ktp->str2key == krb5int_camellia_string_to_key ||
+        ktp->str2key == krb5int_aes2_string_to_key;
+}
+
+krb5_error_code
+krb5int_c_string_to_key_multi(krb5_context context, size_t n,
+                              const krb5_enctype *enctypes,
+                              const krb5_data *string, const krb5_data *salts,
+                              const krb5_data *const *params,
+                              krb5_keyblock *keys)
+{
+    krb5_error_code ret;
+    const struct krb5_keytypes *ktp, **pktps = NULL;
+    const krb5_data **pparams = NULL;
+    krb5_data *psalts = NULL;
+    krb5_keyblock *pkeys = NULL;
+    size_t i, np = 0;
+
+    for (i = 0; i < n; i++)
+        keys[i].contents = NULL;
+
+    pktps = k5calloc(n, sizeof(*pktps), &ret);
+    if (pktps == NULL)
+        goto cleanup;
+    pparams = k5calloc(n, sizeof(*pparams), &ret);
+    if (pparams == NULL)
+        goto cleanup;
+    psalts = k5calloc(n, sizeof(*psalts), &ret);
+    if (psalts == NULL)
+        goto cleanup;
+    pkeys = k5calloc(n, sizeof(*pkeys), &ret);
+    if (pkeys == NULL)
+        goto cleanup;
+
+    /* Allocate the keys, computing the non-PBKDF2 ones (which are cheap)
+     * directly and gathering the rest into one batch. */
+    for (i = 0; i < n; i++) {
+        ktp = find_enctype(enctypes[i]);
+        if (ktp == NULL) {
+            ret = KRB5_BAD_ENCTYPE;
+            goto cleanup;
+        }
+        if (salts[i].length == SALT_TYPE_AFS_LENGTH) {
+            ret = EINVAL;
+            goto cleanup;
+        }
+
+        keys[i].contents = k5alloc(ktp->enc->keylength, &ret);
+        if (keys[i].contents == NULL)
+            goto cleanup;
+        keys[i].magic = KV5M_KEYBLOCK;
+        keys[i].enctype = enctypes[i];
+        keys[i].length = ktp->enc->keylength;
+
+        if (is_pbkdf2_s2k(ktp)) {
+            pktps[np] = ktp;
+            psalts[np] = salts[i];
+            pparams[np] = (params != NULL) ? params[i] : NULL;
+            /* pkeys[np] shares its contents with keys[i]. */
+            pkeys[np++] = keys[i];
+        } else {
+            ret = (*ktp->str2key)(ktp, string, &salts[i],
+                                  (params != NULL) ? params[i] : NULL,
+                                  &keys[i]);
+            if (ret)
+                goto cleanup;
+        }
+    }
+
+    if (np > 0) {
+        ret = krb5int_pbkdf2_string_to_key_multi(pktps, np, string, psalts,
+                                                 pparams, pkeys);
+    }
+
+cleanup:
+    for (i = 0; ret && i < n; i++) {
+        if (keys[i].contents == NULL)
+            continue;
+        zapfree(keys[i].contents, keys[i].length);
+        keys[i].contents = NULL;
+        keys[i].length = 0;
+    }
+    free(pktps);
+    free(pparams);
+    free(psalts);
+    free(pkeys);
+    return ret;
+}
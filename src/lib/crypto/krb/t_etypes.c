@@ -0,0 +1,142 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/crypto/krb/t_etypes.c - Test enctype and checksum type lookups */
+/*
+ * Copyright (C) 2021 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Verify that krb5int_enctypes_index and krb5int_cksumtypes_index agree with
+ * the enctype and checksum type lists, so that find_enctype() and
+ * find_cksumtype() find every list entry and nothing else.  Also verify that
+ * key_keytype() follows a change to a key's enctype after it is created, as
+ * the GSSAPI DES3 code makes.
+ */
+
+#include "crypto_int.h"
+
+/* Return the list entry for enctype by linear search, or NULL. */
+static const struct krb5_keytypes *
+scan_enctype(krb5_enctype enctype)
+{
+    int i;
+
+    for (i = 0; i < krb5int_enctypes_length; i++) {
+        if (krb5int_enctypes_list[i].etype == enctype)
+            return &krb5int_enctypes_list[i];
+    }
+    return NULL;
+}
+
+/* Return the list entry for ctype by linear search, or NULL. */
+static const struct krb5_cksumtypes *
+scan_cksumtype(krb5_cksumtype ctype)
+{
+    size_t i;
+
+    for (i = 0; i < krb5int_cksumtypes_length; i++) {
+        if (krb5int_cksumtypes_list[i].ctype == ctype)
+            return &krb5int_cksumtypes_list[i];
+    }
+    return NULL;
+}
+
+/* Return true if key_keytype() follows a change of a key's enctype from
+ * des3-cbc-sha1 to des3-cbc-raw. */
+static int
+check_retyped_key(void)
+{
+    krb5_keyblock kb;
+    krb5_key key;
+    uint8_t contents[24] = { 0 };
+    const struct krb5_keytypes *ktp;
+
+    kb.magic = KV5M_KEYBLOCK;
+    kb.enctype = ENCTYPE_DES3_CBC_SHA1;
+    kb.length = sizeof(contents);
+    kb.contents = contents;
+    if (krb5_k_create_key(NULL, &kb, &key) != 0)
+        return 0;
+    key->keyblock.enctype = ENCTYPE_DES3_CBC_RAW;
+    ktp = key_keytype(key);
+    krb5_k_free_key(NULL, key);
+    return ktp != NULL && ktp->etype == ENCTYPE_DES3_CBC_RAW;
+}
+
+int
+main()
+{
+    int i, status = 0;
+    size_t j;
+    int32_t n;
+
+    for (i = 0; i < krb5int_enctypes_length; i++) {
+        if (find_enctype(krb5int_enctypes_list[i].etype) !=
+            &krb5int_enctypes_list[i]) {
+            fprintf(stderr, "enctype %d (%s) not found in index\n",
+                    krb5int_enctypes_list[i].etype,
+                    krb5int_enctypes_list[i].name);
+            status = 1;
+        }
+    }
+    for (j = 0; j < krb5int_cksumtypes_length; j++) {
+        if (find_cksumtype(krb5int_cksumtypes_list[j].ctype) !=
+            &krb5int_cksumtypes_list[j]) {
+            fprintf(stderr, "cksumtype %d (%s) not found in index\n",
+                    krb5int_cksumtypes_list[j].ctype,
+                    krb5int_cksumtypes_list[j].name);
+            status = 1;
+        }
+    }
+
+    /* Check that values which alias a list entry's index slot, and values
+     * outside the lists, are not found. */
+    for (n = -1024; n <= 1024; n++) {
+        if (find_enctype(n) != scan_enctype(n)) {
+            fprintf(stderr, "wrong result for enctype %d\n", (int)n);
+            status = 1;
+        }
+        if (find_cksumtype(n) != scan_cksumtype(n)) {
+            fprintf(stderr, "wrong result for cksumtype %d\n", (int)n);
+            status = 1;
+        }
+    }
+    if (find_enctype(INT32_MAX) != NULL || find_enctype(INT32_MIN) != NULL ||
+        find_cksumtype(INT32_MAX) != NULL ||
+        find_cksumtype(INT32_MIN) != NULL) {
+        fprintf(stderr, "extreme type value found in index\n");
+        status = 1;
+    }
+
+    if (!check_retyped_key()) {
+        fprintf(stderr, "key_keytype() ignores a changed key enctype\n");
+        status = 1;
+    }
+
+    return status;
+}
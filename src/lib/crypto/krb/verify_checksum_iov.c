@@ -39,6 +39,7 @@ krb5_k_verify_checksum_iov(krb5_context context,
     krb5_error_code ret;
     krb5_data computed;
     krb5_crypto_iov *checksum;
+    char buf[MAX_HASH_SIZE];
 
     if (checksum_type == 0) {
         ret = krb5int_c_mandatory_cksumtype(context, key->keyblock.enctype,
@@ -65,9 +66,13 @@ krb5_k_verify_checksum_iov(krb5_context context,
                            valid);
     }
 
-    ret = alloc_data(&computed, ctp->compute_size);
-    if (ret != 0)
-        return ret;
+    if (ctp->compute_size <= sizeof(buf)) {
+        computed = make_data(buf, ctp->compute_size);
+    } else {
+        ret = alloc_data(&computed, ctp->compute_size);
+        if (ret != 0)
+            return ret;
+    }
 
     ret = ctp->checksum(ctp, key, usage, data, num_data, &computed);
     if (ret == 0) {
@@ -75,7 +80,10 @@ krb5_k_verify_checksum_iov(krb5_context context,
                           ctp->output_size) == 0);
     }
 
-    zapfree(computed.data, ctp->compute_size);
+    if (computed.data == buf)
+        zap(buf, ctp->compute_size);
+    else
+        zapfree(computed.data, ctp->compute_size);
     return ret;
 }
 
@@ -300,6 +300,13 @@ krb5_error_code kg_encrypt_inplace(krb5_context context, krb5_key key,
                                    int usage, krb5_pointer iv,
                                    krb5_pointer ptr, unsigned int length);
 
+/* Return kiov_buf (which has K5_CRYPTO_IOV_STACK_COUNT entries) if count fits
+ * in it, or else newly allocated space for count entries. */
+krb5_crypto_iov *kg_alloc_kiov(krb5_crypto_iov *kiov_buf, size_t count);
+
+/* Release a result of kg_alloc_kiov(). */
+void kg_free_kiov(krb5_crypto_iov *kiov_buf, krb5_crypto_iov *kiov);
+
 krb5_error_code kg_encrypt_iov (krb5_context context,
                                 int proto, int dce_style,
                                 size_t ec, size_t rrc,
@@ -379,7 +379,7 @@ kg_unseal_stream_iov(OM_uint32 *minor_status,
     krb5_context context = ctx->k5_context;
     int conf_req_flag, toktype2;
     int i = 0, j;
-    gss_iov_buffer_desc *tiov = NULL;
+    gss_iov_buffer_desc tiov_buf[K5_CRYPTO_IOV_STACK_COUNT], *tiov = NULL;
     gss_iov_buffer_t stream, data = NULL;
     gss_iov_buffer_t theader, tdata = NULL, tpadding, ttrailer;
 
@@ -413,7 +413,13 @@ kg_unseal_stream_iov(OM_uint32 *minor_status,
     ptr += 2;
     bodysize -= 2;
 
-    tiov = (gss_iov_buffer_desc *)calloc((size_t)iov_count + 2, sizeof(gss_iov_buffer_desc));
+    /* Avoid a heap allocation for the common small IOV arrays. */
+    if ((size_t)iov_count + 2 <= K5_CRYPTO_IOV_STACK_COUNT) {
+        memset(tiov_buf, 0, sizeof(tiov_buf));
+        tiov = tiov_buf;
+    } else {
+        tiov = calloc((size_t)iov_count + 2, sizeof(gss_iov_buffer_desc));
+    }
     if (tiov == NULL) {
         code = ENOMEM;
         goto cleanup;
@@ -575,7 +581,7 @@ kg_unseal_stream_iov(OM_uint32 *minor_status,
         kg_release_iov(tdata, 1);
 
 cleanup:
-    if (tiov != NULL)
+    if (tiov != tiov_buf)
         free(tiov);
 
     *minor_status = code;
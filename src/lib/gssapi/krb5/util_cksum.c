@@ -182,7 +182,7 @@ checksum_iov_v3(krb5_context context,
     krb5_error_code code;
     gss_iov_buffer_desc *header;
     gss_iov_buffer_desc *trailer;
-    krb5_crypto_iov *kiov;
+    krb5_crypto_iov kiov_buf[K5_CRYPTO_IOV_STACK_COUNT], *kiov;
     size_t kiov_count;
     int i = 0, j;
     unsigned int k5_checksumlen;
@@ -209,7 +209,7 @@ checksum_iov_v3(krb5_context context,
         return KRB5_BAD_MSIZE;
 
     kiov_count = 2 + iov_count;
-    kiov = (krb5_crypto_iov *)xmalloc(kiov_count * sizeof(krb5_crypto_iov));
+    kiov = kg_alloc_kiov(kiov_buf, kiov_count);
     if (kiov == NULL)
         return ENOMEM;
 
@@ -245,7 +245,7 @@ checksum_iov_v3(krb5_context context,
     else
         code = krb5_k_make_checksum_iov(context, type, key, sign_usage, kiov, kiov_count);
 
-    xfree(kiov);
+    kg_free_kiov(kiov_buf, kiov);
 
     return code;
 }
@@ -274,11 +274,27 @@ kg_arcfour_docrypt(const krb5_keyblock *keyblock, int usage,
     return krb5int_arcfour_gsscrypt(keyblock, usage, &kd, &kiov, 1);
 }
 
+krb5_crypto_iov *
+kg_alloc_kiov(krb5_crypto_iov *kiov_buf, size_t count)
+{
+    if (count <= K5_CRYPTO_IOV_STACK_COUNT)
+        return kiov_buf;
+    return calloc(count, sizeof(krb5_crypto_iov));
+}
+
+void
+kg_free_kiov(krb5_crypto_iov *kiov_buf, krb5_crypto_iov *kiov)
+{
+    if (kiov != kiov_buf)
+        free(kiov);
+}
+
 /* AEAD */
 static krb5_error_code
 kg_translate_iov_v1(krb5_context context, krb5_enctype enctype,
                     gss_iov_buffer_desc *iov, int iov_count,
-                    krb5_crypto_iov **pkiov, size_t *pkiov_count)
+                    krb5_crypto_iov *kiov_buf, krb5_crypto_iov **pkiov,
+                    size_t *pkiov_count)
 {
     gss_iov_buffer_desc *header;
     gss_iov_buffer_desc *trailer;
@@ -302,7 +318,7 @@ kg_translate_iov_v1(krb5_context context, krb5_enctype enctype,
     assert(trailer == NULL || trailer->buffer.length == 0);
 
     kiov_count = 3 + iov_count;
-    kiov = (krb5_crypto_iov *)malloc(kiov_count * sizeof(krb5_crypto_iov));
+    kiov = kg_alloc_kiov(kiov_buf, kiov_count);
     if (kiov == NULL)
         return ENOMEM;
 
@@ -347,8 +363,8 @@ kg_translate_iov_v1(krb5_context context, krb5_enctype enctype,
 static krb5_error_code
 kg_translate_iov_v3(krb5_context context, int dce_style, size_t ec, size_t rrc,
                     krb5_enctype enctype, gss_iov_buffer_desc *iov,
-                    int iov_count, krb5_crypto_iov **pkiov,
-                    size_t *pkiov_count)
+                    int iov_count, krb5_crypto_iov *kiov_buf,
+                    krb5_crypto_iov **pkiov, size_t *pkiov_count)
 {
     gss_iov_buffer_t header;
     gss_iov_buffer_t trailer;
@@ -403,7 +419,7 @@ kg_translate_iov_v3(krb5_context context, int dce_style, size_t ec, size_t rrc,
         return KRB5_BAD_MSIZE;
 
     kiov_count = 3 + iov_count;
-    kiov = (krb5_crypto_iov *)malloc(kiov_count * sizeof(krb5_crypto_iov));
+    kiov = kg_alloc_kiov(kiov_buf, kiov_count);
     if (kiov == NULL)
         return ENOMEM;
 
@@ -453,17 +469,22 @@ kg_translate_iov_v3(krb5_context context, int dce_style, size_t ec, size_t rrc,
     return 0;
 }
 
-/* PROTO is 1 if CFX, 0 if pre-CFX */
+/*
+ * PROTO is 1 if CFX, 0 if pre-CFX.  KIOV_BUF must have room for
+ * K5_CRYPTO_IOV_STACK_COUNT entries; it is used for the result if it is large
+ * enough.  Release the result with kg_free_kiov().
+ */
 static krb5_error_code
 kg_translate_iov(krb5_context context, int proto, int dce_style, size_t ec,
                  size_t rrc, krb5_enctype enctype, gss_iov_buffer_desc *iov,
-                 int iov_count, krb5_crypto_iov **pkiov, size_t *pkiov_count)
+                 int iov_count, krb5_crypto_iov *kiov_buf,
+                 krb5_crypto_iov **pkiov, size_t *pkiov_count)
 {
     return proto ?
         kg_translate_iov_v3(context, dce_style, ec, rrc, enctype,
-                            iov, iov_count, pkiov, pkiov_count) :
+                            iov, iov_count, kiov_buf, pkiov, pkiov_count) :
         kg_translate_iov_v1(context, enctype, iov, iov_count,
-                            pkiov, pkiov_count);
+                            kiov_buf, pkiov, pkiov_count);
 }
 
 krb5_error_code
@@ -474,7 +495,7 @@ kg_encrypt_iov(krb5_context context, int proto, int dce_style, size_t ec,
     krb5_error_code code;
     krb5_data *state;
     size_t kiov_len;
-    krb5_crypto_iov *kiov;
+    krb5_crypto_iov kiov_buf[K5_CRYPTO_IOV_STACK_COUNT], *kiov;
 
     code = iv_to_state(context, key, iv, &state);
     if (code)
@@ -482,10 +503,10 @@ kg_encrypt_iov(krb5_context context, int proto, int dce_style, size_t ec,
 
     code = kg_translate_iov(context, proto, dce_style, ec, rrc,
                             key->keyblock.enctype, iov, iov_count,
-                            &kiov, &kiov_len);
+                            kiov_buf, &kiov, &kiov_len);
     if (code == 0) {
         code = krb5_k_encrypt_iov(context, key, usage, state, kiov, kiov_len);
-        free(kiov);
+        kg_free_kiov(kiov_buf, kiov);
     }
 
     krb5_free_data(context, state);
@@ -502,7 +523,7 @@ kg_decrypt_iov(krb5_context context, int proto, int dce_style, size_t ec,
     krb5_error_code code;
     krb5_data *state;
     size_t kiov_len;
-    krb5_crypto_iov *kiov;
+    krb5_crypto_iov kiov_buf[K5_CRYPTO_IOV_STACK_COUNT], *kiov;
 
     code = iv_to_state(context, key, iv, &state);
     if (code)
@@ -510,10 +531,10 @@ kg_decrypt_iov(krb5_context context, int proto, int dce_style, size_t ec,
 
     code = kg_translate_iov(context, proto, dce_style, ec, rrc,
                             key->keyblock.enctype, iov, iov_count,
-                            &kiov, &kiov_len);
+                            kiov_buf, &kiov, &kiov_len);
     if (code == 0) {
         code = krb5_k_decrypt_iov(context, key, usage, state, kiov, kiov_len);
-        free(kiov);
+        kg_free_kiov(kiov_buf, kiov);
     }
 
     krb5_free_data(context, state);
@@ -528,16 +549,16 @@ kg_arcfour_docrypt_iov(krb5_context context, const krb5_keyblock *keyblock,
 {
     krb5_error_code code;
     krb5_data kd = make_data((char *) kd_data, kd_data_len);
-    krb5_crypto_iov *kiov = NULL;
+    krb5_crypto_iov kiov_buf[K5_CRYPTO_IOV_STACK_COUNT], *kiov = NULL;
     size_t kiov_len = 0;
 
     code = kg_translate_iov(context, 0 /* proto */, 0 /* dce_style */,
                             0 /* ec */, 0 /* rrc */, keyblock->enctype,
-                            iov, iov_count, &kiov, &kiov_len);
+                            iov, iov_count, kiov_buf, &kiov, &kiov_len);
     if (code)
         return code;
     code = krb5int_arcfour_gsscrypt(keyblock, usage, &kd, kiov, kiov_len);
-    free(kiov);
+    kg_free_kiov(kiov_buf, kiov);
     return code;
 }
 
@@ -147,6 +147,12 @@ static struct log_control log_control = {
 };
 static struct log_entry def_log_entry;
 
+/* The most recently formatted log timestamp and the time it represents. */
+static time_t log_stamp_time = (time_t)-1;
+static char log_stamp[32];
+static size_t log_stamp_len;
+static k5_mutex_t log_stamp_lock = K5_MUTEX_PARTIAL_INITIALIZER;
+
 /*
  * These macros define any special processing that needs to happen for
  * devices.  For unix, of course, this is hardly anything.
@@ -158,6 +164,384 @@ static struct log_entry def_log_entry;
                                  -1)
 #define DEVICE_CLOSE(d)         fclose(d)
 
+#define DEFAULT_ASYNC_BUFFER_SIZE       (1024 * 1024)
+
+#if defined(ENABLE_THREADS) && defined(HAVE_PTHREAD)
+#define ASYNC_LOGGING
+#endif
+
+#ifdef ASYNC_LOGGING
+/*
+ * Asynchronous file logging.
+ *
+ * If [logging]->async is true, lines destined for FILE and STDERR outputs are
+ * appended to a ring buffer and written out by a background thread, so that a
+ * slow disk does not stall the caller's event loop.  The caller only holds
+ * the lock long enough to copy a line into the buffer; the writer thread
+ * writes everything between tail and head without the lock and then advances
+ * tail.  head and tail count bytes ever written and read, so head - tail is
+ * the amount of buffered data.
+ *
+ * The writer thread is started on the first message logged in a process, so
+ * daemons which fork after krb5_klog_init() get a writer in the child.  The
+ * buffer is drained before any fork so that no line is written twice.
+ *
+ * k5-thread.h has no condition variables, so the conditions are plain pthread
+ * ones; with pthreads, a k5_mutex_t is a pthread mutex and can be waited on.
+ */
+struct log_async {
+    krb5_boolean        enabled;
+    krb5_boolean        block;
+    krb5_boolean        running;
+    krb5_boolean        stopping;
+    krb5_boolean        writing;
+    pthread_t           thread;
+    k5_mutex_t          lock;
+    pthread_cond_t      ready;
+    pthread_cond_t      space;
+    char                *buf;
+    size_t              size;
+    size_t              head;
+    size_t              tail;
+    unsigned long       dropped;
+    unsigned long       unreported;
+};
+
+static struct log_async log_async = {
+    FALSE, FALSE, FALSE, FALSE, FALSE, 0,
+    K5_MUTEX_PARTIAL_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER
+};
+
+static k5_once_t log_async_atfork_once = K5_ONCE_INIT;
+
+/* Write len bytes of data to each file output. */
+static void
+async_write_files(const char *data, size_t len)
+{
+    struct log_entry *le;
+    int lindex;
+
+    if (len == 0)
+        return;
+    for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
+        le = &log_control.log_entries[lindex];
+        if (le->log_type != K_LOG_FILE && le->log_type != K_LOG_STDERR)
+            continue;
+        if (fwrite(data, 1, len, le->lfu_filep) != len) {
+            fprintf(stderr, log_file_err, log_control.log_whoami,
+                    le->lfu_fname);
+        }
+    }
+}
+
+/* Flush each file output. */
+static void
+async_flush_files(void)
+{
+    struct log_entry *le;
+    int lindex;
+
+    for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
+        le = &log_control.log_entries[lindex];
+        if (le->log_type == K_LOG_FILE || le->log_type == K_LOG_STDERR)
+            fflush(le->lfu_filep);
+    }
+}
+
+/* Write out everything buffered, in batches, until asked to stop. */
+static void *
+async_writer(void *arg)
+{
+    struct log_async *la = &log_async;
+    size_t start, end, off, len;
+
+    k5_mutex_lock(&la->lock);
+    for (;;) {
+        while (la->head == la->tail && !la->stopping)
+            pthread_cond_wait(&la->ready, &la->lock);
+        if (la->head == la->tail)
+            break;
+
+        /* Write the buffered data without holding the lock.  Callers only
+         * add data after head, so [tail, head) is stable. */
+        start = la->tail;
+        end = la->head;
+        la->writing = TRUE;
+        k5_mutex_unlock(&la->lock);
+
+        off = start % la->size;
+        len = end - start;
+        if (off + len > la->size) {
+            async_write_files(la->buf + off, la->size - off);
+            async_write_files(la->buf, len - (la->size - off));
+        } else {
+            async_write_files(la->buf + off, len);
+        }
+        async_flush_files();
+
+        k5_mutex_lock(&la->lock);
+        la->tail = end;
+        la->writing = FALSE;
+        pthread_cond_broadcast(&la->space);
+    }
+    k5_mutex_unlock(&la->lock);
+    return NULL;
+}
+
+/* Wait (with the lock held) until the writer has written all buffered data. */
+static void
+async_wait_drained(void)
+{
+    struct log_async *la = &log_async;
+
+    while (la->running && (la->head != la->tail || la->writing))
+        pthread_cond_wait(&la->space, &la->lock);
+}
+
+/* Keep the buffer from being inherited with unwritten data across fork(),
+ * and note that the child has no writer thread yet. */
+static void
+async_atfork_prepare(void)
+{
+    k5_mutex_lock(&log_async.lock);
+    async_wait_drained();
+}
+
+static void
+async_atfork_parent(void)
+{
+    k5_mutex_unlock(&log_async.lock);
+}
+
+static void
+async_atfork_child(void)
+{
+    log_async.running = FALSE;
+    log_async.writing = FALSE;
+    k5_mutex_unlock(&log_async.lock);
+    pthread_cond_init(&log_async.ready, NULL);
+    pthread_cond_init(&log_async.space, NULL);
+}
+
+static void
+async_register_atfork(void)
+{
+    (void)pthread_atfork(async_atfork_prepare, async_atfork_parent,
+                         async_atfork_child);
+}
+
+/* Copy len bytes of data into the buffer at head (with the lock held). */
+static void
+async_copy(const char *data, size_t len)
+{
+    struct log_async *la = &log_async;
+    size_t off = la->head % la->size;
+    size_t first = (off + len > la->size) ? la->size - off : len;
+
+    memcpy(la->buf + off, data, first);
+    memcpy(la->buf, data + first, len - first);
+    la->head += len;
+}
+
+/* Append len bytes of data followed by a newline to the buffer (with the lock
+ * held), or return FALSE if there is no room and the overflow policy is to
+ * drop. */
+static krb5_boolean
+async_append(const char *data, size_t len)
+{
+    struct log_async *la = &log_async;
+
+    if (len + 1 > la->size)
+        return FALSE;
+    while (la->size - (la->head - la->tail) < len + 1) {
+        if (!la->block)
+            return FALSE;
+        pthread_cond_wait(&la->space, &la->lock);
+    }
+
+    async_copy(data, len);
+    async_copy("\n", 1);
+    return TRUE;
+}
+
+/*
+ * Queue a formatted log line for the file outputs.  Return FALSE if the line
+ * should instead be written synchronously, because asynchronous logging is
+ * not configured or the writer thread cannot be started.
+ */
+static krb5_boolean
+async_put(const char *line)
+{
+    struct log_async *la = &log_async;
+    char note[128];
+    size_t len = strlen(line);
+
+    if (!la->enabled)
+        return FALSE;
+
+    k5_mutex_lock(&la->lock);
+    if (!la->running) {
+        if (pthread_create(&la->thread, NULL, async_writer, NULL) != 0) {
+            k5_mutex_unlock(&la->lock);
+            return FALSE;
+        }
+        la->running = TRUE;
+    }
+
+    /* Report lines lost to earlier overflows once there is room again. */
+    if (la->unreported > 0) {
+        snprintf(note, sizeof(note), _("%s: %lu log messages dropped"),
+                 log_control.log_whoami ? log_control.log_whoami : "",
+                 la->unreported);
+        if (async_append(note, strlen(note)))
+            la->unreported = 0;
+    }
+
+    if (async_append(line, len)) {
+        pthread_cond_signal(&la->ready);
+    } else {
+        la->dropped++;
+        la->unreported++;
+    }
+    k5_mutex_unlock(&la->lock);
+    return TRUE;
+}
+
+/* Read the asynchronous logging configuration from the profile. */
+static void
+async_init(krb5_context kcontext)
+{
+    struct log_async *la = &log_async;
+    int async = 0, size = DEFAULT_ASYNC_BUFFER_SIZE, lindex;
+    char *overflow = NULL;
+    krb5_boolean have_files = FALSE;
+
+    for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
+        if (log_control.log_entries[lindex].log_type == K_LOG_FILE ||
+            log_control.log_entries[lindex].log_type == K_LOG_STDERR)
+            have_files = TRUE;
+    }
+    if (!have_files)
+        return;
+
+    if (profile_get_boolean(kcontext->profile, KRB5_CONF_LOGGING,
+                            KRB5_CONF_ASYNC, NULL, 0, &async) || !async)
+        return;
+    if (profile_get_integer(kcontext->profile, KRB5_CONF_LOGGING,
+                            KRB5_CONF_ASYNC_BUFFER_SIZE, NULL,
+                            DEFAULT_ASYNC_BUFFER_SIZE, &size) || size <= 0)
+        size = DEFAULT_ASYNC_BUFFER_SIZE;
+    if (!profile_get_string(kcontext->profile, KRB5_CONF_LOGGING,
+                            KRB5_CONF_ASYNC_OVERFLOW, NULL, NULL,
+                            &overflow) && overflow != NULL) {
+        if (strcasecmp(overflow, "block") == 0)
+            la->block = TRUE;
+        else if (strcasecmp(overflow, "drop") != 0)
+            fprintf(stderr, _("%s: unknown async_overflow value %s\n"),
+                    log_control.log_whoami, overflow);
+        profile_release_string(overflow);
+    }
+
+    la->buf = malloc(size);
+    if (la->buf == NULL)
+        return;
+    la->size = size;
+    la->head = la->tail = 0;
+    la->dropped = la->unreported = 0;
+    (void)k5_once(&log_async_atfork_once, async_register_atfork);
+    la->enabled = TRUE;
+}
+
+/* Write out all buffered data and stop the writer thread. */
+static void
+async_fini(void)
+{
+    struct log_async *la = &log_async;
+    krb5_boolean running;
+
+    if (!la->enabled)
+        return;
+
+    k5_mutex_lock(&la->lock);
+    la->stopping = TRUE;
+    running = la->running;
+    pthread_cond_signal(&la->ready);
+    k5_mutex_unlock(&la->lock);
+    if (running)
+        pthread_join(la->thread, NULL);
+
+    free(la->buf);
+    la->buf = NULL;
+    la->size = 0;
+    la->enabled = la->running = la->stopping = la->block = FALSE;
+}
+
+/* Wait for buffered data to be written and keep the writer from starting
+ * another batch until async_resume() is called. */
+static void
+async_pause(void)
+{
+    if (!log_async.enabled)
+        return;
+    k5_mutex_lock(&log_async.lock);
+    async_wait_drained();
+}
+
+static void
+async_resume(void)
+{
+    if (log_async.enabled)
+        k5_mutex_unlock(&log_async.lock);
+}
+
+unsigned long
+krb5_klog_get_dropped(void)
+{
+    unsigned long dropped;
+
+    k5_mutex_lock(&log_async.lock);
+    dropped = log_async.dropped;
+    k5_mutex_unlock(&log_async.lock);
+    return dropped;
+}
+
+#else /* !ASYNC_LOGGING */
+
+static krb5_boolean
+async_put(const char *line)
+{
+    return FALSE;
+}
+
+static void
+async_init(krb5_context kcontext)
+{
+}
+
+static void
+async_fini(void)
+{
+}
+
+static void
+async_pause(void)
+{
+}
+
+static void
+async_resume(void)
+{
+}
+
+unsigned long
+krb5_klog_get_dropped(void)
+{
+    return 0;
+}
+
+#endif /* !ASYNC_LOGGING */
+
 /*
  * klog_com_err_proc()  - Handle com_err(3) messages as specified by the
  *                        profile.
@@ -516,6 +900,7 @@ krb5_klog_init(krb5_context kcontext, char *ename, char *whoami, krb5_boolean do
         }
         if (do_com_err)
             (void) set_com_err_hook(klog_com_err_proc);
+        async_init(kcontext);
     }
     return((log_control.log_nentries) ? 0 : ENOENT);
 }
@@ -535,6 +920,7 @@ krb5_klog_close(krb5_context kcontext)
 {
     int lindex;
     (void) reset_com_err_hook();
+    async_fini();
     for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
         switch (log_control.log_entries[lindex].log_type) {
         case K_LOG_FILE:
@@ -638,6 +1024,7 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
     time_t      now;
     size_t      soff;
     struct tm  *tm;
+    krb5_boolean queued = FALSE;
 
     /*
      * Format a syslog-esque message of the format:
@@ -652,16 +1039,24 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
     (void) time(&now);
 
     /*
-     * Format the date: mon dd hh:mm:ss
+     * Format the date: mon dd hh:mm:ss.  This only changes once a second, so
+     * reuse the previous result when we can.
      */
-    tm = localtime(&now);
-    if (tm == NULL)
-        return(-1);
-    soff = strftime(outbuf, sizeof(outbuf), "%b %d %H:%M:%S", tm);
-    if (soff > 0)
-        cp += soff;
-    else
-        return(-1);
+    k5_mutex_lock(&log_stamp_lock);
+    if (now != log_stamp_time) {
+        tm = localtime(&now);
+        soff = (tm == NULL) ? 0 :
+            strftime(log_stamp, sizeof(log_stamp), "%b %d %H:%M:%S", tm);
+        if (soff == 0) {
+            k5_mutex_unlock(&log_stamp_lock);
+            return(-1);
+        }
+        log_stamp_len = soff;
+        log_stamp_time = now;
+    }
+    memcpy(outbuf, log_stamp, log_stamp_len + 1);
+    cp += log_stamp_len;
+    k5_mutex_unlock(&log_stamp_lock);
 
 #ifdef VERBOSE_LOGS
     snprintf(cp, sizeof(outbuf) - (cp-outbuf), " %s %s[%ld](%s): ",
@@ -686,6 +1081,11 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
         syslog(priority, "%s", syslogp);
     }
 
+    /* If asynchronous logging is configured, queue the message for the
+     * files instead of writing it here. */
+    if (priority != LOG_DEBUG || log_control.log_debug)
+        queued = async_put(outbuf);
+
     /*
      * Now that we have the message formatted, perform the output to each
      * logging specification.
@@ -703,6 +1103,8 @@ klog_vsyslog(int priority, const char *format, va_list arglist)
             /*
              * Files/standard error.
              */
+            if (queued)
+                break;
             if (fprintf(log_control.log_entries[lindex].lfu_filep, "%s\n",
                         outbuf) < 0) {
                 /* Attempt to report error */
@@ -769,6 +1171,7 @@ krb5_klog_reopen(krb5_context kcontext)
      * Only logs which are actually files need to be closed
      * and reopened in response to a SIGHUP
      */
+    async_pause();
     for (lindex = 0; lindex < log_control.log_nentries; lindex++) {
         if (log_control.log_entries[lindex].log_type == K_LOG_FILE) {
             fclose(log_control.log_entries[lindex].lfu_filep);
@@ -787,4 +1190,5 @@ krb5_klog_reopen(krb5_context kcontext)
             }
         }
     }
+    async_resume();
 }
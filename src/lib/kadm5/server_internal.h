@@ -185,6 +185,37 @@ k5_pwqual_check(krb5_context context, pwqual_handle handle,
                 const char *password, const char *policy_name,
                 krb5_principal princ);
 
+/*** Password dictionaries ***/
+
+/* A loaded password dictionary, used by the dict pwqual module. */
+typedef struct k5_pwdict_st k5_pwdict;
+
+/*
+ * Load the dictionary in path, which may be a text file with one word per line
+ * or a file created by k5_pwdict_compile().  A compiled dictionary is mapped
+ * into memory rather than read.  Return ENOENT if path does not exist.
+ */
+krb5_error_code
+k5_pwdict_open(const char *path, k5_pwdict **dict_out);
+
+/* Return true if word is in dict, ignoring ASCII case.  A dictionary compiled
+ * as a filter may return true for a small fraction of other words. */
+krb5_boolean
+k5_pwdict_contains(k5_pwdict *dict, const char *word);
+
+/* Release a dictionary loaded by k5_pwdict_open(). */
+void
+k5_pwdict_close(k5_pwdict *dict);
+
+/*
+ * Compile the text word list in infile to outfile.  If fp_rate is zero,
+ * create a sorted index of the words; otherwise create a Bloom filter with
+ * approximately the given false positive rate.  outfile is replaced
+ * atomically, so a running kadmind may continue to use the previous file.
+ */
+krb5_error_code
+k5_pwdict_compile(const char *infile, const char *outfile, double fp_rate);
+
 /*** initvt functions for built-in password quality modules ***/
 
 /* The dict module checks passwords against the realm's dictionary. */
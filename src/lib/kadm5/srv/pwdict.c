@@ -0,0 +1,493 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/kadm5/srv/pwdict.c - Password dictionary loading and compilation */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * A password dictionary is either a text file with one word per line, which
+ * is read into memory and sorted when it is opened, or a compiled file made by
+ * "kdb5_util compile_dict", which is mapped into memory and used in place so
+ * that opening it costs nothing regardless of its size.  A compiled file has
+ * the following format, with all integers in big-endian byte order:
+ *
+ *     magic "K5PWDICT" (8 bytes)
+ *     version (4 bytes), currently 1
+ *     type (4 bytes): 1 for a sorted index, 2 for a Bloom filter
+ *     word count (8 bytes)
+ *     param1 (8 bytes)
+ *     param2 (8 bytes)
+ *
+ * In a sorted index, param1 is the offset of a table of word count 8-byte
+ * file offsets, one per word in sorted order.  The words themselves are stored
+ * between the header and the table, folded to lowercase and zero-terminated.
+ * param2 is zero.
+ *
+ * In a Bloom filter, param1 is the number of bits in the filter and param2 is
+ * the number of hash functions.  The filter bits follow the header.  Bit
+ * indices are computed from two siphash values of the lowercased word, using
+ * the seeds below.
+ */
+
+#include "k5-int.h"
+#include "k5-hashtab.h"
+#include <sys/mman.h>
+#include <kadm5/admin.h>
+#include "server_internal.h"
+
+#define PWDICT_MAGIC            "K5PWDICT"
+#define PWDICT_MAGIC_LEN        8
+#define PWDICT_VERSION          1
+#define PWDICT_HEADER_LEN       40
+#define PWDICT_TYPE_TEXT        0
+#define PWDICT_TYPE_INDEX       1
+#define PWDICT_TYPE_FILTER      2
+#define PWDICT_MAX_HASHES       32
+
+static const uint8_t seed1[K5_HASH_SEED_LEN] = "K5PWDICT filter1";
+static const uint8_t seed2[K5_HASH_SEED_LEN] = "K5PWDICT filter2";
+
+struct k5_pwdict_st {
+    int type;
+
+    /* For text dictionaries */
+    char **word_list;           /* sorted list of word pointers */
+    char *word_block;           /* actual word data */
+    size_t word_count;          /* number of words */
+
+    /* For compiled dictionaries */
+    unsigned char *map;
+    size_t maplen;
+    uint64_t count;
+    uint64_t param1;
+    uint64_t param2;
+};
+
+static inline unsigned char
+fold(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+static int
+word_compare(const void *s1, const void *s2)
+{
+    return strcasecmp(*(const char **)s1, *(const char **)s2);
+}
+
+static int
+folded_compare(const void *s1, const void *s2)
+{
+    return strcmp(*(const char **)s1, *(const char **)s2);
+}
+
+/* Compute the Bloom filter bit positions for the folded word w. */
+static void
+filter_hashes(const char *w, uint64_t *h1_out, uint64_t *h2_out)
+{
+    size_t len = strlen(w);
+
+    *h1_out = k5_siphash24((const uint8_t *)w, len, seed1);
+    *h2_out = k5_siphash24((const uint8_t *)w, len, seed2) | 1;
+}
+
+/* Read a text dictionary from fd and sort it. */
+static krb5_error_code
+load_text(k5_pwdict *dict, int fd, size_t size)
+{
+    size_t len, i;
+    ssize_t nread;
+    char *p, *t;
+
+    dict->type = PWDICT_TYPE_TEXT;
+    dict->word_block = malloc(size + 1);
+    if (dict->word_block == NULL)
+        return ENOMEM;
+    for (len = 0; len < size; len += nread) {
+        nread = read(fd, dict->word_block + len, size - len);
+        if (nread <= 0)
+            return (nread == 0) ? EIO : errno;
+    }
+    dict->word_block[size] = '\0';
+
+    p = dict->word_block;
+    len = size;
+    while (len > 0 && (t = memchr(p, '\n', len)) != NULL) {
+        *t = '\0';
+        len -= t - p + 1;
+        p = t + 1;
+        dict->word_count++;
+    }
+    if (dict->word_count == 0)
+        return 0;
+    dict->word_list = calloc(dict->word_count, sizeof(char *));
+    if (dict->word_list == NULL)
+        return ENOMEM;
+    p = dict->word_block;
+    for (i = 0; i < dict->word_count; i++) {
+        dict->word_list[i] = p;
+        p += strlen(p) + 1;
+    }
+    qsort(dict->word_list, dict->word_count, sizeof(char *), word_compare);
+    return 0;
+}
+
+/* Map a compiled dictionary from fd and check its header. */
+static krb5_error_code
+load_compiled(k5_pwdict *dict, int fd, size_t size)
+{
+    const unsigned char *h;
+    uint64_t bytes;
+
+    dict->map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (dict->map == MAP_FAILED) {
+        dict->map = NULL;
+        return errno;
+    }
+    dict->maplen = size;
+#ifdef MADV_RANDOM
+    (void)madvise(dict->map, size, MADV_RANDOM);
+#endif
+
+    h = dict->map;
+    if (load_32_be(h + 8) != PWDICT_VERSION)
+        return EINVAL;
+    dict->type = load_32_be(h + 12);
+    dict->count = load_64_be(h + 16);
+    dict->param1 = load_64_be(h + 24);
+    dict->param2 = load_64_be(h + 32);
+
+    if (dict->type == PWDICT_TYPE_INDEX) {
+        /* The table must end the file, and the word data before it must be
+         * terminated so that lookups cannot run past it. */
+        if (dict->param1 < PWDICT_HEADER_LEN || dict->param1 > size ||
+            dict->count > (size - dict->param1) / 8 ||
+            dict->param1 + dict->count * 8 != size)
+            return EINVAL;
+        if (dict->count > 0 && (dict->param1 == PWDICT_HEADER_LEN ||
+                                dict->map[dict->param1 - 1] != '\0'))
+            return EINVAL;
+    } else if (dict->type == PWDICT_TYPE_FILTER) {
+        bytes = dict->param1 / 8 + 1;
+        if (dict->param1 == 0 || bytes > size - PWDICT_HEADER_LEN ||
+            dict->param2 == 0 || dict->param2 > PWDICT_MAX_HASHES)
+            return EINVAL;
+    } else {
+        return EINVAL;
+    }
+    return 0;
+}
+
+krb5_error_code
+k5_pwdict_open(const char *path, k5_pwdict **dict_out)
+{
+    krb5_error_code ret;
+    k5_pwdict *dict;
+    struct stat sb;
+    char magic[PWDICT_MAGIC_LEN];
+    int fd;
+
+    *dict_out = NULL;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return errno;
+    set_cloexec_fd(fd);
+    if (fstat(fd, &sb) == -1) {
+        ret = errno;
+        close(fd);
+        return ret;
+    }
+
+    dict = k5alloc(sizeof(*dict), &ret);
+    if (dict == NULL) {
+        close(fd);
+        return ret;
+    }
+
+    if (sb.st_size >= PWDICT_HEADER_LEN &&
+        read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+        memcmp(magic, PWDICT_MAGIC, PWDICT_MAGIC_LEN) == 0) {
+        ret = load_compiled(dict, fd, sb.st_size);
+    } else if (lseek(fd, 0, SEEK_SET) == -1) {
+        ret = errno;
+    } else {
+        ret = load_text(dict, fd, sb.st_size);
+    }
+    close(fd);
+    if (ret) {
+        k5_pwdict_close(dict);
+        return ret;
+    }
+
+    *dict_out = dict;
+    return 0;
+}
+
+/* Compare the stored folded word w to the unfolded word s. */
+static int
+compare_folded(const char *w, const char *s)
+{
+    unsigned char a, b;
+
+    for (;; w++, s++) {
+        a = *w;
+        b = fold(*s);
+        if (a != b || a == '\0')
+            return (int)a - (int)b;
+    }
+}
+
+static krb5_boolean
+index_contains(k5_pwdict *dict, const char *word)
+{
+    const unsigned char *table = dict->map + dict->param1;
+    uint64_t lo = 0, hi = dict->count, mid, off;
+    int cmp;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        off = load_64_be(table + mid * 8);
+        if (off < PWDICT_HEADER_LEN || off >= dict->param1)
+            return FALSE;
+        cmp = compare_folded((const char *)dict->map + off, word);
+        if (cmp == 0)
+            return TRUE;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return FALSE;
+}
+
+static krb5_boolean
+filter_contains(k5_pwdict *dict, const char *word)
+{
+    const unsigned char *bits = dict->map + PWDICT_HEADER_LEN;
+    uint64_t h1, h2, bit, i;
+    krb5_boolean found = TRUE;
+    char *w;
+    size_t j;
+
+    w = strdup(word);
+    if (w == NULL)
+        return FALSE;
+    for (j = 0; w[j] != '\0'; j++)
+        w[j] = fold(w[j]);
+    filter_hashes(w, &h1, &h2);
+    for (i = 0; i < dict->param2 && found; i++) {
+        bit = (h1 + i * h2) % dict->param1;
+        found = (bits[bit / 8] & (1 << (bit % 8))) != 0;
+    }
+    zapfree(w, j);
+    return found;
+}
+
+krb5_boolean
+k5_pwdict_contains(k5_pwdict *dict, const char *word)
+{
+    if (dict->type == PWDICT_TYPE_INDEX)
+        return index_contains(dict, word);
+    else if (dict->type == PWDICT_TYPE_FILTER)
+        return filter_contains(dict, word);
+    return dict->word_list != NULL &&
+        bsearch(&word, dict->word_list, dict->word_count, sizeof(char *),
+                word_compare) != NULL;
+}
+
+void
+k5_pwdict_close(k5_pwdict *dict)
+{
+    if (dict == NULL)
+        return;
+    free(dict->word_list);
+    free(dict->word_block);
+    if (dict->map != NULL)
+        munmap(dict->map, dict->maplen);
+    free(dict);
+}
+
+/* Write a compiled dictionary header to fp. */
+static krb5_error_code
+write_header(FILE *fp, uint32_t type, uint64_t count, uint64_t param1,
+             uint64_t param2)
+{
+    unsigned char h[PWDICT_HEADER_LEN];
+
+    memcpy(h, PWDICT_MAGIC, PWDICT_MAGIC_LEN);
+    store_32_be(PWDICT_VERSION, h + 8);
+    store_32_be(type, h + 12);
+    store_64_be(count, h + 16);
+    store_64_be(param1, h + 24);
+    store_64_be(param2, h + 32);
+    return (fwrite(h, sizeof(h), 1, fp) == 1) ? 0 : errno;
+}
+
+/* Write the sorted, deduplicated words in list as an index. */
+static krb5_error_code
+write_index(FILE *fp, char **list, size_t count)
+{
+    krb5_error_code ret;
+    unsigned char offbuf[8];
+    uint64_t off, table, nwords = 0;
+    size_t i, len;
+
+    /* Count the unique words and find the table offset. */
+    table = PWDICT_HEADER_LEN;
+    for (i = 0; i < count; i++) {
+        if (i > 0 && strcmp(list[i], list[i - 1]) == 0)
+            continue;
+        table += strlen(list[i]) + 1;
+        nwords++;
+    }
+
+    ret = write_header(fp, PWDICT_TYPE_INDEX, nwords, table, 0);
+    if (ret)
+        return ret;
+    for (i = 0; i < count; i++) {
+        if (i > 0 && strcmp(list[i], list[i - 1]) == 0)
+            continue;
+        len = strlen(list[i]) + 1;
+        if (fwrite(list[i], len, 1, fp) != 1)
+            return errno;
+    }
+    off = PWDICT_HEADER_LEN;
+    for (i = 0; i < count; i++) {
+        if (i > 0 && strcmp(list[i], list[i - 1]) == 0)
+            continue;
+        store_64_be(off, offbuf);
+        if (fwrite(offbuf, 8, 1, fp) != 1)
+            return errno;
+        off += strlen(list[i]) + 1;
+    }
+    return 0;
+}
+
+/* Write the words in list as a Bloom filter with false positive rate
+ * approximately fp_rate. */
+static krb5_error_code
+write_filter(FILE *fp, char **list, size_t count, double fp_rate)
+{
+    krb5_error_code ret;
+    unsigned char *bits;
+    uint64_t nbits, nhashes, h1, h2, bit, i;
+    size_t j;
+
+    /* The optimal filter uses -log2(fp_rate) hash functions and 1.44 bits
+     * per word per hash function. */
+    for (nhashes = 0; fp_rate < 1 && nhashes < PWDICT_MAX_HASHES; nhashes++)
+        fp_rate *= 2;
+    if (nhashes == 0)
+        nhashes = 1;
+    nbits = (uint64_t)(count * nhashes * 1.4427) + 64;
+
+    bits = k5calloc(nbits / 8 + 1, 1, &ret);
+    if (bits == NULL)
+        return ret;
+    for (j = 0; j < count; j++) {
+        filter_hashes(list[j], &h1, &h2);
+        for (i = 0; i < nhashes; i++) {
+            bit = (h1 + i * h2) % nbits;
+            bits[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+
+    ret = write_header(fp, PWDICT_TYPE_FILTER, count, nbits, nhashes);
+    if (!ret && fwrite(bits, nbits / 8 + 1, 1, fp) != 1)
+        ret = errno;
+    free(bits);
+    return ret;
+}
+
+krb5_error_code
+k5_pwdict_compile(const char *infile, const char *outfile, double fp_rate)
+{
+    krb5_error_code ret;
+    k5_pwdict *dict = NULL;
+    char *tmpfile = NULL, *p, **list = NULL;
+    size_t i, count = 0;
+    FILE *fp = NULL;
+
+    /* Read the word list as a text dictionary, then fold the words in place
+     * and drop empty lines. */
+    ret = k5_pwdict_open(infile, &dict);
+    if (ret)
+        return ret;
+    if (dict->type != PWDICT_TYPE_TEXT) {
+        ret = EINVAL;
+        goto cleanup;
+    }
+    list = dict->word_list;
+    for (i = 0; list != NULL && i < dict->word_count; i++) {
+        if (*list[i] == '\0')
+            continue;
+        for (p = list[i]; *p != '\0'; p++)
+            *p = fold(*p);
+        list[count++] = list[i];
+    }
+    if (fp_rate == 0)
+        qsort(list, count, sizeof(char *), folded_compare);
+
+    if (asprintf(&tmpfile, "%s.tmp", outfile) < 0) {
+        tmpfile = NULL;
+        ret = ENOMEM;
+        goto cleanup;
+    }
+    fp = fopen(tmpfile, "w");
+    if (fp == NULL) {
+        ret = errno;
+        goto cleanup;
+    }
+    if (fp_rate == 0)
+        ret = write_index(fp, list, count);
+    else
+        ret = write_filter(fp, list, count, fp_rate);
+    if (ret)
+        goto cleanup;
+    if (fclose(fp) == EOF) {
+        fp = NULL;
+        ret = errno;
+        goto cleanup;
+    }
+    fp = NULL;
+    if (rename(tmpfile, outfile) != 0) {
+        ret = errno;
+        goto cleanup;
+    }
+
+cleanup:
+    if (fp != NULL)
+        fclose(fp);
+    if (ret && tmpfile != NULL)
+        (void)unlink(tmpfile);
+    free(tmpfile);
+    k5_pwdict_close(dict);
+    return ret;
+}
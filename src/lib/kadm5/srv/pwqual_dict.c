@@ -31,42 +31,15 @@
 
 #include "k5-platform.h"
 #include <krb5/pwqual_plugin.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <unistd.h>
 #include <kadm5/admin.h>
 #include "adm_proto.h"
 #include <syslog.h>
 #include "server_internal.h"
 
 typedef struct dict_moddata_st {
-    char **word_list;        /* list of word pointers */
-    char *word_block;        /* actual word data */
-    unsigned int word_count; /* number of words */
+    k5_pwdict *dict;            /* NULL if no dictionary was loaded */
 } *dict_moddata;
 
-
-/*
- * Function: word_compare
- *
- * Purpose: compare two words in the dictionary.
- *
- * Arguments:
- *      w1              (input) pointer to first word
- *      w2              (input) pointer to second word
- *      <return value>  result of strcmp
- *
- * Requires:
- *      w1 and w2 to point to valid memory
- *
- */
-
-static int
-word_compare(const void *s1, const void *s2)
-{
-    return (strcasecmp(*(const char **)s1, *(const char **)s2));
-}
-
 /*
  * Function: init-dict
  *
@@ -79,27 +52,22 @@ word_compare(const void *s1, const void *s2)
  *
  * Requires:
  *      If WORDFILE exists, it must contain a list of words,
- *      one word per-line.
+ *      one word per-line, or be compiled with kdb5_util compile_dict.
  *
  * Effects:
  *      If WORDFILE exists, it is read into memory sorted for future
- * use.  If it does not exist, it syslogs an error message and returns
- * success.
+ * use, or mapped into memory if it is compiled.  If it does not
+ * exist, it syslogs an error message and returns success.
  *
  * Modifies:
- *      word_list to point to a chunk of allocated memory containing
- *      pointers to words
- *      word_block to contain the dictionary.
+ *      dict to refer to the loaded dictionary.
  *
  */
 
 static int
 init_dict(dict_moddata dict, const char *dict_file)
 {
-    int fd;
-    size_t len, i;
-    char *p, *t;
-    struct stat sb;
+    krb5_error_code ret;
 
     if (dict_file == NULL) {
         krb5_klog_syslog(LOG_INFO,
@@ -107,44 +75,14 @@ init_dict(dict_moddata dict, const char *dict_file)
                            "one."));
         return KADM5_OK;
     }
-    if ((fd = open(dict_file, O_RDONLY)) == -1) {
-        if (errno == ENOENT) {
-            krb5_klog_syslog(LOG_ERR,
-                             _("WARNING!  Cannot find dictionary file %s, "
-                               "continuing without one."), dict_file);
-            return KADM5_OK;
-        } else
-            return errno;
-    }
-    set_cloexec_fd(fd);
-    if (fstat(fd, &sb) == -1) {
-        close(fd);
-        return errno;
-    }
-    if ((dict->word_block = malloc(sb.st_size + 1)) == NULL)
-        return ENOMEM;
-    if (read(fd, dict->word_block, sb.st_size) != sb.st_size)
-        return errno;
-    (void) close(fd);
-    dict->word_block[sb.st_size] = '\0';
-
-    p = dict->word_block;
-    len = sb.st_size;
-    while(len > 0 && (t = memchr(p, '\n', len)) != NULL) {
-        *t = '\0';
-        len -= t - p + 1;
-        p = t + 1;
-        dict->word_count++;
-    }
-    if ((dict->word_list = malloc(dict->word_count * sizeof(char *))) == NULL)
-        return ENOMEM;
-    p = dict->word_block;
-    for (i = 0; i < dict->word_count; i++) {
-        dict->word_list[i] = p;
-        p += strlen(p) + 1;
+    ret = k5_pwdict_open(dict_file, &dict->dict);
+    if (ret == ENOENT) {
+        krb5_klog_syslog(LOG_ERR,
+                         _("WARNING!  Cannot find dictionary file %s, "
+                           "continuing without one."), dict_file);
+        return KADM5_OK;
     }
-    qsort(dict->word_list, dict->word_count, sizeof(char *), word_compare);
-    return KADM5_OK;
+    return ret;
 }
 
 /*
@@ -158,11 +96,10 @@ init_dict(dict_moddata dict, const char *dict_file)
  * Requires:
  *          nothing
  * Effects:
- *      frees up memory occupied by word_list and word_block
- *      sets count back to 0, and resets the pointers to NULL
+ *      releases the loaded dictionary and frees dict.
  *
  * Modifies:
- *      word_list, word_block, and word_count.
+ *      dict.
  *
  */
 
@@ -171,8 +108,7 @@ destroy_dict(dict_moddata dict)
 {
     if (dict == NULL)
         return;
-    free(dict->word_list);
-    free(dict->word_block);
+    k5_pwdict_close(dict->dict);
     free(dict);
     return;
 }
@@ -191,9 +127,7 @@ dict_open(krb5_context context, const char *dict_file,
     dict = malloc(sizeof(*dict));
     if (dict == NULL)
         return ENOMEM;
-    dict->word_list = NULL;
-    dict->word_block = NULL;
-    dict->word_count = 0;
+    dict->dict = NULL;
 
     /* Fill in the dictionary structure with data from dict_file. */
     ret = init_dict(dict, dict_file);
@@ -220,9 +154,7 @@ dict_check(krb5_context context, krb5_pwqual_moddata data,
         return 0;
 
     /* Check against words in the dictionary if we successfully loaded one. */
-    if (dict->word_list != NULL &&
-        bsearch(&password, dict->word_list, dict->word_count, sizeof(char *),
-                word_compare) != NULL)
+    if (dict->dict != NULL && k5_pwdict_contains(dict->dict, password))
         return KADM5_PASS_Q_DICT;
 
     return 0;
@@ -42,6 +42,7 @@
 #include "kdb5.h"
 #include "kdb_log.h"
 #include "kdb5int.h"
+#include <syslog.h>
 
 /* Currently DB2 policy related errors are exported from DAL.  But
    other databases should set_err function to return string.  */
@@ -657,6 +658,426 @@ get_vftabl(krb5_context kcontext, kdb_vftabl **vftabl_ptr)
     return 0;
 }
 
+/*
+ * A realm's database module section may name another [dbmodules] section as
+ * a migration target.  Administrative programs open the target database
+ * alongside the primary one, and principal and policy changes made through
+ * this library are applied to both, under the same ulog update.  A change
+ * which cannot be applied to the target is still applied and logged for the
+ * primary database, which remains authoritative until cutover.
+ * krb5_db_migrate() copies existing data to the target and
+ * krb5_db_verify_migration() compares the two databases.
+ *
+ * Modules find their state through kcontext->dal_handle, so calls into the
+ * target's module are made with the target handle temporarily installed.
+ */
+
+static inline krb5_boolean
+migrating(krb5_context kcontext)
+{
+    return kcontext->dal_handle != NULL &&
+        kcontext->dal_handle->migrate_target != NULL;
+}
+
+/* Install the migration target handle in kcontext, saving the primary handle
+ * in *saved. */
+static inline kdb_vftabl *
+target_enter(krb5_context kcontext, kdb5_dal_handle **saved)
+{
+    *saved = kcontext->dal_handle;
+    kcontext->dal_handle = (*saved)->migrate_target;
+    return &kcontext->dal_handle->lib_handle->vftabl;
+}
+
+static inline void
+target_leave(krb5_context kcontext, kdb5_dal_handle *saved)
+{
+    kcontext->dal_handle = saved;
+}
+
+/* Set *target_out to the migration target section named by the module
+ * section, or to NULL if there is none. */
+static krb5_error_code
+get_target_section(krb5_context kcontext, const char *section,
+                   char **target_out)
+{
+    krb5_error_code status;
+    char *value = NULL;
+
+    *target_out = NULL;
+    status = profile_get_string(kcontext->profile, KDB_MODULE_SECTION,
+                                section, KDB_MIGRATE_POINTER, NULL, &value);
+    if (status || value == NULL)
+        return status;
+    *target_out = strdup(value);
+    profile_release_string(value);
+    return (*target_out == NULL) ? ENOMEM : 0;
+}
+
+/* Create a handle for the module library used by the target section. */
+static krb5_error_code
+target_handle(krb5_context kcontext, const char *target,
+              kdb5_dal_handle **handle_out)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *handle;
+    db_library lib = NULL;
+    char *libname = NULL;
+
+    *handle_out = NULL;
+    handle = k5alloc(sizeof(*handle), &status);
+    if (handle == NULL)
+        return status;
+    status = profile_get_string(kcontext->profile, KDB_MODULE_SECTION, target,
+                                KDB_LIB_POINTER, DB2_NAME, &libname);
+    if (status)
+        goto cleanup;
+    status = kdb_find_library(kcontext, libname, &lib);
+    if (status)
+        goto cleanup;
+    handle->lib_handle = lib;
+    *handle_out = handle;
+    handle = NULL;
+
+cleanup:
+    profile_release_string(libname);
+    free(handle);
+    return status;
+}
+
+static void
+free_target_handle(kdb5_dal_handle *handle)
+{
+    kdb_free_library(handle->lib_handle);
+    free(handle);
+}
+
+/* If the realm has a migration target, open it for this process.  The KDC
+ * only writes to the database through module-internal lockout updates, so
+ * it does not open the target. */
+static krb5_error_code
+open_migrate_target(krb5_context kcontext, const char *section, int mode)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *handle = NULL, *saved;
+    kdb_vftabl *v;
+    char *target = NULL;
+
+    if (mode & KRB5_KDB_SRV_TYPE_KDC)
+        return 0;
+    status = get_target_section(kcontext, section, &target);
+    if (status || target == NULL)
+        return status;
+    status = target_handle(kcontext, target, &handle);
+    if (status)
+        goto cleanup;
+
+    kcontext->dal_handle->migrate_target = handle;
+    v = target_enter(kcontext, &saved);
+    status = v->init_module(kcontext, target, NULL, mode);
+    target_leave(kcontext, saved);
+    if (status) {
+        kcontext->dal_handle->migrate_target = NULL;
+        free_target_handle(handle);
+        k5_prependmsg(kcontext, status,
+                      _("Cannot open migration target database '%s'"),
+                      target);
+    }
+
+cleanup:
+    free(target);
+    return status;
+}
+
+/* Close the migration target, if one is open. */
+static krb5_error_code
+close_migrate_target(krb5_context kcontext)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *handle = kcontext->dal_handle->migrate_target, *saved;
+    kdb_vftabl *v;
+
+    if (handle == NULL)
+        return 0;
+    v = target_enter(kcontext, &saved);
+    status = v->fini_module(kcontext);
+    target_leave(kcontext, saved);
+    if (status)
+        return status;
+    kcontext->dal_handle->migrate_target = NULL;
+    free_target_handle(handle);
+    return 0;
+}
+
+/* Lock the primary database around an operation which must be applied to
+ * the primary and target databases in the same order by all processes.
+ * Modules without locking support are not locked. */
+static krb5_error_code
+migrate_lock(krb5_context kcontext, int mode, krb5_boolean *locked)
+{
+    krb5_error_code status;
+
+    *locked = FALSE;
+    status = krb5_db_lock(kcontext, mode);
+    if (status == KRB5_PLUGIN_OP_NOTSUPP)
+        return 0;
+    if (status == 0)
+        *locked = TRUE;
+    return status;
+}
+
+/* Entry mask bits from kadm5/admin.h, which libkdb5 cannot include. */
+#define KADM5_PRINCIPAL         0x000001
+#define KADM5_PRINC_EXPIRE_TIME 0x000002
+#define KADM5_PW_EXPIRATION     0x000004
+#define KADM5_ATTRIBUTES        0x000010
+#define KADM5_MAX_LIFE          0x000020
+#define KADM5_MAX_RLIFE         0x002000
+#define KADM5_LAST_SUCCESS      0x004000
+#define KADM5_LAST_FAILED       0x008000
+#define KADM5_FAIL_AUTH_COUNT   0x010000
+#define KADM5_KEY_DATA          0x020000
+#define KADM5_TL_DATA           0x040000
+
+/*
+ * The fields a principal entry carries outside of its tl-data, plus the
+ * tl-data itself.  KADM5_POLICY is left out: the policy reference is kept in
+ * the KRB5_TL_KADM_DATA tl-data, which libkdb5 cannot decode, and the LDAP
+ * module rejects KADM5_POLICY for an entry without a policy.  A policy change
+ * made by the current operation still reaches the target through the entry's
+ * own mask.
+ */
+#define TARGET_FIELDS_MASK                                              \
+    (KADM5_PRINC_EXPIRE_TIME | KADM5_PW_EXPIRATION | KADM5_ATTRIBUTES |  \
+     KADM5_MAX_LIFE | KADM5_MAX_RLIFE | KADM5_LAST_SUCCESS |             \
+     KADM5_LAST_FAILED | KADM5_FAIL_AUTH_COUNT | KADM5_KEY_DATA |        \
+     KADM5_TL_DATA)
+
+/*
+ * Store entry in the target.  The target may hold an older copy of the entry
+ * or none at all, so every field is marked as changed, and the entry is marked
+ * as new if the target does not have it.  The primary module's e_data is
+ * private to that module and is not passed on.  db_args are passed only if
+ * the target uses the same module.
+ */
+static krb5_error_code
+target_put_principal(krb5_context kcontext, krb5_db_entry *entry,
+                     char **db_args)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *saved;
+    kdb_vftabl *v;
+    krb5_db_entry tent, *old;
+
+    tent = *entry;
+    tent.e_length = 0;
+    tent.e_data = NULL;
+    tent.mask = (entry->mask & ~KADM5_PRINCIPAL) | TARGET_FIELDS_MASK;
+    if (kcontext->dal_handle->migrate_target->lib_handle !=
+        kcontext->dal_handle->lib_handle)
+        db_args = NULL;
+
+    v = target_enter(kcontext, &saved);
+    if (v->get_principal == NULL || v->put_principal == NULL) {
+        status = KRB5_PLUGIN_OP_NOTSUPP;
+        goto cleanup;
+    }
+    status = v->get_principal(kcontext, entry->princ, 0, &old);
+    if (status == 0) {
+        krb5_db_free_principal(kcontext, old);
+    } else if (status == KRB5_KDB_NOENTRY) {
+        tent.mask |= KADM5_PRINCIPAL;
+    } else {
+        goto cleanup;
+    }
+    status = v->put_principal(kcontext, &tent, db_args);
+
+cleanup:
+    target_leave(kcontext, saved);
+    return status;
+}
+
+/* Delete princ from the target.  It is not an error if the target does not
+ * have it. */
+static krb5_error_code
+target_delete_principal(krb5_context kcontext, krb5_principal princ)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *saved;
+    kdb_vftabl *v;
+
+    v = target_enter(kcontext, &saved);
+    status = (v->delete_principal == NULL) ? KRB5_PLUGIN_OP_NOTSUPP :
+        v->delete_principal(kcontext, princ);
+    target_leave(kcontext, saved);
+    return (status == KRB5_KDB_NOENTRY) ? 0 : status;
+}
+
+static krb5_error_code
+target_get_principal(krb5_context kcontext, krb5_const_principal princ,
+                     krb5_db_entry **entry_out)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *saved;
+    kdb_vftabl *v;
+
+    *entry_out = NULL;
+    v = target_enter(kcontext, &saved);
+    status = (v->get_principal == NULL) ? KRB5_PLUGIN_OP_NOTSUPP :
+        v->get_principal(kcontext, princ, 0, entry_out);
+    if (status == 0 && (*entry_out)->key_data != NULL) {
+        krb5_dbe_sort_key_data((*entry_out)->key_data,
+                               (*entry_out)->n_key_data);
+    }
+    target_leave(kcontext, saved);
+    return status;
+}
+
+static void
+target_free_principal(krb5_context kcontext, krb5_db_entry *entry)
+{
+    kdb5_dal_handle *saved;
+
+    /* Let the target module free its own e_data, if any. */
+    (void)target_enter(kcontext, &saved);
+    krb5_db_free_principal(kcontext, entry);
+    target_leave(kcontext, saved);
+}
+
+/* Store policy in the target, creating it if the target does not have it
+ * yet. */
+static krb5_error_code
+target_store_policy(krb5_context kcontext, osa_policy_ent_t policy)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *saved;
+    kdb_vftabl *v;
+    osa_policy_ent_t old;
+
+    v = target_enter(kcontext, &saved);
+    if (v->get_policy == NULL || v->put_policy == NULL ||
+        v->create_policy == NULL) {
+        status = KRB5_PLUGIN_OP_NOTSUPP;
+    } else {
+        status = v->get_policy(kcontext, policy->name, &old);
+        if (status == 0) {
+            krb5_db_free_policy(kcontext, old);
+            status = v->put_policy(kcontext, policy);
+        } else if (status == KRB5_KDB_NOENTRY) {
+            status = v->create_policy(kcontext, policy);
+        }
+    }
+    target_leave(kcontext, saved);
+    return status;
+}
+
+static krb5_error_code
+target_delete_policy(krb5_context kcontext, char *name)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *saved;
+    kdb_vftabl *v;
+    osa_policy_ent_t old;
+
+    v = target_enter(kcontext, &saved);
+    if (v->get_policy == NULL || v->delete_policy == NULL) {
+        status = KRB5_PLUGIN_OP_NOTSUPP;
+    } else {
+        status = v->get_policy(kcontext, name, &old);
+        if (status == 0) {
+            krb5_db_free_policy(kcontext, old);
+            status = v->delete_policy(kcontext, name);
+        } else if (status == KRB5_KDB_NOENTRY) {
+            status = 0;
+        }
+    }
+    target_leave(kcontext, saved);
+    return status;
+}
+
+/* Bring the target's copy of princ up to date with the primary database,
+ * deleting it from the target if the primary does not have it.  Hold a lock
+ * on the primary so that concurrent changes are not applied to the target out
+ * of order. */
+static krb5_error_code
+migrate_principal(krb5_context kcontext, krb5_const_principal princ)
+{
+    krb5_error_code status;
+    krb5_boolean locked;
+    krb5_db_entry *entry = NULL;
+
+    status = migrate_lock(kcontext, KRB5_DB_LOCKMODE_SHARED, &locked);
+    if (status)
+        return status;
+    status = krb5_db_get_principal(kcontext, princ, 0, &entry);
+    if (status == 0) {
+        status = target_put_principal(kcontext, entry, NULL);
+        krb5_db_free_principal(kcontext, entry);
+    } else if (status == KRB5_KDB_NOENTRY) {
+        status = target_delete_principal(kcontext, (krb5_principal)princ);
+    }
+    if (locked)
+        krb5_db_unlock(kcontext);
+    return status;
+}
+
+/*
+ * Report that a change to the principal or policy name was applied to the
+ * primary database but not to the migration target.  The change stands and
+ * remains logged, so the caller still succeeds.  Remove the target's copy of
+ * the object, if possible, so that it cannot be used with old contents and so
+ * that verification reports it until the object is migrated again.
+ */
+static void
+target_failed(krb5_context kcontext, krb5_error_code status, int type,
+              const char *name)
+{
+    krb5_error_code ret;
+    krb5_principal princ;
+    const char *emsg;
+
+    if (status == 0)
+        return;
+    emsg = krb5_get_error_message(kcontext, status);
+    syslog(LOG_WARNING, _("Cannot apply change to %s %s in migration target "
+                          "database (%s); run kdb5_util migrate"),
+           (type == KRB5_DB_MIGRATE_POLICY) ? _("policy") : _("principal"),
+           name, emsg);
+    krb5_free_error_message(kcontext, emsg);
+
+    if (type == KRB5_DB_MIGRATE_POLICY) {
+        ret = target_delete_policy(kcontext, (char *)name);
+    } else {
+        ret = krb5_parse_name(kcontext, name, &princ);
+        if (ret == 0) {
+            ret = target_delete_principal(kcontext, princ);
+            krb5_free_principal(kcontext, princ);
+        }
+    }
+    if (ret) {
+        syslog(LOG_WARNING, _("Migration target database may hold an old "
+                              "copy of %s"), name);
+    }
+}
+
+/* Call target_failed() for the principal princ. */
+static void
+target_princ_failed(krb5_context kcontext, krb5_error_code status,
+                    krb5_const_principal princ)
+{
+    char *name;
+
+    if (status == 0)
+        return;
+    if (krb5_unparse_name(kcontext, princ, &name) != 0) {
+        syslog(LOG_WARNING, _("Cannot apply change to migration target "
+                              "database; run kdb5_util migrate"));
+        return;
+    }
+    target_failed(kcontext, status, KRB5_DB_MIGRATE_PRINCIPAL, name);
+    krb5_free_unparsed_name(kcontext, name);
+}
+
 /*
  *      External functions... DAL API
  */
@@ -674,6 +1095,11 @@ krb5_db_open(krb5_context kcontext, char **db_args, int mode)
     if (status)
         return status;
     status = v->init_module(kcontext, section, db_args, mode);
+    if (status == 0) {
+        status = open_migrate_target(kcontext, section, mode);
+        if (status)
+            (void)v->fini_module(kcontext);
+    }
     free(section);
     return status;
 }
@@ -715,6 +1141,10 @@ krb5_db_fini(krb5_context kcontext)
     if (kcontext->dal_handle == NULL)
         return 0;
 
+    status = close_migrate_target(kcontext);
+    if (status)
+        return status;
+
     v = &kcontext->dal_handle->lib_handle->vftabl;
     status = v->fini_module(kcontext);
 
@@ -926,6 +1356,7 @@ krb5int_put_principal_no_log(krb5_context kcontext, krb5_db_entry *entry)
 {
     kdb_vftabl *v;
     krb5_error_code status;
+    krb5_boolean locked = FALSE;
     char **db_args;
 
     status = get_vftabl(kcontext, &v);
@@ -938,7 +1369,21 @@ krb5int_put_principal_no_log(krb5_context kcontext, krb5_db_entry *entry)
                                           &db_args);
     if (status)
         return status;
+    if (migrating(kcontext)) {
+        status = migrate_lock(kcontext, KRB5_DB_LOCKMODE_EXCLUSIVE, &locked);
+        if (status)
+            goto cleanup;
+    }
     status = v->put_principal(kcontext, entry, db_args);
+    if (status == 0 && migrating(kcontext)) {
+        target_princ_failed(kcontext,
+                            target_put_principal(kcontext, entry, db_args),
+                            entry->princ);
+    }
+
+cleanup:
+    if (locked)
+        krb5_db_unlock(kcontext);
     free_db_args(db_args);
     return status;
 }
@@ -983,13 +1428,28 @@ krb5int_delete_principal_no_log(krb5_context kcontext,
 {
     kdb_vftabl *v;
     krb5_error_code status;
+    krb5_boolean locked = FALSE;
 
     status = get_vftabl(kcontext, &v);
     if (status)
         return status;
     if (v->delete_principal == NULL)
         return KRB5_PLUGIN_OP_NOTSUPP;
-    return v->delete_principal(kcontext, search_for);
+    if (!migrating(kcontext))
+        return v->delete_principal(kcontext, search_for);
+
+    status = migrate_lock(kcontext, KRB5_DB_LOCKMODE_EXCLUSIVE, &locked);
+    if (status)
+        return status;
+    status = v->delete_principal(kcontext, search_for);
+    if (status == 0) {
+        target_princ_failed(kcontext,
+                            target_delete_principal(kcontext, search_for),
+                            search_for);
+    }
+    if (locked)
+        krb5_db_unlock(kcontext);
+    return status;
 }
 
 krb5_error_code
@@ -1044,7 +1504,17 @@ krb5_db_rename_principal(krb5_context kcontext, krb5_principal source,
         return KRB5_KDB_INUSE;
     }
 
-    return v->rename_principal(kcontext, source, target);
+    status = v->rename_principal(kcontext, source, target);
+    if (status || !migrating(kcontext) ||
+        v->rename_principal == krb5_db_def_rename_principal)
+        return status;
+
+    /* The default rename function updates the target through
+     * krb5_db_put_principal() and krb5_db_delete_principal(); mirror a
+     * module-specific rename here. */
+    target_princ_failed(kcontext, migrate_principal(kcontext, target), target);
+    target_princ_failed(kcontext, migrate_principal(kcontext, source), source);
+    return 0;
 }
 
 /*
@@ -2403,6 +2873,10 @@ krb5_db_create_policy(krb5_context kcontext, osa_policy_ent_t policy)
         return KRB5_PLUGIN_OP_NOTSUPP;
 
     status = v->create_policy(kcontext, policy);
+    if (!status && migrating(kcontext)) {
+        target_failed(kcontext, target_store_policy(kcontext, policy),
+                      KRB5_DB_MIGRATE_POLICY, policy->name);
+    }
     /* iprop does not support policy mods; force full resync. */
     if (!status && logging(kcontext))
         status = ulog_init_header(kcontext);
@@ -2436,6 +2910,10 @@ krb5_db_put_policy(krb5_context kcontext, osa_policy_ent_t policy)
         return KRB5_PLUGIN_OP_NOTSUPP;
 
     status = v->put_policy(kcontext, policy);
+    if (!status && migrating(kcontext)) {
+        target_failed(kcontext, target_store_policy(kcontext, policy),
+                      KRB5_DB_MIGRATE_POLICY, policy->name);
+    }
     /* iprop does not support policy mods; force full resync. */
     if (!status && logging(kcontext))
         status = ulog_init_header(kcontext);
@@ -2470,6 +2948,10 @@ krb5_db_delete_policy(krb5_context kcontext, char *policy)
         return KRB5_PLUGIN_OP_NOTSUPP;
 
     status = v->delete_policy(kcontext, policy);
+    if (!status && migrating(kcontext)) {
+        target_failed(kcontext, target_delete_policy(kcontext, policy),
+                      KRB5_DB_MIGRATE_POLICY, policy);
+    }
     /* iprop does not support policy mods; force full resync. */
     if (!status && logging(kcontext))
         status = ulog_init_header(kcontext);
@@ -2825,3 +3307,550 @@ krb5_dbe_sort_key_data(krb5_key_data *key_data, size_t key_data_length)
         }
     }
 }
+
+krb5_error_code
+krb5_db_create_migration_target(krb5_context kcontext)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *handle = NULL, *saved;
+    kdb_vftabl *v;
+    char *section = NULL, *target = NULL;
+
+    status = get_vftabl(kcontext, &v);
+    if (status)
+        return status;
+    status = get_conf_section(kcontext, &section);
+    if (status)
+        return status;
+    status = get_target_section(kcontext, section, &target);
+    if (status)
+        goto cleanup;
+    if (target == NULL) {
+        status = EINVAL;
+        k5_setmsg(kcontext, status,
+                  _("No migration target is configured for database module "
+                    "section '%s'"), section);
+        goto cleanup;
+    }
+    status = target_handle(kcontext, target, &handle);
+    if (status)
+        goto cleanup;
+
+    kcontext->dal_handle->migrate_target = handle;
+    v = target_enter(kcontext, &saved);
+    if (v->create == NULL) {
+        status = KRB5_PLUGIN_OP_NOTSUPP;
+    } else {
+        status = v->create(kcontext, target, NULL);
+        if (status == 0)
+            status = v->fini_module(kcontext);
+    }
+    target_leave(kcontext, saved);
+    kcontext->dal_handle->migrate_target = NULL;
+    free_target_handle(handle);
+
+cleanup:
+    free(section);
+    free(target);
+    return status;
+}
+
+/* State for the migration and verification passes. */
+struct migrate_state {
+    krb5_context context;
+    krb5_db_migrate_fn func;
+    void *arg;
+    krb5_error_code status;
+    unsigned long count;        /* objects processed in this pass */
+    unsigned long present;      /* primary principals present in target */
+    unsigned long mismatches;
+    krb5_principal *princs;     /* principals found in the target */
+    char **names;               /* policy names found in the target */
+    size_t nfound;
+    size_t nalloc;
+};
+
+static void
+report(struct migrate_state *st, int type, const char *name,
+       krb5_boolean mismatch)
+{
+    if (mismatch)
+        st->mismatches++;
+    if (st->func != NULL)
+        st->func(st->arg, type, name, st->count, mismatch);
+}
+
+static void
+report_principal(struct migrate_state *st, krb5_const_principal princ,
+                 krb5_boolean mismatch)
+{
+    char *name;
+
+    if (st->func == NULL && !mismatch)
+        return;
+    if (krb5_unparse_name(st->context, princ, &name) != 0)
+        name = NULL;
+    report(st, KRB5_DB_MIGRATE_PRINCIPAL, name, mismatch);
+    krb5_free_unparsed_name(st->context, name);
+}
+
+static void
+free_found(struct migrate_state *st)
+{
+    size_t i;
+
+    for (i = 0; i < st->nfound; i++) {
+        if (st->princs != NULL)
+            krb5_free_principal(st->context, st->princs[i]);
+        if (st->names != NULL)
+            free(st->names[i]);
+    }
+    free(st->princs);
+    free(st->names);
+    st->princs = NULL;
+    st->names = NULL;
+    st->nfound = st->nalloc = 0;
+}
+
+/* Make room for one more found object in st. */
+static krb5_error_code
+grow_found(struct migrate_state *st, void **list, size_t elemsize)
+{
+    void *newlist;
+    size_t newalloc;
+
+    if (st->nfound < st->nalloc)
+        return 0;
+    newalloc = (st->nalloc == 0) ? 64 : st->nalloc * 2;
+    newlist = realloc(*list, newalloc * elemsize);
+    if (newlist == NULL)
+        return ENOMEM;
+    *list = newlist;
+    st->nalloc = newalloc;
+    return 0;
+}
+
+static int
+count_cb(krb5_pointer arg, krb5_db_entry *entry)
+{
+    struct migrate_state *st = arg;
+
+    st->count++;
+    return 0;
+}
+
+static int
+collect_princ_cb(krb5_pointer arg, krb5_db_entry *entry)
+{
+    struct migrate_state *st = arg;
+    krb5_error_code status;
+
+    status = grow_found(st, (void **)&st->princs, sizeof(*st->princs));
+    if (status)
+        return status;
+    status = krb5_copy_principal(st->context, entry->princ,
+                                 &st->princs[st->nfound]);
+    if (status)
+        return status;
+    st->nfound++;
+    return 0;
+}
+
+/* Iterate over the principals in the target database. */
+static krb5_error_code
+target_iterate(krb5_context kcontext,
+               int (*func)(krb5_pointer, krb5_db_entry *),
+               struct migrate_state *st)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *saved;
+    kdb_vftabl *v;
+
+    v = target_enter(kcontext, &saved);
+    status = (v->iterate == NULL) ? KRB5_PLUGIN_OP_NOTSUPP :
+        v->iterate(kcontext, NULL, func, st, 0);
+    target_leave(kcontext, saved);
+    return status;
+}
+
+/*
+ * Find principals in the target database which are not in the primary and
+ * call func for each.  nprimary is the number of primary principals matched
+ * in the target.  If the target has no more principals than that, there is
+ * nothing to find.  Otherwise collect the target's principal names first, so
+ * that the target is not locked while the primary is looked up.
+ */
+static krb5_error_code
+find_target_extras(krb5_context kcontext, struct migrate_state *st,
+                   unsigned long nprimary,
+                   krb5_error_code (*func)(struct migrate_state *,
+                                           krb5_principal))
+{
+    krb5_error_code status;
+    krb5_db_entry *entry;
+    unsigned long count = st->count;
+    size_t i;
+
+    st->count = 0;
+    status = target_iterate(kcontext, count_cb, st);
+    if (status || st->count <= nprimary) {
+        st->count = count;
+        return status;
+    }
+    st->count = count;
+
+    status = target_iterate(kcontext, collect_princ_cb, st);
+    for (i = 0; status == 0 && i < st->nfound; i++) {
+        status = krb5_db_get_principal(kcontext, st->princs[i], 0, &entry);
+        if (status == 0) {
+            krb5_db_free_principal(kcontext, entry);
+        } else if (status == KRB5_KDB_NOENTRY) {
+            status = func(st, st->princs[i]);
+        }
+    }
+    free_found(st);
+    return status;
+}
+
+static int
+migrate_princ_cb(krb5_pointer arg, krb5_db_entry *entry)
+{
+    struct migrate_state *st = arg;
+    krb5_error_code status;
+
+    status = migrate_principal(st->context, entry->princ);
+    if (status)
+        return status;
+    st->count++;
+    st->present++;
+    report_principal(st, entry->princ, FALSE);
+    return 0;
+}
+
+static krb5_error_code
+remove_extra_princ(struct migrate_state *st, krb5_principal princ)
+{
+    /* This deletes princ from the target unless it was just created. */
+    return migrate_principal(st->context, princ);
+}
+
+static void
+collect_policy_cb(void *arg, osa_policy_ent_t policy)
+{
+    struct migrate_state *st = arg;
+
+    if (st->status)
+        return;
+    st->status = grow_found(st, (void **)&st->names, sizeof(*st->names));
+    if (st->status)
+        return;
+    st->names[st->nfound] = strdup(policy->name);
+    if (st->names[st->nfound] == NULL)
+        st->status = ENOMEM;
+    else
+        st->nfound++;
+}
+
+/*
+ * Set st->names to the names of the policies in the primary or target
+ * database.  Modules may hold locks across policy iteration callbacks, so the
+ * names are collected first and the policies looked up afterwards.
+ */
+static krb5_error_code
+collect_policies(krb5_context kcontext, struct migrate_state *st,
+                 krb5_boolean target)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *saved;
+    kdb_vftabl *v;
+
+    st->status = 0;
+    if (!target) {
+        status = krb5_db_iter_policy(kcontext, NULL, collect_policy_cb, st);
+        return status ? status : st->status;
+    }
+    v = target_enter(kcontext, &saved);
+    status = (v->iter_policy == NULL) ? 0 :
+        v->iter_policy(kcontext, NULL, collect_policy_cb, st);
+    target_leave(kcontext, saved);
+    return status ? status : st->status;
+}
+
+static krb5_error_code
+target_get_policy(krb5_context kcontext, char *name, osa_policy_ent_t *policy)
+{
+    krb5_error_code status;
+    kdb5_dal_handle *saved;
+    kdb_vftabl *v;
+
+    *policy = NULL;
+    v = target_enter(kcontext, &saved);
+    status = (v->get_policy == NULL) ? KRB5_PLUGIN_OP_NOTSUPP :
+        v->get_policy(kcontext, name, policy);
+    target_leave(kcontext, saved);
+    return status;
+}
+
+/* Call func for each policy in the target database which is not in the
+ * primary. */
+static krb5_error_code
+find_target_extra_policies(krb5_context kcontext, struct migrate_state *st,
+                           krb5_error_code (*func)(struct migrate_state *,
+                                                   char *))
+{
+    krb5_error_code status;
+    osa_policy_ent_t policy;
+    size_t i;
+
+    status = collect_policies(kcontext, st, TRUE);
+    for (i = 0; status == 0 && i < st->nfound; i++) {
+        status = krb5_db_get_policy(kcontext, st->names[i], &policy);
+        if (status == 0)
+            krb5_db_free_policy(kcontext, policy);
+        else if (status == KRB5_KDB_NOENTRY)
+            status = func(st, st->names[i]);
+    }
+    free_found(st);
+    return status;
+}
+
+static krb5_error_code
+remove_extra_policy(struct migrate_state *st, char *name)
+{
+    return target_delete_policy(st->context, name);
+}
+
+krb5_error_code
+krb5_db_migrate(krb5_context kcontext, krb5_db_migrate_fn func, void *arg)
+{
+    krb5_error_code status;
+    struct migrate_state st;
+    osa_policy_ent_t policy;
+    size_t i;
+
+    if (!migrating(kcontext))
+        return KRB5_KDB_DBNOTINITED;
+    memset(&st, 0, sizeof(st));
+    st.context = kcontext;
+    st.func = func;
+    st.arg = arg;
+
+    /* Copy policies first, so that principals never refer to a policy the
+     * target does not have, then remove policies the primary lacks. */
+    status = collect_policies(kcontext, &st, FALSE);
+    for (i = 0; status == 0 && i < st.nfound; i++) {
+        status = krb5_db_get_policy(kcontext, st.names[i], &policy);
+        if (status == KRB5_KDB_NOENTRY) {
+            /* Deleted since the names were collected. */
+            status = 0;
+            continue;
+        }
+        if (status)
+            break;
+        status = target_store_policy(kcontext, policy);
+        krb5_db_free_policy(kcontext, policy);
+        st.count++;
+        if (status == 0)
+            report(&st, KRB5_DB_MIGRATE_POLICY, st.names[i], FALSE);
+    }
+    free_found(&st);
+    if (status == 0)
+        status = find_target_extra_policies(kcontext, &st,
+                                            remove_extra_policy);
+    if (status)
+        return status;
+
+    st.count = 0;
+    status = krb5_db_iterate(kcontext, NULL, migrate_princ_cb, &st, 0);
+    if (status)
+        return status;
+    return find_target_extras(kcontext, &st, st.present, remove_extra_princ);
+}
+
+static krb5_boolean
+data_match(const void *a, const void *b, size_t len)
+{
+    return len == 0 || memcmp(a, b, len) == 0;
+}
+
+static krb5_boolean
+tl_data_match(const krb5_tl_data *a, const krb5_tl_data *b)
+{
+    for (; a != NULL && b != NULL; a = a->tl_data_next, b = b->tl_data_next) {
+        if (a->tl_data_type != b->tl_data_type ||
+            a->tl_data_length != b->tl_data_length ||
+            !data_match(a->tl_data_contents, b->tl_data_contents,
+                        a->tl_data_length))
+            return FALSE;
+    }
+    return a == NULL && b == NULL;
+}
+
+static krb5_boolean
+key_data_match(const krb5_key_data *a, const krb5_key_data *b)
+{
+    int i;
+
+    if (a->key_data_ver != b->key_data_ver ||
+        a->key_data_kvno != b->key_data_kvno)
+        return FALSE;
+    for (i = 0; i < a->key_data_ver && i < 2; i++) {
+        if (a->key_data_type[i] != b->key_data_type[i] ||
+            a->key_data_length[i] != b->key_data_length[i] ||
+            !data_match(a->key_data_contents[i], b->key_data_contents[i],
+                        a->key_data_length[i]))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* Return true if a and b have the same contents.  The lockout fields are not
+ * compared, as the KDC updates them in the primary database only. */
+static krb5_boolean
+entries_match(krb5_context kcontext, const krb5_db_entry *a,
+              const krb5_db_entry *b)
+{
+    int i;
+
+    if (a->attributes != b->attributes || a->max_life != b->max_life ||
+        a->max_renewable_life != b->max_renewable_life ||
+        a->expiration != b->expiration ||
+        a->pw_expiration != b->pw_expiration ||
+        a->n_key_data != b->n_key_data ||
+        !krb5_principal_compare(kcontext, a->princ, b->princ) ||
+        !tl_data_match(a->tl_data, b->tl_data))
+        return FALSE;
+    for (i = 0; i < a->n_key_data; i++) {
+        if (!key_data_match(&a->key_data[i], &b->key_data[i]))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static krb5_boolean
+policies_match(const osa_policy_ent_rec *a, const osa_policy_ent_rec *b)
+{
+    if (strcmp(a->name, b->name) != 0 ||
+        a->pw_min_life != b->pw_min_life ||
+        a->pw_max_life != b->pw_max_life ||
+        a->pw_min_length != b->pw_min_length ||
+        a->pw_min_classes != b->pw_min_classes ||
+        a->pw_history_num != b->pw_history_num ||
+        a->pw_max_fail != b->pw_max_fail ||
+        a->pw_failcnt_interval != b->pw_failcnt_interval ||
+        a->pw_lockout_duration != b->pw_lockout_duration ||
+        a->attributes != b->attributes || a->max_life != b->max_life ||
+        a->max_renewable_life != b->max_renewable_life ||
+        !tl_data_match(a->tl_data, b->tl_data))
+        return FALSE;
+    if (a->allowed_keysalts == NULL || b->allowed_keysalts == NULL)
+        return a->allowed_keysalts == b->allowed_keysalts;
+    return strcmp(a->allowed_keysalts, b->allowed_keysalts) == 0;
+}
+
+static int
+verify_princ_cb(krb5_pointer arg, krb5_db_entry *entry)
+{
+    struct migrate_state *st = arg;
+    krb5_context kcontext = st->context;
+    krb5_error_code status;
+    krb5_boolean locked, match;
+    krb5_db_entry *pent = NULL, *tent = NULL;
+
+    /* Compare current copies, with the primary locked against changes. */
+    status = migrate_lock(kcontext, KRB5_DB_LOCKMODE_SHARED, &locked);
+    if (status)
+        return status;
+    status = krb5_db_get_principal(kcontext, entry->princ, 0, &pent);
+    if (status == KRB5_KDB_NOENTRY) {
+        /* Deleted since the iterator read it. */
+        status = 0;
+        goto cleanup;
+    }
+    if (status)
+        goto cleanup;
+    status = target_get_principal(kcontext, entry->princ, &tent);
+    if (status && status != KRB5_KDB_NOENTRY)
+        goto cleanup;
+    match = (tent != NULL && entries_match(kcontext, pent, tent));
+    status = 0;
+    st->count++;
+    if (tent != NULL)
+        st->present++;
+    report_principal(st, entry->princ, !match);
+
+cleanup:
+    if (locked)
+        krb5_db_unlock(kcontext);
+    krb5_db_free_principal(kcontext, pent);
+    if (tent != NULL)
+        target_free_principal(kcontext, tent);
+    return status;
+}
+
+static krb5_error_code
+report_extra_princ(struct migrate_state *st, krb5_principal princ)
+{
+    report_principal(st, princ, TRUE);
+    return 0;
+}
+
+static krb5_error_code
+report_extra_policy(struct migrate_state *st, char *name)
+{
+    report(st, KRB5_DB_MIGRATE_POLICY, name, TRUE);
+    return 0;
+}
+
+krb5_error_code
+krb5_db_verify_migration(krb5_context kcontext, krb5_db_migrate_fn func,
+                         void *arg, unsigned long *mismatches_out)
+{
+    krb5_error_code status;
+    struct migrate_state st;
+    osa_policy_ent_t policy, tpol;
+    size_t i;
+
+    *mismatches_out = 0;
+    if (!migrating(kcontext))
+        return KRB5_KDB_DBNOTINITED;
+    memset(&st, 0, sizeof(st));
+    st.context = kcontext;
+    st.func = func;
+    st.arg = arg;
+
+    status = collect_policies(kcontext, &st, FALSE);
+    for (i = 0; status == 0 && i < st.nfound; i++) {
+        status = krb5_db_get_policy(kcontext, st.names[i], &policy);
+        if (status == KRB5_KDB_NOENTRY) {
+            status = 0;
+            continue;
+        }
+        if (status)
+            break;
+        status = target_get_policy(kcontext, st.names[i], &tpol);
+        if (status == 0 || status == KRB5_KDB_NOENTRY) {
+            status = 0;
+            st.count++;
+            report(&st, KRB5_DB_MIGRATE_POLICY, st.names[i],
+                   tpol == NULL || !policies_match(policy, tpol));
+        }
+        krb5_db_free_policy(kcontext, policy);
+        krb5_db_free_policy(kcontext, tpol);
+    }
+    free_found(&st);
+    if (status == 0)
+        status = find_target_extra_policies(kcontext, &st,
+                                            report_extra_policy);
+    if (status)
+        return status;
+
+    st.count = 0;
+    status = krb5_db_iterate(kcontext, NULL, verify_princ_cb, &st, 0);
+    if (status)
+        return status;
+    status = find_target_extras(kcontext, &st, st.present,
+                                report_extra_princ);
+    *mismatches_out = st.mismatches;
+    return status;
+}
@@ -32,6 +32,8 @@ struct _kdb5_dal_handle
     db_library lib_handle;
     krb5_keylist_node *master_keylist;
     krb5_principal master_princ;
+    /* Database being migrated to, if the realm has a migration target. */
+    struct _kdb5_dal_handle *migrate_target;
 };
 /* typedef kdb5_dal_handle is in k5-int.h now */
 
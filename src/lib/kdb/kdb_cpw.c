@@ -241,9 +241,52 @@ make_random_salt(krb5_context context, krb5_keysalt *salt_out)
     return 0;
 }
 
+/* Compute the salt for salttype and db_entry's principal into *key_salt. */
+static krb5_error_code
+make_salt(krb5_context context, krb5_int32 salttype, krb5_db_entry *db_entry,
+          krb5_keysalt *key_salt)
+{
+    krb5_error_code retval;
+
+    switch (key_salt->type = salttype) {
+    case KRB5_KDB_SALTTYPE_ONLYREALM: {
+        krb5_data * saltdata;
+        if ((retval = krb5_copy_data(context, krb5_princ_realm(context,
+                                                               db_entry->princ), &saltdata)))
+            return(retval);
+
+        key_salt->data = *saltdata;
+        free(saltdata);
+    }
+        break;
+    case KRB5_KDB_SALTTYPE_NOREALM:
+        if ((retval=krb5_principal2salt_norealm(context, db_entry->princ,
+                                                &key_salt->data)))
+            return(retval);
+        break;
+    case KRB5_KDB_SALTTYPE_NORMAL:
+        if ((retval = krb5_principal2salt(context, db_entry->princ,
+                                          &key_salt->data)))
+            return(retval);
+        break;
+    case KRB5_KDB_SALTTYPE_SPECIAL:
+        retval = make_random_salt(context, key_salt);
+        if (retval)
+            return retval;
+        break;
+    default:
+        return(KRB5_KDB_BAD_SALTTYPE);
+    }
+    return 0;
+}
+
 /*
  * Add key_data for a krb5_db_entry
  * If passwd is NULL the assumes that the caller wants a random password.
+ *
+ * The string-to-key operations for all of the key/salt tuples are performed
+ * together, since they are the expensive part and can share work or run
+ * concurrently.
  */
 static krb5_error_code
 add_key_pwd(context, master_key, ks_tuple, ks_tuple_count, passwd,
@@ -257,12 +300,27 @@ add_key_pwd(context, master_key, ks_tuple, ks_tuple_count, passwd,
     int                   kvno;
 {
     krb5_error_code       retval;
-    krb5_keysalt          key_salt;
-    krb5_keyblock         key;
+    krb5_keysalt        * key_salts = NULL;
+    krb5_keyblock       * keys = NULL;
+    krb5_enctype        * enctypes = NULL;
+    krb5_data           * salts = NULL;
     krb5_data             pwd;
-    int                   i, j;
+    int                   i, j, n = 0;
     krb5_key_data        *kd_slot;
 
+    key_salts = k5calloc(ks_tuple_count, sizeof(*key_salts), &retval);
+    if (key_salts == NULL)
+        goto cleanup;
+    keys = k5calloc(ks_tuple_count, sizeof(*keys), &retval);
+    if (keys == NULL)
+        goto cleanup;
+    enctypes = k5calloc(ks_tuple_count, sizeof(*enctypes), &retval);
+    if (enctypes == NULL)
+        goto cleanup;
+    salts = k5calloc(ks_tuple_count, sizeof(*salts), &retval);
+    if (salts == NULL)
+        goto cleanup;
+
     for (i = 0; i < ks_tuple_count; i++) {
         krb5_boolean similar;
 
@@ -278,7 +336,7 @@ add_key_pwd(context, master_key, ks_tuple, ks_tuple_count, passwd,
                                                  ks_tuple[i].ks_enctype,
                                                  ks_tuple[j].ks_enctype,
                                                  &similar)))
-                return(retval);
+                goto cleanup;
 
             if (similar &&
                 (ks_tuple[j].ks_salttype == ks_tuple[i].ks_salttype))
@@ -288,64 +346,44 @@ add_key_pwd(context, master_key, ks_tuple, ks_tuple_count, passwd,
         if (j < i)
             continue;
 
-        if ((retval = krb5_dbe_create_key_data(context, db_entry)))
-            return(retval);
-        kd_slot = &db_entry->key_data[db_entry->n_key_data - 1];
-
-        /* Convert password string to key using appropriate salt */
-        switch (key_salt.type = ks_tuple[i].ks_salttype) {
-        case KRB5_KDB_SALTTYPE_ONLYREALM: {
-            krb5_data * saltdata;
-            if ((retval = krb5_copy_data(context, krb5_princ_realm(context,
-                                                                   db_entry->princ), &saltdata)))
-                return(retval);
-
-            key_salt.data = *saltdata;
-            free(saltdata);
-        }
-            break;
-        case KRB5_KDB_SALTTYPE_NOREALM:
-            if ((retval=krb5_principal2salt_norealm(context, db_entry->princ,
-                                                    &key_salt.data)))
-                return(retval);
-            break;
-        case KRB5_KDB_SALTTYPE_NORMAL:
-            if ((retval = krb5_principal2salt(context, db_entry->princ,
-                                              &key_salt.data)))
-                return(retval);
-            break;
-        case KRB5_KDB_SALTTYPE_SPECIAL:
-            retval = make_random_salt(context, &key_salt);
-            if (retval)
-                return retval;
-            break;
-        default:
-            return(KRB5_KDB_BAD_SALTTYPE);
-        }
+        retval = make_salt(context, ks_tuple[i].ks_salttype, db_entry,
+                           &key_salts[n]);
+        if (retval)
+            goto cleanup;
+        enctypes[n] = ks_tuple[i].ks_enctype;
+        salts[n] = key_salts[n].data;
+        n++;
+    }
 
-        pwd = string2data((char *)passwd);
+    /* Convert password string to keys using the appropriate salts */
+    pwd = string2data((char *)passwd);
+    retval = krb5int_c_string_to_key_multi(context, n, enctypes, &pwd, salts,
+                                           NULL, keys);
+    if (retval)
+        goto cleanup;
 
-        retval = krb5_c_string_to_key_with_params(context,
-                                                  ks_tuple[i].ks_enctype,
-                                                  &pwd, &key_salt.data,
-                                                  NULL, &key);
-        if (retval) {
-            free(key_salt.data.data);
-            return retval;
-        }
+    for (i = 0; i < n; i++) {
+        if ((retval = krb5_dbe_create_key_data(context, db_entry)))
+            goto cleanup;
+        kd_slot = &db_entry->key_data[db_entry->n_key_data - 1];
 
-        retval = krb5_dbe_encrypt_key_data(context, master_key, &key,
-                                           (const krb5_keysalt *)&key_salt,
+        retval = krb5_dbe_encrypt_key_data(context, master_key, &keys[i],
+                                           (const krb5_keysalt *)&key_salts[i],
                                            kvno, kd_slot);
-        if (key_salt.data.data)
-            free(key_salt.data.data);
-        free(key.contents);
-
-        if( retval )
-            return retval;
+        if (retval)
+            goto cleanup;
     }
 
-    return 0;
+cleanup:
+    for (i = 0; keys != NULL && i < n; i++)
+        krb5_free_keyblock_contents(context, &keys[i]);
+    for (i = 0; key_salts != NULL && i < n; i++)
+        free(key_salts[i].data.data);
+    free(key_salts);
+    free(keys);
+    free(enctypes);
+    free(salts);
+    return retval;
 }
 
 static krb5_error_code
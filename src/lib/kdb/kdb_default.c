@@ -549,3 +549,86 @@ cleanup:
     krb5_db_free_principal(kcontext, kdb);
     return ret;
 }
+
+/* Read the change count from the start of fd, which must be locked.  An empty
+ * file has a count of 0. */
+static krb5_error_code
+read_change_count(int fd, uint64_t *count_out)
+{
+    char buf[32], *end;
+    ssize_t len;
+    unsigned long long count;
+
+    *count_out = 0;
+    if (lseek(fd, 0, SEEK_SET) == -1)
+        return errno;
+    len = read(fd, buf, sizeof(buf) - 1);
+    if (len == -1)
+        return errno;
+    if (len == 0)
+        return 0;
+    buf[len] = '\0';
+    errno = 0;
+    count = strtoull(buf, &end, 10);
+    if (errno != 0 || end == buf || *end != '\n')
+        return KRB5_KDB_DB_CORRUPT;
+    *count_out = count;
+    return 0;
+}
+
+krb5_error_code
+krb5_db_incr_change_count(krb5_context context, const char *path)
+{
+    krb5_error_code ret;
+    uint64_t count;
+    char buf[32];
+    int fd, len;
+    ssize_t nwritten;
+
+    fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd == -1)
+        return errno;
+    set_cloexec_fd(fd);
+    ret = krb5_lock_file(context, fd, KRB5_LOCKMODE_EXCLUSIVE);
+    if (ret)
+        goto cleanup;
+    ret = read_change_count(fd, &count);
+    if (ret)
+        goto cleanup;
+
+    /* The count only grows, so the new text always covers the old. */
+    len = snprintf(buf, sizeof(buf), "%llu\n", (unsigned long long)count + 1);
+    if (lseek(fd, 0, SEEK_SET) == -1) {
+        ret = errno;
+        goto cleanup;
+    }
+    nwritten = write(fd, buf, len);
+    if (nwritten == -1)
+        ret = errno;
+    else if (nwritten != len)
+        ret = EIO;
+
+cleanup:
+    /* Closing the file releases the lock. */
+    close(fd);
+    return ret;
+}
+
+krb5_error_code
+krb5_db_read_change_count(krb5_context context, const char *path,
+                          uint64_t *count_out)
+{
+    krb5_error_code ret;
+    int fd;
+
+    *count_out = 0;
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return errno;
+    set_cloexec_fd(fd);
+    ret = krb5_lock_file(context, fd, KRB5_LOCKMODE_SHARED);
+    if (!ret)
+        ret = read_change_count(fd, count_out);
+    close(fd);
+    return ret;
+}
@@ -0,0 +1,169 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/kdb/t_changecount.c - Unit tests for KDB change count files */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program tests krb5_db_incr_change_count() and
+ * krb5_db_read_change_count().  The test program accepts one argument, a
+ * filename which it unlinks and then uses as the change count file.  It
+ * checks that an increment waits for another process's lock on the file and
+ * then applies to the count written under that lock, and that increments made
+ * by several processes at once are all counted.
+ */
+
+#include "k5-int.h"
+#include "kdb.h"
+#include <sys/wait.h>
+
+#define NCHILDREN 4
+#define NINCR 250
+
+static krb5_context context;
+
+static void
+check_count(const char *filename, uint64_t expected)
+{
+    uint64_t count;
+
+    if (krb5_db_read_change_count(context, filename, &count) != 0)
+        abort();
+    if (count != expected) {
+        fprintf(stderr, "Change count is %llu, expected %llu\n",
+                (unsigned long long)count, (unsigned long long)expected);
+        exit(1);
+    }
+}
+
+static void
+write_file(const char *filename, const char *contents)
+{
+    FILE *fp;
+
+    fp = fopen(filename, "w");
+    if (fp == NULL || fputs(contents, fp) == EOF || fclose(fp) != 0)
+        abort();
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *filename;
+    uint64_t count;
+    pid_t pid;
+    int fd, i, j, status;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s filename\n", argv[0]);
+        exit(1);
+    }
+    filename = argv[1];
+    unlink(filename);
+    if (krb5_init_context(&context) != 0)
+        abort();
+
+    /* A missing file has no count; the first increment creates it. */
+    if (krb5_db_read_change_count(context, filename, &count) != ENOENT)
+        abort();
+    if (krb5_db_incr_change_count(context, filename) != 0)
+        abort();
+    check_count(filename, 1);
+    if (krb5_db_incr_change_count(context, filename) != 0)
+        abort();
+    check_count(filename, 2);
+
+    /* Hold an exclusive lock while a child process increments the count.  The
+     * child must wait, then increment the count written under the lock. */
+    fd = open(filename, O_RDWR);
+    if (fd == -1 || krb5_lock_file(context, fd, KRB5_LOCKMODE_EXCLUSIVE) != 0)
+        abort();
+    pid = fork();
+    if (pid == -1)
+        abort();
+    if (pid == 0) {
+        close(fd);
+        _exit(krb5_db_incr_change_count(context, filename) != 0);
+    }
+    usleep(100000);
+    if (waitpid(pid, &status, WNOHANG) != 0)
+        abort();
+    if (write(fd, "100\n", 4) != 4)
+        abort();
+    close(fd);
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0)
+        abort();
+    check_count(filename, 101);
+
+    /* Increment the count from several processes at once. */
+    for (i = 0; i < NCHILDREN; i++) {
+        pid = fork();
+        if (pid == -1)
+            abort();
+        if (pid == 0) {
+            for (j = 0; j < NINCR; j++) {
+                if (krb5_db_incr_change_count(context, filename) != 0)
+                    _exit(1);
+            }
+            _exit(0);
+        }
+    }
+    for (i = 0; i < NCHILDREN; i++) {
+        if (wait(&status) == -1 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0)
+            abort();
+    }
+    check_count(filename, 101 + NCHILDREN * NINCR);
+
+    /* An empty file has a count of 0. */
+    write_file(filename, "");
+    check_count(filename, 0);
+    if (krb5_db_incr_change_count(context, filename) != 0)
+        abort();
+    check_count(filename, 1);
+
+    /* Check the transition to a longer count. */
+    write_file(filename, "9\n");
+    if (krb5_db_incr_change_count(context, filename) != 0)
+        abort();
+    check_count(filename, 10);
+
+    /* A file without a count is rejected rather than restarted. */
+    write_file(filename, "garbage\n");
+    if (krb5_db_read_change_count(context, filename, &count) !=
+        KRB5_KDB_DB_CORRUPT)
+        abort();
+    if (krb5_db_incr_change_count(context, filename) != KRB5_KDB_DB_CORRUPT)
+        abort();
+
+    unlink(filename);
+    krb5_free_context(context);
+    return 0;
+}
@@ -71,6 +71,7 @@ struct server_st {
 struct krad_client_st {
     krb5_context kctx;
     verto_ctx *vctx;
+    size_t max_sockets;
     struct server_head servers;
 };
 
@@ -105,6 +106,7 @@ get_server(krad_client *rc, const struct addrinfo *ai, const char *secret,
         free(srv);
         return retval;
     }
+    kr_remote_set_max_sockets(srv->serv, rc->max_sockets);
 
     K5_LIST_INSERT_HEAD(&rc->servers, srv, list);
     *out = srv->serv;
@@ -239,6 +241,7 @@ krad_client_new(krb5_context kctx, verto_ctx *vctx, krad_client **out)
 
     tmp->kctx = kctx;
     tmp->vctx = vctx;
+    tmp->max_sockets = 1;
 
     *out = tmp;
     return 0;
@@ -291,35 +294,54 @@ resolve_remote(const char *remote, struct addrinfo **ai)
     return retval;
 }
 
+/* Resolve remote into a list of addresses, using usock and ua as storage for
+ * a Unix domain socket path.  Set *ai_out to the list to free afterwards. */
+static krb5_error_code
+resolve_any(const char *remote, struct addrinfo *usock, struct sockaddr_un *ua,
+            const struct addrinfo **list_out, struct addrinfo **ai_out)
+{
+    krb5_error_code retval;
+
+    *list_out = NULL;
+    *ai_out = NULL;
+
+    if (remote[0] == '/') {
+        ua->sun_family = AF_UNIX;
+        snprintf(ua->sun_path, sizeof(ua->sun_path), "%s", remote);
+        memset(usock, 0, sizeof(*usock));
+        usock->ai_family = AF_UNIX;
+        usock->ai_socktype = SOCK_STREAM;
+        usock->ai_addr = (struct sockaddr *)ua;
+        usock->ai_addrlen = sizeof(*ua);
+        *list_out = usock;
+        return 0;
+    }
+
+    retval = resolve_remote(remote, ai_out);
+    if (retval != 0)
+        return retval;
+    *list_out = *ai_out;
+    return 0;
+}
+
 krb5_error_code
 krad_client_send(krad_client *rc, krad_code code, const krad_attrset *attrs,
                  const char *remote, const char *secret, int timeout,
                  size_t retries, krad_cb cb, void *data)
 {
     struct addrinfo usock, *ai = NULL;
+    const struct addrinfo *list;
     krb5_error_code retval;
     struct sockaddr_un ua;
     request *req;
 
-    if (remote[0] == '/') {
-        ua.sun_family = AF_UNIX;
-        snprintf(ua.sun_path, sizeof(ua.sun_path), "%s", remote);
-        memset(&usock, 0, sizeof(usock));
-        usock.ai_family = AF_UNIX;
-        usock.ai_socktype = SOCK_STREAM;
-        usock.ai_addr = (struct sockaddr *)&ua;
-        usock.ai_addrlen = sizeof(ua);
-
-        retval = request_new(rc, code, attrs, &usock, secret, timeout, retries,
-                             cb, data, &req);
-    } else {
-        retval = resolve_remote(remote, &ai);
-        if (retval == 0) {
-            retval = request_new(rc, code, attrs, ai, secret, timeout, retries,
-                                 cb, data, &req);
-            freeaddrinfo(ai);
-        }
-    }
+    retval = resolve_any(remote, &usock, &ua, &list, &ai);
+    if (retval != 0)
+        return retval;
+    retval = request_new(rc, code, attrs, list, secret, timeout, retries, cb,
+                         data, &req);
+    if (ai != NULL)
+        freeaddrinfo(ai);
     if (retval != 0)
         return retval;
 
@@ -333,3 +355,56 @@ krad_client_send(krad_client *rc, krad_code code, const krad_attrset *attrs,
 
     return 0;
 }
+
+void
+krad_client_set_max_sockets(krad_client *rc, size_t max_sockets)
+{
+    server *srv;
+
+    rc->max_sockets = (max_sockets == 0) ? 1 : max_sockets;
+    K5_LIST_FOREACH(srv, &rc->servers, list)
+        kr_remote_set_max_sockets(srv->serv, rc->max_sockets);
+}
+
+krb5_error_code
+krad_client_get_stats(krad_client *rc, const char *remote,
+                      krad_remote_stats *stats)
+{
+    struct addrinfo usock, *ai = NULL;
+    const struct addrinfo *list, *tmp;
+    krb5_error_code retval;
+    struct sockaddr_un ua;
+    krad_remote_stats rs;
+    krb5_boolean found = FALSE;
+    server *srv;
+
+    memset(stats, 0, sizeof(*stats));
+
+    retval = resolve_any(remote, &usock, &ua, &list, &ai);
+    if (retval != 0)
+        return retval;
+
+    K5_LIST_FOREACH(srv, &rc->servers, list) {
+        for (tmp = list; tmp != NULL; tmp = tmp->ai_next) {
+            if (kr_remote_addr_equals(srv->serv, tmp))
+                break;
+        }
+        if (tmp == NULL)
+            continue;
+
+        kr_remote_get_stats(srv->serv, &rs);
+        stats->sockets += rs.sockets;
+        stats->in_flight += rs.in_flight;
+        stats->requests += rs.requests;
+        stats->responses += rs.responses;
+        stats->timeouts += rs.timeouts;
+        stats->latency_total += rs.latency_total;
+        if (rs.latency_max > stats->latency_max)
+            stats->latency_max = rs.latency_max;
+        found = TRUE;
+    }
+
+    if (ai != NULL)
+        freeaddrinfo(ai);
+    return found ? 0 : ENOENT;
+}
@@ -86,6 +86,15 @@ kr_remote_new(krb5_context kctx, verto_ctx *vctx, const struct addrinfo *info,
 void
 kr_remote_free(krad_remote *rr);
 
+/* Set the maximum number of sockets the remote may open to its server.  Each
+ * socket has its own space of 256 packet identifiers. */
+void
+kr_remote_set_max_sockets(krad_remote *rr, size_t max_sockets);
+
+/* Get the request and latency statistics of the remote. */
+void
+kr_remote_get_stats(const krad_remote *rr, krad_remote_stats *stats);
+
 /*
  * Send the packet to the remote. The cb will be called when a response is
  * received, the request times out, the request is canceled or an error occurs.
@@ -115,6 +124,11 @@ krb5_boolean
 kr_remote_equals(const krad_remote *rr, const struct addrinfo *info,
                  const char *secret);
 
+/* Determine if this remote object refers to the remote resource identified
+ * by the addrinfo struct, regardless of the secret. */
+krb5_boolean
+kr_remote_addr_equals(const krad_remote *rr, const struct addrinfo *info);
+
 /* Adapted from lib/krb5/os/sendto_kdc.c. */
 static inline krb5_error_code
 gai_error_code(int err)
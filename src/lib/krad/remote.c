@@ -33,6 +33,7 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
 
 #include <sys/un.h>
 
@@ -41,12 +42,17 @@
 #define FLAGS_WRITE VERTO_EV_FLAG_IO_WRITE
 #define FLAGS_BASE  VERTO_EV_FLAG_PERSIST | VERTO_EV_FLAG_IO_ERROR
 
+/* Each socket has its own space of RADIUS packet identifiers. */
+#define IDS_PER_SOCKET (UCHAR_MAX + 1)
+
 K5_TAILQ_HEAD(request_head, request_st);
 
 typedef struct request_st request;
+typedef struct conn_st conn;
+
 struct request_st {
     K5_TAILQ_ENTRY(request_st) list;
-    krad_remote *rr;
+    conn *conn;
     krad_packet *request;
     krad_cb cb;
     void *data;
@@ -54,26 +60,48 @@ struct request_st {
     int timeout;
     size_t retries;
     size_t sent;
+    unsigned long long start;
 };
 
-struct krad_remote_st {
-    krb5_context kctx;
-    verto_ctx *vctx;
+/* A source socket to the remote, with the requests outstanding on it. */
+struct conn_st {
+    krad_remote *rr;
     int fd;
     verto_ev *io;
-    char *secret;
-    struct addrinfo *info;
     struct request_head list;
+    size_t count;
     char buffer_[KRAD_PACKET_SIZE_MAX];
     krb5_data buffer;
 };
 
+struct krad_remote_st {
+    krb5_context kctx;
+    verto_ctx *vctx;
+    char *secret;
+    struct addrinfo *info;
+    conn **conns;
+    size_t nconns;
+    size_t max_conns;
+    krad_remote_stats stats;
+};
+
 static void
 on_io(verto_ctx *ctx, verto_ev *ev);
 
 static void
 on_timeout(verto_ctx *ctx, verto_ev *ev);
 
+/* Return the current monotonic time in microseconds. */
+static unsigned long long
+now_us(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 /* Iterate over the set of outstanding packets. */
 static const krad_packet *
 iterator(request **out)
@@ -89,7 +117,7 @@ iterator(request **out)
 
 /* Create a new request. */
 static krb5_error_code
-request_new(krad_remote *rr, krad_packet *rqst, int timeout, size_t retries,
+request_new(conn *c, krad_packet *rqst, int timeout, size_t retries,
             krad_cb cb, void *data, request **out)
 {
     request *tmp;
@@ -98,24 +126,47 @@ request_new(krad_remote *rr, krad_packet *rqst, int timeout, size_t retries,
     if (tmp == NULL)
         return ENOMEM;
 
-    tmp->rr = rr;
+    tmp->conn = c;
     tmp->request = rqst;
     tmp->cb = cb;
     tmp->data = data;
     tmp->timeout = timeout;
     tmp->retries = retries;
+    tmp->start = now_us();
 
     *out = tmp;
     return 0;
 }
 
+/* Record the outcome of a request in the statistics of its remote. */
+static void
+request_record(request *req, krb5_error_code retval)
+{
+    krad_remote_stats *stats = &req->conn->rr->stats;
+    unsigned long long elapsed;
+
+    if (retval == ETIMEDOUT) {
+        stats->timeouts++;
+    } else if (retval == 0) {
+        elapsed = now_us() - req->start;
+        stats->responses++;
+        stats->latency_total += elapsed;
+        if (elapsed > stats->latency_max)
+            stats->latency_max = elapsed;
+    }
+}
+
 /* Finish a request, calling the callback and freeing it. */
 static inline void
 request_finish(request *req, krb5_error_code retval,
                const krad_packet *response)
 {
-    if (retval != ETIMEDOUT)
-        K5_TAILQ_REMOVE(&req->rr->list, req, list);
+    request_record(req, retval);
+
+    if (retval != ETIMEDOUT) {
+        K5_TAILQ_REMOVE(&req->conn->list, req, list);
+        req->conn->count--;
+    }
 
     req->cb(retval, req->request, response, req->data);
 
@@ -140,100 +191,170 @@ request_start_timer(request *r, verto_ctx *vctx)
     return (r->timer == NULL) ? ENOMEM : 0;
 }
 
-/* Disconnect from the remote host. */
+/* Disconnect the socket from the remote host. */
 static void
-remote_disconnect(krad_remote *rr)
+conn_disconnect(conn *c)
 {
-    if (rr->fd >= 0)
-        close(rr->fd);
-    verto_del(rr->io);
-    rr->fd = -1;
-    rr->io = NULL;
+    if (c->fd >= 0)
+        close(c->fd);
+    verto_del(c->io);
+    c->fd = -1;
+    c->io = NULL;
 }
 
-/* Add the specified flags to the remote. This automatically manages the
+/* Add the specified flags to the socket. This automatically manages the
  * lifecycle of the underlying event. Also connects if disconnected. */
 static krb5_error_code
-remote_add_flags(krad_remote *remote, verto_ev_flag flags)
+conn_add_flags(conn *c, verto_ev_flag flags)
 {
     verto_ev_flag curflags = VERTO_EV_FLAG_NONE;
+    const struct addrinfo *info;
     int i;
 
     flags &= (FLAGS_READ | FLAGS_WRITE);
-    if (remote == NULL || flags == FLAGS_NONE)
+    if (c == NULL || flags == FLAGS_NONE)
         return EINVAL;
 
     /* If there is no connection, connect. */
-    if (remote->fd < 0) {
-        verto_del(remote->io);
-        remote->io = NULL;
+    if (c->fd < 0) {
+        verto_del(c->io);
+        c->io = NULL;
 
-        remote->fd = socket(remote->info->ai_family, remote->info->ai_socktype,
-                            remote->info->ai_protocol);
-        if (remote->fd < 0)
+        info = c->rr->info;
+        c->fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (c->fd < 0)
             return errno;
 
-        i = connect(remote->fd, remote->info->ai_addr,
-                    remote->info->ai_addrlen);
+        i = connect(c->fd, info->ai_addr, info->ai_addrlen);
         if (i < 0) {
             i = errno;
-            remote_disconnect(remote);
+            conn_disconnect(c);
             return i;
         }
     }
 
-    if (remote->io == NULL) {
-        remote->io = verto_add_io(remote->vctx, FLAGS_BASE | flags,
-                                  on_io, remote->fd);
-        if (remote->io == NULL)
+    if (c->io == NULL) {
+        c->io = verto_add_io(c->rr->vctx, FLAGS_BASE | flags, on_io, c->fd);
+        if (c->io == NULL)
             return ENOMEM;
-        verto_set_private(remote->io, remote, NULL);
+        verto_set_private(c->io, c, NULL);
     }
 
-    curflags = verto_get_flags(remote->io);
+    curflags = verto_get_flags(c->io);
     if ((curflags & flags) != flags)
-        verto_set_flags(remote->io, FLAGS_BASE | curflags | flags);
+        verto_set_flags(c->io, FLAGS_BASE | curflags | flags);
 
     return 0;
 }
 
-/* Remove the specified flags to the remote. This automatically manages the
+/* Remove the specified flags from the socket. This automatically manages the
  * lifecycle of the underlying event. */
 static void
-remote_del_flags(krad_remote *remote, verto_ev_flag flags)
+conn_del_flags(conn *c, verto_ev_flag flags)
 {
-    if (remote == NULL || remote->io == NULL)
+    if (c == NULL || c->io == NULL)
         return;
 
-    flags = verto_get_flags(remote->io) & (FLAGS_READ | FLAGS_WRITE) & ~flags;
+    flags = verto_get_flags(c->io) & (FLAGS_READ | FLAGS_WRITE) & ~flags;
     if (flags == FLAGS_NONE) {
-        verto_del(remote->io);
-        remote->io = NULL;
+        verto_del(c->io);
+        c->io = NULL;
         return;
     }
 
-    verto_set_flags(remote->io, FLAGS_BASE | flags);
+    verto_set_flags(c->io, FLAGS_BASE | flags);
 }
 
 /* Close the connection and start the timers of all outstanding requests. */
 static void
-remote_shutdown(krad_remote *rr)
+conn_shutdown(conn *c)
 {
     krb5_error_code retval;
-    request *r;
+    request *r, *next;
 
-    remote_disconnect(rr);
+    conn_disconnect(c);
 
     /* Start timers for all unsent packets. */
-    K5_TAILQ_FOREACH(r, &rr->list, list) {
+    K5_TAILQ_FOREACH_SAFE(r, &c->list, list, next) {
         if (r->timer == NULL) {
-            retval = request_start_timer(r, rr->vctx);
+            retval = request_start_timer(r, c->rr->vctx);
             if (retval != 0)
                 request_finish(r, retval, NULL);
         }
     }
 }
 
+/* Create a new, not yet connected socket for rr. */
+static krb5_error_code
+conn_new(krad_remote *rr, conn **out)
+{
+    conn *c;
+
+    c = calloc(1, sizeof(*c));
+    if (c == NULL)
+        return ENOMEM;
+    c->rr = rr;
+    c->fd = -1;
+    c->buffer = make_data(c->buffer_, 0);
+    K5_TAILQ_INIT(&c->list);
+
+    *out = c;
+    return 0;
+}
+
+/* Cancel all requests outstanding on c, disconnect and free it. */
+static void
+conn_free(conn *c)
+{
+    if (c == NULL)
+        return;
+
+    while (!K5_TAILQ_EMPTY(&c->list))
+        request_finish(K5_TAILQ_FIRST(&c->list), ECANCELED, NULL);
+    conn_disconnect(c);
+    free(c);
+}
+
+/*
+ * Choose a socket to carry a new request.  Prefer the least loaded existing
+ * socket with a free packet identifier, opening another socket only when all
+ * existing ones have exhausted their identifier space.
+ */
+static krb5_error_code
+remote_pick_conn(krad_remote *rr, conn **out)
+{
+    krb5_error_code retval;
+    conn *c, *best = NULL, **newconns;
+    size_t i;
+
+    for (i = 0; i < rr->nconns; i++) {
+        c = rr->conns[i];
+        if (c->count < IDS_PER_SOCKET && (best == NULL ||
+                                          c->count < best->count))
+            best = c;
+    }
+    if (best != NULL) {
+        *out = best;
+        return 0;
+    }
+
+    if (rr->nconns >= rr->max_conns)
+        return ERANGE;
+
+    newconns = realloc(rr->conns, (rr->nconns + 1) * sizeof(*rr->conns));
+    if (newconns == NULL)
+        return ENOMEM;
+    rr->conns = newconns;
+
+    retval = conn_new(rr, &c);
+    if (retval != 0)
+        return retval;
+    rr->conns[rr->nconns++] = c;
+
+    *out = c;
+    return 0;
+}
+
 /* Handle when packets receive no response within their allotted time. */
 static void
 on_timeout(verto_ctx *ctx, verto_ev *ev)
@@ -246,7 +367,7 @@ on_timeout(verto_ctx *ctx, verto_ev *ev)
     /* If we have more retries to perform, resend the packet. */
     if (req->retries-- > 0) {
         req->sent = 0;
-        retval = remote_add_flags(req->rr, FLAGS_WRITE);
+        retval = conn_add_flags(req->conn, FLAGS_WRITE);
         if (retval == 0)
             return;
     }
@@ -256,13 +377,13 @@ on_timeout(verto_ctx *ctx, verto_ev *ev)
 
 /* Write data to the socket. */
 static void
-on_io_write(krad_remote *rr)
+on_io_write(conn *c)
 {
     const krb5_data *tmp;
     ssize_t written;
     request *r;
 
-    K5_TAILQ_FOREACH(r, &rr->list, list) {
+    K5_TAILQ_FOREACH(r, &c->list, list) {
         tmp = krad_packet_encode(r->request);
 
         /* If the packet has already been sent, do nothing. */
@@ -270,7 +391,7 @@ on_io_write(krad_remote *rr)
             continue;
 
         /* Send the packet. */
-        written = sendto(verto_get_fd(rr->io), tmp->data + r->sent,
+        written = sendto(verto_get_fd(c->io), tmp->data + r->sent,
                          tmp->length - r->sent, 0, NULL, 0);
         if (written < 0) {
             /* Should we try again? */
@@ -279,20 +400,20 @@ on_io_write(krad_remote *rr)
                 return;
 
             /* This error can't be worked around. */
-            remote_shutdown(rr);
+            conn_shutdown(c);
             return;
         }
 
         /* If the packet was completely sent, set a timeout. */
         r->sent += written;
         if (r->sent == tmp->length) {
-            if (request_start_timer(r, rr->vctx) != 0) {
+            if (request_start_timer(r, c->rr->vctx) != 0) {
                 request_finish(r, ENOMEM, NULL);
                 return;
             }
 
-            if (remote_add_flags(rr, FLAGS_READ) != 0) {
-                remote_shutdown(rr);
+            if (conn_add_flags(c, FLAGS_READ) != 0) {
+                conn_shutdown(c);
                 return;
             }
         }
@@ -300,14 +421,15 @@ on_io_write(krad_remote *rr)
         return;
     }
 
-    remote_del_flags(rr, FLAGS_WRITE);
+    conn_del_flags(c, FLAGS_WRITE);
     return;
 }
 
 /* Read data from the socket. */
 static void
-on_io_read(krad_remote *rr)
+on_io_read(conn *c)
 {
+    krad_remote *rr = c->rr;
     const krad_packet *req = NULL;
     krad_packet *rsp = NULL;
     krb5_error_code retval;
@@ -315,19 +437,19 @@ on_io_read(krad_remote *rr)
     request *tmp, *r;
     int i;
 
-    pktlen = sizeof(rr->buffer_) - rr->buffer.length;
+    pktlen = sizeof(c->buffer_) - c->buffer.length;
     if (rr->info->ai_socktype == SOCK_STREAM) {
-        pktlen = krad_packet_bytes_needed(&rr->buffer);
+        pktlen = krad_packet_bytes_needed(&c->buffer);
         if (pktlen < 0) {
             /* If we received a malformed packet on a stream socket,
              * assume the socket to be unrecoverable. */
-            remote_shutdown(rr);
+            conn_shutdown(c);
             return;
         }
     }
 
     /* Read the packet. */
-    i = recv(verto_get_fd(rr->io), rr->buffer.data + rr->buffer.length,
+    i = recv(verto_get_fd(c->io), c->buffer.data + c->buffer.length,
              pktlen, 0);
 
     /* On these errors, try again. */
@@ -336,28 +458,28 @@ on_io_read(krad_remote *rr)
 
     /* On any other errors or on EOF, the socket is unrecoverable. */
     if (i <= 0) {
-        remote_shutdown(rr);
+        conn_shutdown(c);
         return;
     }
 
     /* If we have a partial read or just the header, try again. */
-    rr->buffer.length += i;
-    pktlen = krad_packet_bytes_needed(&rr->buffer);
+    c->buffer.length += i;
+    pktlen = krad_packet_bytes_needed(&c->buffer);
     if (rr->info->ai_socktype == SOCK_STREAM && pktlen > 0)
         return;
 
     /* Decode the packet. */
-    tmp = K5_TAILQ_FIRST(&rr->list);
-    retval = krad_packet_decode_response(rr->kctx, rr->secret, &rr->buffer,
+    tmp = K5_TAILQ_FIRST(&c->list);
+    retval = krad_packet_decode_response(rr->kctx, rr->secret, &c->buffer,
                                          (krad_packet_iter_cb)iterator, &tmp,
                                          &req, &rsp);
-    rr->buffer.length = 0;
+    c->buffer.length = 0;
     if (retval != 0)
         return;
 
     /* Match the response with an outstanding request. */
     if (req != NULL) {
-        K5_TAILQ_FOREACH(r, &rr->list, list) {
+        K5_TAILQ_FOREACH(r, &c->list, list) {
             if (r->request == req &&
                 r->sent == krad_packet_encode(req)->length) {
                 request_finish(r, 0, rsp);
@@ -373,14 +495,14 @@ on_io_read(krad_remote *rr)
 static void
 on_io(verto_ctx *ctx, verto_ev *ev)
 {
-    krad_remote *rr;
+    conn *c;
 
-    rr = verto_get_private(ev);
+    c = verto_get_private(ev);
 
     if (verto_get_fd_state(ev) & VERTO_EV_FLAG_IO_WRITE)
-        on_io_write(rr);
+        on_io_write(c);
     else
-        on_io_read(rr);
+        on_io_read(c);
 }
 
 krb5_error_code
@@ -395,9 +517,7 @@ kr_remote_new(krb5_context kctx, verto_ctx *vctx, const struct addrinfo *info,
         goto error;
     tmp->kctx = kctx;
     tmp->vctx = vctx;
-    tmp->buffer = make_data(tmp->buffer_, 0);
-    K5_TAILQ_INIT(&tmp->list);
-    tmp->fd = -1;
+    tmp->max_conns = 1;
 
     tmp->secret = strdup(secret);
     if (tmp->secret == NULL)
@@ -424,20 +544,42 @@ error:
 void
 kr_remote_free(krad_remote *rr)
 {
+    size_t i;
+
     if (rr == NULL)
         return;
 
-    while (!K5_TAILQ_EMPTY(&rr->list))
-        request_finish(K5_TAILQ_FIRST(&rr->list), ECANCELED, NULL);
+    for (i = 0; i < rr->nconns; i++)
+        conn_free(rr->conns[i]);
+    free(rr->conns);
 
     free(rr->secret);
     if (rr->info != NULL)
         free(rr->info->ai_addr);
     free(rr->info);
-    remote_disconnect(rr);
     free(rr);
 }
 
+void
+kr_remote_set_max_sockets(krad_remote *rr, size_t max_sockets)
+{
+    rr->max_conns = (max_sockets == 0) ? 1 : max_sockets;
+}
+
+void
+kr_remote_get_stats(const krad_remote *rr, krad_remote_stats *stats)
+{
+    size_t i;
+
+    *stats = rr->stats;
+    stats->sockets = stats->in_flight = 0;
+    for (i = 0; i < rr->nconns; i++) {
+        if (rr->conns[i]->fd >= 0)
+            stats->sockets++;
+        stats->in_flight += rr->conns[i]->count;
+    }
+}
+
 krb5_error_code
 kr_remote_send(krad_remote *rr, krad_code code, krad_attrset *attrs,
                krad_cb cb, void *data, int timeout, size_t retries,
@@ -446,17 +588,22 @@ kr_remote_send(krad_remote *rr, krad_code code, krad_attrset *attrs,
     krad_packet *tmp = NULL;
     krb5_error_code retval;
     request *r;
+    conn *c;
 
     if (rr->info->ai_socktype == SOCK_STREAM)
         retries = 0;
 
-    r = K5_TAILQ_FIRST(&rr->list);
+    retval = remote_pick_conn(rr, &c);
+    if (retval != 0)
+        goto error;
+
+    r = K5_TAILQ_FIRST(&c->list);
     retval = krad_packet_new_request(rr->kctx, rr->secret, code, attrs,
                                      (krad_packet_iter_cb)iterator, &r, &tmp);
     if (retval != 0)
         goto error;
 
-    K5_TAILQ_FOREACH(r, &rr->list, list) {
+    K5_TAILQ_FOREACH(r, &c->list, list) {
         if (r->request == tmp) {
             retval = EALREADY;
             goto error;
@@ -464,15 +611,19 @@ kr_remote_send(krad_remote *rr, krad_code code, krad_attrset *attrs,
     }
 
     timeout = timeout / (retries + 1);
-    retval = request_new(rr, tmp, timeout, retries, cb, data, &r);
+    retval = request_new(c, tmp, timeout, retries, cb, data, &r);
     if (retval != 0)
         goto error;
 
-    retval = remote_add_flags(rr, FLAGS_WRITE);
-    if (retval != 0)
+    retval = conn_add_flags(c, FLAGS_WRITE);
+    if (retval != 0) {
+        free(r);
         goto error;
+    }
 
-    K5_TAILQ_INSERT_TAIL(&rr->list, r, list);
+    K5_TAILQ_INSERT_TAIL(&c->list, r, list);
+    c->count++;
+    rr->stats.requests++;
     if (pkt != NULL)
         *pkt = tmp;
     return 0;
@@ -486,24 +637,23 @@ void
 kr_remote_cancel(krad_remote *rr, const krad_packet *pkt)
 {
     request *r;
+    size_t i;
 
-    K5_TAILQ_FOREACH(r, &rr->list, list) {
-        if (r->request == pkt) {
-            request_finish(r, ECANCELED, NULL);
-            return;
+    for (i = 0; i < rr->nconns; i++) {
+        K5_TAILQ_FOREACH(r, &rr->conns[i]->list, list) {
+            if (r->request == pkt) {
+                request_finish(r, ECANCELED, NULL);
+                return;
+            }
         }
     }
 }
 
 krb5_boolean
-kr_remote_equals(const krad_remote *rr, const struct addrinfo *info,
-                 const char *secret)
+kr_remote_addr_equals(const krad_remote *rr, const struct addrinfo *info)
 {
     struct sockaddr_un *a, *b;
 
-    if (strcmp(rr->secret, secret) != 0)
-        return FALSE;
-
     if (info->ai_addrlen != rr->info->ai_addrlen)
         return FALSE;
 
@@ -533,3 +683,13 @@ kr_remote_equals(const krad_remote *rr, const struct addrinfo *info,
 
     return TRUE;
 }
+
+krb5_boolean
+kr_remote_equals(const krad_remote *rr, const struct addrinfo *info,
+                 const char *secret)
+{
+    if (strcmp(rr->secret, secret) != 0)
+        return FALSE;
+
+    return kr_remote_addr_equals(rr, info);
+}
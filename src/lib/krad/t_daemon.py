@@ -27,6 +27,7 @@ from io import StringIO
 import os
 import sys
 import signal
+import threading
 
 try:
     from pyrad import dictionary, packet, server
@@ -42,6 +43,11 @@ ATTRIBUTE\tUser-Password\t2\toctets
 ATTRIBUTE\tNAS-Identifier\t32\tstring
 """
 
+# To stand in for a slow OTP backend during load tests, replies may be delayed
+# by setting T_DAEMON_DELAY to a number of milliseconds.  Delayed replies are
+# sent from timer threads so that many requests can be outstanding at once.
+DELAY = float(os.environ.get("T_DAEMON_DELAY", "0")) / 1000
+
 class TestServer(server.Server):
     def _HandleAuthPacket(self, pkt):
         server.Server._HandleAuthPacket(self, pkt)
@@ -50,19 +56,24 @@ class TestServer(server.Server):
 
         for key in pkt.keys():
             if key == "User-Password":
-                passwd = map(pkt.PwDecrypt, pkt[key])
+                passwd = list(map(pkt.PwDecrypt, pkt[key]))
 
         reply = self.CreateReplyPacket(pkt)
         if passwd == ['accept']:
             reply.code = packet.AccessAccept
         else:
             reply.code = packet.AccessReject
-        self.SendReplyPacket(pkt.fd, reply)
+
+        if DELAY > 0:
+            threading.Timer(DELAY, self.SendReplyPacket,
+                            (pkt.fd, reply)).start()
+        else:
+            self.SendReplyPacket(pkt.fd, reply)
 
 srv = TestServer(addresses=["localhost"],
                  hosts={"127.0.0.1":
                         server.RemoteHost("127.0.0.1", "foo", "localhost")},
-                 dict=dictionary.Dictionary(StringIO.StringIO(DICTIONARY)))
+                 dict=dictionary.Dictionary(StringIO(DICTIONARY)))
 
 # Write a sentinel character to let the parent process know we're listening.
 sys.stdout.write("~")
@@ -0,0 +1,150 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krad/t_load.c - Concurrent request load test for libkrad */
+/*
+ * Copyright (C) 2020 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Issue more simultaneous requests to a single server than fit in the 256
+ * packet identifiers of one socket, and verify that the client spreads them
+ * across a pool of sockets.  Print the throughput and latency observed.
+ */
+
+#include "t_daemon.h"
+#include <time.h>
+
+#define REQUEST_COUNT 1000
+#define MAX_SOCKETS 8
+
+static verto_ctx *vctx;
+static int outstanding, accepted, failed;
+
+static void
+callback(krb5_error_code retval, const krad_packet *request,
+         const krad_packet *response, void *data)
+{
+    if (retval == 0 &&
+        krad_packet_get_code(response) == krad_code_name2num("Access-Accept"))
+        accepted++;
+    else
+        failed++;
+
+    if (--outstanding == 0)
+        verto_break(vctx);
+}
+
+static unsigned long long
+now_us(void)
+{
+    struct timespec ts;
+
+    insist(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int
+main(int argc, const char **argv)
+{
+    krad_attrset *attrs;
+    krad_client *rc;
+    krad_remote_stats stats;
+    krb5_context kctx;
+    krb5_data tmp;
+    unsigned long long start, elapsed;
+    krb5_error_code retval;
+    int i;
+
+    /* Have the daemon hold each reply for a while, like an OTP backend. */
+    setenv("T_DAEMON_DELAY", "20", 1);
+    if (!daemon_start(argc, argv)) {
+        fprintf(stderr, "Unable to start pyrad daemon, skipping test...\n");
+        return 0;
+    }
+
+    noerror(krb5_init_context(&kctx));
+    vctx = verto_new(NULL, VERTO_EV_TYPE_IO | VERTO_EV_TYPE_TIMEOUT);
+    insist(vctx != NULL);
+    noerror(krad_client_new(kctx, vctx, &rc));
+
+    noerror(krad_attrset_new(kctx, &attrs));
+    tmp = string2data("testUser");
+    noerror(krad_attrset_add(attrs, krad_attr_name2num("User-Name"), &tmp));
+    tmp = string2data("accept");
+    noerror(krad_attrset_add(attrs, krad_attr_name2num("User-Password"),
+                             &tmp));
+
+    /* With the default of one socket, the identifier space runs out. */
+    for (i = 0; i < 256; i++) {
+        noerror(krad_client_send(rc, krad_code_name2num("Access-Request"),
+                                 attrs, "localhost", "foo", 10000, 3,
+                                 callback, NULL));
+        outstanding++;
+    }
+    retval = krad_client_send(rc, krad_code_name2num("Access-Request"), attrs,
+                              "localhost", "foo", 10000, 3, callback, NULL);
+    insist(retval == ERANGE);
+    verto_run(vctx);
+    insist(accepted == 256 && failed == 0);
+
+    /* With a pool of sockets, all of the requests can be in flight. */
+    krad_client_set_max_sockets(rc, MAX_SOCKETS);
+    accepted = 0;
+    start = now_us();
+    for (i = 0; i < REQUEST_COUNT; i++) {
+        noerror(krad_client_send(rc, krad_code_name2num("Access-Request"),
+                                 attrs, "localhost", "foo", 10000, 3,
+                                 callback, NULL));
+        outstanding++;
+    }
+    noerror(krad_client_get_stats(rc, "localhost", &stats));
+    insist(stats.in_flight == REQUEST_COUNT);
+    insist(stats.sockets == (REQUEST_COUNT + 255) / 256);
+    verto_run(vctx);
+    elapsed = now_us() - start;
+    insist(accepted == REQUEST_COUNT && failed == 0);
+
+    noerror(krad_client_get_stats(rc, "localhost", &stats));
+    insist(stats.in_flight == 0);
+    insist(stats.requests == 256 + REQUEST_COUNT);
+    insist(stats.responses == 256 + REQUEST_COUNT);
+    printf("%d requests over %d sockets in %llu ms (%.0f/s); "
+           "latency avg %llu us, max %llu us\n", REQUEST_COUNT,
+           (int)stats.sockets, elapsed / 1000,
+           REQUEST_COUNT * 1e6 / (elapsed ? elapsed : 1),
+           stats.latency_total / stats.responses, stats.latency_max);
+
+    insist(krad_client_get_stats(rc, "/nonexistent", &stats) == ENOENT);
+
+    krad_attrset_free(attrs);
+    krad_client_free(rc);
+    verto_free(vctx);
+    krb5_free_context(kctx);
+    return 0;
+}
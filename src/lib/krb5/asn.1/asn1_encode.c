@@ -629,13 +629,19 @@ split_der(asn1buf *buf, uint8_t *const *der, size_t len, taginfo *tag_out)
  */
 static krb5_error_code
 store_der(const taginfo *t, const uint8_t *asn1, size_t len, void *val,
-          size_t *count_out)
+          size_t *count_out, asn1_arena *arena)
 {
     uint8_t *der;
     size_t der_len;
 
     *count_out = 0;
     der_len = t->tag_len + len + t->tag_end_len;
+    if (arena != NULL) {
+        /* The DER encoding is contiguous in the input; refer to it there. */
+        *(const uint8_t **)val = asn1 - t->tag_len;
+        *count_out = der_len;
+        return 0;
+    }
     der = malloc(der_len);
     if (der == NULL)
         return ENOMEM;
@@ -1045,6 +1051,142 @@ free_sequence_of(const struct atype_info *eltinfo, void *val, size_t count)
     }
 }
 
+/**** Functions for arena allocation during decoding ****/
+
+/*
+ * An arena is a chain of blocks.  The first allocation in the first block is
+ * the top-level decoded object, so the arena can be found from it and freed
+ * all at once.  The first block is sized from the encoding length, which is
+ * usually enough to hold the whole result since strings are not copied.
+ */
+struct arena_block {
+    struct arena_block *next;
+    size_t size;                /* Usable bytes following the header */
+    size_t used;
+};
+
+struct asn1_arena_st {
+    struct arena_block *first;
+    struct arena_block *last;
+};
+
+/* Alignment sufficient for any decoded C structure. */
+typedef union {
+    void *p;
+    uintmax_t i;
+    double d;
+} arena_align;
+
+#define ARENA_ROUND(n) (((n) + sizeof(arena_align) - 1) &       \
+                        ~(sizeof(arena_align) - 1))
+#define ARENA_HDRLEN ARENA_ROUND(sizeof(struct arena_block))
+#define ARENA_DATA(b) ((uint8_t *)(b) + ARENA_HDRLEN)
+#define ARENA_MIN_BLOCK 1024
+
+static krb5_error_code
+arena_add_block(asn1_arena *arena, size_t size)
+{
+    struct arena_block *b;
+
+    b = malloc(ARENA_HDRLEN + size);
+    if (b == NULL)
+        return ENOMEM;
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+    if (arena->last != NULL)
+        arena->last->next = b;
+    else
+        arena->first = b;
+    arena->last = b;
+    return 0;
+}
+
+static void
+arena_free_blocks(struct arena_block *b)
+{
+    struct arena_block *next;
+
+    for (; b != NULL; b = next) {
+        next = b->next;
+        free(b);
+    }
+}
+
+/* Return size zeroed bytes from arena, or NULL on allocation failure. */
+static void *
+arena_alloc(asn1_arena *arena, size_t size)
+{
+    struct arena_block *b = arena->last;
+    void *ptr;
+
+    size = ARENA_ROUND(size);
+    if (b == NULL || b->size - b->used < size) {
+        if (arena_add_block(arena, size > ARENA_MIN_BLOCK ? size :
+                            ARENA_MIN_BLOCK) != 0)
+            return NULL;
+        b = arena->last;
+    }
+    ptr = ARENA_DATA(b) + b->used;
+    b->used += size;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+/* Allocate size zeroed bytes from arena if it is not null, or from the heap if
+ * it is. */
+static void *
+decode_alloc(asn1_arena *arena, size_t size)
+{
+    return (arena != NULL) ? arena_alloc(arena, size) : calloc(1, size);
+}
+
+void
+k5_asn1_free_arena(void *rep)
+{
+    if (rep != NULL)
+        arena_free_blocks((struct arena_block *)((uint8_t *)rep -
+                                                 ARENA_HDRLEN));
+}
+
+/*
+ * Decode a counted string into arena.  Byte strings are left in place in the
+ * input; other string types are decoded normally and copied into the arena.
+ * The input is only read, so the cast from const is safe as long as callers
+ * treat the result as read-only, which the arena decoders require.
+ */
+static krb5_error_code
+decode_string_arena(asn1_arena *arena, const struct string_info *string,
+                    const uint8_t *asn1, size_t len, void *val,
+                    size_t *count_out)
+{
+    krb5_error_code ret;
+    uint8_t *str, *copy;
+    size_t slen;
+
+    if (string->dec == k5_asn1_decode_bytestring) {
+        *(uint8_t **)val = (len > 0) ? (uint8_t *)asn1 : NULL;
+        *count_out = len;
+        return 0;
+    }
+    ret = string->dec(asn1, len, &str, &slen);
+    if (ret)
+        return ret;
+    copy = NULL;
+    if (slen > 0) {
+        copy = arena_alloc(arena, slen);
+        if (copy == NULL) {
+            free(str);
+            return ENOMEM;
+        }
+        memcpy(copy, str, slen);
+    }
+    free(str);
+    *(uint8_t **)val = copy;
+    *count_out = slen;
+    return 0;
+}
+
 /**** Functions for decoding objects based on type info ****/
 
 /* Return nonzero if t is an expected tag for an ASN.1 object of type a. */
@@ -1129,23 +1271,26 @@ check_atype_tag(const struct atype_info *a, const taginfo *t)
 
 static krb5_error_code
 decode_cntype(const taginfo *t, const uint8_t *asn1, size_t len,
-              const struct cntype_info *c, void *val, size_t *count_out);
+              const struct cntype_info *c, void *val, size_t *count_out,
+              asn1_arena *arena);
 static krb5_error_code
 decode_atype_to_ptr(const taginfo *t, const uint8_t *asn1, size_t len,
-                    const struct atype_info *basetype, void **ptr_out);
+                    const struct atype_info *basetype, void **ptr_out,
+                    asn1_arena *arena);
 static krb5_error_code
 decode_sequence(const uint8_t *asn1, size_t len, const struct seq_info *seq,
-                void *val);
+                void *val, asn1_arena *arena);
 static krb5_error_code
 decode_sequence_of(const uint8_t *asn1, size_t len,
-                   const struct atype_info *elemtype, void **seq_out,
-                   size_t *count_out);
+                   const struct atype_info *elemtype, size_t extra,
+                   void **seq_out, size_t *count_out, asn1_arena *arena);
 
 /* Given the enclosing tag t, decode from asn1/len the contents of the ASN.1
- * type specified by a, placing the result into val (caller-allocated). */
+ * type specified by a, placing the result into val (caller-allocated).  If
+ * arena is not null, allocate memory from it instead of the heap. */
 static krb5_error_code
 decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
-             const struct atype_info *a, void *val)
+             const struct atype_info *a, void *val, asn1_arena *arena)
 {
     krb5_error_code ret;
 
@@ -1153,19 +1298,20 @@ decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
     case atype_fn: {
         const struct fn_info *fn = a->tinfo;
         assert(fn->dec != NULL);
-        return fn->dec(t, asn1, len, val);
+        return fn->dec(t, asn1, len, val, arena);
     }
     case atype_sequence:
-        return decode_sequence(asn1, len, a->tinfo, val);
+        return decode_sequence(asn1, len, a->tinfo, val, arena);
     case atype_ptr: {
         const struct ptr_info *ptrinfo = a->tinfo;
         void *ptr = LOADPTR(val, ptrinfo);
         assert(ptrinfo->basetype != NULL);
         if (ptr != NULL) {
             /* Container was already allocated by a previous sequence field. */
-            return decode_atype(t, asn1, len, ptrinfo->basetype, ptr);
+            return decode_atype(t, asn1, len, ptrinfo->basetype, ptr, arena);
         } else {
-            ret = decode_atype_to_ptr(t, asn1, len, ptrinfo->basetype, &ptr);
+            ret = decode_atype_to_ptr(t, asn1, len, ptrinfo->basetype, &ptr,
+                                      arena);
             if (ret)
                 return ret;
             STOREPTR(ptr, ptrinfo, val);
@@ -1176,18 +1322,19 @@ decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
         const struct offset_info *off = a->tinfo;
         assert(off->basetype != NULL);
         return decode_atype(t, asn1, len, off->basetype,
-                            (char *)val + off->dataoff);
+                            (char *)val + off->dataoff, arena);
     }
     case atype_optional: {
         const struct optional_info *opt = a->tinfo;
-        return decode_atype(t, asn1, len, opt->basetype, val);
+        return decode_atype(t, asn1, len, opt->basetype, val, arena);
     }
     case atype_counted: {
         const struct counted_info *counted = a->tinfo;
         void *dataptr = (char *)val + counted->dataoff;
         size_t count;
         assert(counted->basetype != NULL);
-        ret = decode_cntype(t, asn1, len, counted->basetype, dataptr, &count);
+        ret = decode_cntype(t, asn1, len, counted->basetype, dataptr, &count,
+                            arena);
         if (ret)
             return ret;
         return store_count(count, counted, val);
@@ -1207,7 +1354,7 @@ decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
             if (!check_atype_tag(tag->basetype, tp))
                 return ASN1_BAD_ID;
         }
-        return decode_atype(tp, asn1, len, tag->basetype, val);
+        return decode_atype(tp, asn1, len, tag->basetype, val, arena);
     }
     case atype_bool: {
         intmax_t intval;
@@ -1260,7 +1407,8 @@ decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
  */
 static krb5_error_code
 decode_cntype(const taginfo *t, const uint8_t *asn1, size_t len,
-              const struct cntype_info *c, void *val, size_t *count_out)
+              const struct cntype_info *c, void *val, size_t *count_out,
+              asn1_arena *arena)
 {
     krb5_error_code ret;
 
@@ -1268,17 +1416,21 @@ decode_cntype(const taginfo *t, const uint8_t *asn1, size_t len,
     case cntype_string: {
         const struct string_info *string = c->tinfo;
         assert(string->dec != NULL);
+        if (arena != NULL) {
+            return decode_string_arena(arena, string, asn1, len, val,
+                                       count_out);
+        }
         return string->dec(asn1, len, val, count_out);
     }
     case cntype_der:
-        return store_der(t, asn1, len, val, count_out);
+        return store_der(t, asn1, len, val, count_out, arena);
     case cntype_seqof: {
         const struct atype_info *a = c->tinfo;
         const struct ptr_info *ptrinfo = a->tinfo;
         void *seq;
         assert(a->type == atype_ptr);
-        ret = decode_sequence_of(asn1, len, ptrinfo->basetype, &seq,
-                                 count_out);
+        ret = decode_sequence_of(asn1, len, ptrinfo->basetype, 0, &seq,
+                                 count_out, arena);
         if (ret)
             return ret;
         STOREPTR(seq, ptrinfo, val);
@@ -1289,7 +1441,8 @@ decode_cntype(const taginfo *t, const uint8_t *asn1, size_t len,
         size_t i;
         for (i = 0; i < choice->n_options; i++) {
             if (check_atype_tag(choice->options[i], t)) {
-                ret = decode_atype(t, asn1, len, choice->options[i], val);
+                ret = decode_atype(t, asn1, len, choice->options[i], val,
+                                   arena);
                 if (ret)
                     return ret;
                 *count_out = i;
@@ -1309,30 +1462,13 @@ decode_cntype(const taginfo *t, const uint8_t *asn1, size_t len,
     return 0;
 }
 
-/* Add a null pointer to the end of a sequence.  ptr is consumed on success
- * (to be replaced by *ptr_out), left alone on failure. */
-static krb5_error_code
-null_terminate(const struct atype_info *eltinfo, void *ptr, size_t count,
-               void **ptr_out)
-{
-    const struct ptr_info *ptrinfo = eltinfo->tinfo;
-    void *endptr;
-
-    assert(eltinfo->type == atype_ptr);
-    ptr = realloc(ptr, (count + 1) * eltinfo->size);
-    if (ptr == NULL)
-        return ENOMEM;
-    endptr = (char *)ptr + count * eltinfo->size;
-    STOREPTR(NULL, ptrinfo, endptr);
-    *ptr_out = ptr;
-    return 0;
-}
-
 static krb5_error_code
 decode_atype_to_ptr(const taginfo *t, const uint8_t *asn1, size_t len,
-                    const struct atype_info *a, void **ptr_out)
+                    const struct atype_info *a, void **ptr_out,
+                    asn1_arena *arena)
 {
     krb5_error_code ret;
+    const struct atype_info *eltinfo;
     void *ptr;
     size_t count;
 
@@ -1340,24 +1476,26 @@ decode_atype_to_ptr(const taginfo *t, const uint8_t *asn1, size_t len,
     switch (a->type) {
     case atype_nullterm_sequence_of:
     case atype_nonempty_nullterm_sequence_of:
-        ret = decode_sequence_of(asn1, len, a->tinfo, &ptr, &count);
+        /* Decode with one extra zeroed element, which serves as the null
+         * terminator. */
+        eltinfo = a->tinfo;
+        assert(eltinfo->type == atype_ptr);
+        ret = decode_sequence_of(asn1, len, eltinfo, 1, &ptr, &count, arena);
         if (ret)
             return ret;
-        ret = null_terminate(a->tinfo, ptr, count, &ptr);
-        if (ret) {
-            free_sequence_of(a->tinfo, ptr, count);
-            return ret;
-        }
+        STOREPTR(NULL, (const struct ptr_info *)eltinfo->tinfo,
+                 (char *)ptr + count * eltinfo->size);
         /* Historically we do not enforce non-emptiness of sequences when
          * decoding, even when it is required by the ASN.1 type. */
         break;
     default:
-        ptr = calloc(a->size, 1);
+        ptr = decode_alloc(arena, a->size);
         if (ptr == NULL)
             return ENOMEM;
-        ret = decode_atype(t, asn1, len, a, ptr);
+        ret = decode_atype(t, asn1, len, a, ptr, arena);
         if (ret) {
-            free(ptr);
+            if (arena == NULL)
+                free(ptr);
             return ret;
         }
         break;
@@ -1409,7 +1547,7 @@ omit_atype(const struct atype_info *a, void *val)
 /* Decode an ASN.1 sequence into a C object. */
 static krb5_error_code
 decode_sequence(const uint8_t *asn1, size_t len, const struct seq_info *seq,
-                void *val)
+                void *val, asn1_arena *arena)
 {
     krb5_error_code ret;
     const uint8_t *contents;
@@ -1441,7 +1579,7 @@ decode_sequence(const uint8_t *asn1, size_t len, const struct seq_info *seq,
          * changing this before making the encoder visible to plugins. */
         if (i == seq->n_fields)
             break;
-        ret = decode_atype(&t, contents, clen, seq->fields[i], val);
+        ret = decode_atype(&t, contents, clen, seq->fields[i], val, arena);
         if (ret)
             goto error;
     }
@@ -1456,7 +1594,10 @@ decode_sequence(const uint8_t *asn1, size_t len, const struct seq_info *seq,
 
 error:
     /* Free what we've decoded so far.  Free pointers in a second pass in
-     * case multiple fields refer to the same pointer. */
+     * case multiple fields refer to the same pointer.  Memory from an arena
+     * is freed with the arena. */
+    if (arena != NULL)
+        return ret;
     for (j = 0; j < i; j++)
         free_atype(seq->fields[j], val);
     for (j = 0; j < i; j++)
@@ -1464,36 +1605,45 @@ error:
     return ret;
 }
 
+/*
+ * Decode the elements of a sequence-of into a zeroed array with extra unused
+ * elements at the end.  The elements are counted first so that the array can
+ * be allocated once.  If there are no elements and extra is 0, *seq_out is
+ * set to NULL.
+ */
 static krb5_error_code
 decode_sequence_of(const uint8_t *asn1, size_t len,
-                   const struct atype_info *elemtype, void **seq_out,
-                   size_t *count_out)
+                   const struct atype_info *elemtype, size_t extra,
+                   void **seq_out, size_t *count_out, asn1_arena *arena)
 {
     krb5_error_code ret;
-    void *seq = NULL, *elem, *newseq;
-    const uint8_t *contents;
-    size_t clen, count = 0;
+    void *seq = NULL, *elem;
+    const uint8_t *contents, *p;
+    size_t clen, plen, n, count = 0;
     taginfo t;
 
     *seq_out = NULL;
     *count_out = 0;
-    while (len > 0) {
+    for (n = 0, p = asn1, plen = len; plen > 0; n++) {
+        ret = get_tag(p, plen, &t, &contents, &clen, &p, &plen);
+        if (ret)
+            return ret;
+        if (!check_atype_tag(elemtype, &t))
+            return ASN1_BAD_ID;
+    }
+    if (n + extra > 0) {
+        if (n + extra > SIZE_MAX / elemtype->size)
+            return ENOMEM;
+        seq = decode_alloc(arena, (n + extra) * elemtype->size);
+        if (seq == NULL)
+            return ENOMEM;
+    }
+    while (count < n) {
         ret = get_tag(asn1, len, &t, &contents, &clen, &asn1, &len);
         if (ret)
             goto error;
-        if (!check_atype_tag(elemtype, &t)) {
-            ret = ASN1_BAD_ID;
-            goto error;
-        }
-        newseq = realloc(seq, (count + 1) * elemtype->size);
-        if (newseq == NULL) {
-            ret = ENOMEM;
-            goto error;
-        }
-        seq = newseq;
         elem = (char *)seq + count * elemtype->size;
-        memset(elem, 0, elemtype->size);
-        ret = decode_atype(&t, contents, clen, elemtype, elem);
+        ret = decode_atype(&t, contents, clen, elemtype, elem, arena);
         if (ret)
             goto error;
         count++;
@@ -1503,8 +1653,10 @@ decode_sequence_of(const uint8_t *asn1, size_t len,
     return 0;
 
 error:
-    free_sequence_of(elemtype, seq, count);
-    free(seq);
+    if (arena == NULL) {
+        free_sequence_of(elemtype, seq, count);
+        free(seq);
+    }
     return ret;
 }
 
@@ -1520,9 +1672,9 @@ k5_asn1_encode_atype(asn1buf *buf, const void *val, const struct atype_info *a,
 
 krb5_error_code
 k5_asn1_decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
-                     const struct atype_info *a, void *val)
+                     const struct atype_info *a, void *val, asn1_arena *arena)
 {
-    return decode_atype(t, asn1, len, a, val);
+    return decode_atype(t, asn1, len, a, val, arena);
 }
 
 krb5_error_code
@@ -1573,9 +1725,9 @@ k5_asn1_full_encode(const void *rep, const struct atype_info *a,
     return 0;
 }
 
-krb5_error_code
-k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
-                    void **retrep)
+static krb5_error_code
+full_decode(const krb5_data *code, const struct atype_info *a, void **retrep,
+            asn1_arena *arena)
 {
     krb5_error_code ret;
     const uint8_t *contents, *remainder;
@@ -1591,5 +1743,38 @@ k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
      * non-length-preserving enctypes, it will sometimes be nonzero). */
     if (!check_atype_tag(a, &t))
         return ASN1_BAD_ID;
-    return decode_atype_to_ptr(&t, contents, clen, a, retrep);
+    return decode_atype_to_ptr(&t, contents, clen, a, retrep, arena);
+}
+
+krb5_error_code
+k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
+                    void **retrep)
+{
+    return full_decode(code, a, retrep, NULL);
+}
+
+krb5_error_code
+k5_asn1_full_decode_arena(const krb5_data *code, const struct atype_info *a,
+                          void **retrep)
+{
+    krb5_error_code ret;
+    asn1_arena arena;
+    size_t size;
+
+    *retrep = NULL;
+    arena.first = arena.last = NULL;
+
+    /* Size the first block so that it will usually hold the whole result.
+     * The top-level object must be its first allocation. */
+    size = ARENA_ROUND(a->size) + code->length + ARENA_MIN_BLOCK;
+    ret = arena_add_block(&arena, size);
+    if (ret)
+        return ret;
+    ret = full_decode(code, a, retrep, &arena);
+    if (ret) {
+        arena_free_blocks(arena.first);
+        return ret;
+    }
+    assert(*retrep == ARENA_DATA(arena.first));
+    return 0;
 }
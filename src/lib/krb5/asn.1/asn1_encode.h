@@ -33,6 +33,9 @@
 
 typedef struct asn1buf_st asn1buf;
 
+/* An allocation arena used by k5_asn1_full_decode_arena(). */
+typedef struct asn1_arena_st asn1_arena;
+
 typedef struct {
     asn1_class asn1class;
     asn1_construction construction;
@@ -146,7 +149,8 @@ struct atype_info {
 
 struct fn_info {
     krb5_error_code (*enc)(asn1buf *, const void *, taginfo *);
-    krb5_error_code (*dec)(const taginfo *, const uint8_t *, size_t, void *);
+    krb5_error_code (*dec)(const taginfo *, const uint8_t *, size_t, void *,
+                           asn1_arena *);
     int (*check_tag)(const taginfo *);
     void (*free_func)(void *);
 };
@@ -527,10 +531,11 @@ k5_asn1_encode_atype(asn1buf *buf, const void *val, const struct atype_info *a,
                      taginfo *tag_out);
 
 /* Decode the tag and contents of a type, storing the result in the
- * caller-allocated C object val.  Used only by kdc_req_body. */
+ * caller-allocated C object val, using arena if it is not null.  Used only by
+ * kdc_req_body. */
 krb5_error_code
 k5_asn1_decode_atype(const taginfo *t, const uint8_t *asn1, size_t len,
-                     const struct atype_info *a, void *val);
+                     const struct atype_info *a, void *val, asn1_arena *arena);
 
 /* Returns a completed encoding, with tag and in the correct byte order, in an
  * allocated krb5_data. */
@@ -541,6 +546,14 @@ krb5_error_code
 k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
                     void **rep_out);
 
+/* Like k5_asn1_full_decode(), but place the result in a single arena which
+ * must be released with k5_asn1_free_arena().  Octet strings, character
+ * strings, and stored DER encodings in the result point into code, which must
+ * remain valid and unmodified for the lifetime of the result. */
+krb5_error_code
+k5_asn1_full_decode_arena(const krb5_data *code, const struct atype_info *a,
+                          void **rep_out);
+
 #define MAKE_ENCODER(FNAME, DESC)                                       \
     krb5_error_code                                                     \
     FNAME(const aux_type_##DESC *rep, krb5_data **code_out)             \
@@ -564,6 +577,25 @@ k5_asn1_full_decode(const krb5_data *code, const struct atype_info *a,
     }                                                                   \
     extern int dummy /* gobble semicolon */
 
+/* Define an arena decoder for a type whose C structure has a magic field,
+ * which is set to K5_ASN1_ARENA_MAGIC so that the type's free function can
+ * recognize the result. */
+#define MAKE_ARENA_DECODER(FNAME, DESC)                                 \
+    krb5_error_code                                                     \
+    FNAME(const krb5_data *code, aux_type_##DESC **rep_out)             \
+    {                                                                   \
+        krb5_error_code ret;                                            \
+        void *rep;                                                      \
+        *rep_out = NULL;                                                \
+        ret = k5_asn1_full_decode_arena(code, &k5_atype_##DESC, &rep);  \
+        if (ret)                                                        \
+            return ret;                                                 \
+        *rep_out = rep;                                                 \
+        (*rep_out)->magic = K5_ASN1_ARENA_MAGIC;                        \
+        return 0;                                                       \
+    }                                                                   \
+    extern int dummy /* gobble semicolon */
+
 #include <stddef.h>
 /*
  * Ugly hack!
@@ -131,7 +131,8 @@ encode_seqno(asn1buf *buf, const void *p, taginfo *rettag)
     return 0;
 }
 static krb5_error_code
-decode_seqno(const taginfo *t, const uint8_t *asn1, size_t len, void *p)
+decode_seqno(const taginfo *t, const uint8_t *asn1, size_t len, void *p,
+             asn1_arena *arena)
 {
     krb5_error_code ret;
     intmax_t val;
@@ -166,7 +167,7 @@ encode_kerberos_time(asn1buf *buf, const void *p, taginfo *rettag)
 }
 static krb5_error_code
 decode_kerberos_time(const taginfo *t, const uint8_t *asn1, size_t len,
-                     void *p)
+                     void *p, asn1_arena *arena)
 {
     krb5_error_code ret;
     time_t val;
@@ -239,7 +240,8 @@ encode_krb5_flags(asn1buf *buf, const void *p, taginfo *rettag)
     return k5_asn1_encode_bitstring(buf, &cptr, 4);
 }
 static krb5_error_code
-decode_krb5_flags(const taginfo *t, const uint8_t *asn1, size_t len, void *val)
+decode_krb5_flags(const taginfo *t, const uint8_t *asn1, size_t len, void *val,
+                  asn1_arena *arena)
 {
     krb5_error_code ret;
     size_t i, blen;
@@ -325,7 +327,8 @@ encode_lr_type(asn1buf *buf, const void *p, taginfo *rettag)
     return 0;
 }
 static krb5_error_code
-decode_lr_type(const taginfo *t, const uint8_t *asn1, size_t len, void *p)
+decode_lr_type(const taginfo *t, const uint8_t *asn1, size_t len, void *p,
+               asn1_arena *arena)
 {
     krb5_error_code ret;
     intmax_t val;
@@ -501,13 +504,14 @@ free_kdc_req_body(void *val)
 }
 static krb5_error_code
 decode_kdc_req_body(const taginfo *t, const uint8_t *asn1, size_t len,
-                    void *val)
+                    void *val, asn1_arena *arena)
 {
     krb5_error_code ret;
     kdc_req_hack h;
     krb5_kdc_req *b = val;
     memset(&h, 0, sizeof(h));
-    ret = k5_asn1_decode_atype(t, asn1, len, &k5_atype_kdc_req_body_hack, &h);
+    ret = k5_asn1_decode_atype(t, asn1, len, &k5_atype_kdc_req_body_hack, &h,
+                               arena);
     if (ret)
         return ret;
     b->kdc_options = h.v.kdc_options;
@@ -522,7 +526,12 @@ decode_kdc_req_body(const taginfo *t, const uint8_t *asn1, size_t len,
     b->addresses = h.v.addresses;
     b->authorization_data = h.v.authorization_data;
     b->second_ticket = h.v.second_ticket;
-    if (b->client != NULL && b->server != NULL) {
+    if (b->client != NULL && b->server != NULL && arena != NULL) {
+        /* Nothing in an arena is freed individually, so the principals can
+         * share the realm. */
+        b->client->realm = h.server_realm;
+        b->server->realm = h.server_realm;
+    } else if (b->client != NULL && b->server != NULL) {
         ret = krb5int_copy_data_contents(NULL, &h.server_realm,
                                          &b->client->realm);
         if (ret) {
@@ -535,7 +544,7 @@ decode_kdc_req_body(const taginfo *t, const uint8_t *asn1, size_t len,
         b->client->realm = h.server_realm;
     else if (b->server != NULL)
         b->server->realm = h.server_realm;
-    else
+    else if (arena == NULL)
         free(h.server_realm.data);
     return 0;
 }
@@ -1192,14 +1201,17 @@ MAKE_ENCODER(encode_krb5_tgs_rep, tgs_rep);
 MAKE_DECODER(decode_krb5_tgs_rep, tgs_rep);
 MAKE_ENCODER(encode_krb5_ap_req, ap_req);
 MAKE_DECODER(decode_krb5_ap_req, ap_req);
+MAKE_ARENA_DECODER(decode_krb5_ap_req_arena, ap_req);
 MAKE_ENCODER(encode_krb5_ap_rep, ap_rep);
 MAKE_DECODER(decode_krb5_ap_rep, ap_rep);
 MAKE_ENCODER(encode_krb5_ap_rep_enc_part, ap_rep_enc_part);
 MAKE_DECODER(decode_krb5_ap_rep_enc_part, ap_rep_enc_part);
 MAKE_ENCODER(encode_krb5_as_req, as_req_encode);
 MAKE_DECODER(decode_krb5_as_req, as_req);
+MAKE_ARENA_DECODER(decode_krb5_as_req_arena, as_req);
 MAKE_ENCODER(encode_krb5_tgs_req, tgs_req_encode);
 MAKE_DECODER(decode_krb5_tgs_req, tgs_req);
+MAKE_ARENA_DECODER(decode_krb5_tgs_req_arena, tgs_req);
 MAKE_ENCODER(encode_krb5_kdc_req_body, kdc_req_body);
 MAKE_DECODER(decode_krb5_kdc_req_body, kdc_req_body);
 MAKE_ENCODER(encode_krb5_safe, safe);
@@ -96,18 +96,39 @@ extern krb5_error_code krb5_change_cache (void);
 
 #define KRB5_OK 0
 
-/* Individual credentials within a cache, in a linked list.  */
+/* Individual credentials within a cache, in a linked list.  Each link is also
+ * on the index chain for its server name. */
 typedef struct _krb5_mcc_link {
     struct _krb5_mcc_link *next;
+    struct _krb5_mcc_link *index_next;
     krb5_creds *creds;
 } krb5_mcc_link;
 
-/* Per-cache data header.  */
+/* The credentials for one server name, most recently stored first. */
+struct mcc_index_entry {
+    struct mcc_index_entry *next;
+    krb5_data key;
+    krb5_mcc_link *links;
+};
+
+/*
+ * Per-cache data header.  lock is held by writers and by krb5_cc_lock(), and
+ * is reentrant for the context holding it.  On its first acquisition it also
+ * write-locks rwlock, which readers lock shared unless their context already
+ * holds lock.  Readers cannot examine lock.owner without racing against other
+ * contexts, so the context holding rwlock for writing is also recorded in
+ * writer, which is protected by writer_lock.
+ */
 typedef struct _krb5_mcc_data {
     char *name;
     k5_cc_mutex lock;
+    k5_rwlock_t rwlock;
+    k5_mutex_t writer_lock;
+    krb5_context writer;
     krb5_principal prin;
     krb5_mcc_link *link;
+    struct k5_hashtab *index;   /* Server name key to mcc_index_entry */
+    struct mcc_index_entry *index_entries;
     /* Time offsets for clock-skewed clients.  */
     krb5_int32 time_offset;
     krb5_int32 usec_offset;
@@ -146,12 +167,157 @@ init_table(krb5_context context)
     return k5_hashtab_create(seed, 64, &mcc_hashtab);
 }
 
+/* Lock d for modification by context. */
+static void
+mcc_write_lock(krb5_context context, krb5_mcc_data *d)
+{
+    k5_cc_mutex_lock(context, &d->lock);
+    if (d->lock.refcount == 1) {
+        k5_rwlock_wrlock(&d->rwlock);
+        k5_mutex_lock(&d->writer_lock);
+        d->writer = context;
+        k5_mutex_unlock(&d->writer_lock);
+    }
+}
+
+/* Return true if context holds the write lock on d. */
+static krb5_boolean
+mcc_is_writer(krb5_context context, krb5_mcc_data *d)
+{
+    krb5_boolean result;
+
+    k5_mutex_lock(&d->writer_lock);
+    result = (d->writer == context);
+    k5_mutex_unlock(&d->writer_lock);
+    return result;
+}
+
+static void
+mcc_write_unlock(krb5_context context, krb5_mcc_data *d)
+{
+    /* Only the writer may examine lock.refcount. */
+    if (!mcc_is_writer(context, d))
+        return;
+    if (d->lock.refcount == 1) {
+        k5_mutex_lock(&d->writer_lock);
+        d->writer = NULL;
+        k5_mutex_unlock(&d->writer_lock);
+        k5_rwlock_unlock(&d->rwlock);
+    }
+    k5_cc_mutex_unlock(context, &d->lock);
+}
+
+/* Lock d for reading by context, unless context already holds the write lock.
+ * Return true if a read lock was taken. */
+static krb5_boolean
+mcc_read_lock(krb5_context context, krb5_mcc_data *d)
+{
+    if (mcc_is_writer(context, d))
+        return FALSE;
+    k5_rwlock_rdlock(&d->rwlock);
+    return TRUE;
+}
+
+static void
+mcc_read_unlock(krb5_mcc_data *d, krb5_boolean locked)
+{
+    if (locked)
+        k5_rwlock_unlock(&d->rwlock);
+}
+
+/* Set *key to the index key for princ, which is its name components without
+ * the realm, so that realm-insensitive lookups can use the index too. */
+static krb5_error_code
+make_index_key(krb5_const_principal princ, krb5_data *key)
+{
+    krb5_error_code ret;
+    size_t len = 0;
+    uint8_t *p;
+    int i;
+
+    for (i = 0; i < princ->length; i++)
+        len += 4 + princ->data[i].length;
+    ret = alloc_data(key, len);
+    if (ret)
+        return ret;
+    p = (uint8_t *)key->data;
+    for (i = 0; i < princ->length; i++) {
+        store_32_be(princ->data[i].length, p);
+        if (princ->data[i].length > 0)
+            memcpy(p + 4, princ->data[i].data, princ->data[i].length);
+        p += 4 + princ->data[i].length;
+    }
+    return 0;
+}
+
+/* Return the index chain for princ in d, or NULL if there is none. */
+static krb5_mcc_link *
+index_lookup(krb5_mcc_data *d, krb5_const_principal princ)
+{
+    struct mcc_index_entry *e;
+    krb5_data key;
+
+    if (d->index == NULL || make_index_key(princ, &key) != 0)
+        return NULL;
+    e = k5_hashtab_get(d->index, key.data, key.length);
+    free(key.data);
+    return (e != NULL) ? e->links : NULL;
+}
+
+/* Add link to the index of d under its server name.  Call with d
+ * write-locked. */
+static krb5_error_code
+index_add(krb5_context context, krb5_mcc_data *d, krb5_mcc_link *link)
+{
+    krb5_error_code ret;
+    struct mcc_index_entry *e;
+    uint8_t seed[K5_HASH_SEED_LEN];
+    krb5_data key, d_seed = make_data(seed, sizeof(seed));
+
+    if (d->index == NULL) {
+        ret = krb5_c_random_make_octets(context, &d_seed);
+        if (ret)
+            return ret;
+        ret = k5_hashtab_create(seed, 64, &d->index);
+        if (ret)
+            return ret;
+    }
+
+    ret = make_index_key(link->creds->server, &key);
+    if (ret)
+        return ret;
+    e = k5_hashtab_get(d->index, key.data, key.length);
+    if (e != NULL) {
+        free(key.data);
+    } else {
+        e = malloc(sizeof(*e));
+        if (e == NULL) {
+            free(key.data);
+            return ENOMEM;
+        }
+        e->key = key;
+        e->links = NULL;
+        ret = k5_hashtab_add(d->index, e->key.data, e->key.length, e);
+        if (ret) {
+            free(e->key.data);
+            free(e);
+            return ret;
+        }
+        e->next = d->index_entries;
+        d->index_entries = e;
+    }
+    link->index_next = e->links;
+    e->links = link;
+    return 0;
+}
+
 /* Remove creds from d, invalidate any existing cursors, and unset the client
  * principal.  The caller is responsible for locking. */
 static void
 empty_mcc_cache(krb5_context context, krb5_mcc_data *d)
 {
     krb5_mcc_link *curr, *next;
+    struct mcc_index_entry *e, *enext;
 
     for (curr = d->link; curr != NULL; curr = next) {
         next = curr->next;
@@ -159,6 +325,15 @@ empty_mcc_cache(krb5_context context, krb5_mcc_data *d)
         free(curr);
     }
     d->link = NULL;
+    for (e = d->index_entries; e != NULL; e = enext) {
+        enext = e->next;
+        free(e->key.data);
+        free(e);
+    }
+    d->index_entries = NULL;
+    if (d->index != NULL)
+        k5_hashtab_free(d->index);
+    d->index = NULL;
     d->generation++;
     krb5_free_principal(context, d->prin);
     d->prin = NULL;
@@ -182,7 +357,7 @@ krb5_mcc_initialize(krb5_context context, krb5_ccache id, krb5_principal princ)
     krb5_error_code ret;
     krb5_mcc_data *d = id->data;
 
-    k5_cc_mutex_lock(context, &d->lock);
+    mcc_write_lock(context, d);
     empty_mcc_cache(context, d);
 
     ret = krb5_copy_principal(context, princ, &d->prin);
@@ -193,7 +368,7 @@ krb5_mcc_initialize(krb5_context context, krb5_ccache id, krb5_principal princ)
         d->usec_offset = os_ctx->usec_offset;
     }
 
-    k5_cc_mutex_unlock(context, &d->lock);
+    mcc_write_unlock(context, d);
     if (ret == KRB5_OK)
         krb5_change_cache();
     return ret;
@@ -223,6 +398,8 @@ krb5_mcc_close(krb5_context context, krb5_ccache id)
         empty_mcc_cache(context, d);
         free(d->name);
         k5_cc_mutex_destroy(&d->lock);
+        k5_rwlock_destroy(&d->rwlock);
+        k5_mutex_destroy(&d->writer_lock);
         free(d);
     }
     return KRB5_OK;
@@ -246,11 +423,11 @@ krb5_mcc_destroy(krb5_context context, krb5_ccache id)
 
     /* Empty the cache and remove the reference for the table slot.  There will
      * always be at least one reference left for the handle being destroyed. */
-    k5_cc_mutex_lock(context, &d->lock);
+    mcc_write_lock(context, d);
     empty_mcc_cache(context, d);
     if (removed_from_table)
         d->refcount--;
-    k5_cc_mutex_unlock(context, &d->lock);
+    mcc_write_unlock(context, d);
 
     /* Invalidate the handle, possibly removing the last reference to d and
      * freeing it. */
@@ -343,15 +520,16 @@ krb5_mcc_start_seq_get(krb5_context context, krb5_ccache id,
 {
     struct mcc_cursor *mcursor;
     krb5_mcc_data *d;
+    krb5_boolean locked;
 
     mcursor = malloc(sizeof(*mcursor));
     if (mcursor == NULL)
         return KRB5_CC_NOMEM;
     d = id->data;
-    k5_cc_mutex_lock(context, &d->lock);
+    locked = mcc_read_lock(context, d);
     mcursor->generation = d->generation;
     mcursor->next_link = d->link;
-    k5_cc_mutex_unlock(context, &d->lock);
+    mcc_read_unlock(d, locked);
     *cursor = mcursor;
     return KRB5_OK;
 }
@@ -383,6 +561,7 @@ krb5_mcc_next_cred(krb5_context context, krb5_ccache id,
     struct mcc_cursor *mcursor;
     krb5_error_code retval;
     krb5_mcc_data *d = id->data;
+    krb5_boolean locked;
 
     memset(creds, 0, sizeof(krb5_creds));
     mcursor = *cursor;
@@ -394,9 +573,10 @@ krb5_mcc_next_cred(krb5_context context, krb5_ccache id,
      * cache has been reinitialized or destroyed, freeing the pointer in the
      * cursor.  Keep the cache locked while we copy the creds and advance the
      * pointer, in case another thread reinitializes the cache after we check
-     * the generation.
+     * the generation.  Other readers may advance their own cursors
+     * concurrently.
      */
-    k5_cc_mutex_lock(context, &d->lock);
+    locked = mcc_read_lock(context, d);
     if (mcursor->generation != d->generation) {
         retval = KRB5_CC_END;
         goto done;
@@ -415,7 +595,7 @@ krb5_mcc_next_cred(krb5_context context, krb5_ccache id,
         mcursor->next_link = mcursor->next_link->next;
 
 done:
-    k5_cc_mutex_unlock(context, &d->lock);
+    mcc_read_unlock(d, locked);
     return retval;
 }
 
@@ -462,14 +642,32 @@ new_mcc_data (const char *name, krb5_mcc_data **dataptr)
         free(d);
         return err;
     }
+    err = k5_rwlock_init(&d->rwlock);
+    if (err) {
+        k5_cc_mutex_destroy(&d->lock);
+        free(d);
+        return err;
+    }
+    err = k5_mutex_init(&d->writer_lock);
+    if (err) {
+        k5_rwlock_destroy(&d->rwlock);
+        k5_cc_mutex_destroy(&d->lock);
+        free(d);
+        return err;
+    }
 
     d->name = strdup(name);
     if (d->name == NULL) {
+        k5_mutex_destroy(&d->writer_lock);
+        k5_rwlock_destroy(&d->rwlock);
         k5_cc_mutex_destroy(&d->lock);
         free(d);
         return KRB5_CC_NOMEM;
     }
+    d->writer = NULL;
     d->link = NULL;
+    d->index = NULL;
+    d->index_entries = NULL;
     d->prin = NULL;
     d->time_offset = 0;
     d->usec_offset = 0;
@@ -478,6 +676,8 @@ new_mcc_data (const char *name, krb5_mcc_data **dataptr)
 
     if (k5_hashtab_add(mcc_hashtab, d->name, strlen(d->name), d) != 0) {
         free(d->name);
+        k5_mutex_destroy(&d->writer_lock);
+        k5_rwlock_destroy(&d->rwlock);
         k5_cc_mutex_destroy(&d->lock);
         free(d);
         return KRB5_CC_NOMEM;
@@ -583,12 +783,68 @@ krb5_mcc_get_principal(krb5_context context, krb5_ccache id, krb5_principal *pri
     return krb5_copy_principal(context, ptr->prin, princ);
 }
 
+/* Return the position of enctype in ktypes, or -1 if it is not present. */
+static int
+ktype_pref(krb5_enctype enctype, const krb5_enctype *ktypes)
+{
+    int i;
+
+    for (i = 0; ktypes[i] != ENCTYPE_NULL; i++) {
+        if (ktypes[i] == enctype)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * Find a credential matching mcreds as k5_cc_retrieve_cred_default() would,
+ * but compare the stored credentials in place and copy only the result.  When
+ * mcreds has a server, only the index chain for its name is searched; the
+ * chain is in the same order as the full list.
+ */
 krb5_error_code KRB5_CALLCONV
 krb5_mcc_retrieve(krb5_context context, krb5_ccache id, krb5_flags whichfields,
                   krb5_creds *mcreds, krb5_creds *creds)
 {
-    return k5_cc_retrieve_cred_default(context, id, whichfields, mcreds,
-                                       creds);
+    krb5_error_code ret;
+    krb5_mcc_data *d = id->data;
+    krb5_mcc_link *l, *best = NULL;
+    krb5_enctype *ktypes = NULL;
+    krb5_boolean locked, use_index = (mcreds->server != NULL);
+    int pref, best_pref = 0;
+
+    if (whichfields & KRB5_TC_SUPPORTED_KTYPES) {
+        ret = krb5_get_tgs_ktypes(context, mcreds->server, &ktypes);
+        if (ret)
+            return ret;
+    }
+    ret = KRB5_CC_NOTFOUND;
+
+    locked = mcc_read_lock(context, d);
+    l = use_index ? index_lookup(d, mcreds->server) : d->link;
+    for (; l != NULL; l = use_index ? l->index_next : l->next) {
+        if (l->creds == NULL ||
+            !krb5int_cc_creds_match_request(context, whichfields, mcreds,
+                                            l->creds))
+            continue;
+        if (ktypes == NULL) {
+            best = l;
+            break;
+        }
+        pref = ktype_pref(l->creds->keyblock.enctype, ktypes);
+        if (pref < 0) {
+            ret = KRB5_CC_NOT_KTYPE;
+        } else if (best == NULL || pref < best_pref) {
+            best = l;
+            best_pref = pref;
+        }
+    }
+    if (best != NULL)
+        ret = k5_copy_creds_contents(context, best->creds, creds);
+    mcc_read_unlock(d, locked);
+
+    free(ktypes);
+    return ret;
 }
 
 /*
@@ -605,7 +861,7 @@ krb5_mcc_remove_cred(krb5_context context, krb5_ccache cache, krb5_flags flags,
     krb5_mcc_data *data = (krb5_mcc_data *)cache->data;
     krb5_mcc_link *l;
 
-    k5_cc_mutex_lock(context, &data->lock);
+    mcc_write_lock(context, data);
 
     for (l = data->link; l != NULL; l = l->next) {
         if (l->creds != NULL &&
@@ -615,7 +871,7 @@ krb5_mcc_remove_cred(krb5_context context, krb5_ccache cache, krb5_flags flags,
         }
     }
 
-    k5_cc_mutex_unlock(context, &data->lock);
+    mcc_write_unlock(context, data);
     return 0;
 }
 
@@ -665,13 +921,22 @@ krb5_mcc_store(krb5_context ctx, krb5_ccache id, krb5_creds *creds)
     new_node = malloc(sizeof(krb5_mcc_link));
     if (new_node == NULL)
         return ENOMEM;
+    new_node->index_next = NULL;
     err = krb5_copy_creds(ctx, creds, &new_node->creds);
     if (err)
         goto cleanup;
-    k5_cc_mutex_lock(ctx, &mptr->lock);
+    mcc_write_lock(ctx, mptr);
+    if (new_node->creds->server != NULL) {
+        err = index_add(ctx, mptr, new_node);
+        if (err) {
+            mcc_write_unlock(ctx, mptr);
+            krb5_free_creds(ctx, new_node->creds);
+            goto cleanup;
+        }
+    }
     new_node->next = mptr->link;
     mptr->link = new_node;
-    k5_cc_mutex_unlock(ctx, &mptr->lock);
+    mcc_write_unlock(ctx, mptr);
     return 0;
 cleanup:
     free(new_node);
@@ -744,7 +1009,7 @@ krb5_mcc_lock(krb5_context context, krb5_ccache id)
 {
     krb5_mcc_data *data = (krb5_mcc_data *) id->data;
 
-    k5_cc_mutex_lock(context, &data->lock);
+    mcc_write_lock(context, data);
     return 0;
 }
 
@@ -753,7 +1018,7 @@ krb5_mcc_unlock(krb5_context context, krb5_ccache id)
 {
     krb5_mcc_data *data = (krb5_mcc_data *) id->data;
 
-    k5_cc_mutex_unlock(context, &data->lock);
+    mcc_write_unlock(context, data);
     return 0;
 }
 
@@ -0,0 +1,157 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/ccache/t_mccperf.c - Measure MEMORY ccache retrieval speed */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program fills MEMORY caches with service tickets for distinct server
+ * principals, checks that krb5_cc_retrieve_cred() finds each of them (and
+ * does not find a principal which was never stored), then measures the rate
+ * of retrievals against caches of increasing size.  Usage:
+ *
+ *     ./t_mccperf count
+ */
+
+#include "k5-int.h"
+#include <sys/time.h>
+
+static const int sizes[] = { 10, 100, 1000, 10000 };
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static krb5_principal
+make_server(krb5_context ctx, int n)
+{
+    krb5_principal princ;
+    char host[32];
+
+    snprintf(host, sizeof(host), "host%d.example.com", n);
+    assert(krb5_build_principal(ctx, &princ, 11, "EXAMPLE.COM", "HTTP", host,
+                                (char *)NULL) == 0);
+    return princ;
+}
+
+/* Store size credentials for distinct servers into a new MEMORY cache. */
+static krb5_ccache
+fill_cache(krb5_context ctx, krb5_principal client, int size)
+{
+    krb5_ccache cc;
+    krb5_creds creds;
+    krb5_octet keybytes[16] = { 0 };
+    int i;
+
+    assert(krb5_cc_new_unique(ctx, "MEMORY", NULL, &cc) == 0);
+    assert(krb5_cc_initialize(ctx, cc, client) == 0);
+    for (i = 0; i < size; i++) {
+        memset(&creds, 0, sizeof(creds));
+        creds.client = client;
+        creds.server = make_server(ctx, i);
+        creds.keyblock.magic = KV5M_KEYBLOCK;
+        creds.keyblock.enctype = ENCTYPE_AES128_CTS_HMAC_SHA1_96;
+        creds.keyblock.contents = keybytes;
+        creds.keyblock.length = sizeof(keybytes);
+        creds.times.endtime = 0x7FFFFFFF;
+        creds.ticket = string2data("ticket");
+        assert(krb5_cc_store_cred(ctx, cc, &creds) == 0);
+        krb5_free_principal(ctx, creds.server);
+    }
+    return cc;
+}
+
+static void
+retrieve(krb5_context ctx, krb5_ccache cc, krb5_principal client, int n,
+         krb5_error_code expected)
+{
+    krb5_creds mcreds, creds;
+    krb5_error_code ret;
+
+    memset(&mcreds, 0, sizeof(mcreds));
+    mcreds.client = client;
+    mcreds.server = make_server(ctx, n);
+    ret = krb5_cc_retrieve_cred(ctx, cc, 0, &mcreds, &creds);
+    assert(ret == expected);
+    if (ret == 0) {
+        assert(krb5_principal_compare(ctx, creds.server, mcreds.server));
+        assert(data_eq_string(creds.ticket, "ticket"));
+        krb5_free_cred_contents(ctx, &creds);
+    }
+    krb5_free_principal(ctx, mcreds.server);
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    krb5_ccache cc;
+    krb5_principal client;
+    struct timeval start;
+    double secs;
+    size_t s;
+    int count, size, i;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: t_mccperf count\n");
+        exit(1);
+    }
+    count = atoi(argv[1]);
+
+    assert(krb5_init_context(&ctx) == 0);
+    assert(krb5_parse_name(ctx, "user@EXAMPLE.COM", &client) == 0);
+
+    for (s = 0; s < sizeof(sizes) / sizeof(*sizes); s++) {
+        size = sizes[s];
+        cc = fill_cache(ctx, client, size);
+        for (i = 0; i < size; i++)
+            retrieve(ctx, cc, client, i, 0);
+        retrieve(ctx, cc, client, size, KRB5_CC_NOTFOUND);
+
+        gettimeofday(&start, NULL);
+        for (i = 0; i < count; i++)
+            retrieve(ctx, cc, client, i % size, 0);
+        secs = elapsed(&start);
+        if (secs <= 0)
+            secs = 1e-6;
+        printf("%d retrievals from %d creds in %.3f s (%.0f/s)\n", count,
+               size, secs, count / secs);
+        assert(krb5_cc_destroy(ctx, cc) == 0);
+    }
+
+    krb5_free_principal(ctx, client);
+    krb5_free_context(ctx);
+    return 0;
+}
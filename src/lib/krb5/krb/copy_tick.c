@@ -26,9 +26,9 @@
 
 #include "k5-int.h"
 
-static krb5_error_code
-copy_enc_tkt_part(krb5_context context, const krb5_enc_tkt_part *partfrom,
-                  krb5_enc_tkt_part **partto)
+krb5_error_code
+k5_copy_enc_tkt_part(krb5_context context, const krb5_enc_tkt_part *partfrom,
+                     krb5_enc_tkt_part **partto)
 {
     krb5_error_code retval;
     krb5_enc_tkt_part *tempto;
@@ -110,7 +110,8 @@ krb5_copy_ticket(krb5_context context, const krb5_ticket *from, krb5_ticket **pt
     }
     tempto->enc_part.ciphertext = *scratch;
     free(scratch);
-    retval = copy_enc_tkt_part(context, from->enc_part2, &tempto->enc_part2);
+    retval = k5_copy_enc_tkt_part(context, from->enc_part2,
+                                  &tempto->enc_part2);
     if (retval) {
         free(tempto->enc_part.ciphertext.data);
         krb5_free_principal(context, tempto->server);
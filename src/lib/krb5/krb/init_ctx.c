@@ -55,6 +55,7 @@
 #include <ctype.h>
 #include "brand.c"
 #include "../krb5_libinit.h"
+#include "prof_int.h"    /* for profile_copy() and profile_get_data_serial() */
 
 static krb5_enctype default_enctype_list[] = {
     ENCTYPE_AES256_CTS_HMAC_SHA1_96, ENCTYPE_AES128_CTS_HMAC_SHA1_96,
@@ -120,6 +121,243 @@ get_tristate(krb5_context ctx, const char *name, const char *third_option,
     return 0;
 }
 
+/*
+ * The [libdefaults] values read during context creation.  Processes which
+ * create many contexts from the same configuration reuse these through a
+ * small process-wide cache of snapshots.  Each snapshot holds a copy of the
+ * profile it was read from, which keeps the shared parsed file data alive, and
+ * the profile's data serial at the time.  A new context can use a snapshot if
+ * its profile reads the same file data and none of the files have been
+ * reloaded since, which profile_open_file() checks for each new profile.
+ */
+struct config_snapshot {
+    profile_t profile;
+    unsigned long serial;
+    int allow_weak_crypto;
+    int ignore_acceptor_hostname;
+    int enforce_ok_as_delegate;
+    int dns_canonicalize_hostname;
+    int clockskew;
+    int kdc_default_options;
+    int kdc_timesync;
+    int ccache_type;
+    char *plugin_dir;
+    char *err_fmt;
+};
+
+#define CONFIG_SNAPSHOT_SLOTS 4
+
+static k5_mutex_t snapshot_lock = K5_MUTEX_PARTIAL_INITIALIZER;
+static struct config_snapshot *snapshots[CONFIG_SNAPSHOT_SLOTS];
+static unsigned int snapshot_next;
+
+static void
+free_config_values(struct config_snapshot *snap)
+{
+    profile_release_string(snap->plugin_dir);
+    profile_release_string(snap->err_fmt);
+    snap->plugin_dir = snap->err_fmt = NULL;
+}
+
+static void
+free_config_snapshot(struct config_snapshot *snap)
+{
+    if (snap == NULL)
+        return;
+    free_config_values(snap);
+    profile_release(snap->profile);
+    free(snap);
+}
+
+/* Copy the values (but not the profile or serial) of src into dst. */
+static krb5_error_code
+copy_config_values(const struct config_snapshot *src,
+                   struct config_snapshot *dst)
+{
+    *dst = *src;
+    dst->profile = NULL;
+    dst->plugin_dir = dst->err_fmt = NULL;
+    if (src->plugin_dir != NULL) {
+        dst->plugin_dir = strdup(src->plugin_dir);
+        if (dst->plugin_dir == NULL)
+            return ENOMEM;
+    }
+    if (src->err_fmt != NULL) {
+        dst->err_fmt = strdup(src->err_fmt);
+        if (dst->err_fmt == NULL) {
+            free(dst->plugin_dir);
+            dst->plugin_dir = NULL;
+            return ENOMEM;
+        }
+    }
+    return 0;
+}
+
+krb5_error_code
+k5_config_snapshot_init(void)
+{
+    return k5_mutex_finish_init(&snapshot_lock);
+}
+
+/* The profile library may already have been finalized, so the snapshots are
+ * not released here.  Like the profile library's shared trees, they remain
+ * reachable until the library is unloaded. */
+void
+k5_config_snapshot_fini(void)
+{
+    k5_mutex_destroy(&snapshot_lock);
+}
+
+/* If a current snapshot exists for profile, copy its values into vals and
+ * return true. */
+static krb5_boolean
+find_config_snapshot(profile_t profile, struct config_snapshot *vals)
+{
+    struct config_snapshot *snap;
+    unsigned long serial = profile_get_data_serial(profile);
+    krb5_boolean found = FALSE;
+    int i;
+
+    k5_mutex_lock(&snapshot_lock);
+    for (i = 0; i < CONFIG_SNAPSHOT_SLOTS; i++) {
+        snap = snapshots[i];
+        if (snap != NULL && snap->serial == serial &&
+            profile_same_files(snap->profile, profile)) {
+            found = (copy_config_values(snap, vals) == 0);
+            break;
+        }
+    }
+    k5_mutex_unlock(&snapshot_lock);
+    return found;
+}
+
+/* Record vals, which were read from profile when its data serial was serial,
+ * as a snapshot.  Failures are not reported since the cache is optional. */
+static void
+save_config_snapshot(profile_t profile, unsigned long serial,
+                     const struct config_snapshot *vals)
+{
+    struct config_snapshot *snap, *old;
+
+    snap = calloc(1, sizeof(*snap));
+    if (snap == NULL)
+        return;
+    if (copy_config_values(vals, snap) != 0 ||
+        profile_copy(profile, &snap->profile) != 0 ||
+        !profile_same_files(snap->profile, profile)) {
+        free_config_snapshot(snap);
+        return;
+    }
+    snap->serial = serial;
+
+    k5_mutex_lock(&snapshot_lock);
+    old = snapshots[snapshot_next];
+    snapshots[snapshot_next] = snap;
+    snapshot_next = (snapshot_next + 1) % CONFIG_SNAPSHOT_SLOTS;
+    k5_mutex_unlock(&snapshot_lock);
+    free_config_snapshot(old);
+}
+
+/* Read the [libdefaults] values used during context creation from ctx's
+ * profile into vals.  Set *cacheable to false if any errors were traced
+ * rather than returned. */
+static krb5_error_code
+read_config_values(krb5_context ctx, struct config_snapshot *vals,
+                   krb5_boolean *cacheable)
+{
+    krb5_error_code retval;
+
+    memset(vals, 0, sizeof(*vals));
+    *cacheable = TRUE;
+
+    retval = get_boolean(ctx, KRB5_CONF_ALLOW_WEAK_CRYPTO, 0,
+                         &vals->allow_weak_crypto);
+    if (retval)
+        return retval;
+
+    retval = get_boolean(ctx, KRB5_CONF_IGNORE_ACCEPTOR_HOSTNAME, 0,
+                         &vals->ignore_acceptor_hostname);
+    if (retval)
+        return retval;
+
+    retval = get_boolean(ctx, KRB5_CONF_ENFORCE_OK_AS_DELEGATE, 0,
+                         &vals->enforce_ok_as_delegate);
+    if (retval)
+        return retval;
+
+    retval = get_tristate(ctx, KRB5_CONF_DNS_CANONICALIZE_HOSTNAME, "fallback",
+                          CANONHOST_FALLBACK, CANONHOST_FALLBACK,
+                          &vals->dns_canonicalize_hostname);
+    if (retval)
+        return retval;
+
+    if (get_integer(ctx, KRB5_CONF_CLOCKSKEW, DEFAULT_CLOCKSKEW,
+                    &vals->clockskew) != 0)
+        *cacheable = FALSE;
+
+    if (get_integer(ctx, KRB5_CONF_KDC_DEFAULT_OPTIONS, KDC_OPT_RENEWABLE_OK,
+                    &vals->kdc_default_options) != 0)
+        *cacheable = FALSE;
+#define DEFAULT_KDC_TIMESYNC 1
+    if (get_integer(ctx, KRB5_CONF_KDC_TIMESYNC, DEFAULT_KDC_TIMESYNC,
+                    &vals->kdc_timesync) != 0)
+        *cacheable = FALSE;
+
+    retval = profile_get_string(ctx->profile, KRB5_CONF_LIBDEFAULTS,
+                                KRB5_CONF_PLUGIN_BASE_DIR, 0,
+                                DEFAULT_PLUGIN_BASE_DIR, &vals->plugin_dir);
+    if (retval) {
+        TRACE_PROFILE_ERR(ctx, KRB5_CONF_PLUGIN_BASE_DIR,
+                          KRB5_CONF_LIBDEFAULTS, retval);
+        return retval;
+    }
+
+    /*
+     * We use a default file credentials cache of 3.  See
+     * lib/krb5/krb/ccache/file/fcc.h for a description of the
+     * credentials cache types.
+     *
+     * Note: DCE 1.0.3a only supports a cache type of 1
+     *      DCE 1.1 supports a cache type of 2.
+     */
+#define DEFAULT_CCACHE_TYPE 4
+    if (get_integer(ctx, KRB5_CONF_CCACHE_TYPE, DEFAULT_CCACHE_TYPE,
+                    &vals->ccache_type) != 0)
+        *cacheable = FALSE;
+
+    /* It's OK if this fails */
+    if (profile_get_string(ctx->profile, KRB5_CONF_LIBDEFAULTS,
+                           KRB5_CONF_ERR_FMT, NULL, NULL, &vals->err_fmt) != 0)
+        *cacheable = FALSE;
+
+    return 0;
+}
+
+/* Get the [libdefaults] values for ctx's profile into vals, from a snapshot
+ * if possible. */
+static krb5_error_code
+get_config_values(krb5_context ctx, struct config_snapshot *vals)
+{
+    krb5_error_code retval;
+    krb5_boolean cacheable;
+    unsigned long serial;
+
+    if (find_config_snapshot(ctx->profile, vals))
+        return 0;
+
+    /* Take the serial first, so that a reload while we read the values only
+     * makes the snapshot look stale. */
+    serial = profile_get_data_serial(ctx->profile);
+    retval = read_config_values(ctx, vals, &cacheable);
+    if (retval) {
+        free_config_values(vals);
+        return retval;
+    }
+    if (cacheable)
+        save_config_snapshot(ctx->profile, serial, vals);
+    return 0;
+}
+
 krb5_error_code KRB5_CALLCONV
 krb5_init_context(krb5_context *context)
 {
@@ -163,8 +401,7 @@ krb5_init_context_profile(profile_t profile, krb5_flags flags,
         long pid;
     } seed_data;
     krb5_data seed;
-    int tmp;
-    char *plugin_dir = NULL;
+    struct config_snapshot vals = { 0 };
 
     /* Verify some assumptions.  If the assumptions hold and the
        compiler is optimizing, this should result in no code being
@@ -222,26 +459,13 @@ krb5_init_context_profile(profile_t profile, krb5_flags flags,
         k5_init_trace(ctx);
 #endif
 
-    retval = get_boolean(ctx, KRB5_CONF_ALLOW_WEAK_CRYPTO, 0, &tmp);
-    if (retval)
-        goto cleanup;
-    ctx->allow_weak_crypto = tmp;
-
-    retval = get_boolean(ctx, KRB5_CONF_IGNORE_ACCEPTOR_HOSTNAME, 0, &tmp);
-    if (retval)
-        goto cleanup;
-    ctx->ignore_acceptor_hostname = tmp;
-
-    retval = get_boolean(ctx, KRB5_CONF_ENFORCE_OK_AS_DELEGATE, 0, &tmp);
-    if (retval)
-        goto cleanup;
-    ctx->enforce_ok_as_delegate = tmp;
-
-    retval = get_tristate(ctx, KRB5_CONF_DNS_CANONICALIZE_HOSTNAME, "fallback",
-                          CANONHOST_FALLBACK, CANONHOST_FALLBACK, &tmp);
+    retval = get_config_values(ctx, &vals);
     if (retval)
         goto cleanup;
-    ctx->dns_canonicalize_hostname = tmp;
+    ctx->allow_weak_crypto = vals.allow_weak_crypto;
+    ctx->ignore_acceptor_hostname = vals.ignore_acceptor_hostname;
+    ctx->enforce_ok_as_delegate = vals.enforce_ok_as_delegate;
+    ctx->dns_canonicalize_hostname = vals.dns_canonicalize_hostname;
 
     /* initialize the prng (not well, but passable) */
     if ((retval = krb5_c_random_os_entropy( ctx, 0, NULL)) !=0)
@@ -255,50 +479,32 @@ krb5_init_context_profile(profile_t profile, krb5_flags flags,
         goto cleanup;
 
     ctx->default_realm = 0;
-    get_integer(ctx, KRB5_CONF_CLOCKSKEW, DEFAULT_CLOCKSKEW, &tmp);
-    ctx->clockskew = tmp;
-
-    get_integer(ctx, KRB5_CONF_KDC_DEFAULT_OPTIONS, KDC_OPT_RENEWABLE_OK,
-                &tmp);
-    ctx->kdc_default_options = tmp;
-#define DEFAULT_KDC_TIMESYNC 1
-    get_integer(ctx, KRB5_CONF_KDC_TIMESYNC, DEFAULT_KDC_TIMESYNC, &tmp);
-    ctx->library_options = tmp ? KRB5_LIBOPT_SYNC_KDCTIME : 0;
-
-    retval = profile_get_string(ctx->profile, KRB5_CONF_LIBDEFAULTS,
-                                KRB5_CONF_PLUGIN_BASE_DIR, 0,
-                                DEFAULT_PLUGIN_BASE_DIR, &plugin_dir);
-    if (!retval)
-        retval = k5_expand_path_tokens(ctx, plugin_dir, &ctx->plugin_base_dir);
+    ctx->clockskew = vals.clockskew;
+    ctx->kdc_default_options = vals.kdc_default_options;
+    ctx->library_options = vals.kdc_timesync ? KRB5_LIBOPT_SYNC_KDCTIME : 0;
+
+    /* Expand the plugin base directory for each context, since the result
+     * can depend on the process's identity. */
+    retval = k5_expand_path_tokens(ctx, vals.plugin_dir,
+                                   &ctx->plugin_base_dir);
     if (retval) {
         TRACE_PROFILE_ERR(ctx, KRB5_CONF_PLUGIN_BASE_DIR,
                           KRB5_CONF_LIBDEFAULTS, retval);
         goto cleanup;
     }
 
-    /*
-     * We use a default file credentials cache of 3.  See
-     * lib/krb5/krb/ccache/file/fcc.h for a description of the
-     * credentials cache types.
-     *
-     * Note: DCE 1.0.3a only supports a cache type of 1
-     *      DCE 1.1 supports a cache type of 2.
-     */
-#define DEFAULT_CCACHE_TYPE 4
-    get_integer(ctx, KRB5_CONF_CCACHE_TYPE, DEFAULT_CCACHE_TYPE, &tmp);
-    ctx->fcc_default_format = tmp + 0x0500;
+    ctx->fcc_default_format = vals.ccache_type + 0x0500;
     ctx->prompt_types = 0;
     ctx->use_conf_ktypes = 0;
     ctx->udp_pref_limit = -1;
 
-    /* It's OK if this fails */
-    (void)profile_get_string(ctx->profile, KRB5_CONF_LIBDEFAULTS,
-                             KRB5_CONF_ERR_FMT, NULL, NULL, &ctx->err_fmt);
+    ctx->err_fmt = vals.err_fmt;
+    vals.err_fmt = NULL;
     *context_out = ctx;
     ctx = NULL;
 
 cleanup:
-    profile_release_string(plugin_dir);
+    free_config_values(&vals);
     krb5_free_context(ctx);
     return retval;
 }
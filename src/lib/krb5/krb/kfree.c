@@ -91,6 +91,14 @@ krb5_free_ap_req(krb5_context context, krb5_ap_req *val)
 {
     if (val == NULL)
         return;
+    if (val->magic == K5_ASN1_ARENA_MAGIC) {
+        /* Only a decrypted ticket part can have been added to the arena
+         * structure. */
+        if (val->ticket != NULL)
+            krb5_free_enc_tkt_part(context, val->ticket->enc_part2);
+        k5_asn1_free_arena(val);
+        return;
+    }
     krb5_free_ticket(context, val->ticket);
     free(val->authenticator.ciphertext.data);
     free(val);
@@ -328,8 +336,19 @@ krb5_free_kdc_rep(krb5_context context, krb5_kdc_rep *val)
 void KRB5_CALLCONV
 krb5_free_kdc_req(krb5_context context, krb5_kdc_req *val)
 {
+    krb5_ticket **tkt;
+
     if (val == NULL)
         return;
+    if (val->magic == K5_ASN1_ARENA_MAGIC) {
+        /* unenc_authdata and decrypted second ticket parts are not part of
+         * the encoding, so they are not in the arena. */
+        krb5_free_authdata(context, val->unenc_authdata);
+        for (tkt = val->second_ticket; tkt != NULL && *tkt != NULL; tkt++)
+            krb5_free_enc_tkt_part(context, (*tkt)->enc_part2);
+        k5_asn1_free_arena(val);
+        return;
+    }
     krb5_free_pa_data(context, val->padata);
     krb5_free_principal(context, val->client);
     krb5_free_principal(context, val->server);
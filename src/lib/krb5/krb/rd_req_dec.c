@@ -475,7 +475,8 @@ static krb5_error_code
 rd_req_decoded_opt(krb5_context context, krb5_auth_context *auth_context,
                    const krb5_ap_req *req, krb5_const_principal server,
                    krb5_keytab keytab, krb5_flags *ap_req_options,
-                   krb5_ticket **ticket, int check_valid_flag)
+                   krb5_ticket **ticket, int check_valid_flag,
+                   int ticket_decrypted)
 {
     krb5_error_code       retval = 0;
     krb5_enctype         *desired_etypes = NULL;
@@ -487,13 +488,18 @@ rd_req_decoded_opt(krb5_context context, krb5_auth_context *auth_context,
 
     decrypt_key.enctype = ENCTYPE_NULL;
     decrypt_key.contents = NULL;
-    req->ticket->enc_part2 = NULL;
+    if (!ticket_decrypted)
+        req->ticket->enc_part2 = NULL;
 
     /* if (req->ap_options & AP_OPTS_USE_SESSION_KEY)
        do we need special processing here ?     */
 
     /* decrypt the ticket */
-    if ((*auth_context)->key) { /* User to User authentication */
+    if (ticket_decrypted) {
+        /* The caller supplied the decrypted ticket part. */
+        if (server == NULL)
+            server = req->ticket->server;
+    } else if ((*auth_context)->key) { /* User to User authentication */
         if ((retval = krb5_decrypt_tkt_part(context,
                                             &(*auth_context)->key->keyblock,
                                             req->ticket)))
@@ -798,7 +804,8 @@ krb5_rd_req_decoded(krb5_context context, krb5_auth_context *auth_context,
     retval = rd_req_decoded_opt(context, auth_context,
                                 req, server, keytab,
                                 ap_req_options, ticket,
-                                1); /* check_valid_flag */
+                                1, /* check_valid_flag */
+                                0);
     return retval;
 }
 
@@ -813,10 +820,21 @@ krb5_rd_req_decoded_anyflag(krb5_context context,
     retval = rd_req_decoded_opt(context, auth_context,
                                 req, server, keytab,
                                 ap_req_options, ticket,
-                                0); /* don't check_valid_flag */
+                                0, /* don't check_valid_flag */
+                                0);
     return retval;
 }
 
+krb5_error_code
+k5_rd_req_decoded_decrypted(krb5_context context,
+                            krb5_auth_context *auth_context,
+                            const krb5_ap_req *req,
+                            krb5_const_principal server)
+{
+    return rd_req_decoded_opt(context, auth_context, req, server, NULL, NULL,
+                              NULL, 0, 1);
+}
+
 #ifndef LEAN_CLIENT
 static krb5_error_code
 decrypt_authenticator(krb5_context context, const krb5_ap_req *request,
@@ -0,0 +1,121 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/krb/t_ctxperf.c - Measure krb5_init_context() throughput */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program checks that contexts see changes to the configuration file
+ * even though context creation reuses [libdefaults] values from earlier
+ * contexts, then measures the rate at which contexts can be created and
+ * freed.  Usage:
+ *
+ *     ./t_ctxperf count
+ */
+
+#include "k5-int.h"
+#include <sys/time.h>
+
+#define CONF_FILE "t_ctxperf.conf"
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+/* Write a configuration file with the given clockskew value, giving it a
+ * modification time distinct from any earlier version. */
+static void
+write_conf(int clockskew, time_t mtime)
+{
+    FILE *fp;
+    struct timeval times[2];
+
+    fp = fopen(CONF_FILE, "w");
+    assert(fp != NULL);
+    fprintf(fp, "[libdefaults]\n\tclockskew = %d\n\terr_fmt = %%M\n",
+            clockskew);
+    fclose(fp);
+    times[0].tv_sec = times[1].tv_sec = mtime;
+    times[0].tv_usec = times[1].tv_usec = 0;
+    assert(utimes(CONF_FILE, times) == 0);
+}
+
+static void
+check_clockskew(int expected)
+{
+    krb5_context ctx;
+
+    assert(krb5_init_context(&ctx) == 0);
+    assert(ctx->clockskew == expected);
+    assert(ctx->err_fmt != NULL && strcmp(ctx->err_fmt, "%M") == 0);
+    krb5_free_context(ctx);
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    struct timeval start;
+    double secs;
+    time_t now = time(NULL);
+    int count, i;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: t_ctxperf count\n");
+        exit(1);
+    }
+    count = atoi(argv[1]);
+
+    setenv("KRB5_CONFIG", CONF_FILE, 1);
+    write_conf(100, now - 10);
+    check_clockskew(100);
+    check_clockskew(100);
+    write_conf(200, now - 5);
+    check_clockskew(200);
+    check_clockskew(200);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < count; i++) {
+        assert(krb5_init_context(&ctx) == 0);
+        krb5_free_context(ctx);
+    }
+    secs = elapsed(&start);
+    if (secs <= 0)
+        secs = 1e-6;
+    printf("%d contexts in %.3f s (%.0f/s)\n", count, secs, count / secs);
+
+    unlink(CONF_FILE);
+    return 0;
+}
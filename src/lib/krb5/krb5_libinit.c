@@ -10,6 +10,7 @@
 #include "k5-platform.h"
 #include "cc-int.h"
 #include "kt-int.h"
+#include "rc-int.h"
 #include "os-proto.h"
 
 /*
@@ -48,6 +49,15 @@ int krb5int_lib_init(void)
     if (err)
         return err;
     err = k5_mutex_finish_init(&krb5int_us_time_mutex);
+    if (err)
+        return err;
+    err = k5_config_snapshot_init();
+    if (err)
+        return err;
+    err = k5_rc_mem_initialize();
+    if (err)
+        return err;
+    err = k5_trace_initialize();
     if (err)
         return err;
 
@@ -77,7 +87,11 @@ void krb5int_lib_fini(void)
     printf("krb5int_lib_fini\n");
 #endif
 
+    /* Flush binary trace buffers first; flushing reads the time of day. */
+    k5_trace_finalize();
     k5_mutex_destroy(&krb5int_us_time_mutex);
+    k5_config_snapshot_fini();
+    k5_rc_mem_finalize();
 
     krb5int_cc_finalize();
 #ifndef LEAN_CLIENT
@@ -7,4 +7,8 @@
 krb5_error_code krb5int_initialize_library (void);
 void krb5int_cleanup_library (void);
 
+/* Set up and release the cache of configuration snapshots in init_ctx.c. */
+krb5_error_code k5_config_snapshot_init(void);
+void k5_config_snapshot_fini(void);
+
 #endif /* KRB5_LIBINIT_H */
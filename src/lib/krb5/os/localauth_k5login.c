@@ -44,6 +44,189 @@
 #define FILE_OWNER_OK(UID)  ((UID) == 0)
 #endif
 
+/* Keep the contents of at most this many k5login files per context. */
+#define MAX_CACHED_K5LOGINS 64
+
+/* The lines of a k5login file, with the stat fields used to check whether the
+ * file has changed since it was read. */
+struct k5login_file {
+    struct k5login_file *next;
+    char *filename;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    long mtime_nsec;
+    time_t ctime;
+    char **lines;
+    size_t nlines;
+};
+
+/* Module data: recently read k5login files, most recently used first. */
+struct k5login_cache {
+    struct k5login_file *files;
+    size_t count;
+};
+
+static long
+mtime_nsec(const struct stat *st)
+{
+#if defined HAVE_STRUCT_STAT_ST_MTIMENSEC
+    return st->st_mtimensec;
+#elif defined HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC
+    return st->st_mtimespec.tv_nsec;
+#elif defined HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    return st->st_mtim.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+static void
+free_k5login_file(struct k5login_file *file)
+{
+    size_t i;
+
+    if (file == NULL)
+        return;
+    for (i = 0; i < file->nlines; i++)
+        free(file->lines[i]);
+    free(file->lines);
+    free(file->filename);
+    free(file);
+}
+
+/* Return true if st shows that file has not changed since it was read. */
+static krb5_boolean
+file_unchanged(const struct k5login_file *file, const struct stat *st)
+{
+    return file->dev == st->st_dev && file->ino == st->st_ino &&
+        file->size == st->st_size && file->mtime == st->st_mtime &&
+        file->mtime_nsec == mtime_nsec(st) && file->ctime == st->st_ctime;
+}
+
+/*
+ * Read the k5login file filename, checking that it is owned by uid or by
+ * root.  Each line is kept as it will be compared: without its newline, and
+ * truncated to fit in a BUFSIZ buffer.
+ */
+static krb5_error_code
+read_k5login_file(const char *filename, uid_t uid,
+                  struct k5login_file **file_out)
+{
+    krb5_error_code ret;
+    struct k5login_file *file = NULL;
+    struct stat sbuf;
+    char *newline, **newlines, linebuf[BUFSIZ];
+    int gobble;
+    FILE *fp;
+
+    *file_out = NULL;
+    fp = fopen(filename, "r");
+    if (fp == NULL)
+        return errno;
+    set_cloexec_file(fp);
+
+    /* For security reasons, the .k5login file must be owned either by
+     * the user or by root. */
+    if (fstat(fileno(fp), &sbuf)) {
+        ret = errno;
+        goto cleanup;
+    }
+    if (sbuf.st_uid != uid && !FILE_OWNER_OK(sbuf.st_uid)) {
+        ret = EPERM;
+        goto cleanup;
+    }
+
+    file = k5alloc(sizeof(*file), &ret);
+    if (file == NULL)
+        goto cleanup;
+    file->filename = strdup(filename);
+    if (file->filename == NULL) {
+        ret = ENOMEM;
+        goto cleanup;
+    }
+    file->dev = sbuf.st_dev;
+    file->ino = sbuf.st_ino;
+    file->size = sbuf.st_size;
+    file->mtime = sbuf.st_mtime;
+    file->mtime_nsec = mtime_nsec(&sbuf);
+    file->ctime = sbuf.st_ctime;
+
+    while (fgets(linebuf, sizeof(linebuf), fp) != NULL) {
+        newline = strrchr(linebuf, '\n');
+        if (newline != NULL)
+            *newline = '\0';
+        newlines = realloc(file->lines,
+                           (file->nlines + 1) * sizeof(*file->lines));
+        if (newlines == NULL) {
+            ret = ENOMEM;
+            goto cleanup;
+        }
+        file->lines = newlines;
+        file->lines[file->nlines] = strdup(linebuf);
+        if (file->lines[file->nlines] == NULL) {
+            ret = ENOMEM;
+            goto cleanup;
+        }
+        file->nlines++;
+        /* Clean up the rest of the line if necessary. */
+        if (newline == NULL)
+            while ((gobble = getc(fp)) != EOF && gobble != '\n');
+    }
+
+    *file_out = file;
+    file = NULL;
+    ret = 0;
+
+cleanup:
+    free_k5login_file(file);
+    fclose(fp);
+    return ret;
+}
+
+/* Return the cached contents of filename if st shows they are still current,
+ * moving them to the front of cache.  Discard them if they are stale. */
+static struct k5login_file *
+cache_lookup(struct k5login_cache *cache, const char *filename,
+             const struct stat *st)
+{
+    struct k5login_file *file, **fp;
+
+    for (fp = &cache->files; *fp != NULL; fp = &(*fp)->next) {
+        file = *fp;
+        if (strcmp(file->filename, filename) != 0)
+            continue;
+        *fp = file->next;
+        if (!file_unchanged(file, st)) {
+            free_k5login_file(file);
+            cache->count--;
+            return NULL;
+        }
+        file->next = cache->files;
+        cache->files = file;
+        return file;
+    }
+    return NULL;
+}
+
+/* Add file to the front of cache, discarding the least recently used entry if
+ * the cache is full. */
+static void
+cache_add(struct k5login_cache *cache, struct k5login_file *file)
+{
+    struct k5login_file **fp;
+
+    file->next = cache->files;
+    cache->files = file;
+    if (++cache->count <= MAX_CACHED_K5LOGINS)
+        return;
+    for (fp = &cache->files; (*fp)->next != NULL; fp = &(*fp)->next);
+    free_k5login_file(*fp);
+    *fp = NULL;
+    cache->count--;
+}
+
 /*
  * Find the k5login filename for luser, either in the user's homedir or in a
  * configured directory under the username.
@@ -77,19 +260,24 @@ get_k5login_filename(krb5_context context, const char *lname,
     return 0;
 }
 
-/* Determine whether aname is authorized to log in as lname according to the
- * user's k5login file. */
+/*
+ * Determine whether aname is authorized to log in as lname according to the
+ * user's k5login file.  The file contents are cached in data and reread when
+ * stat() shows that the file has changed.
+ */
 static krb5_error_code
 userok_k5login(krb5_context context, krb5_localauth_moddata data,
                krb5_const_principal aname, const char *lname)
 {
     krb5_error_code ret;
-    int authoritative = TRUE, gobble;
+    struct k5login_cache *cache = (struct k5login_cache *)data;
+    struct k5login_file *file = NULL;
+    int authoritative = TRUE;
     char *filename = NULL, *princname = NULL;
-    char *newline, linebuf[BUFSIZ], pwbuf[BUFSIZ];
+    char pwbuf[BUFSIZ];
     struct stat sbuf;
     struct passwd pwx, *pwd;
-    FILE *fp = NULL;
+    size_t i;
 
     ret = profile_get_boolean(context->profile, KRB5_CONF_LIBDEFAULTS,
                               KRB5_CONF_K5LOGIN_AUTHORITATIVE, NULL, TRUE,
@@ -107,7 +295,7 @@ userok_k5login(krb5_context context, krb5_localauth_moddata data,
     if (ret)
         goto cleanup;
 
-    if (access(filename, F_OK) != 0) {
+    if (stat(filename, &sbuf) != 0) {
         ret = KRB5_PLUGIN_NO_HANDLE;
         goto cleanup;
     }
@@ -116,50 +304,69 @@ userok_k5login(krb5_context context, krb5_localauth_moddata data,
     if (ret)
         goto cleanup;
 
-    fp = fopen(filename, "r");
-    if (fp == NULL) {
-        ret = errno;
-        goto cleanup;
-    }
-    set_cloexec_file(fp);
-
-    /* For security reasons, the .k5login file must be owned either by
-     * the user or by root. */
-    if (fstat(fileno(fp), &sbuf)) {
-        ret = errno;
-        goto cleanup;
-    }
-    if (sbuf.st_uid != pwd->pw_uid && !FILE_OWNER_OK(sbuf.st_uid)) {
-        ret = EPERM;
-        goto cleanup;
+    if (cache != NULL)
+        file = cache_lookup(cache, filename, &sbuf);
+    if (file != NULL) {
+        /* The cached file may have been read on behalf of another user. */
+        if (sbuf.st_uid != pwd->pw_uid && !FILE_OWNER_OK(sbuf.st_uid)) {
+            ret = EPERM;
+            goto cleanup;
+        }
+    } else {
+        ret = read_k5login_file(filename, pwd->pw_uid, &file);
+        if (ret)
+            goto cleanup;
+        if (cache != NULL)
+            cache_add(cache, file);
     }
 
     /* Check each line. */
-    while (fgets(linebuf, sizeof(linebuf), fp) != NULL) {
-        newline = strrchr(linebuf, '\n');
-        if (newline != NULL)
-            *newline = '\0';
-        if (strcmp(linebuf, princname) == 0) {
+    ret = EPERM;
+    for (i = 0; i < file->nlines; i++) {
+        if (strcmp(file->lines[i], princname) == 0) {
             ret = 0;
-            goto cleanup;
+            break;
         }
-        /* Clean up the rest of the line if necessary. */
-        if (newline == NULL)
-            while ((gobble = getc(fp)) != EOF && gobble != '\n');
     }
 
-    /* We didn't find it. */
-    ret = EPERM;
-
 cleanup:
+    if (cache == NULL)
+        free_k5login_file(file);
     free(princname);
     free(filename);
-    if (fp != NULL)
-        fclose(fp);
     /* If k5login files are non-authoritative, never reject. */
     return (!authoritative && ret) ? KRB5_PLUGIN_NO_HANDLE : ret;
 }
 
+static krb5_error_code
+k5login_init(krb5_context context, krb5_localauth_moddata *data_out)
+{
+    krb5_error_code ret;
+    struct k5login_cache *cache;
+
+    *data_out = NULL;
+    cache = k5alloc(sizeof(*cache), &ret);
+    if (cache == NULL)
+        return ret;
+    *data_out = (krb5_localauth_moddata)cache;
+    return 0;
+}
+
+static void
+k5login_fini(krb5_context context, krb5_localauth_moddata data)
+{
+    struct k5login_cache *cache = (struct k5login_cache *)data;
+    struct k5login_file *file, *next;
+
+    if (cache == NULL)
+        return;
+    for (file = cache->files; file != NULL; file = next) {
+        next = file->next;
+        free_k5login_file(file);
+    }
+    free(cache);
+}
+
 #else /* _WIN32 */
 
 static krb5_error_code
@@ -178,6 +385,10 @@ localauth_k5login_initvt(krb5_context context, int maj_ver, int min_ver,
     krb5_localauth_vtable vt = (krb5_localauth_vtable)vtable;
 
     vt->name = "k5login";
+#if !defined(_WIN32)
+    vt->init = k5login_init;
+    vt->fini = k5login_fini;
+#endif
     vt->userok = userok_k5login;
     return 0;
 }
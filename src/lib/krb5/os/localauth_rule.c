@@ -62,16 +62,67 @@
  * No substitutions are allowed within <text>.  A "g" indicates that the
  * substitution should be performed globally; otherwise it will be performed at
  * most once.
+ *
+ * The regular expressions of each rule are compiled on first use and kept in
+ * the module data until the profile is reloaded.
  */
 
 #include "k5-int.h"
+#include "k5-hashtab.h"
 #include "os-proto.h"
+#include "prof_int.h"           /* for profile_get_data_serial() */
 #include <krb5/localauth_plugin.h>
 #include <ctype.h>
 
 #ifdef HAVE_REGEX_H
 #include <regex.h>
 
+/* Flush the compiled rule cache if it grows beyond this many rules. */
+#define MAX_COMPILED_RULES 256
+
+/* A compiled s/regexp/text/ expression. */
+struct subst {
+    regex_t re;
+    char *repl;
+    krb5_boolean global;
+};
+
+/*
+ * A RULE value with its match and substitution expressions compiled.  The
+ * selection string is still computed from the rule text, as it depends on the
+ * principal.  Rules which do not parse cleanly are cached with usable set to
+ * false, and are interpreted as before so that their errors are unchanged.
+ */
+struct compiled_rule {
+    struct compiled_rule *next;
+    char *rule;
+    krb5_boolean usable;
+    size_t match_offset;        /* Offset of the part after the selstring */
+    krb5_boolean has_match;
+    regex_t match;
+    struct subst *substs;
+    size_t nsubsts;
+};
+
+/* Module data: compiled rules keyed by rule text, discarded whenever the
+ * profile is reloaded. */
+struct rule_cache {
+    struct k5_hashtab *table;
+    struct compiled_rule *rules;
+    size_t count;
+    unsigned long serial;
+};
+
+/* Return true if re matches all of str. */
+static krb5_boolean
+full_match(const regex_t *re, const char *str)
+{
+    regmatch_t m;
+
+    return regexec(re, str, 1, &m, 0) == 0 && m.rm_so == 0 &&
+        (size_t)m.rm_eo == strlen(str);
+}
+
 /* Process the match portion of a rule and update *contextp.  Return
  * KRB5_LNAME_NOTRANS if selstring doesn't match the regexp. */
 static krb5_error_code
@@ -81,7 +132,6 @@ aname_do_match(const char *selstring, const char **contextp)
     const char *startp, *endp;
     char *regstr;
     regex_t re;
-    regmatch_t m;
 
     /* If no regexp is present, leave *contextp alone and return success. */
     if (**contextp != '(')
@@ -97,38 +147,35 @@ aname_do_match(const char *selstring, const char **contextp)
         return ret;
 
     /* Perform the match. */
-    ret = (regcomp(&re, regstr, REG_EXTENDED) == 0 &&
-           regexec(&re, selstring, 1, &m, 0) == 0 &&
-           m.rm_so == 0 && (size_t)m.rm_eo == strlen(selstring)) ? 0 :
-        KRB5_LNAME_NOTRANS;
-    regfree(&re);
+    if (regcomp(&re, regstr, REG_EXTENDED) == 0) {
+        ret = full_match(&re, selstring) ? 0 : KRB5_LNAME_NOTRANS;
+        regfree(&re);
+    } else {
+        ret = KRB5_LNAME_NOTRANS;
+    }
     free(regstr);
     *contextp = endp + 1;
     return ret;
 }
 
-/* Replace regular expression matches of regstr with repl in instr, producing
- * *outstr.  If doall is true, replace all matches for regstr. */
+/* Replace matches of re with repl in instr, producing *outstr.  If doall is
+ * true, replace all matches for re. */
 static krb5_error_code
-do_replacement(const char *regstr, const char *repl, krb5_boolean doall,
+do_replacement(const regex_t *re, const char *repl, krb5_boolean doall,
                const char *instr, char **outstr)
 {
     struct k5buf buf;
-    regex_t re;
     regmatch_t m;
 
     *outstr = NULL;
-    if (regcomp(&re, regstr, REG_EXTENDED))
-        return KRB5_LNAME_NOTRANS;
     k5_buf_init_dynamic(&buf);
-    while (regexec(&re, instr, 1, &m, 0) == 0) {
+    while (regexec(re, instr, 1, &m, 0) == 0) {
         k5_buf_add_len(&buf, instr, m.rm_so);
         k5_buf_add(&buf, repl);
         instr += m.rm_eo;
         if (!doall)
             break;
     }
-    regfree(&re);
     k5_buf_add(&buf, instr);
     if (k5_buf_status(&buf) != 0)
         return ENOMEM;
@@ -148,6 +195,7 @@ aname_replacer(const char *string, const char **contextp, char **result)
     const char *cp, *ep, *tp;
     char *newstr, *rule = NULL, *repl = NULL, *current = NULL;
     krb5_boolean doglobal;
+    regex_t re;
 
     *result = NULL;
 
@@ -185,7 +233,12 @@ aname_replacer(const char *string, const char **contextp, char **result)
         if (doglobal)
             cp++;
 
-        ret = do_replacement(rule, repl, doglobal, current, &newstr);
+        if (regcomp(&re, rule, REG_EXTENDED)) {
+            ret = KRB5_LNAME_NOTRANS;
+            goto cleanup;
+        }
+        ret = do_replacement(&re, repl, doglobal, current, &newstr);
+        regfree(&re);
         if (ret)
             goto cleanup;
         free(current);
@@ -273,18 +326,15 @@ aname_get_selstring(krb5_context context, krb5_const_principal aname,
     return 0;
 }
 
+/* Apply rule to aname by parsing it as we go. */
 static krb5_error_code
-an2ln_rule(krb5_context context, krb5_localauth_moddata data, const char *type,
-           const char *rule, krb5_const_principal aname, char **lname_out)
+interpret_rule(krb5_context context, const char *rule,
+               krb5_const_principal aname, char **lname_out)
 {
     krb5_error_code ret;
     const char *current;
     char *selstring = NULL;
 
-    *lname_out = NULL;
-    if (rule == NULL)
-        return KRB5_CONFIG_BADFORMAT;
-
     /* Compute the selection string. */
     current = rule;
     ret = aname_get_selstring(context, aname, &current, &selstring);
@@ -306,6 +356,231 @@ cleanup:
     return ret;
 }
 
+static void
+free_compiled_rule(struct compiled_rule *cr)
+{
+    size_t i;
+
+    if (cr == NULL)
+        return;
+    if (cr->has_match)
+        regfree(&cr->match);
+    for (i = 0; i < cr->nsubsts; i++) {
+        regfree(&cr->substs[i].re);
+        free(cr->substs[i].repl);
+    }
+    free(cr->substs);
+    free(cr->rule);
+    free(cr);
+}
+
+/* Compile the match and substitution parts of cr->rule.  Leave cr->usable
+ * false if they do not parse or do not compile. */
+static krb5_error_code
+compile_rule(struct compiled_rule *cr)
+{
+    krb5_error_code ret;
+    const char *cp, *ep, *tp;
+    char *regstr;
+    struct subst *newsubsts, *sub;
+
+    /* aname_get_selstring() always stops at the first ']'. */
+    cp = cr->rule;
+    if (*cp == '[') {
+        cp = strchr(cp, ']');
+        if (cp == NULL)
+            return 0;
+        cp++;
+    }
+    cr->match_offset = cp - cr->rule;
+
+    if (*cp == '(') {
+        ep = strchr(cp + 1, ')');
+        if (ep == NULL)
+            return 0;
+        regstr = k5memdup0(cp + 1, ep - (cp + 1), &ret);
+        if (regstr == NULL)
+            return ret;
+        cr->has_match = (regcomp(&cr->match, regstr, REG_EXTENDED) == 0);
+        free(regstr);
+        if (!cr->has_match)
+            return 0;
+        cp = ep + 1;
+    }
+
+    while (*cp != '\0') {
+        while (isspace((unsigned char)*cp))
+            cp++;
+        if (!(cp[0] == 's' && cp[1] == '/' && (ep = strchr(cp + 2, '/')) &&
+              (tp = strchr(ep + 1, '/'))))
+            return 0;
+
+        newsubsts = realloc(cr->substs,
+                            (cr->nsubsts + 1) * sizeof(*cr->substs));
+        if (newsubsts == NULL)
+            return ENOMEM;
+        cr->substs = newsubsts;
+        sub = &cr->substs[cr->nsubsts];
+
+        regstr = k5memdup0(cp + 2, ep - (cp + 2), &ret);
+        if (regstr == NULL)
+            return ret;
+        sub->repl = k5memdup0(ep + 1, tp - (ep + 1), &ret);
+        if (sub->repl == NULL) {
+            free(regstr);
+            return ret;
+        }
+        if (regcomp(&sub->re, regstr, REG_EXTENDED) != 0) {
+            free(regstr);
+            free(sub->repl);
+            return 0;
+        }
+        free(regstr);
+        cr->nsubsts++;
+
+        cp = tp + 1;
+        sub->global = (*cp == 'g');
+        if (sub->global)
+            cp++;
+    }
+    cr->usable = TRUE;
+    return 0;
+}
+
+static void
+flush_rule_cache(struct rule_cache *cache)
+{
+    struct compiled_rule *cr, *next;
+
+    for (cr = cache->rules; cr != NULL; cr = next) {
+        next = cr->next;
+        k5_hashtab_remove(cache->table, cr->rule, strlen(cr->rule));
+        free_compiled_rule(cr);
+    }
+    cache->rules = NULL;
+    cache->count = 0;
+}
+
+/* Return the compiled form of rule, compiling it if it is not already in
+ * cache.  Return NULL if the rule must be interpreted. */
+static struct compiled_rule *
+get_compiled_rule(krb5_context context, struct rule_cache *cache,
+                  const char *rule)
+{
+    struct compiled_rule *cr;
+    unsigned long serial;
+
+    serial = profile_get_data_serial(context->profile);
+    if (serial != cache->serial) {
+        flush_rule_cache(cache);
+        cache->serial = serial;
+    }
+
+    cr = k5_hashtab_get(cache->table, rule, strlen(rule));
+    if (cr != NULL)
+        return cr->usable ? cr : NULL;
+
+    if (cache->count >= MAX_COMPILED_RULES)
+        flush_rule_cache(cache);
+    cr = calloc(1, sizeof(*cr));
+    if (cr == NULL)
+        return NULL;
+    cr->rule = strdup(rule);
+    if (cr->rule == NULL || compile_rule(cr) != 0 ||
+        k5_hashtab_add(cache->table, cr->rule, strlen(cr->rule), cr) != 0) {
+        free_compiled_rule(cr);
+        return NULL;
+    }
+    cr->next = cache->rules;
+    cache->rules = cr;
+    cache->count++;
+    return cr->usable ? cr : NULL;
+}
+
+static krb5_error_code
+an2ln_rule(krb5_context context, krb5_localauth_moddata data, const char *type,
+           const char *rule, krb5_const_principal aname, char **lname_out)
+{
+    krb5_error_code ret;
+    struct rule_cache *cache = (struct rule_cache *)data;
+    struct compiled_rule *cr = NULL;
+    const char *current;
+    char *selstring = NULL, *newstr;
+    size_t i;
+
+    *lname_out = NULL;
+    if (rule == NULL)
+        return KRB5_CONFIG_BADFORMAT;
+
+    if (cache != NULL)
+        cr = get_compiled_rule(context, cache, rule);
+    if (cr == NULL)
+        return interpret_rule(context, rule, aname, lname_out);
+
+    current = rule;
+    ret = aname_get_selstring(context, aname, &current, &selstring);
+    if (ret)
+        return ret;
+    if (current != rule + cr->match_offset) {
+        free(selstring);
+        return interpret_rule(context, rule, aname, lname_out);
+    }
+
+    if (cr->has_match && !full_match(&cr->match, selstring)) {
+        ret = KRB5_LNAME_NOTRANS;
+        goto cleanup;
+    }
+
+    for (i = 0; i < cr->nsubsts; i++) {
+        ret = do_replacement(&cr->substs[i].re, cr->substs[i].repl,
+                             cr->substs[i].global, selstring, &newstr);
+        if (ret)
+            goto cleanup;
+        free(selstring);
+        selstring = newstr;
+    }
+    *lname_out = selstring;
+    selstring = NULL;
+
+cleanup:
+    free(selstring);
+    return ret;
+}
+
+static krb5_error_code
+rule_init(krb5_context context, krb5_localauth_moddata *data_out)
+{
+    krb5_error_code ret;
+    struct rule_cache *cache;
+    /* Rule text comes from the profile, so a fixed seed is sufficient. */
+    static const uint8_t seed[K5_HASH_SEED_LEN];
+
+    *data_out = NULL;
+    cache = k5alloc(sizeof(*cache), &ret);
+    if (cache == NULL)
+        return ret;
+    ret = k5_hashtab_create(seed, 16, &cache->table);
+    if (ret) {
+        free(cache);
+        return ret;
+    }
+    cache->serial = profile_get_data_serial(context->profile);
+    *data_out = (krb5_localauth_moddata)cache;
+    return 0;
+}
+
+static void
+rule_fini(krb5_context context, krb5_localauth_moddata data)
+{
+    struct rule_cache *cache = (struct rule_cache *)data;
+
+    if (cache == NULL)
+        return;
+    flush_rule_cache(cache);
+    k5_hashtab_free(cache->table);
+    free(cache);
+}
+
 #else /* HAVE_REGEX_H */
 
 static krb5_error_code
@@ -332,6 +607,10 @@ localauth_rule_initvt(krb5_context context, int maj_ver, int min_ver,
 
     vt->name = "rule";
     vt->an2ln_types = types;
+#ifdef HAVE_REGEX_H
+    vt->init = rule_init;
+    vt->fini = rule_fini;
+#endif
     vt->an2ln = an2ln_rule;
     vt->free_string = freestr;
     return 0;
@@ -214,6 +214,12 @@ krb5_error_code k5_kt_client_default_name(krb5_context context,
 krb5_error_code k5_write_messages(krb5_context, krb5_pointer, krb5_data *,
                                   int);
 void k5_init_trace(krb5_context context);
+int k5_trace_initialize(void);
+void k5_trace_finalize(void);
+
+/* Render the binary trace log in data as text, appending it to buf. */
+krb5_error_code k5_trace_decode(krb5_context context, const void *data,
+                                size_t len, struct k5buf *buf);
 
 #include "k5-thread.h"
 extern k5_mutex_t krb5int_us_time_mutex;
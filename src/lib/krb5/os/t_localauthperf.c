@@ -0,0 +1,217 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/os/t_localauthperf.c - Measure localauth mapping speed */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program checks auth_to_local mappings and k5login authorization
+ * against a configuration with a typical set of rules, checks that a
+ * rewritten k5login file is noticed, then measures the rate of
+ * krb5_aname_to_localname() and krb5_kuserok() calls.  Finally it rewrites
+ * the configuration and checks that the cached rules and k5login contents are
+ * not used after the profile is reloaded.  Usage:
+ *
+ *     ./t_localauthperf count
+ */
+
+#include "k5-int.h"
+#include <pwd.h>
+#include <sys/time.h>
+
+#define CONF_FILE "t_localauthperf.conf"
+#define K5LOGIN_DIR "t_localauthperf.dir"
+#define K5LOGIN_DIR2 "t_localauthperf.dir2"
+
+static const char conf[] =
+    "[libdefaults]\n"
+    "\tdefault_realm = EXAMPLE.COM\n"
+    "\tk5login_directory = " K5LOGIN_DIR "\n"
+    "[realms]\n"
+    "\tEXAMPLE.COM = {\n"
+    "\t\tauth_to_local = RULE:[2:$1%$2@$0](.*%admin@EXAMPLE\\.COM)"
+    "s/%.*//\n"
+    "\t\tauth_to_local = RULE:[2:$2@$0](nfs@EXAMPLE\\.COM)s/.*/nobody/\n"
+    "\t\tauth_to_local = RULE:[1:$1@$0](.*@CORP\\.EXAMPLE\\.COM)"
+    "s/@.*//s/\\./_/g\n"
+    "\t\tauth_to_local = DEFAULT\n"
+    "\t}\n";
+
+/* The replacement configuration maps every EXAMPLE.COM principal to guest and
+ * reads k5login files from a different directory. */
+static const char conf2[] =
+    "[libdefaults]\n"
+    "\tdefault_realm = EXAMPLE.COM\n"
+    "\tk5login_directory = " K5LOGIN_DIR2 "\n"
+    "[realms]\n"
+    "\tEXAMPLE.COM = {\n"
+    "\t\tauth_to_local = RULE:[1:$1@$0](.*@EXAMPLE\\.COM)s/.*/guest/\n"
+    "\t\tauth_to_local = RULE:[2:$1%$2@$0](.*%admin@EXAMPLE\\.COM)"
+    "s/%.*/_admin/\n"
+    "\t}\n";
+
+static const struct {
+    const char *princ;
+    const char *lname;
+} mappings[] = {
+    { "alice@EXAMPLE.COM", "alice" },
+    { "bob/admin@EXAMPLE.COM", "bob" },
+    { "host/nfs@EXAMPLE.COM", "nobody" },
+    { "carol.smith@CORP.EXAMPLE.COM", "carol_smith" },
+    { "dave@OTHER.COM", NULL },
+};
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static void
+write_file(const char *filename, const char *contents)
+{
+    FILE *fp;
+
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fputs(contents, fp);
+    fclose(fp);
+}
+
+static void
+check_mapping(krb5_context ctx, krb5_principal princ, const char *expected)
+{
+    krb5_error_code ret;
+    char lname[256];
+
+    ret = krb5_aname_to_localname(ctx, princ, sizeof(lname), lname);
+    if (expected == NULL) {
+        assert(ret == KRB5_LNAME_NOTRANS);
+    } else {
+        assert(ret == 0);
+        assert(strcmp(lname, expected) == 0);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    krb5_principal princs[sizeof(mappings) / sizeof(*mappings)];
+    krb5_principal user, other;
+    struct passwd *pw;
+    struct timeval start;
+    double secs;
+    time_t now;
+    char *k5login, *k5login2;
+    size_t n = sizeof(mappings) / sizeof(*mappings);
+    int count, i;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: t_localauthperf count\n");
+        exit(1);
+    }
+    count = atoi(argv[1]);
+
+    pw = getpwuid(getuid());
+    assert(pw != NULL);
+    write_file(CONF_FILE, conf);
+    (void)mkdir(K5LOGIN_DIR, 0700);
+    assert(asprintf(&k5login, "%s/%s", K5LOGIN_DIR, pw->pw_name) >= 0);
+    write_file(k5login, "user1@EXAMPLE.COM\nuser2@EXAMPLE.COM\n"
+               "user3@EXAMPLE.COM\n");
+    (void)mkdir(K5LOGIN_DIR2, 0700);
+    assert(asprintf(&k5login2, "%s/%s", K5LOGIN_DIR2, pw->pw_name) >= 0);
+    write_file(k5login2, "user3@EXAMPLE.COM\n");
+
+    setenv("KRB5_CONFIG", CONF_FILE, 1);
+    assert(krb5_init_context(&ctx) == 0);
+    for (i = 0; i < (int)n; i++)
+        assert(krb5_parse_name(ctx, mappings[i].princ, &princs[i]) == 0);
+    assert(krb5_parse_name(ctx, "user3@EXAMPLE.COM", &user) == 0);
+    assert(krb5_parse_name(ctx, "user4@EXAMPLE.COM", &other) == 0);
+
+    /* Check each mapping twice, to exercise the cached rules. */
+    for (i = 0; i < (int)n * 2; i++)
+        check_mapping(ctx, princs[i % n], mappings[i % n].lname);
+
+    /* Check that k5login changes are noticed. */
+    assert(krb5_kuserok(ctx, user, pw->pw_name));
+    assert(!krb5_kuserok(ctx, other, pw->pw_name));
+    write_file(k5login, "user4@EXAMPLE.COM\n");
+    assert(!krb5_kuserok(ctx, user, pw->pw_name));
+    assert(krb5_kuserok(ctx, other, pw->pw_name));
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < count; i++)
+        check_mapping(ctx, princs[i % n], mappings[i % n].lname);
+    secs = elapsed(&start);
+    if (secs <= 0)
+        secs = 1e-6;
+    printf("%d mappings in %.3f s (%.0f/s)\n", count, secs, count / secs);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < count; i++)
+        assert(krb5_kuserok(ctx, other, pw->pw_name));
+    secs = elapsed(&start);
+    if (secs <= 0)
+        secs = 1e-6;
+    printf("%d kuserok checks in %.3f s (%.0f/s)\n", count, secs,
+           count / secs);
+
+    /* Rewrite the configuration.  The profile library checks a file at most
+     * once per second, so wait for the clock to advance first. */
+    now = time(NULL);
+    while (time(NULL) == now)
+        usleep(10000);
+    write_file(CONF_FILE, conf2);
+    check_mapping(ctx, princs[0], "guest");
+    check_mapping(ctx, princs[1], "bob_admin");
+    check_mapping(ctx, princs[2], NULL);
+    assert(krb5_kuserok(ctx, user, pw->pw_name));
+    assert(!krb5_kuserok(ctx, other, pw->pw_name));
+
+    for (i = 0; i < (int)n; i++)
+        krb5_free_principal(ctx, princs[i]);
+    krb5_free_principal(ctx, user);
+    krb5_free_principal(ctx, other);
+    krb5_free_context(ctx);
+    unlink(k5login);
+    unlink(k5login2);
+    rmdir(K5LOGIN_DIR);
+    rmdir(K5LOGIN_DIR2);
+    unlink(CONF_FILE);
+    free(k5login);
+    free(k5login2);
+    return 0;
+}
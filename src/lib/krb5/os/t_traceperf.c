@@ -0,0 +1,112 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/os/t_traceperf.c - Measure the cost of a trace event */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program measures the cost of recording a typical trace event with
+ * KRB5_TRACE text logging and with KRB5_TRACE_BINARY logging.  Usage:
+ *
+ *     ./t_traceperf count
+ */
+
+#include "k5-int.h"
+#include <sys/time.h>
+
+#define TEXT_FILE "t_traceperf.out"
+#define BINARY_FILE "t_traceperf.bin"
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static void
+run(krb5_context ctx, const char *desc, int count)
+{
+    krb5_ccache cc;
+    krb5_creds creds;
+    struct timeval start;
+    double secs;
+    int i;
+
+    memset(&creds, 0, sizeof(creds));
+    assert(krb5_cc_resolve(ctx, "MEMORY:t_traceperf", &cc) == 0);
+    assert(krb5_parse_name(ctx, "user@EXAMPLE.COM", &creds.client) == 0);
+    assert(krb5_parse_name(ctx, "host/server.example.com@EXAMPLE.COM",
+                           &creds.server) == 0);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < count; i++)
+        TRACE_CC_RETRIEVE(ctx, cc, &creds, KRB5_CC_NOTFOUND);
+    secs = elapsed(&start);
+    if (secs <= 0)
+        secs = 1e-6;
+    printf("%d %s trace events in %.3f s (%.0f/s, %.0f ns each)\n", count,
+           desc, secs, count / secs, secs * 1e9 / count);
+
+    krb5_free_cred_contents(ctx, &creds);
+    krb5_cc_close(ctx, cc);
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    int count;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: t_traceperf count\n");
+        exit(1);
+    }
+    count = atoi(argv[1]);
+    if (count <= 0)
+        count = 1;
+
+    unsetenv("KRB5_TRACE_BINARY");
+    setenv("KRB5_TRACE", TEXT_FILE, 1);
+    assert(krb5_init_context(&ctx) == 0);
+    run(ctx, "text", count);
+    krb5_free_context(ctx);
+
+    setenv("KRB5_TRACE_BINARY", BINARY_FILE, 1);
+    assert(krb5_init_context(&ctx) == 0);
+    run(ctx, "binary", count);
+    krb5_free_context(ctx);
+
+    unlink(TEXT_FILE);
+    unlink(BINARY_FILE);
+    return 0;
+}
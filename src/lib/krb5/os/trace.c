@@ -39,6 +39,7 @@
 
 #include "k5-int.h"
 #include "os-proto.h"
+#include "k5-queue.h"
 
 #ifndef DISABLE_TRACING
 
@@ -384,11 +385,992 @@ subfmt(krb5_context context, struct k5buf *buf, const char *fmt, ...)
     va_end(ap);
 }
 
+/*
+ * Binary trace logging.  When KRB5_TRACE_BINARY names a file, trace events
+ * are not formatted as they happen.  Instead each event is recorded as a
+ * format ID, a monotonic timestamp, and the argument values needed to render
+ * the format later, in a buffer owned by the calling thread.  No lock is taken
+ * to record an event; a thread's buffer is written to the file in a single
+ * write() when it fills, when the thread records an event at least
+ * FLUSH_INTERVAL_NS after its last write, when the thread forks or exits, and
+ * when the library is finalized.  Events recorded since a thread's last write
+ * are lost if the process crashes, and a thread which goes idle keeps its last
+ * events buffered until it records another event or exits.  k5_trace_decode()
+ * renders the file as the text KRB5_TRACE would have produced.
+ *
+ * Each write is a chunk consisting of a header (CHUNK_HEADER_LEN bytes: magic,
+ * record length, pid, thread number, wall-clock seconds and microseconds, and
+ * monotonic nanoseconds at the time of the write) followed by records.  The
+ * first event in a thread for each format string is preceded by a definition
+ * record giving the format text for its ID.  Integers are written in host
+ * byte order, so a trace must be decoded on a host of the same byte order.
+ */
+
+#define TRACE_MAGIC 0x4B355442  /* "K5TB" */
+#define CHUNK_HEADER_LEN 36
+#define BUFFER_SIZE 65536
+#define FLUSH_INTERVAL_NS 1000000000
+#define FORMAT_SLOTS 1024
+#define MAX_FORMATS (FORMAT_SLOTS * 3 / 4)
+#define INLINE_FORMAT 0xFFFF
+#define MAX_BYTES 1024
+#define MAX_LIST 64
+#define MAX_COMPONENTS 32
+
+#define REC_DEF 1
+#define REC_EVENT 2
+
+struct format_slot {
+    const char *fmt;
+    uint16_t id;
+};
+
+struct trace_buffer {
+    K5_LIST_ENTRY(trace_buffer) links;
+    uint32_t pid;
+    uint32_t thread;
+    size_t len;
+    uint64_t last_flush;        /* Monotonic time of the last write */
+    krb5_boolean full;
+    unsigned int nformats;
+    struct format_slot formats[FORMAT_SLOTS];
+    unsigned char data[BUFFER_SIZE];
+};
+
+static K5_LIST_HEAD(, trace_buffer) buffers;
+static k5_mutex_t buffers_lock = K5_MUTEX_PARTIAL_INITIALIZER;
+static int binary_fd = -1;
+static uint32_t next_thread = 1;
+
+static void KRB5_CALLCONV
+binary_trace_cb(krb5_context context, const krb5_trace_info *info, void *data)
+{
+    /* Events are recorded by krb5int_trace() before this could be called. */
+}
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+put(struct trace_buffer *tb, const void *p, size_t len)
+{
+    if (tb->full || BUFFER_SIZE - tb->len < len) {
+        tb->full = TRUE;
+        return;
+    }
+    if (len == 0)
+        return;
+    memcpy(tb->data + tb->len, p, len);
+    tb->len += len;
+}
+
+static void
+put_u8(struct trace_buffer *tb, uint8_t val)
+{
+    put(tb, &val, 1);
+}
+
+static void
+put_u16(struct trace_buffer *tb, uint16_t val)
+{
+    put(tb, &val, 2);
+}
+
+static void
+put_i32(struct trace_buffer *tb, int32_t val)
+{
+    put(tb, &val, 4);
+}
+
+static void
+put_i64(struct trace_buffer *tb, int64_t val)
+{
+    put(tb, &val, 8);
+}
+
+/* Put a counted byte string, truncated to MAX_BYTES. */
+static void
+put_bytes(struct trace_buffer *tb, const void *p, size_t len)
+{
+    if (len > MAX_BYTES)
+        len = MAX_BYTES;
+    put_u16(tb, len);
+    put(tb, p, len);
+}
+
+/* Put a flag byte, followed by a counted byte string if p is not NULL. */
+static void
+put_opt_bytes(struct trace_buffer *tb, const void *p, size_t len)
+{
+    put_u8(tb, p != NULL);
+    if (p != NULL)
+        put_bytes(tb, p, len);
+}
+
+static void
+put_opt_str(struct trace_buffer *tb, const char *s)
+{
+    put_opt_bytes(tb, s, (s == NULL) ? 0 : strlen(s));
+}
+
+static void
+put_princ(struct trace_buffer *tb, krb5_const_principal princ)
+{
+    int32_t i, n;
+
+    put_u8(tb, princ != NULL);
+    if (princ == NULL)
+        return;
+    n = (princ->length > MAX_COMPONENTS) ? MAX_COMPONENTS : princ->length;
+    put_i32(tb, princ->type);
+    put_bytes(tb, princ->realm.data, princ->realm.length);
+    put_i32(tb, n);
+    for (i = 0; i < n; i++)
+        put_bytes(tb, princ->data[i].data, princ->data[i].length);
+}
+
+/* Put the hash of len bytes at p, as "{hashlenstr}" would display it. */
+static void
+put_hash(krb5_context context, struct trace_buffer *tb, const void *p,
+         size_t len)
+{
+    char *str = hash_bytes(context, p, len);
+
+    put_opt_str(tb, (str == NULL) ? "" : str);
+    free(str);
+}
+
+static void
+put_keyblock(krb5_context context, struct trace_buffer *tb,
+             const krb5_keyblock *keyblock)
+{
+    put_u8(tb, keyblock != NULL);
+    if (keyblock == NULL)
+        return;
+    put_i32(tb, keyblock->enctype);
+    put_hash(context, tb, keyblock->contents, keyblock->length);
+}
+
+/*
+ * Find the next {word} in *fmt.  Set *lit and *litlen to the literal text
+ * preceding it and copy the word into word.  Return FALSE if there is no
+ * further word, in the same cases where trace_format() stops.
+ */
+static krb5_boolean
+next_word(const char **fmt, const char **lit, size_t *litlen, char *word,
+          size_t wsize)
+{
+    const char *p = *fmt;
+    size_t len;
+
+    *lit = p;
+    *litlen = strcspn(p, "{");
+    if (p[*litlen] == '\0')
+        return FALSE;
+    p += *litlen + 1;
+    len = strcspn(p, "}");
+    if (p[len] == '\0' || len > wsize - 1)
+        return FALSE;
+    memcpy(word, p, len);
+    word[len] = '\0';
+    *fmt = p + len + 1;
+    return TRUE;
+}
+
+/* Encode the arguments for fmt into tb, consuming them from ap in the same
+ * way as trace_format(). */
+static void
+encode_args(krb5_context context, struct trace_buffer *tb, const char *fmt,
+            va_list ap)
+{
+    char word[200], namebuf[200];
+    const char *lit, *p;
+    size_t litlen, len, n;
+    krb5_error_code kerr;
+    struct remote_address *ra;
+    const krb5_data *d;
+    const krb5_checksum *cksum;
+    krb5_key key;
+    krb5_pa_data **padata;
+    krb5_enctype *etypes;
+    krb5_ccache ccache;
+    krb5_keytab keytab;
+    krb5_creds *creds;
+
+    while (next_word(&fmt, &lit, &litlen, word, sizeof(word))) {
+        if (strcmp(word, "int") == 0 || strcmp(word, "errno") == 0) {
+            put_i32(tb, va_arg(ap, int));
+        } else if (strcmp(word, "long") == 0) {
+            put_i64(tb, va_arg(ap, long));
+        } else if (strcmp(word, "str") == 0) {
+            put_opt_str(tb, va_arg(ap, const char *));
+        } else if (strcmp(word, "lenstr") == 0 ||
+                   strcmp(word, "hexlenstr") == 0) {
+            len = va_arg(ap, size_t);
+            p = va_arg(ap, const char *);
+            if (p == NULL && len != 0)
+                put_u8(tb, 0);
+            else
+                put_opt_bytes(tb, (p == NULL) ? "" : p, len);
+        } else if (strcmp(word, "hashlenstr") == 0) {
+            len = va_arg(ap, size_t);
+            p = va_arg(ap, const char *);
+            if (p == NULL && len != 0)
+                put_u8(tb, 0);
+            else
+                put_hash(context, tb, p, len);
+        } else if (strcmp(word, "raddr") == 0) {
+            ra = va_arg(ap, struct remote_address *);
+            put_i32(tb, ra->transport);
+            put_i32(tb, ra->family);
+            put_bytes(tb, &ra->saddr, ra->len);
+        } else if (strcmp(word, "data") == 0 || strcmp(word, "hexdata") == 0) {
+            d = va_arg(ap, krb5_data *);
+            if (d == NULL || (d->length != 0 && d->data == NULL))
+                put_u8(tb, 0);
+            else
+                put_opt_bytes(tb, (d->data == NULL) ? "" : d->data, d->length);
+        } else if (strcmp(word, "kerr") == 0) {
+            kerr = va_arg(ap, krb5_error_code);
+            put_i32(tb, kerr);
+            /* Keep an extended message; others can be found by the
+             * decoder. */
+            put_opt_str(tb, (kerr != 0 && context->err.code == kerr) ?
+                        context->err.msg : NULL);
+        } else if (strcmp(word, "keyblock") == 0) {
+            put_keyblock(context, tb, va_arg(ap, const krb5_keyblock *));
+        } else if (strcmp(word, "key") == 0) {
+            key = va_arg(ap, krb5_key);
+            put_keyblock(context, tb, (key == NULL) ? NULL : &key->keyblock);
+        } else if (strcmp(word, "cksum") == 0) {
+            cksum = va_arg(ap, const krb5_checksum *);
+            put_i32(tb, cksum->checksum_type);
+            put_bytes(tb, cksum->contents, cksum->length);
+        } else if (strcmp(word, "princ") == 0) {
+            put_princ(tb, va_arg(ap, krb5_principal));
+        } else if (strcmp(word, "ptype") == 0) {
+            put_i32(tb, va_arg(ap, krb5_int32));
+        } else if (strcmp(word, "patypes") == 0) {
+            padata = va_arg(ap, krb5_pa_data **);
+            for (n = 0; padata != NULL && padata[n] != NULL; n++);
+            put_u16(tb, (n > MAX_LIST) ? MAX_LIST : n);
+            for (n = 0; n < MAX_LIST && padata != NULL && padata[n] != NULL;
+                 n++)
+                put_i32(tb, padata[n]->pa_type);
+        } else if (strcmp(word, "patype") == 0) {
+            put_i32(tb, va_arg(ap, krb5_preauthtype));
+        } else if (strcmp(word, "etype") == 0) {
+            put_i32(tb, va_arg(ap, krb5_enctype));
+        } else if (strcmp(word, "etypes") == 0) {
+            etypes = va_arg(ap, krb5_enctype *);
+            for (n = 0; etypes != NULL && etypes[n] != 0; n++);
+            put_u16(tb, (n > MAX_LIST) ? MAX_LIST : n);
+            for (n = 0; n < MAX_LIST && etypes != NULL && etypes[n] != 0; n++)
+                put_i32(tb, etypes[n]);
+        } else if (strcmp(word, "ccache") == 0) {
+            ccache = va_arg(ap, krb5_ccache);
+            put_opt_str(tb, krb5_cc_get_type(context, ccache));
+            put_opt_str(tb, krb5_cc_get_name(context, ccache));
+        } else if (strcmp(word, "keytab") == 0) {
+            keytab = va_arg(ap, krb5_keytab);
+            if (krb5_kt_get_name(context, keytab, namebuf,
+                                 sizeof(namebuf)) == 0)
+                put_opt_str(tb, namebuf);
+            else
+                put_u8(tb, 0);
+        } else if (strcmp(word, "creds") == 0) {
+            creds = va_arg(ap, krb5_creds *);
+            put_princ(tb, creds->client);
+            put_princ(tb, creds->server);
+        }
+    }
+}
+
+/* Look up the ID of fmt in tb, assigning one if necessary.  Set *added if a
+ * new ID was assigned, and return the slot used so that the assignment can be
+ * undone. */
+static struct format_slot *
+find_format(struct trace_buffer *tb, const char *fmt, krb5_boolean *added)
+{
+    struct format_slot *slot;
+    size_t i;
+
+    *added = FALSE;
+    i = ((uintptr_t)fmt * 2654435761U) % FORMAT_SLOTS;
+    for (;;) {
+        slot = &tb->formats[i];
+        if (slot->fmt == fmt)
+            return slot;
+        if (slot->fmt == NULL)
+            break;
+        i = (i + 1) % FORMAT_SLOTS;
+    }
+    if (tb->nformats >= MAX_FORMATS)
+        return NULL;
+    slot->fmt = fmt;
+    slot->id = tb->nformats++;
+    *added = TRUE;
+    return slot;
+}
+
+static void
+write_all(int fd, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        p += n;
+        len -= n;
+    }
+}
+
+/* Write the records in tb to the trace file as a chunk and empty tb. */
+static void
+flush_buffer(struct trace_buffer *tb)
+{
+    uint32_t magic = TRACE_MAGIC, reclen = tb->len - CHUNK_HEADER_LEN;
+    uint32_t usec32;
+    krb5_timestamp sec;
+    krb5_int32 usec;
+    int64_t sec64;
+    uint64_t mono;
+
+    if (reclen == 0 || binary_fd == -1)
+        return;
+    mono = monotonic_ns();
+    if (krb5_crypto_us_timeofday(&sec, &usec) != 0)
+        sec = usec = 0;
+    sec64 = (uint32_t)sec;
+    usec32 = usec;
+    memcpy(tb->data, &magic, 4);
+    memcpy(tb->data + 4, &reclen, 4);
+    memcpy(tb->data + 8, &tb->pid, 4);
+    memcpy(tb->data + 12, &tb->thread, 4);
+    memcpy(tb->data + 16, &sec64, 8);
+    memcpy(tb->data + 24, &usec32, 4);
+    memcpy(tb->data + 28, &mono, 8);
+    write_all(binary_fd, tb->data, tb->len);
+    tb->len = CHUNK_HEADER_LEN;
+    tb->last_flush = mono;
+}
+
+static void
+reset_buffer(struct trace_buffer *tb)
+{
+    tb->pid = getpid();
+    tb->len = CHUNK_HEADER_LEN;
+    tb->last_flush = monotonic_ns();
+    tb->nformats = 0;
+    memset(tb->formats, 0, sizeof(tb->formats));
+}
+
+/* Thread-specific data destructor for a thread's trace buffer. */
+static void
+free_buffer(void *ptr)
+{
+    struct trace_buffer *tb = ptr;
+
+    k5_mutex_lock(&buffers_lock);
+    flush_buffer(tb);
+    K5_LIST_REMOVE(tb, links);
+    k5_mutex_unlock(&buffers_lock);
+    free(tb);
+}
+
+static struct trace_buffer *
+get_buffer(void)
+{
+    struct trace_buffer *tb;
+
+    tb = k5_getspecific(K5_KEY_KRB5_TRACE);
+    if (tb != NULL)
+        return tb;
+    tb = malloc(sizeof(*tb));
+    if (tb == NULL)
+        return NULL;
+    reset_buffer(tb);
+    tb->full = FALSE;
+    k5_mutex_lock(&buffers_lock);
+    tb->thread = next_thread++;
+    K5_LIST_INSERT_HEAD(&buffers, tb, links);
+    k5_mutex_unlock(&buffers_lock);
+    if (k5_setspecific(K5_KEY_KRB5_TRACE, tb) != 0) {
+        free_buffer(tb);
+        return NULL;
+    }
+    return tb;
+}
+
+static void
+binary_trace(krb5_context context, const char *fmt, va_list ap)
+{
+    struct trace_buffer *tb;
+    struct format_slot *slot;
+    krb5_boolean added;
+    size_t start;
+    uint64_t now;
+    va_list ap2;
+    int attempt;
+
+    tb = get_buffer();
+    if (tb == NULL)
+        return;
+    for (attempt = 0; attempt < 2; attempt++) {
+        start = tb->len;
+        tb->full = FALSE;
+        slot = find_format(tb, fmt, &added);
+        if (added) {
+            put_u8(tb, REC_DEF);
+            put_u16(tb, slot->id);
+            put_bytes(tb, fmt, strlen(fmt));
+        }
+        put_u8(tb, REC_EVENT);
+        put_u16(tb, (slot == NULL) ? INLINE_FORMAT : slot->id);
+        if (slot == NULL)
+            put_bytes(tb, fmt, strlen(fmt));
+        now = monotonic_ns();
+        put_i64(tb, now);
+        va_copy(ap2, ap);
+        encode_args(context, tb, fmt, ap2);
+        va_end(ap2);
+        if (!tb->full) {
+            if (now - tb->last_flush >= FLUSH_INTERVAL_NS)
+                flush_buffer(tb);
+            return;
+        }
+
+        /* Discard the partial record and retry with an empty buffer. */
+        tb->len = start;
+        if (added) {
+            slot->fmt = NULL;
+            tb->nformats--;
+        }
+        if (start == CHUNK_HEADER_LEN)
+            return;
+        flush_buffer(tb);
+    }
+}
+
+/* Open the binary trace file if it has not already been opened. */
+static krb5_error_code
+open_binary_trace(const char *filename)
+{
+    krb5_error_code ret = 0;
+
+    k5_mutex_lock(&buffers_lock);
+    if (binary_fd == -1) {
+        binary_fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0600);
+        if (binary_fd == -1)
+            ret = errno;
+        else
+            set_cloexec_fd(binary_fd);
+    }
+    k5_mutex_unlock(&buffers_lock);
+    return ret;
+}
+
+#if defined(ENABLE_THREADS) && defined(HAVE_PTHREAD)
+/* Write out the forking thread's records, which the child will discard.
+ * Other threads append to their buffers without locking, so their records
+ * stay in the parent until those threads write them. */
+static void
+trace_atfork_prepare(void)
+{
+    struct trace_buffer *tb;
+
+    k5_mutex_lock(&buffers_lock);
+    tb = k5_getspecific(K5_KEY_KRB5_TRACE);
+    if (tb != NULL)
+        flush_buffer(tb);
+}
+
+static void
+trace_atfork_parent(void)
+{
+    k5_mutex_unlock(&buffers_lock);
+}
+
+/* Discard records inherited from the parent, which will write its own copy,
+ * and start the child's format IDs afresh. */
+static void
+trace_atfork_child(void)
+{
+    struct trace_buffer *tb;
+
+    K5_LIST_FOREACH(tb, &buffers, links)
+        reset_buffer(tb);
+    k5_mutex_unlock(&buffers_lock);
+}
+#endif
+
+int
+k5_trace_initialize(void)
+{
+    int ret;
+
+    ret = k5_mutex_finish_init(&buffers_lock);
+    if (ret)
+        return ret;
+    ret = k5_key_register(K5_KEY_KRB5_TRACE, free_buffer);
+    if (ret)
+        return ret;
+#if defined(ENABLE_THREADS) && defined(HAVE_PTHREAD)
+    (void)pthread_atfork(trace_atfork_prepare, trace_atfork_parent,
+                         trace_atfork_child);
+#endif
+    return 0;
+}
+
+void
+k5_trace_finalize(void)
+{
+    struct trace_buffer *tb, *next;
+
+    k5_mutex_lock(&buffers_lock);
+    K5_LIST_FOREACH_SAFE(tb, &buffers, links, next) {
+        flush_buffer(tb);
+        K5_LIST_REMOVE(tb, links);
+        free(tb);
+    }
+    (void)k5_setspecific(K5_KEY_KRB5_TRACE, NULL);
+    if (binary_fd != -1)
+        close(binary_fd);
+    binary_fd = -1;
+    k5_mutex_unlock(&buffers_lock);
+    k5_key_delete(K5_KEY_KRB5_TRACE);
+    k5_mutex_destroy(&buffers_lock);
+}
+
+/* A cursor over a binary trace being decoded. */
+struct reader {
+    const unsigned char *p;
+    const unsigned char *end;
+    krb5_boolean bad;
+};
+
+static const void *
+get(struct reader *r, size_t len)
+{
+    const unsigned char *p = r->p;
+
+    if (r->bad || (size_t)(r->end - r->p) < len) {
+        r->bad = TRUE;
+        return NULL;
+    }
+    r->p += len;
+    return p;
+}
+
+static uint8_t
+get_u8(struct reader *r)
+{
+    const uint8_t *p = get(r, 1);
+
+    return (p == NULL) ? 0 : *p;
+}
+
+static uint16_t
+get_u16(struct reader *r)
+{
+    const void *p = get(r, 2);
+    uint16_t val = 0;
+
+    if (p != NULL)
+        memcpy(&val, p, 2);
+    return val;
+}
+
+static int32_t
+get_i32(struct reader *r)
+{
+    const void *p = get(r, 4);
+    int32_t val = 0;
+
+    if (p != NULL)
+        memcpy(&val, p, 4);
+    return val;
+}
+
+static int64_t
+get_i64(struct reader *r)
+{
+    const void *p = get(r, 8);
+    int64_t val = 0;
+
+    if (p != NULL)
+        memcpy(&val, p, 8);
+    return val;
+}
+
+static krb5_data
+get_bytes(struct reader *r)
+{
+    uint16_t len = get_u16(r);
+    const void *p = get(r, len);
+
+    return make_data((void *)p, (p == NULL) ? 0 : len);
+}
+
+/* Read an optional byte string; return FALSE if it was absent. */
+static krb5_boolean
+get_opt_bytes(struct reader *r, krb5_data *d_out)
+{
+    *d_out = empty_data();
+    if (!get_u8(r))
+        return FALSE;
+    *d_out = get_bytes(r);
+    return TRUE;
+}
+
+/* Read a principal into *princ, using comps for its components.  Return FALSE
+ * if no principal was recorded. */
+static krb5_boolean
+get_princ(struct reader *r, krb5_principal_data *princ, krb5_data *comps)
+{
+    int32_t i, n;
+
+    memset(princ, 0, sizeof(*princ));
+    if (!get_u8(r))
+        return FALSE;
+    princ->type = get_i32(r);
+    princ->realm = get_bytes(r);
+    n = get_i32(r);
+    if (n < 0 || n > MAX_COMPONENTS) {
+        r->bad = TRUE;
+        return FALSE;
+    }
+    for (i = 0; i < n; i++)
+        comps[i] = get_bytes(r);
+    princ->data = comps;
+    princ->length = n;
+    return !r->bad;
+}
+
+static void
+render_princ(krb5_context context, struct k5buf *buf, struct reader *r)
+{
+    krb5_principal_data princ;
+    krb5_data comps[MAX_COMPONENTS];
+
+    if (get_princ(r, &princ, comps))
+        subfmt(context, buf, "{princ}", &princ);
+}
+
+static void
+render_keyblock(krb5_context context, struct k5buf *buf, struct reader *r)
+{
+    krb5_data hash;
+
+    if (!get_u8(r)) {
+        k5_buf_add(buf, "(null)");
+        return;
+    }
+    subfmt(context, buf, "{etype}/", (krb5_enctype)get_i32(r));
+    if (get_opt_bytes(r, &hash))
+        k5_buf_add_len(buf, hash.data, hash.length);
+}
+
+/* Render one event with format fmt, reading its arguments from r. */
+static void
+render_event(krb5_context context, struct k5buf *buf, const char *fmt,
+             struct reader *r)
+{
+    char word[200];
+    const char *lit, *msg;
+    size_t litlen;
+    unsigned int i, n;
+    struct remote_address ra;
+    krb5_data d, d2;
+    krb5_error_code kerr;
+    krb5_checksum cksum;
+    krb5_pa_data pa[MAX_LIST], *padata[MAX_LIST + 1];
+    krb5_enctype etypes[MAX_LIST + 1];
+
+    while (next_word(&fmt, &lit, &litlen, word, sizeof(word))) {
+        k5_buf_add_len(buf, lit, litlen);
+        if (strcmp(word, "int") == 0) {
+            k5_buf_add_fmt(buf, "%d", (int)get_i32(r));
+        } else if (strcmp(word, "long") == 0) {
+            k5_buf_add_fmt(buf, "%ld", (long)get_i64(r));
+        } else if (strcmp(word, "str") == 0 || strcmp(word, "lenstr") == 0 ||
+                   strcmp(word, "data") == 0) {
+            if (get_opt_bytes(r, &d))
+                buf_add_printable_len(buf, d.data, d.length);
+            else
+                k5_buf_add(buf, "(null)");
+        } else if (strcmp(word, "hexlenstr") == 0 ||
+                   strcmp(word, "hexdata") == 0) {
+            if (get_opt_bytes(r, &d))
+                subfmt(context, buf, "{hexdata}", &d);
+            else
+                k5_buf_add(buf, "(null)");
+        } else if (strcmp(word, "hashlenstr") == 0) {
+            if (get_opt_bytes(r, &d))
+                k5_buf_add_len(buf, d.data, d.length);
+            else
+                k5_buf_add(buf, "(null)");
+        } else if (strcmp(word, "raddr") == 0) {
+            memset(&ra, 0, sizeof(ra));
+            ra.transport = get_i32(r);
+            ra.family = get_i32(r);
+            d = get_bytes(r);
+            ra.len = (d.length > sizeof(ra.saddr)) ? sizeof(ra.saddr) :
+                d.length;
+            memcpy(&ra.saddr, d.data, ra.len);
+            subfmt(context, buf, "{raddr}", &ra);
+        } else if (strcmp(word, "errno") == 0) {
+            subfmt(context, buf, "{errno}", (int)get_i32(r));
+        } else if (strcmp(word, "kerr") == 0) {
+            kerr = get_i32(r);
+            if (get_opt_bytes(r, &d)) {
+                k5_buf_add_fmt(buf, "%ld/", (long)kerr);
+                k5_buf_add_len(buf, d.data, d.length);
+            } else {
+                msg = krb5_get_error_message(context, kerr);
+                k5_buf_add_fmt(buf, "%ld/%s", (long)kerr,
+                               kerr ? msg : "Success");
+                krb5_free_error_message(context, msg);
+            }
+        } else if (strcmp(word, "keyblock") == 0 ||
+                   strcmp(word, "key") == 0) {
+            render_keyblock(context, buf, r);
+        } else if (strcmp(word, "cksum") == 0) {
+            cksum.checksum_type = get_i32(r);
+            d = get_bytes(r);
+            cksum.length = d.length;
+            cksum.contents = (krb5_octet *)d.data;
+            subfmt(context, buf, "{cksum}", &cksum);
+        } else if (strcmp(word, "princ") == 0) {
+            render_princ(context, buf, r);
+        } else if (strcmp(word, "ptype") == 0) {
+            subfmt(context, buf, "{ptype}", (krb5_int32)get_i32(r));
+        } else if (strcmp(word, "patypes") == 0) {
+            n = get_u16(r);
+            if (n > MAX_LIST)
+                n = MAX_LIST;
+            memset(pa, 0, sizeof(pa));
+            for (i = 0; i < n; i++) {
+                pa[i].pa_type = get_i32(r);
+                padata[i] = &pa[i];
+            }
+            padata[n] = NULL;
+            subfmt(context, buf, "{patypes}", padata);
+        } else if (strcmp(word, "patype") == 0) {
+            subfmt(context, buf, "{patype}", (krb5_preauthtype)get_i32(r));
+        } else if (strcmp(word, "etype") == 0) {
+            subfmt(context, buf, "{etype}", (krb5_enctype)get_i32(r));
+        } else if (strcmp(word, "etypes") == 0) {
+            n = get_u16(r);
+            if (n > MAX_LIST)
+                n = MAX_LIST;
+            for (i = 0; i < n; i++)
+                etypes[i] = get_i32(r);
+            etypes[n] = 0;
+            subfmt(context, buf, "{etypes}", etypes);
+        } else if (strcmp(word, "ccache") == 0) {
+            (void)get_opt_bytes(r, &d);
+            (void)get_opt_bytes(r, &d2);
+            k5_buf_add_len(buf, d.data, d.length);
+            k5_buf_add(buf, ":");
+            k5_buf_add_len(buf, d2.data, d2.length);
+        } else if (strcmp(word, "keytab") == 0) {
+            if (get_opt_bytes(r, &d))
+                k5_buf_add_len(buf, d.data, d.length);
+        } else if (strcmp(word, "creds") == 0) {
+            render_princ(context, buf, r);
+            k5_buf_add(buf, " -> ");
+            render_princ(context, buf, r);
+        }
+    }
+    k5_buf_add_len(buf, lit, litlen);
+}
+
+/* Format definitions seen so far for one thread of one process. */
+struct decode_thread {
+    uint32_t pid;
+    uint32_t thread;
+    char **formats;
+    size_t nformats;
+};
+
+static struct decode_thread *
+find_thread(struct decode_thread **threads, size_t *nthreads, uint32_t pid,
+            uint32_t thread)
+{
+    struct decode_thread *t;
+    size_t i;
+
+    for (i = 0; i < *nthreads; i++) {
+        t = &(*threads)[i];
+        if (t->pid == pid && t->thread == thread)
+            return t;
+    }
+    t = realloc(*threads, (*nthreads + 1) * sizeof(**threads));
+    if (t == NULL)
+        return NULL;
+    *threads = t;
+    t = &t[(*nthreads)++];
+    t->pid = pid;
+    t->thread = thread;
+    t->formats = NULL;
+    t->nformats = 0;
+    return t;
+}
+
+/* Record the definition of format id for t. */
+static krb5_error_code
+define_format(struct decode_thread *t, uint16_t id, const krb5_data *fmt)
+{
+    krb5_error_code ret;
+    char **newformats, *str;
+    size_t i;
+
+    if (id >= t->nformats) {
+        newformats = realloc(t->formats, (id + 1) * sizeof(*newformats));
+        if (newformats == NULL)
+            return ENOMEM;
+        for (i = t->nformats; i <= id; i++)
+            newformats[i] = NULL;
+        t->formats = newformats;
+        t->nformats = id + 1;
+    }
+    str = k5memdup0(fmt->data, fmt->length, &ret);
+    if (str == NULL)
+        return ret;
+    free(t->formats[id]);
+    t->formats[id] = str;
+    return 0;
+}
+
+/* Decode the records of one chunk into buf. */
+static krb5_error_code
+decode_chunk(krb5_context context, struct reader *r, struct decode_thread *t,
+             int64_t wall_us, uint64_t mono, struct k5buf *buf)
+{
+    krb5_error_code ret;
+    krb5_data fmtdata;
+    uint16_t id;
+    uint8_t type;
+    uint64_t ts;
+    int64_t us;
+    char *fmt, *inline_fmt;
+
+    while (r->p < r->end && !r->bad) {
+        type = get_u8(r);
+        id = get_u16(r);
+        if (type == REC_DEF) {
+            fmtdata = get_bytes(r);
+            if (r->bad)
+                break;
+            ret = define_format(t, id, &fmtdata);
+            if (ret)
+                return ret;
+            continue;
+        } else if (type != REC_EVENT) {
+            r->bad = TRUE;
+            break;
+        }
+
+        inline_fmt = NULL;
+        if (id == INLINE_FORMAT) {
+            fmtdata = get_bytes(r);
+            inline_fmt = k5memdup0(fmtdata.data, fmtdata.length, &ret);
+            if (inline_fmt == NULL)
+                return ret;
+            fmt = inline_fmt;
+        } else if (id < t->nformats && t->formats[id] != NULL) {
+            fmt = t->formats[id];
+        } else {
+            r->bad = TRUE;
+            break;
+        }
+        ts = get_i64(r);
+        us = wall_us - (int64_t)(mono - ts) / 1000;
+        k5_buf_add_fmt(buf, "[%d/%u] %u.%06d: ", (int)t->pid,
+                       (unsigned int)t->thread, (unsigned int)(us / 1000000),
+                       (int)(us % 1000000));
+        render_event(context, buf, fmt, r);
+        k5_buf_add(buf, "\n");
+        free(inline_fmt);
+    }
+    return r->bad ? EINVAL : 0;
+}
+
+krb5_error_code
+k5_trace_decode(krb5_context context, const void *data, size_t len,
+                struct k5buf *buf)
+{
+    krb5_error_code ret = 0;
+    struct reader r, chunk;
+    struct decode_thread *threads = NULL, *t;
+    size_t nthreads = 0, i, j;
+    uint32_t magic, reclen, pid, thread, usec;
+    int64_t sec;
+    uint64_t mono;
+
+    r.p = data;
+    r.end = r.p + len;
+    r.bad = FALSE;
+    while (r.p < r.end) {
+        magic = get_i32(&r);
+        reclen = get_i32(&r);
+        pid = get_i32(&r);
+        thread = get_i32(&r);
+        sec = get_i64(&r);
+        usec = get_i32(&r);
+        mono = get_i64(&r);
+        chunk.p = get(&r, reclen);
+        if (r.bad || magic != TRACE_MAGIC) {
+            ret = EINVAL;
+            break;
+        }
+        chunk.end = chunk.p + reclen;
+        chunk.bad = FALSE;
+        t = find_thread(&threads, &nthreads, pid, thread);
+        if (t == NULL) {
+            ret = ENOMEM;
+            break;
+        }
+        ret = decode_chunk(context, &chunk, t, sec * 1000000 + usec, mono,
+                           buf);
+        if (ret)
+            break;
+    }
+
+    for (i = 0; i < nthreads; i++) {
+        for (j = 0; j < threads[i].nformats; j++)
+            free(threads[i].formats[j]);
+        free(threads[i].formats);
+    }
+    free(threads);
+    if (ret == 0 && k5_buf_status(buf) != 0)
+        ret = ENOMEM;
+    return ret;
+}
+
 void
 k5_init_trace(krb5_context context)
 {
     const char *filename;
 
+    filename = secure_getenv("KRB5_TRACE_BINARY");
+    if (filename != NULL && open_binary_trace(filename) == 0) {
+        (void)krb5_set_trace_callback(context, binary_trace_cb, NULL);
+        return;
+    }
     filename = secure_getenv("KRB5_TRACE");
     if (filename)
         (void) krb5_set_trace_filename(context, filename);
@@ -406,6 +1388,10 @@ krb5int_trace(krb5_context context, const char *fmt, ...)
     if (context == NULL || context->trace_callback == NULL)
         return;
     va_start(ap, fmt);
+    if (context->trace_callback == binary_trace_cb) {
+        binary_trace(context, fmt, ap);
+        goto cleanup;
+    }
     str = trace_format(context, fmt, ap);
     if (str == NULL)
         goto cleanup;
@@ -469,6 +1455,24 @@ krb5_set_trace_filename(krb5_context context, const char *filename)
 
 #else /* DISABLE_TRACING */
 
+int
+k5_trace_initialize(void)
+{
+    return 0;
+}
+
+void
+k5_trace_finalize(void)
+{
+}
+
+krb5_error_code
+k5_trace_decode(krb5_context context, const void *data, size_t len,
+                struct k5buf *buf)
+{
+    return KRB5_TRACE_NOSUPP;
+}
+
 krb5_error_code KRB5_CALLCONV
 krb5_set_trace_callback(krb5_context context, krb5_trace_callback fn,
                         void *cb_data)
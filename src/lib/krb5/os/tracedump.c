@@ -0,0 +1,86 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/os/tracedump.c - Render a binary trace log as text */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program renders a trace log written by a program run with
+ * KRB5_TRACE_BINARY set, in the format KRB5_TRACE would have used.  Usage:
+ *
+ *     ./tracedump filename
+ */
+
+#include "k5-int.h"
+#include "os-proto.h"
+
+int
+main(int argc, char **argv)
+{
+    krb5_error_code ret;
+    krb5_context ctx;
+    struct k5buf in, out;
+    char buf[8192];
+    size_t n;
+    FILE *fp;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: tracedump filename\n");
+        return 1;
+    }
+    fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    k5_buf_init_dynamic(&in);
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        k5_buf_add_len(&in, buf, n);
+    fclose(fp);
+    if (k5_buf_status(&in) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    ret = krb5_init_context(&ctx);
+    if (ret) {
+        com_err("tracedump", ret, "while initializing krb5");
+        return 1;
+    }
+    k5_buf_init_dynamic(&out);
+    ret = k5_trace_decode(ctx, in.data, in.len, &out);
+    if (k5_buf_status(&out) == 0)
+        fwrite(out.data, 1, out.len, stdout);
+    if (ret)
+        com_err("tracedump", ret, "while decoding %s", argv[1]);
+    k5_buf_free(&in);
+    k5_buf_free(&out);
+    krb5_free_context(ctx);
+    return ret ? 1 : 0;
+}
@@ -47,6 +47,7 @@ struct krb5_rc_st {
 
 extern const krb5_rc_ops k5_rc_dfl_ops;
 extern const krb5_rc_ops k5_rc_file2_ops;
+extern const krb5_rc_ops k5_rc_mem_ops;
 extern const krb5_rc_ops k5_rc_none_ops;
 
 /* Check and store a replay record in an open (but not locked) file descriptor,
@@ -54,4 +55,8 @@ extern const krb5_rc_ops k5_rc_none_ops;
 krb5_error_code k5_rcfile2_store(krb5_context context, int fd,
                                  const krb5_data *tag_data);
 
+/* Set up and release the process-wide state of the mem replay cache type. */
+int k5_rc_mem_initialize(void);
+void k5_rc_mem_finalize(void);
+
 #endif /* RC_INT_H */
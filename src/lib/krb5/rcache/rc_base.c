@@ -20,7 +20,8 @@ struct typelist {
     struct typelist *next;
 };
 static struct typelist none = { &k5_rc_none_ops, 0 };
-static struct typelist file2 = { &k5_rc_file2_ops, &none };
+static struct typelist mem = { &k5_rc_mem_ops, &none };
+static struct typelist file2 = { &k5_rc_file2_ops, &mem };
 static struct typelist dfl = { &k5_rc_dfl_ops, &file2 };
 static struct typelist *typehead = &dfl;
 
@@ -0,0 +1,347 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/rcache/rc_mem.c - process-wide in-memory replay cache type */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The mem replay cache type keeps replay records in memory for the life of the
+ * process.  All handles resolved with the same residual share one set of
+ * records, so a multithreaded acceptor can detect replays without file I/O
+ * even if it opens a new handle for each authentication.
+ *
+ * Records are spread across shards by a keyed hash of the tag, each with its
+ * own lock, so that concurrent stores seldom contend.  Within a shard, records
+ * are grouped into buckets by arrival time, and a whole bucket is discarded
+ * once its newest possible record is older than the clock skew, so expiry
+ * examines one bucket rather than every record.  Each shard may use an equal
+ * part of the memory limit; a store which would exceed it fails rather than
+ * discarding records which have not yet expired.
+ */
+
+#include "k5-int.h"
+#include "k5-queue.h"
+#include "k5-hashtab.h"
+#include "k5-thread.h"
+#include "rc-int.h"
+
+#define MEMRC_SHARDS 64
+#define BUCKET_SECONDS 10
+#define DEFAULT_LIMIT_KB (64 * 1024)
+
+struct entry {
+    struct entry *next;         /* next entry in the same bucket */
+    krb5_data tag;              /* points just past this structure */
+};
+
+struct bucket {
+    K5_TAILQ_ENTRY(bucket) links;
+    krb5_timestamp start;       /* arrival time of the first entry */
+    struct entry *entries;
+};
+
+K5_TAILQ_HEAD(bucket_queue, bucket);
+
+struct shard {
+    k5_mutex_t lock;
+    struct k5_hashtab *table;
+    struct bucket_queue buckets;
+    size_t used;                /* bytes of entries in this shard */
+};
+
+struct memrc {
+    struct memrc *next;
+    char *name;
+    uint8_t seed[K5_HASH_SEED_LEN];
+    size_t nshards;
+    size_t shard_limit;
+    struct shard *shards;
+};
+
+static k5_mutex_t memrc_lock = K5_MUTEX_PARTIAL_INITIALIZER;
+static struct memrc *memrc_list;
+
+/* Remove the entries in b from shard and free them along with b. */
+static void
+discard_bucket(struct shard *shard, struct bucket *b)
+{
+    struct entry *e, *next;
+
+    for (e = b->entries; e != NULL; e = next) {
+        next = e->next;
+        k5_hashtab_remove(shard->table, e->tag.data, e->tag.length);
+        shard->used -= sizeof(*e) + e->tag.length;
+        free(e);
+    }
+    free(b);
+}
+
+/* Discard the buckets of shard whose entries are all older than skew. */
+static void
+expire_buckets(struct shard *shard, krb5_timestamp now, krb5_deltat skew)
+{
+    struct bucket *b;
+
+    while ((b = K5_TAILQ_FIRST(&shard->buckets)) != NULL &&
+           ts_delta(now, b->start) > BUCKET_SECONDS + skew) {
+        K5_TAILQ_REMOVE(&shard->buckets, b, links);
+        discard_bucket(shard, b);
+    }
+}
+
+static krb5_error_code
+insert_entry(struct shard *shard, const krb5_data *tag, krb5_timestamp now)
+{
+    struct bucket *b;
+    struct entry *e;
+
+    b = K5_TAILQ_LAST(&shard->buckets, bucket_queue);
+    if (b == NULL || ts_delta(now, b->start) >= BUCKET_SECONDS) {
+        b = calloc(1, sizeof(*b));
+        if (b == NULL)
+            return ENOMEM;
+        b->start = now;
+        K5_TAILQ_INSERT_TAIL(&shard->buckets, b, links);
+    }
+
+    e = malloc(sizeof(*e) + tag->length);
+    if (e == NULL)
+        return ENOMEM;
+    e->tag = make_data(e + 1, tag->length);
+    if (tag->length > 0)
+        memcpy(e->tag.data, tag->data, tag->length);
+    if (k5_hashtab_add(shard->table, e->tag.data, e->tag.length, e) != 0) {
+        free(e);
+        return ENOMEM;
+    }
+    e->next = b->entries;
+    b->entries = e;
+    shard->used += sizeof(*e) + e->tag.length;
+    return 0;
+}
+
+static void
+memrc_free(struct memrc *mrc)
+{
+    struct shard *shard;
+    struct bucket *b;
+    size_t i;
+
+    if (mrc == NULL)
+        return;
+    for (i = 0; i < mrc->nshards && mrc->shards != NULL; i++) {
+        shard = &mrc->shards[i];
+        if (shard->table == NULL)
+            continue;
+        while ((b = K5_TAILQ_FIRST(&shard->buckets)) != NULL) {
+            K5_TAILQ_REMOVE(&shard->buckets, b, links);
+            discard_bucket(shard, b);
+        }
+        k5_hashtab_free(shard->table);
+        k5_mutex_destroy(&shard->lock);
+    }
+    free(mrc->shards);
+    free(mrc->name);
+    free(mrc);
+}
+
+/* Create a cache named name with nshards shards sharing limit bytes. */
+static krb5_error_code
+memrc_create(krb5_context context, const char *name, size_t nshards,
+             size_t limit, struct memrc **mrc_out)
+{
+    krb5_error_code ret;
+    struct memrc *mrc;
+    struct shard *shard;
+    uint8_t seed[K5_HASH_SEED_LEN];
+    krb5_data d;
+    size_t i;
+
+    *mrc_out = NULL;
+
+    mrc = k5alloc(sizeof(*mrc), &ret);
+    if (mrc == NULL)
+        return ret;
+    mrc->name = k5memdup0(name, strlen(name), &ret);
+    if (mrc->name == NULL)
+        goto error;
+    d = make_data(mrc->seed, sizeof(mrc->seed));
+    ret = krb5_c_random_make_octets(context, &d);
+    if (ret)
+        goto error;
+    mrc->shards = k5calloc(nshards, sizeof(*mrc->shards), &ret);
+    if (mrc->shards == NULL)
+        goto error;
+    mrc->nshards = nshards;
+    mrc->shard_limit = limit / nshards;
+
+    for (i = 0; i < nshards; i++) {
+        shard = &mrc->shards[i];
+        d = make_data(seed, sizeof(seed));
+        ret = krb5_c_random_make_octets(context, &d);
+        if (ret)
+            goto error;
+        ret = k5_mutex_init(&shard->lock);
+        if (ret)
+            goto error;
+        ret = k5_hashtab_create(seed, 64, &shard->table);
+        if (ret) {
+            k5_mutex_destroy(&shard->lock);
+            goto error;
+        }
+        K5_TAILQ_INIT(&shard->buckets);
+    }
+
+    *mrc_out = mrc;
+    return 0;
+
+error:
+    memrc_free(mrc);
+    return ret;
+}
+
+/* Check tag against mrc and record it if it is not a replay. */
+static krb5_error_code
+memrc_store(krb5_context context, struct memrc *mrc, const krb5_data *tag)
+{
+    krb5_error_code ret;
+    krb5_timestamp now;
+    struct shard *shard;
+    uint64_t hash;
+
+    ret = krb5_timeofday(context, &now);
+    if (ret)
+        return ret;
+
+    hash = k5_siphash24((uint8_t *)tag->data, tag->length, mrc->seed);
+    shard = &mrc->shards[hash % mrc->nshards];
+
+    k5_mutex_lock(&shard->lock);
+    expire_buckets(shard, now, context->clockskew);
+    if (k5_hashtab_get(shard->table, tag->data, tag->length) != NULL) {
+        ret = KRB5KRB_AP_ERR_REPEAT;
+    } else if (shard->used + sizeof(struct entry) + tag->length >
+               mrc->shard_limit) {
+        ret = KRB5_RC_IO_SPACE;
+        k5_setmsg(context, ret, _("Replay cache memory limit reached"));
+    } else {
+        ret = insert_entry(shard, tag, now);
+    }
+    k5_mutex_unlock(&shard->lock);
+    return ret;
+}
+
+/* Get the memory limit for new caches in bytes from the profile. */
+static krb5_error_code
+get_limit(krb5_context context, size_t *limit_out)
+{
+    krb5_error_code ret;
+    int kb;
+
+    *limit_out = 0;
+    ret = profile_get_integer(context->profile, KRB5_CONF_LIBDEFAULTS,
+                              KRB5_CONF_MEM_RCACHE_LIMIT, NULL,
+                              DEFAULT_LIMIT_KB, &kb);
+    if (ret)
+        return ret;
+    if (kb <= 0) {
+        k5_setmsg(context, EINVAL, _("Invalid mem_rcache_limit value %d"),
+                  kb);
+        return EINVAL;
+    }
+    *limit_out = (size_t)kb * 1024;
+    return 0;
+}
+
+static krb5_error_code
+mem_resolve(krb5_context context, const char *residual, void **rcdata_out)
+{
+    krb5_error_code ret = 0;
+    struct memrc *mrc;
+    size_t limit;
+
+    *rcdata_out = NULL;
+
+    k5_mutex_lock(&memrc_lock);
+    for (mrc = memrc_list; mrc != NULL; mrc = mrc->next) {
+        if (strcmp(mrc->name, residual) == 0)
+            break;
+    }
+    if (mrc == NULL) {
+        ret = get_limit(context, &limit);
+        if (!ret)
+            ret = memrc_create(context, residual, MEMRC_SHARDS, limit, &mrc);
+        if (!ret) {
+            mrc->next = memrc_list;
+            memrc_list = mrc;
+        }
+    }
+    k5_mutex_unlock(&memrc_lock);
+
+    *rcdata_out = mrc;
+    return ret;
+}
+
+static void
+mem_close(krb5_context context, void *rcdata)
+{
+    /* The records persist until the library is unloaded. */
+}
+
+static krb5_error_code
+mem_store(krb5_context context, void *rcdata, const krb5_data *tag)
+{
+    return memrc_store(context, rcdata, tag);
+}
+
+int
+k5_rc_mem_initialize(void)
+{
+    return k5_mutex_finish_init(&memrc_lock);
+}
+
+void
+k5_rc_mem_finalize(void)
+{
+    struct memrc *mrc, *next;
+
+    for (mrc = memrc_list; mrc != NULL; mrc = next) {
+        next = mrc->next;
+        memrc_free(mrc);
+    }
+    memrc_list = NULL;
+    k5_mutex_destroy(&memrc_lock);
+}
+
+const krb5_rc_ops k5_rc_mem_ops = {
+    "mem",
+    mem_resolve,
+    mem_close,
+    mem_store
+};
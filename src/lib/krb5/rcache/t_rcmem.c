@@ -0,0 +1,275 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* lib/krb5/rcache/t_rcmem.c - mem replay cache tests and benchmark */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program checks replay detection, bucketed expiry, and the memory
+ * limit of the mem replay cache type, checks that handles with the same
+ * residual share records, then measures the rate of stores by increasing
+ * numbers of threads into a cache with one shard and a cache with the default
+ * number of shards.  Usage:
+ *
+ *     ./t_rcmem count
+ */
+
+#include "rc_mem.c"
+#include <pthread.h>
+#include <sys/time.h>
+
+#define ENTRY_SIZE(len) (sizeof(struct entry) + (len))
+
+static const int nthreads_list[] = { 1, 2, 4, 8 };
+
+struct worker {
+    pthread_t thread;
+    struct memrc *mrc;
+    int id;
+    int count;
+};
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static krb5_error_code
+store(krb5_context ctx, struct memrc *mrc, uint32_t n)
+{
+    uint8_t tag[4];
+    krb5_data d = make_data(tag, sizeof(tag));
+
+    store_32_be(n, tag);
+    return memrc_store(ctx, mrc, &d);
+}
+
+static size_t
+count_buckets(struct memrc *mrc)
+{
+    struct bucket *b;
+    size_t i, n = 0;
+
+    for (i = 0; i < mrc->nshards; i++) {
+        K5_TAILQ_FOREACH(b, &mrc->shards[i].buckets, links)
+            n++;
+    }
+    return n;
+}
+
+static size_t
+total_used(struct memrc *mrc)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < mrc->nshards; i++)
+        n += mrc->shards[i].used;
+    return n;
+}
+
+static void
+test_replay(krb5_context ctx)
+{
+    struct memrc *mrc;
+    uint32_t i;
+
+    /* Store a thousand unique tags, then verify that they all appear as
+     * replays. */
+    assert(memrc_create(ctx, "test", 4, 1024 * 1024, &mrc) == 0);
+    for (i = 0; i < 1000; i++)
+        assert(store(ctx, mrc, i) == 0);
+    for (i = 0; i < 1000; i++)
+        assert(store(ctx, mrc, i) == KRB5KRB_AP_ERR_REPEAT);
+    assert(total_used(mrc) == 1000 * ENTRY_SIZE(4));
+    memrc_free(mrc);
+}
+
+static void
+test_expiry(krb5_context ctx)
+{
+    struct memrc *mrc;
+    uint32_t i;
+
+    /* Entries arriving within one bucket interval share a bucket. */
+    ctx->clockskew = 100;
+    assert(memrc_create(ctx, "test", 1, 1024 * 1024, &mrc) == 0);
+    krb5_set_debugging_time(ctx, 1000, 0);
+    assert(store(ctx, mrc, 1) == 0);
+    krb5_set_debugging_time(ctx, 1000 + BUCKET_SECONDS - 1, 0);
+    assert(store(ctx, mrc, 2) == 0);
+    assert(count_buckets(mrc) == 1);
+
+    /* The bucket is kept while either entry might still be replayed. */
+    krb5_set_debugging_time(ctx, 1000 + BUCKET_SECONDS + 100, 0);
+    assert(store(ctx, mrc, 1) == KRB5KRB_AP_ERR_REPEAT);
+    assert(count_buckets(mrc) == 1);
+
+    /* Once both have expired, the whole bucket is discarded. */
+    krb5_set_debugging_time(ctx, 1000 + BUCKET_SECONDS + 101, 0);
+    assert(store(ctx, mrc, 2) == 0);
+    assert(count_buckets(mrc) == 1);
+    memrc_free(mrc);
+
+    /* Store a thousand unique tags, each spaced out so that previous entries
+     * appear as expired.  Expiry only visits the shard being stored to, so
+     * use one shard and verify that only one entry remains. */
+    assert(memrc_create(ctx, "test", 1, 1024 * 1024, &mrc) == 0);
+    for (i = 1; i < 1000; i++) {
+        krb5_set_debugging_time(ctx, i * 200, 0);
+        assert(store(ctx, mrc, i) == 0);
+    }
+    assert(count_buckets(mrc) == 1);
+    assert(total_used(mrc) == ENTRY_SIZE(4));
+    memrc_free(mrc);
+}
+
+static void
+test_limit(krb5_context ctx)
+{
+    struct memrc *mrc;
+    uint32_t i;
+
+    /* Fill a one-shard cache to its limit and verify that further stores are
+     * refused until the existing entries expire. */
+    ctx->clockskew = 100;
+    assert(memrc_create(ctx, "test", 1, 10 * ENTRY_SIZE(4), &mrc) == 0);
+    krb5_set_debugging_time(ctx, 1000, 0);
+    for (i = 0; i < 10; i++)
+        assert(store(ctx, mrc, i) == 0);
+    assert(store(ctx, mrc, 10) == KRB5_RC_IO_SPACE);
+    assert(store(ctx, mrc, 0) == KRB5KRB_AP_ERR_REPEAT);
+    krb5_set_debugging_time(ctx, 1000 + BUCKET_SECONDS + 101, 0);
+    assert(store(ctx, mrc, 10) == 0);
+    memrc_free(mrc);
+}
+
+static void
+test_shared(krb5_context ctx)
+{
+    krb5_rcache rc1, rc2;
+    uint8_t tag[4] = { 1, 2, 3, 4 };
+    krb5_data d = make_data(tag, sizeof(tag));
+
+    /* Handles with the same residual share records, even after every handle
+     * has been closed. */
+    krb5_set_debugging_time(ctx, 1000, 0);
+    assert(k5_rc_resolve(ctx, "mem:shared", &rc1) == 0);
+    assert(k5_rc_resolve(ctx, "mem:shared", &rc2) == 0);
+    assert(rc1->ops->store(ctx, rc1->data, &d) == 0);
+    assert(rc2->ops->store(ctx, rc2->data, &d) == KRB5KRB_AP_ERR_REPEAT);
+    k5_rc_close(ctx, rc1);
+    k5_rc_close(ctx, rc2);
+    assert(k5_rc_resolve(ctx, "mem:shared", &rc1) == 0);
+    assert(rc1->ops->store(ctx, rc1->data, &d) == KRB5KRB_AP_ERR_REPEAT);
+    k5_rc_close(ctx, rc1);
+
+    /* A different residual names a different cache. */
+    assert(k5_rc_resolve(ctx, "mem:other", &rc1) == 0);
+    assert(rc1->ops->store(ctx, rc1->data, &d) == 0);
+    k5_rc_close(ctx, rc1);
+}
+
+static void *
+run_worker(void *arg)
+{
+    struct worker *w = arg;
+    krb5_context ctx;
+    int i;
+
+    assert(krb5_init_context(&ctx) == 0);
+    for (i = 0; i < w->count; i++)
+        assert(store(ctx, w->mrc, (uint32_t)w->id << 24 | i) == 0);
+    krb5_free_context(ctx);
+    return NULL;
+}
+
+static void
+bench(krb5_context ctx, size_t nshards, int nthreads, int count)
+{
+    struct memrc *mrc;
+    struct worker workers[8];
+    struct timeval start;
+    double secs;
+    int i;
+
+    assert(memrc_create(ctx, "bench", nshards, (size_t)1 << 30, &mrc) == 0);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nthreads; i++) {
+        workers[i].mrc = mrc;
+        workers[i].id = i;
+        workers[i].count = count / nthreads;
+        assert(pthread_create(&workers[i].thread, NULL, run_worker,
+                              &workers[i]) == 0);
+    }
+    for (i = 0; i < nthreads; i++)
+        assert(pthread_join(workers[i].thread, NULL) == 0);
+    secs = elapsed(&start);
+    if (secs <= 0)
+        secs = 1e-6;
+    count = count / nthreads * nthreads;
+    printf("%d stores by %d threads into %d shards in %.3f s (%.0f/s)\n",
+           count, nthreads, (int)nshards, secs, count / secs);
+    memrc_free(mrc);
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    size_t s;
+    int count;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: t_rcmem count\n");
+        exit(1);
+    }
+    count = atoi(argv[1]);
+
+    assert(k5_rc_mem_initialize() == 0);
+    assert(krb5_init_context(&ctx) == 0);
+    test_replay(ctx);
+    test_expiry(ctx);
+    test_limit(ctx);
+    test_shared(ctx);
+    krb5_free_context(ctx);
+
+    assert(krb5_init_context(&ctx) == 0);
+    for (s = 0; s < sizeof(nthreads_list) / sizeof(*nthreads_list); s++) {
+        bench(ctx, 1, nthreads_list[s], count);
+        bench(ctx, MEMRC_SHARDS, nthreads_list[s], count);
+    }
+    krb5_free_context(ctx);
+    k5_rc_mem_finalize();
+    return 0;
+}
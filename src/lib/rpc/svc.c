@@ -53,8 +53,14 @@ static char sccsid[] = "@(#)svc.c 1.41 87/10/13 Copyr 1984 Sun Micro";
 #include <string.h>
 #include <errno.h>
 
-#ifdef FD_SETSIZE
+/*
+ * Transports indexed by descriptor.  The table grows as needed, so
+ * descriptors above FD_SETSIZE can be served through svc_getreq_fd();
+ * svc_fdset and svc_maxfd only cover descriptors which fit in an fd_set.
+ */
 static SVCXPRT **xports;
+static int xports_size;
+#ifdef FD_SETSIZE
 extern int gssrpc_svc_fdset_init;
 #else
 
@@ -63,10 +69,11 @@ extern int gssrpc_svc_fdset_init;
 #else
 #define NOFILE (sizeof(int) * 8)
 #endif
-
-static SVCXPRT *xports[NOFILE];
 #endif /* def FD_SETSIZE */
 
+static svc_xprt_notify_fn xprt_notify;
+static void *xprt_notify_data;
+
 #define NULL_SVC ((struct svc_callout *)0)
 #define	RQCRED_SIZE	1024		/* this size is excessive */
 
@@ -90,6 +97,28 @@ static void svc_do_xprt(SVCXPRT *xprt);
 
 /* ***************  SVCXPRT related stuff **************** */
 
+/* Make room in xports for descriptor sock.  Return FALSE on failure. */
+static bool_t
+grow_xports(int sock)
+{
+	SVCXPRT **newx;
+	int newsize;
+
+	if (sock < xports_size)
+		return (TRUE);
+	newsize = (xports_size == 0) ? 64 : xports_size;
+	while (newsize <= sock)
+		newsize *= 2;
+	newx = realloc(xports, newsize * sizeof(SVCXPRT *));
+	if (newx == NULL)
+		return (FALSE);
+	memset(newx + xports_size, 0,
+	       (newsize - xports_size) * sizeof(SVCXPRT *));
+	xports = newx;
+	xports_size = newsize;
+	return (TRUE);
+}
+
 /*
  * Activate a transport handle.
  */
@@ -98,30 +127,28 @@ xprt_register(SVCXPRT *xprt)
 {
 	int sock = xprt->xp_sock;
 
+	if (sock < 0 || !grow_xports(sock))
+		return;
+	xports[sock] = xprt;
 #ifdef FD_SETSIZE
 	if (gssrpc_svc_fdset_init == 0) {
 		FD_ZERO(&svc_fdset);
 		gssrpc_svc_fdset_init++;
 	}
-	if (xports == NULL) {
-		xports = (SVCXPRT **)
-			mem_alloc(FD_SETSIZE * sizeof(SVCXPRT *));
-		memset(xports, 0, FD_SETSIZE * sizeof(SVCXPRT *));
-	}
 	if (sock < FD_SETSIZE) {
-		xports[sock] = xprt;
 		FD_SET(sock, &svc_fdset);
 		if (sock > svc_maxfd)
 			svc_maxfd = sock;
 	}
 #else
 	if (sock < NOFILE) {
-		xports[sock] = xprt;
 		svc_fds |= (1 << sock);
 		if (sock > svc_maxfd)
 			svc_maxfd = sock;
 	}
 #endif /* def FD_SETSIZE */
+	if (xprt_notify != NULL)
+		(*xprt_notify)(xprt, TRUE, xprt_notify_data);
 }
 
 /*
@@ -132,21 +159,45 @@ xprt_unregister(SVCXPRT *xprt)
 {
 	int sock = xprt->xp_sock;
 
+	if (sock < 0 || sock >= xports_size || xports[sock] != xprt)
+		return;
+	xports[sock] = (SVCXPRT *)0;
 #ifdef FD_SETSIZE
-	if ((sock < FD_SETSIZE) && (xports[sock] == xprt)) {
-		xports[sock] = (SVCXPRT *)0;
+	if (sock < FD_SETSIZE)
 		FD_CLR(sock, &svc_fdset);
-	}
 #else
-	if ((sock < NOFILE) && (xports[sock] == xprt)) {
-		xports[sock] = (SVCXPRT *)0;
+	if (sock < NOFILE)
 		svc_fds &= ~(1 << sock);
-	}
 #endif /* def FD_SETSIZE */
 	if (svc_maxfd <= sock) {
 		while ((svc_maxfd > 0) && xports[svc_maxfd] == 0)
 			svc_maxfd--;
 	}
+	if (xprt_notify != NULL)
+		(*xprt_notify)(xprt, FALSE, xprt_notify_data);
+}
+
+/*
+ * Arrange for fn to be called with data whenever a transport handle is
+ * activated or de-activated, such as when a connection is accepted on a
+ * TCP rendezvous transport.
+ */
+void
+svc_set_xprt_notify(svc_xprt_notify_fn fn, void *data)
+{
+	xprt_notify = fn;
+	xprt_notify_data = data;
+}
+
+/*
+ * Return the active transport handle for descriptor sock, or NULL.
+ */
+SVCXPRT *
+svc_fd_xprt(int sock)
+{
+	if (sock < 0 || sock >= xports_size)
+		return (NULL);
+	return (xports[sock]);
 }
 
 
@@ -425,22 +476,39 @@ svc_getreqset(FDSET_TYPE *readfds)
 		if (!FD_ISSET(sock, readfds))
 			continue;
 		/* sock has input waiting */
-		xprt = xports[sock];
+		xprt = svc_fd_xprt(sock);
 		/* now receive msgs from xprtprt (support batch calls) */
-		svc_do_xprt(xprt);
+		if (xprt != NULL)
+			svc_do_xprt(xprt);
 	}
 #else
 	for (sock = 0; readfds_local != 0; sock++, readfds_local >>= 1) {
 		if ((readfds_local & 1) == 0)
 			continue;
 		/* sock has input waiting */
-		xprt = xports[sock];
+		xprt = svc_fd_xprt(sock);
 		/* now receive msgs from xprtprt (support batch calls) */
-		svc_do_xprt(xprt);
+		if (xprt != NULL)
+			svc_do_xprt(xprt);
 	}
 #endif
 }
 
+/*
+ * Receive and dispatch the requests waiting on descriptor sock, which
+ * need not fit in an fd_set.  This is meant for callers which watch
+ * each descriptor separately, using svc_set_xprt_notify() to learn of
+ * new ones.
+ */
+void
+svc_getreq_fd(int sock)
+{
+	SVCXPRT *xprt = svc_fd_xprt(sock);
+
+	if (xprt != NULL)
+		svc_do_xprt(xprt);
+}
+
 extern struct svc_auth_ops svc_auth_gss_ops;
 
 static void
@@ -49,6 +49,9 @@ static char sccsid[] = "@(#)svc_tcp.c 1.21 87/08/11 Copyr 1984 Sun Micro";
 #include <sys/socket.h>
 #include <port-sockets.h>
 #include <socket-utils.h>
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 /*extern bool_t abort();
 extern errno;
 */
@@ -175,7 +178,9 @@ svctcp_create(
                         (void)closesocket(sock);
 		return ((SVCXPRT *)NULL);
 	}
-	if (listen(sock, 2) != 0) {
+	/* Let the system queue as many connections as it allows, so that a
+	 * burst of clients is not refused while the server is busy. */
+	if (listen(sock, SOMAXCONN) != 0) {
 		perror("svctcp_.c - cannot listen");
                 if (madesock)
                         (void)closesocket(sock);
@@ -228,6 +233,9 @@ makefd_xprt(
 	SVCXPRT *xprt;
 	struct tcp_conn *cd;
 
+	/* Without poll(), readtcp() can only wait for descriptors which fit
+	 * in an fd_set. */
+#ifndef HAVE_POLL_H
 #ifdef FD_SETSIZE
 	if (fd >= FD_SETSIZE) {
 		(void) fprintf(stderr, "svc_tcp: makefd_xprt: fd too high\n");
@@ -241,6 +249,7 @@ makefd_xprt(
 		goto done;
 	}
 #endif
+#endif /* !HAVE_POLL_H */
 	xprt = (SVCXPRT *)mem_alloc(sizeof(SVCXPRT));
 	if (xprt == (SVCXPRT *)NULL) {
 		(void) fprintf(stderr, "svc_tcp: makefd_xprt: out of memory\n");
@@ -356,6 +365,24 @@ readtcp(
 {
 	SVCXPRT *xprt = (void *)xprtptr;
 	int sock = xprt->xp_sock;
+#ifdef HAVE_POLL_H
+	struct pollfd pfd;
+	int tout = wait_per_try.tv_sec * 1000 + wait_per_try.tv_usec / 1000;
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	do {
+		pfd.revents = 0;
+		switch (poll(&pfd, 1, tout)) {
+		case -1:
+			if (errno == EINTR)
+				continue;
+			goto fatal_err;
+		case 0:
+			goto fatal_err;
+		}
+	} while (pfd.revents == 0);
+#else /* !HAVE_POLL_H */
 	struct timeval tout;
 #ifdef FD_SETSIZE
 	fd_set mask;
@@ -383,6 +410,7 @@ readtcp(
 			goto fatal_err;
 		}
 	} while (loopcond);
+#endif /* !HAVE_POLL_H */
 	if ((len = read(sock, buf, (size_t) len)) > 0) {
 		return (len);
 	}
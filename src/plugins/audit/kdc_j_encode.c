@@ -37,32 +37,27 @@
 #include <krb5/audit_plugin.h>
 #include <syslog.h>
 
-static krb5_error_code
-string_to_value(const char *in, k5_json_object obj, const char *key);
-static krb5_error_code
-princ_to_value(krb5_principal princ, k5_json_object obj, const char *key);
-static krb5_error_code
-data_to_value(krb5_data *data, k5_json_object obj, const char *key);
-static krb5_error_code
-int32_to_value(krb5_int32 int32, k5_json_object obj, const char *key);
-static krb5_error_code
-bool_to_value(krb5_boolean b, k5_json_object obj, const char *key);
-static krb5_error_code
-addr_to_obj(krb5_address *a, k5_json_object obj);
-static krb5_error_code
-eventinfo_to_value(k5_json_object obj, const char *name,
-                   const int stage, const krb5_boolean ev_success);
-static krb5_error_code
-addr_to_value(const krb5_address *address, k5_json_object obj,
-              const char *key);
-static krb5_error_code
-req_to_value(krb5_kdc_req *req, const krb5_boolean ev_success,
-             k5_json_object obj);
-static krb5_error_code
-rep_to_value(krb5_kdc_rep *rep, const krb5_boolean ev_success,
-             k5_json_object obj);
-static krb5_error_code
-tkt_to_value(krb5_ticket *tkt, k5_json_object obj, const char *key);
+static void string_to_value(k5_json_writer *w, const char *in,
+                            const char *key);
+static void princ_to_value(k5_json_writer *w, krb5_principal princ,
+                           const char *key);
+static void data_to_value(k5_json_writer *w, krb5_data *data,
+                          const char *key);
+static void int32_to_value(k5_json_writer *w, krb5_int32 int32,
+                           const char *key);
+static void bool_to_value(k5_json_writer *w, krb5_boolean b,
+                          const char *key);
+static void addr_to_obj(k5_json_writer *w, krb5_address *a);
+static void eventinfo_to_value(k5_json_writer *w, const char *name,
+                               const int stage, const krb5_boolean ev_success);
+static void addr_to_value(k5_json_writer *w, const krb5_address *address,
+                          const char *key);
+static void req_to_value(k5_json_writer *w, krb5_kdc_req *req,
+                         const krb5_boolean ev_success);
+static void rep_to_value(k5_json_writer *w, krb5_kdc_rep *rep,
+                         const krb5_boolean ev_success);
+static void tkt_to_value(k5_json_writer *w, krb5_ticket *tkt,
+                         const char *key);
 static char *map_patype(krb5_preauthtype pa_type);
 
 #define NULL_STATE "state is NULL"
@@ -71,52 +66,68 @@ static char *map_patype(krb5_preauthtype pa_type);
 #define T_VALIDATED 1
 #define T_NOT_VALIDATED 2
 
+/*
+ * Events are written directly into a k5buf as they are walked, rather than
+ * being assembled into a k5_json value tree and then encoded.  Object members
+ * are written in the order the tree-based encoder used to insert them, so the
+ * output is unchanged.  Buffer allocation failures are detected once, when
+ * the event is finished.
+ */
+
+/* Begin a top-level event object in buf. */
+static void
+event_begin(struct k5buf *buf, k5_json_writer *w)
+{
+    k5_buf_init_dynamic(buf);
+    k5_json_writer_init(w, buf);
+    k5_json_write_begin_object(w);
+}
+
+/* Finish the event object in buf and return its text in *jout. */
+static krb5_error_code
+event_finish(struct k5buf *buf, k5_json_writer *w, char **jout)
+{
+    k5_json_write_end_object(w);
+    if (k5_buf_status(buf) != 0)
+        return ENOMEM;
+    *jout = buf->data;
+    return 0;
+}
+
 /* KDC server STOP. Returns 0 on success. */
 krb5_error_code
 kau_j_kdc_stop(const krb5_boolean ev_success, char **jout)
 {
-    krb5_error_code ret = 0;
-    k5_json_object obj = NULL;
+    struct k5buf buf;
+    k5_json_writer w;
 
     *jout = NULL;
 
     /* Main object. */
-    if (k5_json_object_create(&obj))
-        return ENOMEM;
+    event_begin(&buf, &w);
 
     /* Audit event_ID and ev_success. */
-    ret = string_to_value("KDC_STOP", obj, AU_EVENT_NAME);
-    if (!ret)
-        ret = bool_to_value(ev_success, obj, AU_EVENT_STATUS);
-    if (!ret)
-        ret = k5_json_encode(obj, jout);
-    k5_json_release(obj);
-
-    return ret;
+    string_to_value(&w, "KDC_STOP", AU_EVENT_NAME);
+    bool_to_value(&w, ev_success, AU_EVENT_STATUS);
+    return event_finish(&buf, &w, jout);
 }
 
 /* KDC server START. Returns 0 on success. */
 krb5_error_code
 kau_j_kdc_start(const krb5_boolean ev_success, char **jout)
 {
-    krb5_error_code ret = 0;
-    k5_json_object obj = NULL;
+    struct k5buf buf;
+    k5_json_writer w;
 
     *jout = NULL;
 
     /* Main object. */
-    if (k5_json_object_create(&obj))
-        return ENOMEM;
+    event_begin(&buf, &w);
 
     /* Audit event_ID and ev_success. */
-    ret = string_to_value("KDC_START", obj, AU_EVENT_NAME);
-    if (!ret)
-        ret = bool_to_value(ev_success, obj, AU_EVENT_STATUS);
-    if (!ret)
-        ret = k5_json_encode(obj, jout);
-    k5_json_release(obj);
-
-    return ret;
+    string_to_value(&w, "KDC_START", AU_EVENT_NAME);
+    bool_to_value(&w, ev_success, AU_EVENT_STATUS);
+    return event_finish(&buf, &w, jout);
 }
 
 /* AS-REQ. Returns 0 on success. */
@@ -124,8 +135,8 @@ krb5_error_code
 kau_j_as_req(const krb5_boolean ev_success, krb5_audit_state *state,
              char **jout)
 {
-    krb5_error_code ret = 0;
-    k5_json_object obj = NULL;
+    struct k5buf buf;
+    k5_json_writer w;
 
     *jout = NULL;
 
@@ -135,48 +146,25 @@ kau_j_as_req(const krb5_boolean ev_success, krb5_audit_state *state,
     }
 
     /* Main object. */
-    if (k5_json_object_create(&obj))
-        return ENOMEM;
+    event_begin(&buf, &w);
     /* Audit event_ID and ev_success. */
-    ret = eventinfo_to_value(obj, "AS_REQ", state->stage, ev_success);
-    if (ret)
-        goto error;
+    eventinfo_to_value(&w, "AS_REQ", state->stage, ev_success);
     /* TGT ticket ID */
-    ret = string_to_value(state->tkt_out_id, obj, AU_TKT_OUT_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->tkt_out_id, AU_TKT_OUT_ID);
     /* Request ID. */
-    ret = string_to_value(state->req_id, obj, AU_REQ_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->req_id, AU_REQ_ID);
     /* Client's port and address. */
-    ret = int32_to_value(state->cl_port, obj, AU_FROMPORT);
-    if (ret)
-        goto error;
-    ret = addr_to_value(state->cl_addr, obj, AU_FROMADDR);
-    if (ret)
-        goto error;
+    int32_to_value(&w, state->cl_port, AU_FROMPORT);
+    addr_to_value(&w, state->cl_addr, AU_FROMADDR);
     /* KDC status msg */
-    ret = string_to_value(state->status, obj, AU_KDC_STATUS);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->status, AU_KDC_STATUS);
     /* non-local client's referral realm. */
-    ret = data_to_value(state->cl_realm, obj, AU_CREF_REALM);
-    if (ret)
-        goto error;
+    data_to_value(&w, state->cl_realm, AU_CREF_REALM);
     /* Request. */
-    ret = req_to_value(state->request, ev_success, obj);
-    if (ret == ENOMEM)
-        goto error;
+    req_to_value(&w, state->request, ev_success);
     /* Reply/ticket info. */
-    ret = rep_to_value(state->reply, ev_success, obj);
-    if (ret == ENOMEM)
-        goto error;
-    ret = k5_json_encode(obj, jout);
-
-error:
-    k5_json_release(obj);
-    return ret;
+    rep_to_value(&w, state->reply, ev_success);
+    return event_finish(&buf, &w, jout);
 }
 
 /* TGS-REQ. Returns 0 on success. */
@@ -184,8 +172,8 @@ krb5_error_code
 kau_j_tgs_req(const krb5_boolean ev_success, krb5_audit_state *state,
               char **jout)
 {
-    krb5_error_code ret = 0;
-    k5_json_object obj = NULL;
+    struct k5buf buf;
+    k5_json_writer w;
     krb5_kdc_req *req = state->request;
     int tkt_validated = 0, tkt_renewed = 0;
 
@@ -197,31 +185,18 @@ kau_j_tgs_req(const krb5_boolean ev_success, krb5_audit_state *state,
     }
 
     /* Main object. */
-    if (k5_json_object_create(&obj))
-        return ENOMEM;
+    event_begin(&buf, &w);
 
     /* Audit Event ID and ev_success. */
-    ret = eventinfo_to_value(obj, "TGS_REQ", state->stage, ev_success);
-    if (ret)
-        goto error;
+    eventinfo_to_value(&w, "TGS_REQ", state->stage, ev_success);
     /* Primary and derived ticket IDs. */
-    ret = string_to_value(state->tkt_in_id, obj, AU_TKT_IN_ID);
-    if (ret)
-        goto error;
-    ret = string_to_value(state->tkt_out_id, obj, AU_TKT_OUT_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->tkt_in_id, AU_TKT_IN_ID);
+    string_to_value(&w, state->tkt_out_id, AU_TKT_OUT_ID);
     /* Request ID */
-    ret = string_to_value(state->req_id, obj, AU_REQ_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->req_id, AU_REQ_ID);
     /* client’s address and port. */
-    ret = int32_to_value(state->cl_port, obj, AU_FROMPORT);
-    if (ret)
-        goto error;
-    ret = addr_to_value(state->cl_addr, obj, AU_FROMADDR);
-    if (ret)
-        goto error;
+    int32_to_value(&w, state->cl_port, AU_FROMPORT);
+    addr_to_value(&w, state->cl_addr, AU_FROMADDR);
     /* Ticket was renewed, validated. */
     if ((ev_success == TRUE) && (req != NULL)) {
         tkt_renewed = (req->kdc_options & KDC_OPT_RENEW) ?
@@ -229,29 +204,15 @@ kau_j_tgs_req(const krb5_boolean ev_success, krb5_audit_state *state,
         tkt_validated = (req->kdc_options & KDC_OPT_VALIDATE) ?
                       T_VALIDATED : T_NOT_VALIDATED;
     }
-    ret = int32_to_value(tkt_renewed, obj, AU_TKT_RENEWED);
-    if (ret)
-        goto error;
-    ret = int32_to_value(tkt_validated, obj, AU_TKT_VALIDATED);
-    if (ret)
-        goto error;
+    int32_to_value(&w, tkt_renewed, AU_TKT_RENEWED);
+    int32_to_value(&w, tkt_validated, AU_TKT_VALIDATED);
     /* KDC status msg, including "ISSUE". */
-    ret = string_to_value(state->status, obj, AU_KDC_STATUS);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->status, AU_KDC_STATUS);
     /* request */
-    ret = req_to_value(req, ev_success, obj);
-    if (ret == ENOMEM)
-        goto error;
+    req_to_value(&w, req, ev_success);
     /* reply/ticket */
-    ret = rep_to_value(state->reply, ev_success, obj);
-    if (ret == ENOMEM)
-        goto error;
-    ret = k5_json_encode(obj, jout);
-
-error:
-    k5_json_release(obj);
-    return ret;
+    rep_to_value(&w, state->reply, ev_success);
+    return event_finish(&buf, &w, jout);
 }
 
 /* S4U2Self protocol extension. Returns 0 on success. */
@@ -259,8 +220,8 @@ krb5_error_code
 kau_j_tgs_s4u2self(const krb5_boolean ev_success, krb5_audit_state *state,
                    char **jout)
 {
-    krb5_error_code ret = 0;
-    k5_json_object obj = NULL;
+    struct k5buf buf;
+    k5_json_writer w;
 
     *jout = NULL;
 
@@ -270,45 +231,25 @@ kau_j_tgs_s4u2self(const krb5_boolean ev_success, krb5_audit_state *state,
     }
 
     /* Main object. */
-    if (k5_json_object_create(&obj))
-        return ENOMEM;
+    event_begin(&buf, &w);
 
     /* Audit Event ID and ev_success. */
-    ret = eventinfo_to_value(obj, "S4U2SELF", state->stage, ev_success);
-    if (ret)
-        goto error;
+    eventinfo_to_value(&w, "S4U2SELF", state->stage, ev_success);
     /* Front-end server's TGT ticket ID. */
-    ret = string_to_value(state->tkt_in_id, obj, AU_TKT_IN_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->tkt_in_id, AU_TKT_IN_ID);
     /* service "to self" ticket or referral TGT ticket ID. */
-    ret = string_to_value(state->tkt_out_id, obj, AU_TKT_OUT_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->tkt_out_id, AU_TKT_OUT_ID);
     /* Request ID. */
-    ret = string_to_value(state->req_id, obj, AU_REQ_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->req_id, AU_REQ_ID);
     if (ev_success == FALSE) {
         /* KDC status msg. */
-        ret = string_to_value(state->status, obj, AU_KDC_STATUS);
-        if (ret)
-            goto error;
+        string_to_value(&w, state->status, AU_KDC_STATUS);
         /* Local policy or S4U protocol constraints. */
-        ret = int32_to_value(state->violation, obj, AU_VIOLATION);
-        if (ret)
-            goto error;
+        int32_to_value(&w, state->violation, AU_VIOLATION);
     }
     /* Impersonated user. */
-    ret = princ_to_value(state->s4u2self_user, obj, AU_REQ_S4U2S_USER);
-    if (ret)
-        goto error;
-
-    ret = k5_json_encode(obj, jout);
-
-error:
-    k5_json_release(obj);
-    return ret;
+    princ_to_value(&w, state->s4u2self_user, AU_REQ_S4U2S_USER);
+    return event_finish(&buf, &w, jout);
 }
 
 /* S4U2Proxy protocol extension. Returns 0 on success. */
@@ -316,8 +257,8 @@ krb5_error_code
 kau_j_tgs_s4u2proxy(const krb5_boolean ev_success, krb5_audit_state *state,
                     char **jout)
 {
-    krb5_error_code ret = 0;
-    k5_json_object obj = NULL;
+    struct k5buf buf;
+    k5_json_writer w;
     krb5_kdc_req *req = state->request;
 
     *jout = NULL;
@@ -328,52 +269,31 @@ kau_j_tgs_s4u2proxy(const krb5_boolean ev_success, krb5_audit_state *state,
     }
 
     /* Main object. */
-    if (k5_json_object_create(&obj))
-        return ENOMEM;
+    event_begin(&buf, &w);
 
     /* Audit Event ID and ev_success. */
-    ret = eventinfo_to_value(obj, "S4U2PROXY", state->stage, ev_success);
-    if (ret)
-        goto error;
+    eventinfo_to_value(&w, "S4U2PROXY", state->stage, ev_success);
     /* Front-end server's TGT ticket ID. */
-    ret = string_to_value(state->tkt_in_id, obj, AU_TKT_IN_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->tkt_in_id, AU_TKT_IN_ID);
     /* Resource service or referral TGT ticket ID. */
-    ret = string_to_value(state->tkt_out_id, obj, AU_TKT_OUT_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->tkt_out_id, AU_TKT_OUT_ID);
     /* User's evidence ticket ID. */
-    ret = string_to_value(state->evid_tkt_id, obj, AU_EVIDENCE_TKT_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->evid_tkt_id, AU_EVIDENCE_TKT_ID);
     /* Request ID. */
-    ret = string_to_value(state->req_id, obj, AU_REQ_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->req_id, AU_REQ_ID);
 
     if (ev_success == FALSE) {
         /* KDC status msg. */
-        ret = string_to_value(state->status, obj, AU_KDC_STATUS);
-        if (ret)
-            goto error;
+        string_to_value(&w, state->status, AU_KDC_STATUS);
         /* Local policy or S4U protocol constraints. */
-        ret = int32_to_value(state->violation, obj, AU_VIOLATION);
-        if (ret)
-            goto error;
+        int32_to_value(&w, state->violation, AU_VIOLATION);
     }
     /* Delegated user. */
     if (req != NULL) {
-        ret = princ_to_value(req->second_ticket[0]->enc_part2->client,
-                             obj, AU_REQ_S4U2P_USER);
-        if (ret)
-            goto error;
+        princ_to_value(&w, req->second_ticket[0]->enc_part2->client,
+                       AU_REQ_S4U2P_USER);
     }
-    ret = k5_json_encode(obj, jout);
-
-error:
-    k5_json_release(obj);
-    return ret;
+    return event_finish(&buf, &w, jout);
 }
 
 /* U2U. Returns 0 on success. */
@@ -381,8 +301,8 @@ krb5_error_code
 kau_j_tgs_u2u(const krb5_boolean ev_success, krb5_audit_state *state,
               char **jout)
 {
-    krb5_error_code ret = 0;
-    k5_json_object obj = NULL;
+    struct k5buf buf;
+    k5_json_writer w;
     krb5_kdc_req *req = state->request;
 
     if (!state) {
@@ -393,500 +313,274 @@ kau_j_tgs_u2u(const krb5_boolean ev_success, krb5_audit_state *state,
     *jout = NULL;
 
     /* Main object. */
-    if (k5_json_object_create(&obj))
-        return ENOMEM;
+    event_begin(&buf, &w);
     /* Audit Event ID and ev_success. */
-    ret = eventinfo_to_value(obj, "U2U", state->stage, ev_success);
-    if (ret)
-        goto error;
+    eventinfo_to_value(&w, "U2U", state->stage, ev_success);
     /* Front-end server's TGT ticket ID. */
-    ret = string_to_value(state->tkt_in_id, obj, AU_TKT_IN_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->tkt_in_id, AU_TKT_IN_ID);
     /* Service ticket ID. */
-    ret = string_to_value(state->tkt_out_id, obj, AU_TKT_OUT_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->tkt_out_id, AU_TKT_OUT_ID);
     /* Request ID. */
-    ret = string_to_value(state->req_id, obj, AU_REQ_ID);
-    if (ret)
-        goto error;
+    string_to_value(&w, state->req_id, AU_REQ_ID);
 
     if (ev_success == FALSE) {
         /* KDC status msg. */
-        ret = string_to_value(state->status, obj, AU_KDC_STATUS);
-        if (ret)
-            goto error;
+        string_to_value(&w, state->status, AU_KDC_STATUS);
     }
     /* Client in the second ticket. */
     if (req != NULL) {
-        ret = princ_to_value(req->second_ticket[0]->enc_part2->client,
-                             obj, AU_REQ_U2U_USER);
-        if (ret)
-            goto error;
+        princ_to_value(&w, req->second_ticket[0]->enc_part2->client,
+                       AU_REQ_U2U_USER);
     }
     /* Enctype of a session key of the second ticket. */
-    ret = int32_to_value(req->second_ticket[0]->enc_part2->session->enctype,
-                         obj, AU_SRV_ETYPE);
-    if (ret)
-        goto error;
-
-    ret = k5_json_encode(obj, jout);
-
-error:
-    k5_json_release(obj);
-    return ret;
+    int32_to_value(&w, req->second_ticket[0]->enc_part2->session->enctype,
+                   AU_SRV_ETYPE);
+    return event_finish(&buf, &w, jout);
 }
 
 /* Low level utilities */
 
-/* Converts string into a property of a JSON object. Returns 0 on success.*/
-static krb5_error_code
-string_to_value(const char *in, k5_json_object obj, const char *key)
+/* Writes a string as a property of a JSON object. */
+static void
+string_to_value(k5_json_writer *w, const char *in, const char *key)
 {
-    krb5_error_code ret = 0;
-    k5_json_string str = NULL;
-
     if (in == NULL)
-        return 0;
+        return;
 
-    ret = k5_json_string_create(in, &str);
-    if (ret)
-        return ret;
-    ret = k5_json_object_set(obj, key, str);
-    k5_json_release(str);
-
-    return ret;
+    k5_json_write_key(w, key);
+    k5_json_write_string(w, in);
 }
 
 /*
- * Converts a krb5_data struct into a property of a JSON object.
+ * Writes a krb5_data struct as a property of a JSON object.
  * (Borrowed from preauth_otp.c)
- * Returns 0 on success.
  */
-static krb5_error_code
-data_to_value(krb5_data *data, k5_json_object obj, const char *key)
+static void
+data_to_value(k5_json_writer *w, krb5_data *data, const char *key)
 {
-    krb5_error_code ret = 0;
-    k5_json_string str = NULL;
-
     if (data == NULL || data->data == NULL || data->length < 1)
-        return 0;
-
-    ret = k5_json_string_create_len(data->data, data->length, &str);
-    if (ret)
-        return ret;
-    ret = k5_json_object_set(obj, key, str);
-    k5_json_release(str);
+        return;
 
-    return ret;
+    k5_json_write_key(w, key);
+    k5_json_write_string_len(w, data->data, data->length);
 }
 
-/*
- * Converts krb5_int32 into a property of a JSON object.
- * Returns 0 on success.
- */
-static krb5_error_code
-int32_to_value(krb5_int32 int32, k5_json_object obj, const char *key)
+/* Writes krb5_int32 as a property of a JSON object. */
+static void
+int32_to_value(k5_json_writer *w, krb5_int32 int32, const char *key)
 {
-    krb5_error_code ret = 0;
-    k5_json_number num = NULL;
-
-    ret = k5_json_number_create(int32, &num);
-    if (ret)
-        return ENOMEM;
-    ret = k5_json_object_set(obj, key, num);
-    k5_json_release(num);
-
-    return ret;
+    k5_json_write_key(w, key);
+    k5_json_write_number(w, int32);
 }
 
-/*
- * Converts krb5_boolean into a property of a JSON object.
- * Returns 0 on success.
- */
-static krb5_error_code
-bool_to_value(krb5_boolean in, k5_json_object obj, const char *key)
+/* Writes krb5_boolean as a property of a JSON object. */
+static void
+bool_to_value(k5_json_writer *w, krb5_boolean in, const char *key)
 {
-    krb5_error_code ret = 0;
-    k5_json_bool b = 0;
-
-    ret = k5_json_bool_create(in, &b);
-    if (ret)
-        return ENOMEM;
-
-    ret = k5_json_object_set(obj, key, b);
-    k5_json_release(b);
-
-    return ret;
+    k5_json_write_key(w, key);
+    k5_json_write_bool(w, in);
 }
 
 /* Wrapper-level utilities */
 
-/* Wrapper for stage and event_status tags. Returns 0 on success. */
-static krb5_error_code
-eventinfo_to_value(k5_json_object obj, const char *name,
+/* Wrapper for stage and event_status tags. */
+static void
+eventinfo_to_value(k5_json_writer *w, const char *name,
                    const int stage, const krb5_boolean ev_success)
 {
-    krb5_error_code ret = 0;
-
-    ret = string_to_value(name, obj, AU_EVENT_NAME);
-    if (ret)
-        return ret;
-    ret = int32_to_value(stage, obj, AU_STAGE);
-    if (!ret)
-        ret = bool_to_value(ev_success, obj, AU_EVENT_STATUS);
-
-    return ret;
+    string_to_value(w, name, AU_EVENT_NAME);
+    int32_to_value(w, stage, AU_STAGE);
+    bool_to_value(w, ev_success, AU_EVENT_STATUS);
 }
 
-/*
- * Converts krb5_principal into a property of a JSON object.
- * Returns 0 on success.
- */
-static krb5_error_code
-princ_to_value(krb5_principal princ, k5_json_object obj, const char *key)
+/* Writes krb5_principal as a property of a JSON object. */
+static void
+princ_to_value(k5_json_writer *w, krb5_principal princ, const char *key)
 {
-    krb5_error_code ret = 0;
-    k5_json_object tmp = NULL;
-    k5_json_array arr = NULL;
-    k5_json_string str = NULL;
-    int i = 0;
+    int i;
 
     if (princ == NULL || princ->data == NULL)
-        return 0;
-
-    /* Main object. */
-    if (k5_json_object_create(&tmp))
-        return ENOMEM;
+        return;
 
-    ret = k5_json_array_create(&arr);
-    if (ret)
-        goto error;
+    k5_json_write_key(w, key);
+    k5_json_write_begin_object(w);
+    k5_json_write_key(w, AU_COMPONENTS);
+    k5_json_write_begin_array(w);
     for (i = 0; i < princ->length; i++) {
-        ret = k5_json_string_create_len((&princ->data[i])->data,
-                                       (&princ->data[i])->length, &str);
-        if (ret)
-            goto error;
-        ret = k5_json_array_add(arr, str);
-        k5_json_release(str);
-        if (ret)
-            goto error;
+        k5_json_write_string_len(w, princ->data[i].data,
+                                 princ->data[i].length);
     }
-    ret = k5_json_object_set(tmp, AU_COMPONENTS, arr);
-    if (ret)
-        goto error;
-    ret = data_to_value(&princ->realm, tmp, AU_REALM);
-    if (ret)
-        goto error;
-    ret = int32_to_value(princ->length, tmp, AU_LENGTH);
-    if (ret)
-        goto error;
-    ret = int32_to_value(princ->type, tmp, AU_TYPE);
-    if (ret)
-        goto error;
-
-    ret = k5_json_object_set(obj, key, tmp);
-
-error:
-    k5_json_release(tmp);
-    k5_json_release(arr);
-    return ret;
+    k5_json_write_end_array(w);
+    data_to_value(w, &princ->realm, AU_REALM);
+    int32_to_value(w, princ->length, AU_LENGTH);
+    int32_to_value(w, princ->type, AU_TYPE);
+    k5_json_write_end_object(w);
 }
 
-/*
- * Helper for JSON encoding of krb5_address.
- * Returns 0 on success.
- */
-static krb5_error_code
-addr_to_obj(krb5_address *a, k5_json_object obj)
+/* Helper for JSON encoding of the members of a krb5_address object. */
+static void
+addr_to_obj(k5_json_writer *w, krb5_address *a)
 {
-    krb5_error_code ret = 0;
-    k5_json_number num = NULL;
-    k5_json_array arr = NULL;
     int i;
 
     if (a == NULL || a->contents == NULL || a->length <= 0)
-        return 0;
+        return;
 
-    ret = int32_to_value(a->addrtype, obj, AU_TYPE);
-    if (ret)
-        goto error;
-    ret = int32_to_value(a->length, obj, AU_LENGTH);
-    if (ret)
-        goto error;
+    int32_to_value(w, a->addrtype, AU_TYPE);
+    int32_to_value(w, a->length, AU_LENGTH);
 
     if (a->addrtype == ADDRTYPE_INET || a->addrtype == ADDRTYPE_INET6) {
-        ret = k5_json_array_create(&arr);
-        if (ret)
-            goto error;
-        for (i = 0; i < (int)a->length; i++) {
-            ret = k5_json_number_create(a->contents[i], &num);
-            if (ret)
-                goto error;
-            ret = k5_json_array_add(arr, num);
-            k5_json_release(num);
-            if (ret)
-                goto error;
-        }
-        ret = k5_json_object_set(obj, AU_IP, arr);
-        if (ret)
-            goto error;
+        k5_json_write_key(w, AU_IP);
+        k5_json_write_begin_array(w);
+        for (i = 0; i < (int)a->length; i++)
+            k5_json_write_number(w, a->contents[i]);
+        k5_json_write_end_array(w);
     }
-
-error:
-    k5_json_release(arr);
-    return ret;
 }
 
-/*
- * Converts krb5_fulladdr into a property of a JSON object.
- * Returns 0 on success.
- */
-static krb5_error_code
-addr_to_value(const krb5_address *address, k5_json_object obj, const char *key)
+/* Writes krb5_address as a property of a JSON object. */
+static void
+addr_to_value(k5_json_writer *w, const krb5_address *address, const char *key)
 {
-    krb5_error_code ret = 0;
-    k5_json_object addr_obj = NULL;
-
     if (address == NULL)
-        return 0;
+        return;
 
-    ret = k5_json_object_create(&addr_obj);
-    if (ret)
-        return ret;
-    ret = addr_to_obj((krb5_address *)address, addr_obj);
-    if (!ret)
-        ret = k5_json_object_set(obj, key, addr_obj);
-    k5_json_release(addr_obj);
+    k5_json_write_key(w, key);
+    k5_json_write_begin_object(w);
+    addr_to_obj(w, (krb5_address *)address);
+    k5_json_write_end_object(w);
+}
 
-    return ret;
+/* Writes an array of the names of the known preauth types in padata. */
+static void
+patypes_to_value(k5_json_writer *w, krb5_pa_data **padata, const char *key)
+{
+    const char *name;
+
+    k5_json_write_key(w, key);
+    k5_json_write_begin_array(w);
+    for (; *padata != NULL; padata++) {
+        name = map_patype((*padata)->pa_type);
+        if (strlen(name) > 1)
+            k5_json_write_string(w, name);
+    }
+    k5_json_write_end_array(w);
 }
 
-/*
- * Helper for JSON encoding of krb5_kdc_req.
- * Returns 0 on success.
- */
-static krb5_error_code
-req_to_value(krb5_kdc_req *req, const krb5_boolean ev_success,
-             k5_json_object obj)
+/* Helper for JSON encoding of krb5_kdc_req. */
+static void
+req_to_value(k5_json_writer *w, krb5_kdc_req *req,
+             const krb5_boolean ev_success)
 {
-    krb5_error_code ret = 0;
-    k5_json_number num = NULL;
-    k5_json_string str = NULL;
-    k5_json_object tmpa = NULL;
-    k5_json_array arr = NULL, arra = NULL, arrpa = NULL;
-    krb5_pa_data **padata;
-    int i = 0;
+    int i;
 
     if (req == NULL)
-        return 0;
+        return;
+
+    princ_to_value(w, req->client, AU_REQ_CLIENT);
+    princ_to_value(w, req->server, AU_REQ_SERVER);
 
-    ret = princ_to_value(req->client, obj, AU_REQ_CLIENT);
-    if (ret)
-        goto error;
-    ret = princ_to_value(req->server, obj, AU_REQ_SERVER);
-    if (ret)
-        goto error;
-
-    ret = int32_to_value(req->kdc_options, obj, AU_REQ_KDC_OPTIONS);
-        if (ret)
-            goto error;
-    ret = int32_to_value(req->from, obj, AU_REQ_TKT_START);
-        if (ret)
-            goto error;
-    ret = int32_to_value(req->till, obj, AU_REQ_TKT_END);
-        if (ret)
-            goto error;
-    ret = int32_to_value(req->rtime, obj, AU_REQ_TKT_RENEW_TILL);
-        if (ret)
-            goto error;
+    int32_to_value(w, req->kdc_options, AU_REQ_KDC_OPTIONS);
+    int32_to_value(w, req->from, AU_REQ_TKT_START);
+    int32_to_value(w, req->till, AU_REQ_TKT_END);
+    int32_to_value(w, req->rtime, AU_REQ_TKT_RENEW_TILL);
     /* Available/requested enctypes. */
-    ret = k5_json_array_create(&arr);
-    if (ret)
-        goto error;
+    k5_json_write_key(w, AU_REQ_AVAIL_ETYPES);
+    k5_json_write_begin_array(w);
     for (i = 0; (i < req->nktypes); i++) {
-        if (req->ktype[i] > 0) {
-            ret = k5_json_number_create(req->ktype[i], &num);
-            if (ret)
-                goto error;
-            ret = k5_json_array_add(arr, num);
-            k5_json_release(num);
-            if (ret)
-                goto error;
-        }
+        if (req->ktype[i] > 0)
+            k5_json_write_number(w, req->ktype[i]);
     }
-    ret = k5_json_object_set(obj, AU_REQ_AVAIL_ETYPES, arr);
-    if (ret)
-        goto error;
+    k5_json_write_end_array(w);
     /* Pre-auth types. */
-    if (ev_success == TRUE && req->padata) {
-            ret = k5_json_array_create(&arrpa);
-            if (ret)
-                goto error;
-            for (padata = req->padata; *padata; padata++) {
-                if (strlen(map_patype((*padata)->pa_type)) > 1) {
-                    ret = k5_json_string_create(map_patype((*padata)->pa_type),
-                                                &str);
-                    if (ret)
-                        goto error;
-                    ret = k5_json_array_add(arrpa, str);
-                    k5_json_release(str);
-                    if (ret)
-                        goto error;
-                }
-            }
-            ret = k5_json_object_set(obj, AU_REQ_PA_TYPE, arrpa);
-    }
+    if (ev_success == TRUE && req->padata)
+        patypes_to_value(w, req->padata, AU_REQ_PA_TYPE);
     /* List of requested addresses. */
     if (req->addresses) {
-        ret = k5_json_array_create(&arra);
-        if (ret)
-                goto error;
+        k5_json_write_key(w, AU_REQ_ADDRESSES);
+        k5_json_write_begin_array(w);
         for (i = 0; req->addresses[i] != NULL; i++) {
-            ret = k5_json_object_create(&tmpa);
-            if (ret)
-                goto error;
-            ret = addr_to_obj(req->addresses[i], tmpa);
-            if (ret)
-                goto error;
-            ret = k5_json_array_add(arra, tmpa);
-            k5_json_release(tmpa);
-            if (ret)
-                goto error;
+            k5_json_write_begin_object(w);
+            addr_to_obj(w, req->addresses[i]);
+            k5_json_write_end_object(w);
         }
-        ret = k5_json_object_set(obj, AU_REQ_ADDRESSES, arra);
-        if (ret)
-            goto error;
+        k5_json_write_end_array(w);
     }
-error:
-    k5_json_release(arr);
-    k5_json_release(arra);
-    k5_json_release(arrpa);
-    return ret;
 }
 
-/*
- * Helper for JSON encoding of krb5_kdc_rep.
- * Returns 0 on success.
- */
-static krb5_error_code
-rep_to_value(krb5_kdc_rep *rep, const krb5_boolean ev_success,
-             k5_json_object obj)
+/* Helper for JSON encoding of krb5_kdc_rep. */
+static void
+rep_to_value(k5_json_writer *w, krb5_kdc_rep *rep,
+             const krb5_boolean ev_success)
 {
-    krb5_error_code ret = 0;
-    krb5_pa_data **padata;
-    k5_json_array arrpa = NULL;
-    k5_json_string str = NULL;
-
     if (rep == NULL)
-        return 0;
+        return;
 
     if (ev_success == TRUE) {
-        ret = tkt_to_value(rep->ticket, obj, AU_REP_TICKET);
+        tkt_to_value(w, rep->ticket, AU_REP_TICKET);
         /* Enctype of the reply-encrypting key. */
-        ret = int32_to_value(rep->enc_part.enctype, obj, AU_REP_ETYPE);
-        if (ret)
-            goto error;
-    } else {
-
-        if (rep->padata) {
-            ret = k5_json_array_create(&arrpa);
-            if (ret)
-                goto error;
-            for (padata = rep->padata; *padata; padata++) {
-                if (strlen(map_patype((*padata)->pa_type)) > 1) {
-                    ret = k5_json_string_create(map_patype((*padata)->pa_type),
-                                                          &str);
-                    if (ret)
-                        goto error;
-                    ret = k5_json_array_add(arrpa, str);
-                    k5_json_release(str);
-                    if (ret)
-                        goto error;
-                }
-            }
-        }
-        ret = k5_json_object_set(obj, AU_REP_PA_TYPE, arrpa);
+        int32_to_value(w, rep->enc_part.enctype, AU_REP_ETYPE);
+    } else if (rep->padata) {
+        patypes_to_value(w, rep->padata, AU_REP_PA_TYPE);
     }
-error:
-    k5_json_release(arrpa);
-    return ret;
 }
 
-/*
- * Converts krb5_ticket into a property of a JSON object.
- * Returns 0 on success.
- */
-static krb5_error_code
-tkt_to_value(krb5_ticket *tkt, k5_json_object obj,
-              const char *key)
+/* Returns true if princ_to_value() would write princ. */
+static inline krb5_boolean
+princ_present(krb5_principal princ)
+{
+    return princ != NULL && princ->data != NULL;
+}
+
+/* Writes krb5_ticket as a property of a JSON object. */
+static void
+tkt_to_value(k5_json_writer *w, krb5_ticket *tkt, const char *key)
 {
-    krb5_error_code ret = 0;
-    k5_json_object tmp = NULL;
     krb5_enc_tkt_part *part2 = NULL;
+    krb5_principal cname;
 
     if (tkt == NULL)
-        return 0;
+        return;
+
+    if (tkt->enc_part2)
+        part2 = tkt->enc_part2;
 
     /* Main object. */
-    if (k5_json_object_create(&tmp))
-        return ENOMEM;
+    k5_json_write_key(w, key);
+    k5_json_write_begin_object(w);
 
     /*
      * CNAME - potentially redundant data...
-     * ...but it is part of the ticket. So, record it as such.
+     * ...but it is part of the ticket. So, record it as such.  CNAME is
+     * recorded first as the server name and replaced by the ticket client
+     * if there is one, keeping its position ahead of SNAME.
      */
-    ret = princ_to_value(tkt->server, tmp, AU_CNAME);
-    if (ret)
-        goto error;
-    ret = princ_to_value(tkt->server, tmp, AU_SNAME);
-    if (ret)
-        goto error;
+    cname = (part2 != NULL && princ_present(part2->client)) ?
+        part2->client : tkt->server;
+    if (princ_present(tkt->server)) {
+        princ_to_value(w, cname, AU_CNAME);
+        princ_to_value(w, tkt->server, AU_SNAME);
+    }
     /* Enctype of a long-term key of service. */
     if (tkt->enc_part.enctype)
-        ret = int32_to_value(tkt->enc_part.enctype, tmp, AU_SRV_ETYPE);
-    if (ret)
-        goto error;
-    if (tkt->enc_part2)
-        part2 = tkt->enc_part2;
+        int32_to_value(w, tkt->enc_part.enctype, AU_SRV_ETYPE);
     if (part2) {
-        ret = princ_to_value(part2->client, tmp, AU_CNAME);
-        if (ret)
-            goto error;
-        ret = int32_to_value(part2->flags, tmp, AU_FLAGS);
-        if (ret)
-            goto error;
+        if (!princ_present(tkt->server))
+            princ_to_value(w, part2->client, AU_CNAME);
+        int32_to_value(w, part2->flags, AU_FLAGS);
         /* Chosen by KDC session key enctype (short-term key). */
-        ret = int32_to_value(part2->session->enctype, tmp, AU_SESS_ETYPE);
-        if (ret)
-            goto error;
-        ret = int32_to_value(part2->times.starttime, tmp, AU_START);
-        if (ret)
-            goto error;
-        ret = int32_to_value(part2->times.endtime, tmp, AU_END);
-        if (ret)
-            goto error;
-        ret = int32_to_value(part2->times.renew_till, tmp, AU_RENEW_TILL);
-        if (ret)
-            goto error;
-        ret = int32_to_value(part2->times.authtime, tmp, AU_AUTHTIME);
-        if (ret)
-            goto error;
+        int32_to_value(w, part2->session->enctype, AU_SESS_ETYPE);
+        int32_to_value(w, part2->times.starttime, AU_START);
+        int32_to_value(w, part2->times.endtime, AU_END);
+        int32_to_value(w, part2->times.renew_till, AU_RENEW_TILL);
+        int32_to_value(w, part2->times.authtime, AU_AUTHTIME);
         if (part2->transited.tr_contents.length > 0) {
-            ret = data_to_value(&part2->transited.tr_contents,
-                               tmp, AU_TR_CONTENTS);
-            if (ret)
-                goto error;
+            data_to_value(w, &part2->transited.tr_contents,
+                          AU_TR_CONTENTS);
         }
     } /* part2 != NULL */
 
-    if (!ret)
-        ret = k5_json_object_set(obj, key, tmp);
-
-error:
-    k5_json_release(tmp);
-    return ret;
+    k5_json_write_end_object(w);
 }
 
 /* Map preauth numeric type to the naming string. */
@@ -0,0 +1,330 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/audit/t_j_encode.c - Test and benchmark the JSON audit encoders */
+/*
+ * Copyright (C) 2020 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * Encode a fixed set of audit events and compare the results to the expected
+ * JSON text.  If an iteration count is given, also report how many events per
+ * second the encoders produce.
+ *
+ * Usage: t_j_encode [iterations]
+ */
+
+#include <k5-int.h>
+#include "kdc_j_encode.h"
+#include <time.h>
+
+static krb5_context ctx;
+
+static krb5_address addr_inet = {
+    KV5M_ADDRESS, ADDRTYPE_INET, 4, (krb5_octet *)"\x0a\x00\x00\x01"
+};
+static krb5_address addr_inet6 = {
+    KV5M_ADDRESS, ADDRTYPE_INET6, 16,
+    (krb5_octet *)"\xfe\x80\x00\x00\x00\x00\x00\x00"
+    "\x00\x00\x00\x00\x00\x00\x00\x02"
+};
+static krb5_address addr_netbios = {
+    KV5M_ADDRESS, ADDRTYPE_NETBIOS, 4, (krb5_octet *)"HOST"
+};
+static krb5_address *req_addrs[] = {
+    &addr_inet, &addr_netbios, &addr_inet6, NULL
+};
+
+static krb5_enctype ktypes[] = {
+    ENCTYPE_AES256_CTS_HMAC_SHA1_96, ENCTYPE_AES128_CTS_HMAC_SHA1_96, 0,
+    ENCTYPE_ARCFOUR_HMAC
+};
+
+static krb5_pa_data pa_ts = { KV5M_PA_DATA, KRB5_PADATA_ENC_TIMESTAMP };
+static krb5_pa_data pa_pac = { KV5M_PA_DATA, KRB5_PADATA_PAC_REQUEST };
+static krb5_pa_data pa_unknown = { KV5M_PA_DATA, 12345 };
+static krb5_pa_data pa_etinfo2 = { KV5M_PA_DATA, KRB5_PADATA_ETYPE_INFO2 };
+static krb5_pa_data pa_salt = { KV5M_PA_DATA, KRB5_PADATA_PW_SALT };
+static krb5_pa_data *req_padata[] = { &pa_ts, &pa_pac, &pa_unknown, NULL };
+static krb5_pa_data *rep_padata[] = { &pa_etinfo2, &pa_unknown, &pa_salt,
+                                      NULL };
+
+static krb5_keyblock session = { KV5M_KEYBLOCK, ENCTYPE_AES128_CTS_HMAC_SHA1_96 };
+
+static const char *expected[] = {
+    "{\"event_name\":\"KDC_START\",\"event_success\":true}",
+    "{\"event_name\":\"KDC_STOP\",\"event_success\":false}",
+    "{\"event_name\":\"AS_REQ\",\"stage\":3,\"event_success\":true,\"tkt_ou"
+    "t_id\":\"out\\tid\",\"req_id\":\"REQ/1\",\"fromport\":88,\"fromaddr\":"
+    "{\"type\":2,\"length\":4,\"ip\":[10,0,0,1]},\"kdc_status\":\"ISSUE\","
+    "\"clreferral_realm\":\"OTHER.REALM\",\"req.client\":{\"components\":["
+    "\"user\\\"q\\\\\"],\"realm\":\"KRBTEST.COM\",\"length\":1,\"type\":1},"
+    "\"req.server\":{\"components\":[\"krbtgt\",\"KRBTEST.COM\"],\"realm\":"
+    "\"KRBTEST.COM\",\"length\":2,\"type\":1},\"req.kdc_options\":107374184"
+    "0,\"req.tkt_start\":0,\"req.tkt_end\":1600000000,\"req.tkt_renew_till"
+    "\":-5,\"req.avail_etypes\":[18,17,23],\"req.pa_type\":[\"ENC_TIMESTAMP"
+    "\",\"PAC_REQUEST\"],\"req.addresses\":[{\"type\":2,\"length\":4,\"ip\""
+    ":[10,0,0,1]},{\"type\":20,\"length\":4},{\"type\":24,\"length\":16,\"i"
+    "p\":[254,128,0,0,0,0,0,0,0,0,0,0,0,0,0,2]}],\"rep.ticket\":{\"cname\":"
+    "{\"components\":[\"user\"],\"realm\":\"KRBTEST.COM\",\"length\":1,\"ty"
+    "pe\":1},\"sname\":{\"components\":[\"krbtgt\",\"KRBTEST.COM\"],\"realm"
+    "\":\"KRBTEST.COM\",\"length\":2,\"type\":1},\"srv_etype\":18,\"flags\""
+    ":1077936128,\"sess_etype\":17,\"start\":1500000001,\"end\":1500086400,"
+    "\"renew_till\":1500604800,\"authtime\":1500000000,\"tr_contents\":\"A."
+    "ORG,\\nB.ORG\"},\"rep_etype\":18}",
+    "{\"event_name\":\"AS_REQ\",\"stage\":3,\"event_success\":false,\"tkt_o"
+    "ut_id\":\"out\\tid\",\"req_id\":\"REQ/1\",\"fromport\":88,\"fromaddr\""
+    ":{\"type\":2,\"length\":4,\"ip\":[10,0,0,1]},\"kdc_status\":\"ISSUE\","
+    "\"clreferral_realm\":\"OTHER.REALM\",\"req.client\":{\"components\":["
+    "\"user\\\"q\\\\\"],\"realm\":\"KRBTEST.COM\",\"length\":1,\"type\":1},"
+    "\"req.server\":{\"components\":[\"krbtgt\",\"KRBTEST.COM\"],\"realm\":"
+    "\"KRBTEST.COM\",\"length\":2,\"type\":1},\"req.kdc_options\":107374184"
+    "0,\"req.tkt_start\":0,\"req.tkt_end\":1600000000,\"req.tkt_renew_till"
+    "\":-5,\"req.avail_etypes\":[18,17,23],\"req.addresses\":[{\"type\":2,"
+    "\"length\":4,\"ip\":[10,0,0,1]},{\"type\":20,\"length\":4},{\"type\":2"
+    "4,\"length\":16,\"ip\":[254,128,0,0,0,0,0,0,0,0,0,0,0,0,0,2]}],\"rep.p"
+    "a_type\":[\"ETYPE_INFO2\",\"PW_SALT\"]}",
+    "{\"event_name\":\"TGS_REQ\",\"stage\":2,\"event_success\":true,\"tkt_i"
+    "n_id\":\"in\",\"tkt_out_id\":\"out\",\"req_id\":\"REQ/2\",\"fromport\""
+    ":65535,\"fromaddr\":{\"type\":24,\"length\":16,\"ip\":[254,128,0,0,0,0"
+    ",0,0,0,0,0,0,0,0,0,2]},\"tkt_renewed\":1,\"tkt_validated\":2,\"kdc_sta"
+    "tus\":\"UNKNOWN_SERVER\",\"req.client\":{\"components\":[\"user\\\"q\\"
+    "\\\"],\"realm\":\"KRBTEST.COM\",\"length\":1,\"type\":1},\"req.server"
+    "\":{\"components\":[\"krbtgt\",\"KRBTEST.COM\"],\"realm\":\"KRBTEST.CO"
+    "M\",\"length\":2,\"type\":1},\"req.kdc_options\":2,\"req.tkt_start\":0"
+    ",\"req.tkt_end\":1600000000,\"req.tkt_renew_till\":-5,\"req.avail_etyp"
+    "es\":[18,17,23],\"rep.ticket\":{\"cname\":{\"components\":[\"user\"],"
+    "\"realm\":\"KRBTEST.COM\",\"length\":1,\"type\":1},\"sname\":{\"compon"
+    "ents\":[\"krbtgt\",\"KRBTEST.COM\"],\"realm\":\"KRBTEST.COM\",\"length"
+    "\":2,\"type\":1},\"srv_etype\":18,\"flags\":1077936128,\"sess_etype\":"
+    "17,\"start\":1500000001,\"end\":1500086400,\"renew_till\":1500604800,"
+    "\"authtime\":1500000000,\"tr_contents\":\"A.ORG,\\nB.ORG\"},\"rep_etyp"
+    "e\":18}",
+    "{\"event_name\":\"TGS_REQ\",\"stage\":2,\"event_success\":false,\"tkt_"
+    "in_id\":\"in\",\"tkt_out_id\":\"out\",\"req_id\":\"REQ/2\",\"fromport"
+    "\":65535,\"fromaddr\":{\"type\":24,\"length\":16,\"ip\":[254,128,0,0,0"
+    ",0,0,0,0,0,0,0,0,0,0,2]},\"tkt_renewed\":0,\"tkt_validated\":0,\"kdc_s"
+    "tatus\":\"UNKNOWN_SERVER\",\"req.client\":{\"components\":[\"user\\\"q"
+    "\\\\\"],\"realm\":\"KRBTEST.COM\",\"length\":1,\"type\":1},\"req.serve"
+    "r\":{\"components\":[\"krbtgt\",\"KRBTEST.COM\"],\"realm\":\"KRBTEST.C"
+    "OM\",\"length\":2,\"type\":1},\"req.kdc_options\":2,\"req.tkt_start\":"
+    "0,\"req.tkt_end\":1600000000,\"req.tkt_renew_till\":-5,\"req.avail_ety"
+    "pes\":[18,17,23],\"rep.pa_type\":[\"ETYPE_INFO2\",\"PW_SALT\"]}",
+    "{\"event_name\":\"S4U2SELF\",\"stage\":2,\"event_success\":true,\"tkt_"
+    "in_id\":\"in\",\"tkt_out_id\":\"out\",\"req_id\":\"REQ/2\",\"s4u2self_"
+    "user\":{\"components\":[\"imp\",\"admin\"],\"realm\":\"KRBTEST.COM\","
+    "\"length\":2,\"type\":1}}",
+    "{\"event_name\":\"S4U2SELF\",\"stage\":2,\"event_success\":false,\"tkt"
+    "_in_id\":\"in\",\"tkt_out_id\":\"out\",\"req_id\":\"REQ/2\",\"kdc_stat"
+    "us\":\"UNKNOWN_SERVER\",\"violation\":4,\"s4u2self_user\":{\"component"
+    "s\":[\"imp\",\"admin\"],\"realm\":\"KRBTEST.COM\",\"length\":2,\"type"
+    "\":1}}",
+    "{\"event_name\":\"S4U2PROXY\",\"stage\":2,\"event_success\":true,\"tkt"
+    "_in_id\":\"in\",\"tkt_out_id\":\"out\",\"evidence_tkt_id\":\"evid\",\""
+    "req_id\":\"REQ/2\",\"s4u2proxy_user\":{\"components\":[\"imp\",\"admin"
+    "\"],\"realm\":\"KRBTEST.COM\",\"length\":2,\"type\":1}}",
+    "{\"event_name\":\"S4U2PROXY\",\"stage\":2,\"event_success\":false,\"tk"
+    "t_in_id\":\"in\",\"tkt_out_id\":\"out\",\"evidence_tkt_id\":\"evid\","
+    "\"req_id\":\"REQ/2\",\"kdc_status\":\"UNKNOWN_SERVER\",\"violation\":4"
+    ",\"s4u2proxy_user\":{\"components\":[\"imp\",\"admin\"],\"realm\":\"KR"
+    "BTEST.COM\",\"length\":2,\"type\":1}}",
+    "{\"event_name\":\"U2U\",\"stage\":2,\"event_success\":true,\"tkt_in_id"
+    "\":\"in\",\"tkt_out_id\":\"out\",\"req_id\":\"REQ/2\",\"u2u_user\":{\""
+    "components\":[\"imp\",\"admin\"],\"realm\":\"KRBTEST.COM\",\"length\":"
+    "2,\"type\":1},\"srv_etype\":17}",
+    "{\"event_name\":\"U2U\",\"stage\":2,\"event_success\":false,\"tkt_in_i"
+    "d\":\"in\",\"tkt_out_id\":\"out\",\"req_id\":\"REQ/2\",\"kdc_status\":"
+    "\"UNKNOWN_SERVER\",\"u2u_user\":{\"components\":[\"imp\",\"admin\"],\""
+    "realm\":\"KRBTEST.COM\",\"length\":2,\"type\":1},\"srv_etype\":17}",
+    NULL
+};
+
+static krb5_principal
+parse(const char *name)
+{
+    krb5_principal princ;
+
+    if (krb5_parse_name(ctx, name, &princ) != 0)
+        abort();
+    return princ;
+}
+
+/* Encode each event type with the data set up in main(), adding the results
+ * to out if it is not NULL. */
+static void
+encode_all(krb5_audit_state *as, krb5_audit_state *tgs, char **out)
+{
+    char *js;
+    size_t n = 0;
+
+#define ENCODE(call)                                    \
+    do {                                                \
+        js = NULL;                                      \
+        if ((call) != 0)                                \
+            abort();                                    \
+        if (out != NULL)                                \
+            out[n++] = js;                              \
+        else                                            \
+            free(js);                                   \
+    } while (0)
+
+    ENCODE(kau_j_kdc_start(TRUE, &js));
+    ENCODE(kau_j_kdc_stop(FALSE, &js));
+    ENCODE(kau_j_as_req(TRUE, as, &js));
+    ENCODE(kau_j_as_req(FALSE, as, &js));
+    ENCODE(kau_j_tgs_req(TRUE, tgs, &js));
+    ENCODE(kau_j_tgs_req(FALSE, tgs, &js));
+    ENCODE(kau_j_tgs_s4u2self(TRUE, tgs, &js));
+    ENCODE(kau_j_tgs_s4u2self(FALSE, tgs, &js));
+    ENCODE(kau_j_tgs_s4u2proxy(TRUE, tgs, &js));
+    ENCODE(kau_j_tgs_s4u2proxy(FALSE, tgs, &js));
+    ENCODE(kau_j_tgs_u2u(TRUE, tgs, &js));
+    ENCODE(kau_j_tgs_u2u(FALSE, tgs, &js));
+    if (out != NULL)
+        out[n] = NULL;
+#undef ENCODE
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_kdc_req req, tgsreq;
+    krb5_kdc_rep rep;
+    krb5_ticket tkt, evidence, *second[2];
+    krb5_enc_tkt_part enc, evidence_enc;
+    krb5_audit_state as, tgs;
+    krb5_data realm = string2data("OTHER.REALM");
+    char *results[20];
+    struct timespec start, end;
+    double secs;
+    long i, iterations = (argc > 1) ? atol(argv[1]) : 0;
+    int failed = 0;
+
+    if (krb5_init_context(&ctx) != 0)
+        abort();
+
+    memset(&req, 0, sizeof(req));
+    req.client = parse("user\\\"q\\\\@KRBTEST.COM");
+    req.server = parse("krbtgt/KRBTEST.COM@KRBTEST.COM");
+    req.kdc_options = KDC_OPT_FORWARDABLE | KDC_OPT_RENEWABLE_OK;
+    req.from = 0;
+    req.till = 1600000000;
+    req.rtime = -5;
+    req.ktype = ktypes;
+    req.nktypes = sizeof(ktypes) / sizeof(*ktypes);
+    req.padata = req_padata;
+    req.addresses = req_addrs;
+
+    memset(&enc, 0, sizeof(enc));
+    enc.client = parse("user@KRBTEST.COM");
+    enc.flags = TKT_FLG_FORWARDABLE | TKT_FLG_INITIAL;
+    enc.session = &session;
+    enc.times.authtime = 1500000000;
+    enc.times.starttime = 1500000001;
+    enc.times.endtime = 1500086400;
+    enc.times.renew_till = 1500604800;
+    enc.transited.tr_contents = string2data("A.ORG,\nB.ORG");
+
+    memset(&tkt, 0, sizeof(tkt));
+    tkt.server = req.server;
+    tkt.enc_part.enctype = ENCTYPE_AES256_CTS_HMAC_SHA1_96;
+    tkt.enc_part2 = &enc;
+
+    memset(&rep, 0, sizeof(rep));
+    rep.ticket = &tkt;
+    rep.enc_part.enctype = ENCTYPE_AES256_CTS_HMAC_SHA1_96;
+    rep.padata = rep_padata;
+
+    memset(&as, 0, sizeof(as));
+    as.request = &req;
+    as.reply = &rep;
+    as.cl_addr = &addr_inet;
+    as.cl_port = 88;
+    as.stage = 3;
+    as.status = "ISSUE";
+    as.tkt_out_id = "out\tid";
+    strlcpy(as.req_id, "REQ/1", sizeof(as.req_id));
+    as.cl_realm = &realm;
+
+    /* A TGS request with the components of a principal containing a nul
+     * byte, and a second ticket for S4U2Proxy and U2U. */
+    memset(&evidence_enc, 0, sizeof(evidence_enc));
+    evidence_enc.client = parse("imp\\0ersonated/admin@KRBTEST.COM");
+    evidence_enc.session = &session;
+    memset(&evidence, 0, sizeof(evidence));
+    evidence.enc_part2 = &evidence_enc;
+    second[0] = &evidence;
+    second[1] = NULL;
+
+    tgsreq = req;
+    tgsreq.kdc_options = KDC_OPT_RENEW;
+    tgsreq.padata = NULL;
+    tgsreq.addresses = NULL;
+    tgsreq.second_ticket = second;
+
+    memset(&tgs, 0, sizeof(tgs));
+    tgs.request = &tgsreq;
+    tgs.reply = &rep;
+    tgs.cl_addr = &addr_inet6;
+    tgs.cl_port = 65535;
+    tgs.stage = 2;
+    tgs.status = "UNKNOWN_SERVER";
+    tgs.tkt_in_id = "in";
+    tgs.tkt_out_id = "out";
+    tgs.evid_tkt_id = "evid";
+    strlcpy(tgs.req_id, "REQ/2", sizeof(tgs.req_id));
+    tgs.s4u2self_user = evidence_enc.client;
+    tgs.violation = 4;
+
+    encode_all(&as, &tgs, results);
+    for (i = 0; results[i] != NULL; i++) {
+        if (expected[i] == NULL || strcmp(results[i], expected[i]) != 0) {
+            fprintf(stderr, "Event %ld mismatch: %s\n", i, results[i]);
+            failed = 1;
+        }
+        free(results[i]);
+    }
+
+    if (iterations > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations; i++)
+            encode_all(&as, &tgs, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        secs = (end.tv_sec - start.tv_sec) +
+            (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("%ld events in %.3f s: %.0f events/s\n", iterations * 12, secs,
+               iterations * 12 / secs);
+    }
+
+    krb5_free_principal(ctx, req.client);
+    krb5_free_principal(ctx, req.server);
+    krb5_free_principal(ctx, enc.client);
+    krb5_free_principal(ctx, evidence_enc.client);
+    krb5_free_context(ctx);
+    return failed;
+}
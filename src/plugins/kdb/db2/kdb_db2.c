@@ -205,7 +205,7 @@ configure_context(krb5_context context, char *conf_section, char **db_args)
     krb5_db2_context *dbc;
     char **t_ptr, *opt = NULL, *val = NULL, *pval = NULL;
     profile_t profile = KRB5_DB_GET_PROFILE(context);
-    int bval;
+    int bval, ival;
 
     status = ctx_get(context, &dbc);
     if (status != 0)
@@ -276,6 +276,29 @@ configure_context(krb5_context context, char *conf_section, char **db_args)
         goto cleanup;
     dbc->disable_lockout = bval;
 
+    status = profile_get_integer(profile, KDB_MODULE_SECTION, conf_section,
+                                 KRB5_CONF_PAGE_SIZE, 0, &ival);
+    if (status != 0)
+        goto cleanup;
+    /* The btree and hash formats both need a power of two in this range. */
+    if (ival != 0 && (ival < 512 || ival > 65536 || (ival & (ival - 1)))) {
+        status = EINVAL;
+        k5_setmsg(context, status, _("Invalid DB2 page size %d"), ival);
+        goto cleanup;
+    }
+    dbc->page_size = ival;
+
+    status = profile_get_integer(profile, KDB_MODULE_SECTION, conf_section,
+                                 KRB5_CONF_CACHE_SIZE, 0, &ival);
+    if (status != 0)
+        goto cleanup;
+    if (ival < 0 || ival > INT_MAX / 1024) {
+        status = EINVAL;
+        k5_setmsg(context, status, _("Invalid DB2 cache size %d"), ival);
+        goto cleanup;
+    }
+    dbc->cache_size = ival * 1024;
+
 cleanup:
     free(opt);
     free(val);
@@ -346,8 +369,8 @@ open_db(krb5_context context, krb5_db2_context *dbc, int flags, int mode,
     BTREEINFO bti;
     HASHINFO hashi;
     bti.flags = 0;
-    bti.cachesize = 0;
-    bti.psize = 4096;
+    bti.cachesize = dbc->cache_size;
+    bti.psize = (dbc->page_size != 0) ? dbc->page_size : 4096;
     bti.lorder = 0;
     bti.minkeypage = 0;
     bti.compare = NULL;
@@ -358,8 +381,8 @@ open_db(krb5_context context, krb5_db2_context *dbc, int flags, int mode,
     if (ctx_dbsuffix(dbc, SUFFIX_DB, &fname) != 0)
         return ENOMEM;
 
-    hashi.bsize = 4096;
-    hashi.cachesize = 0;
+    hashi.bsize = (dbc->page_size != 0) ? dbc->page_size : 4096;
+    hashi.cachesize = dbc->cache_size;
     hashi.ffactor = 40;
     hashi.hash = NULL;
     hashi.lorder = 0;
@@ -393,21 +416,79 @@ open_db(krb5_context context, krb5_db2_context *dbc, int flags, int mode,
     return (db == NULL) ? errno : 0;
 }
 
+/* Set *lf_st and *db_st to the current state of dbc's lock file and database
+ * file. */
+static krb5_error_code
+ctx_file_state(krb5_db2_context *dbc, struct stat *lf_st, struct stat *db_st)
+{
+    krb5_error_code retval;
+    char *fname;
+
+    if (fstat(dbc->db_lf_file, lf_st) != 0)
+        return errno;
+    retval = ctx_dbsuffix(dbc, SUFFIX_DB, &fname);
+    if (retval)
+        return retval;
+    retval = (stat(fname, db_st) != 0) ? errno : 0;
+    free(fname);
+    return retval;
+}
+
+static krb5_boolean
+same_file_state(const struct stat *a, const struct stat *b)
+{
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+        a->st_size == b->st_size && a->st_mtime == b->st_mtime;
+}
+
+/*
+ * Return true if dbc->db is a read-only handle kept open by this process
+ * since a previous shared lock, and the database has not changed since it
+ * was opened.  Every write updates the lock file time (see ctx_update_age()),
+ * and replacing or extending the database file changes its identity or size.
+ */
+static krb5_boolean
+ctx_db_current(krb5_db2_context *dbc)
+{
+    struct stat lf_st, db_st;
+
+    if (dbc->db == NULL || dbc->db_pid != getpid())
+        return FALSE;
+    if (ctx_file_state(dbc, &lf_st, &db_st) != 0)
+        return FALSE;
+    return same_file_state(&lf_st, &dbc->db_lf_st) &&
+        same_file_state(&db_st, &dbc->db_st);
+}
+
+/* Close dbc->db if it is open. */
+static void
+ctx_close_db(krb5_db2_context *dbc)
+{
+    if (dbc->db == NULL)
+        return;
+    dbc->db->close(dbc->db);
+    dbc->db = NULL;
+    dbc->db_pid = 0;
+}
+
 static krb5_error_code
 ctx_unlock(krb5_context context, krb5_db2_context *dbc)
 {
     krb5_error_code retval, retval2;
-    DB *db;
 
     retval = osa_adb_release_lock(dbc->policy_db);
 
     if (!dbc->db_locks_held) /* lock already unlocked */
         return KRB5_KDB_NOTLOCKED;
 
-    db = dbc->db;
     if (--(dbc->db_locks_held) == 0) {
-        db->close(db);
-        dbc->db = NULL;
+        /*
+         * Keep a read-only handle open for the next shared lock, so that
+         * lookups do not reopen and remap the database each time.  A
+         * writable handle is closed to flush it.
+         */
+        if (dbc->db_lock_mode != KRB5_LOCKMODE_SHARED)
+            ctx_close_db(dbc);
         dbc->db_lock_mode = 0;
 
         retval2 = krb5_lock_file(context, dbc->db_lf_file,
@@ -447,12 +528,24 @@ ctx_lock(krb5_context context, krb5_db2_context *dbc, int lockmode)
         else if (retval)
             return retval;
 
-        /* Open the DB (or re-open it for read/write). */
-        if (dbc->db != NULL)
-            dbc->db->close(dbc->db);
-        retval = open_db(context, dbc,
-                         kmode == KRB5_LOCKMODE_SHARED ? O_RDONLY : O_RDWR,
-                         0600, &dbc->db);
+        /* Open the DB (or re-open it for read/write), unless we can reuse a
+         * read-only handle from a previous shared lock. */
+        if (kmode == KRB5_LOCKMODE_SHARED && ctx_db_current(dbc)) {
+            retval = 0;
+        } else {
+            ctx_close_db(dbc);
+            retval = open_db(context, dbc,
+                             kmode == KRB5_LOCKMODE_SHARED ? O_RDONLY : O_RDWR,
+                             0600, &dbc->db);
+            if (retval == 0) {
+                dbc->db_pid = getpid();
+                set_cloexec_fd(dbc->db->fd(dbc->db));
+            }
+            /* Without the file state, the handle will not be reused. */
+            if (retval == 0 && kmode == KRB5_LOCKMODE_SHARED &&
+                ctx_file_state(dbc, &dbc->db_lf_st, &dbc->db_st) != 0)
+                dbc->db_pid = -1;
+        }
         if (retval) {
             dbc->db_locks_held = 0;
             dbc->db_lock_mode = 0;
@@ -522,6 +615,7 @@ cleanup:
 static void
 ctx_fini(krb5_db2_context *dbc)
 {
+    ctx_close_db(dbc);
     if (dbc->db_lf_file != -1)
         (void) close(dbc->db_lf_file);
     if (dbc->policy_db)
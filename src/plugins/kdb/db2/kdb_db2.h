@@ -48,6 +48,13 @@ typedef struct _krb5_db2_context {
     krb5_boolean        disable_last_success;
     krb5_boolean        disable_lockout;
     krb5_boolean        unlockiter;
+    int                 page_size;      /* Page size for new databases  */
+    int                 cache_size;     /* Page cache size in bytes     */
+    /* When the last lock was shared, db is kept open, along with the state
+     * of the files when it was opened, until the database changes. */
+    struct stat         db_lf_st;       /* Lock file state              */
+    struct stat         db_st;          /* Database file state          */
+    pid_t               db_pid;         /* Process which opened db      */
 } krb5_db2_context;
 
 krb5_error_code krb5_db2_init(krb5_context);
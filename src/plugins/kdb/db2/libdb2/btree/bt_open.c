@@ -312,6 +312,15 @@ __bt_open(fname, flags, mode, openinfo, dflags)
 	if (!F_ISSET(t, B_INMEM))
 		mpool_filter(t->bt_mp, __bt_pgin, __bt_pgout, t);
 
+	/*
+	 * A read-only tree in native byte order needs no page conversion,
+	 * so its pages can be used directly from a mapping of the file,
+	 * shared with the OS page cache.  Fall back to reading pages into
+	 * the cache if the file can't be mapped.
+	 */
+	if (F_ISSET(t, B_RDONLY) && !F_ISSET(t, B_NEEDSWAP))
+		(void)mpool_map(t->bt_mp);
+
 	/* Create a root page if new tree. */
 	if (nroot(t) == RET_ERROR)
 		goto err;
@@ -36,6 +36,7 @@ static char sccsid[] = "@(#)mpool.c	8.7 (Berkeley) 11/2/95";
 #endif /* LIBC_SCCS and not lint */
 
 #include <sys/param.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 #include <errno.h>
@@ -48,7 +49,9 @@ static char sccsid[] = "@(#)mpool.c	8.7 (Berkeley) 11/2/95";
 #include "mpool.h"
 
 static BKT *mpool_bkt __P((MPOOL *));
+static void mpool_grow_hash __P((MPOOL *));
 static BKT *mpool_look __P((MPOOL *, db_pgno_t));
+static int  mpool_mapped __P((MPOOL *, void *));
 static int  mpool_write __P((MPOOL *, BKT *));
 
 /*
@@ -63,7 +66,7 @@ mpool_open(key, fd, pagesize, maxcache)
 {
 	struct stat sb;
 	MPOOL *mp;
-	int entry;
+	db_pgno_t entry;
 
 	/*
 	 * Get information about the file.
@@ -82,7 +85,19 @@ mpool_open(key, fd, pagesize, maxcache)
 	if ((mp = (MPOOL *)calloc(1, sizeof(MPOOL))) == NULL)
 		return (NULL);
 	TAILQ_INIT(&mp->lqh);
-	for (entry = 0; entry < HASHSIZE; ++entry)
+
+	/*
+	 * Start with a small hash table; mpool_bkt grows it as pages are
+	 * cached, so that opening a pool with a large maximum cache stays
+	 * cheap.
+	 */
+	mp->hashsize = HASHSIZE;
+	mp->hqh = malloc(mp->hashsize * sizeof(*mp->hqh));
+	if (mp->hqh == NULL) {
+		free(mp);
+		return (NULL);
+	}
+	for (entry = 0; entry < mp->hashsize; ++entry)
 		TAILQ_INIT(&mp->hqh[entry]);
 	mp->maxcache = maxcache;
 	mp->npages = sb.st_size / pagesize;
@@ -107,6 +122,36 @@ mpool_filter(mp, pgin, pgout, pgcookie)
 	mp->pgcookie = pgcookie;
 }
 
+/*
+ * mpool_map --
+ *	Map the file read-only, so that mpool_get can return pages which
+ *	exist in the file directly from the mapping instead of reading them
+ *	into the cache.  Only suitable for a file opened read-only whose
+ *	input filter, if any, leaves pages unchanged.  Failure is not fatal;
+ *	pages are then read into the cache as usual.
+ */
+int
+mpool_map(mp)
+	MPOOL *mp;
+{
+	size_t len;
+	void *map;
+
+	if (mp->map != NULL || mp->npages == 0)
+		return (RET_SUCCESS);
+	len = (size_t)mp->npages * mp->pagesize;
+	if (len / mp->pagesize != mp->npages) {
+		errno = E2BIG;
+		return (RET_ERROR);
+	}
+	map = mmap(NULL, len, PROT_READ, MAP_SHARED, mp->fd, 0);
+	if (map == MAP_FAILED)
+		return (RET_ERROR);
+	mp->map = map;
+	mp->mapsize = len;
+	return (RET_SUCCESS);
+}
+
 /*
  * mpool_new --
  *	Get a new page of memory.
@@ -142,7 +187,7 @@ mpool_new(mp, pgnoaddr, flags)
 
 	bp->flags = MPOOL_PINNED | MPOOL_INUSE;
 
-	head = &mp->hqh[HASHKEY(bp->pgno)];
+	head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 	TAILQ_INSERT_HEAD(head, bp, hq);
 	TAILQ_INSERT_TAIL(&mp->lqh, bp, q);
 	return (bp->page);
@@ -156,6 +201,10 @@ mpool_delete(mp, page)
 	struct _hqh *head;
 	BKT *bp;
 
+	/* Mapped pages have no bucket to release. */
+	if (mpool_mapped(mp, page))
+		return (RET_SUCCESS);
+
 	bp = (void *)((char *)page - sizeof(BKT));
 
 #ifdef DEBUG
@@ -167,7 +216,7 @@ mpool_delete(mp, page)
 #endif
 
 	/* Remove from the hash and lru queues. */
-	head = &mp->hqh[HASHKEY(bp->pgno)];
+	head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 	TAILQ_REMOVE(head, bp, hq);
 	TAILQ_REMOVE(&mp->lqh, bp, q);
 
@@ -194,6 +243,10 @@ mpool_get(mp, pgno, flags)
 	++mp->pageget;
 #endif
 
+	/* Pages within the mapping are returned in place. */
+	if (mp->map != NULL && pgno < mp->mapsize / mp->pagesize)
+		return (mp->map + (size_t)pgno * mp->pagesize);
+
 	/* Check for a page that is cached. */
 	if ((bp = mpool_look(mp, pgno)) != NULL) {
 #ifdef DEBUG
@@ -207,7 +260,7 @@ mpool_get(mp, pgno, flags)
 		 * Move the page to the head of the hash chain and the tail
 		 * of the lru chain.
 		 */
-		head = &mp->hqh[HASHKEY(bp->pgno)];
+		head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 		TAILQ_REMOVE(head, bp, hq);
 		TAILQ_INSERT_HEAD(head, bp, hq);
 		TAILQ_REMOVE(&mp->lqh, bp, q);
@@ -262,7 +315,7 @@ mpool_get(mp, pgno, flags)
 	 * Add the page to the head of the hash chain and the tail
 	 * of the lru chain.
 	 */
-	head = &mp->hqh[HASHKEY(bp->pgno)];
+	head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 	TAILQ_INSERT_HEAD(head, bp, hq);
 	TAILQ_INSERT_TAIL(&mp->lqh, bp, q);
 
@@ -288,6 +341,14 @@ mpool_put(mp, page, flags)
 #ifdef STATISTICS
 	++mp->pageput;
 #endif
+	if (mpool_mapped(mp, page)) {
+		/* The mapping is read-only. */
+		if (flags & MPOOL_DIRTY) {
+			errno = EPERM;
+			return (RET_ERROR);
+		}
+		return (RET_SUCCESS);
+	}
 	bp = (void *)((char *)page - sizeof(BKT));
 #ifdef DEBUG
 	if (!(bp->flags & MPOOL_PINNED)) {
@@ -318,7 +379,11 @@ mpool_close(mp)
 		free(bp);
 	}
 
+	if (mp->map != NULL)
+		(void)munmap(mp->map, mp->mapsize);
+
 	/* Free the MPOOL cookie. */
+	free(mp->hqh);
 	free(mp);
 	return (RET_SUCCESS);
 }
@@ -374,7 +439,7 @@ mpool_bkt(mp)
 			++mp->pageflush;
 #endif
 			/* Remove from the hash and lru queues. */
-			head = &mp->hqh[HASHKEY(bp->pgno)];
+			head = &mp->hqh[HASHKEY(mp, bp->pgno)];
 			TAILQ_REMOVE(head, bp, hq);
 			TAILQ_REMOVE(&mp->lqh, bp, q);
 #if defined(DEBUG) && !defined(DEBUG_IDX0SPLIT)
@@ -398,10 +463,40 @@ new:	if ((bp = (BKT *)malloc(sizeof(BKT) + mp->pagesize)) == NULL)
 #endif
 	bp->page = (char *)bp + sizeof(BKT);
 	bp->flags = 0;
-	++mp->curcache;
+	if (++mp->curcache > mp->hashsize)
+		mpool_grow_hash(mp);
 	return (bp);
 }
 
+/*
+ * mpool_grow_hash
+ *	Double the number of hash chains, so that chains stay short as the
+ *	cache grows.  Failure is not fatal; the chains just get longer.
+ */
+static void
+mpool_grow_hash(mp)
+	MPOOL *mp;
+{
+	struct _hqh *hqh, *oldhqh;
+	BKT *bp;
+	db_pgno_t entry;
+
+	if (mp->hashsize >= MAXHASHSIZE)
+		return;
+	hqh = malloc(mp->hashsize * 2 * sizeof(*hqh));
+	if (hqh == NULL)
+		return;
+	oldhqh = mp->hqh;
+	mp->hqh = hqh;
+	mp->hashsize *= 2;
+	for (entry = 0; entry < mp->hashsize; ++entry)
+		TAILQ_INIT(&mp->hqh[entry]);
+	/* Every hashed bucket is also on the lru queue. */
+	for (bp = mp->lqh.tqh_first; bp != NULL; bp = bp->q.tqe_next)
+		TAILQ_INSERT_TAIL(&mp->hqh[HASHKEY(mp, bp->pgno)], bp, hq);
+	free(oldhqh);
+}
+
 /*
  * mpool_write
  *	Write a page to disk.
@@ -458,7 +553,7 @@ mpool_look(mp, pgno)
 	struct _hqh *head;
 	BKT *bp;
 
-	head = &mp->hqh[HASHKEY(pgno)];
+	head = &mp->hqh[HASHKEY(mp, pgno)];
 	for (bp = head->tqh_first; bp != NULL; bp = bp->hq.tqe_next)
 		if ((bp->pgno == pgno) && (bp->flags & MPOOL_INUSE)) {
 #ifdef STATISTICS
@@ -472,6 +567,19 @@ mpool_look(mp, pgno)
 	return (NULL);
 }
 
+/*
+ * mpool_mapped
+ *	Return true if page lies within the file mapping.
+ */
+static int
+mpool_mapped(mp, page)
+	MPOOL *mp;
+	void *page;
+{
+	return (mp->map != NULL && (char *)page >= mp->map &&
+	    (char *)page < mp->map + mp->mapsize);
+}
+
 #ifdef STATISTICS
 /*
  * mpool_stat
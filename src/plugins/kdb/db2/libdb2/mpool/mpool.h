@@ -42,8 +42,9 @@
  * Inactive pages are threaded on a free chain.  Each reference to a memory
  * pool is handed an opaque MPOOL cookie which stores all of this information.
  */
-#define	HASHSIZE	128
-#define	HASHKEY(pgno)	((pgno - 1) % HASHSIZE)
+#define	HASHSIZE	128		/* initial number of hash chains */
+#define	MAXHASHSIZE	(1U << 20)	/* maximum number of hash chains */
+#define	HASHKEY(mp, pgno)	((pgno - 1) & ((mp)->hashsize - 1))
 
 /* The BKT structures are the elements of the queues. */
 typedef struct _bkt {
@@ -61,7 +62,8 @@ typedef struct _bkt {
 typedef struct MPOOL {
 	TAILQ_HEAD(_lqh, _bkt) lqh;	/* lru queue head */
 					/* hash queue array */
-	TAILQ_HEAD(_hqh, _bkt) hqh[HASHSIZE];
+	TAILQ_HEAD(_hqh, _bkt) *hqh;
+	db_pgno_t	hashsize;		/* number of hash queues */
 	db_pgno_t	curcache;		/* current number of cached pages */
 	db_pgno_t	maxcache;		/* max number of cached pages */
 	db_pgno_t	npages;			/* number of pages in the file */
@@ -72,6 +74,8 @@ typedef struct MPOOL {
 					/* page out conversion routine */
 	void    (*pgout) __P((void *, db_pgno_t, void *));
 	void	*pgcookie;		/* cookie for page in/out routines */
+	char	*map;			/* read-only mapping of the file */
+	size_t	mapsize;		/* length of the mapping */
 #ifdef STATISTICS
 	u_long	cachehit;
 	u_long	cachemiss;
@@ -95,6 +99,7 @@ typedef struct MPOOL {
 #define mpool_filter	kdb2_mpool_filter
 #define mpool_new	kdb2_mpool_new
 #define mpool_get	kdb2_mpool_get
+#define mpool_map	kdb2_mpool_map
 #define mpool_delete	kdb2_mpool_delete
 #define mpool_put	kdb2_mpool_put
 #define mpool_sync	kdb2_mpool_sync
@@ -107,6 +112,7 @@ void	 mpool_filter __P((MPOOL *, void (*)(void *, db_pgno_t, void *),
 	    void (*)(void *, db_pgno_t, void *), void *));
 void	*mpool_new __P((MPOOL *, db_pgno_t *, u_int));
 void	*mpool_get __P((MPOOL *, db_pgno_t, u_int));
+int	 mpool_map __P((MPOOL *));
 int	 mpool_delete __P((MPOOL *, void *));
 int	 mpool_put __P((MPOOL *, void *, u_int));
 int	 mpool_sync __P((MPOOL *));
@@ -0,0 +1,186 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/kdb/db2/libdb2/test/dbperf.c - Measure btree lookup throughput */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program creates a btree database of count principal-like records,
+ * then measures the rate of random lookups with the database opened for
+ * read-write access (pages read into the mpool cache, with the default and
+ * with a large cache size) and for read-only access (pages used directly
+ * from a mapping of the file).  Every lookup result is checked.  Usage:
+ *
+ *     ./dbperf count [pagesize]
+ */
+
+#include <sys/time.h>
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "db-int.h"
+#include "btree.h"
+
+#define DBFILE "__dbperf.db"
+#define DATALEN 400
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static size_t
+make_key(char *buf, size_t len, int i)
+{
+    return snprintf(buf, len, "user%d/host%d.example.com@EXAMPLE.COM",
+                    i, i % 97);
+}
+
+/* Fill buf with data identifying record i. */
+static void
+make_data(char *buf, int i)
+{
+    memset(buf, 'A' + i % 26, DATALEN);
+    memcpy(buf, &i, sizeof(i));
+}
+
+static DB *
+open_tree(int flags, u_int psize, u_int cachesize)
+{
+    BTREEINFO bti;
+    DB *db;
+
+    memset(&bti, 0, sizeof(bti));
+    bti.psize = psize;
+    bti.cachesize = cachesize;
+    db = dbopen(DBFILE, flags, 0600, DB_BTREE, &bti);
+    if (db == NULL) {
+        perror(DBFILE);
+        exit(1);
+    }
+    return db;
+}
+
+static void
+create_tree(int count, u_int psize)
+{
+    DB *db;
+    DBT key, data;
+    char kbuf[128], dbuf[DATALEN];
+    int i;
+
+    unlink(DBFILE);
+    db = open_tree(O_RDWR | O_CREAT, psize, 1024 * 1024);
+    for (i = 0; i < count; i++) {
+        key.data = kbuf;
+        key.size = make_key(kbuf, sizeof(kbuf), i);
+        make_data(dbuf, i);
+        data.data = dbuf;
+        data.size = DATALEN;
+        assert(db->put(db, &key, &data, 0) == 0);
+    }
+    assert(db->close(db) == 0);
+}
+
+static void
+lookups(const char *desc, int count, int flags, u_int cachesize)
+{
+    DB *db;
+    DBT key, data;
+    BTREE *t;
+    struct timeval start;
+    double secs;
+    char kbuf[128], dbuf[DATALEN];
+    unsigned int r = 1;
+    int i, n;
+
+    db = open_tree(flags, 0, cachesize);
+    t = db->internal;
+    /* Read-only trees should be served from a mapping of the file. */
+    assert((t->bt_mp->map != NULL) == ((flags & O_ACCMODE) == O_RDONLY));
+
+    /* A nonexistent key must not be found. */
+    key.data = "nobody@EXAMPLE.COM";
+    key.size = strlen(key.data);
+    assert(db->get(db, &key, &data, 0) == 1);
+
+    gettimeofday(&start, NULL);
+    for (n = 0; n < count; n++) {
+        r = r * 1103515245 + 12345;
+        i = (r >> 8) % count;
+        key.data = kbuf;
+        key.size = make_key(kbuf, sizeof(kbuf), i);
+        assert(db->get(db, &key, &data, 0) == 0);
+        make_data(dbuf, i);
+        assert(data.size == DATALEN);
+        assert(memcmp(data.data, dbuf, DATALEN) == 0);
+    }
+    secs = elapsed(&start);
+    if (secs <= 0)
+        secs = 1e-6;
+    printf("%d lookups (%s) in %.3f s (%.0f/s)\n", count, desc, secs,
+           count / secs);
+    assert(db->close(db) == 0);
+}
+
+int
+main(int argc, char **argv)
+{
+    int count;
+    u_int psize;
+
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "Usage: dbperf count [pagesize]\n");
+        exit(1);
+    }
+    count = atoi(argv[1]);
+    psize = (argc == 3) ? atoi(argv[2]) : 4096;
+    if (count <= 0) {
+        fprintf(stderr, "dbperf: count must be positive\n");
+        exit(1);
+    }
+
+    create_tree(count, psize);
+    lookups("read-write, default cache", count, O_RDWR, 0);
+    lookups("read-write, 64MB cache", count, O_RDWR, 64 * 1024 * 1024);
+    lookups("read-only, mapped", count, O_RDONLY, 0);
+
+    unlink(DBFILE);
+    return 0;
+}
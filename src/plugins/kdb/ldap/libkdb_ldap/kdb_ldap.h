@@ -212,6 +212,8 @@ typedef struct _krb5_ldap_context {
     krb5_boolean                  disable_lockout;
     int                           ldap_debug;
     krb5_context                  kcontext;   /* to set the error code and message */
+    struct ldap_princ_cache       *princ_cache;
+    char                          *cache_stamp_file;
 } krb5_ldap_context;
 
 
@@ -313,4 +315,9 @@ krb5_ldap_lockout_audit(krb5_context context,
                         krb5_timestamp stamp,
                         krb5_error_code status);
 
+/* ldap_princ_cache.c */
+void
+krb5_ldap_princ_cache_changed(krb5_context context,
+                              krb5_ldap_context *ldap_context);
+
 #endif
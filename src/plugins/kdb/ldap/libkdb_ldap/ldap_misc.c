@@ -314,6 +314,7 @@ krb5_ldap_read_server_params(krb5_context context, char *conf_section,
     char *servers, *save_ptr, *item;
     const char *delims = "\t\n\f\v\r ,", *name;
     krb5_error_code ret = 0;
+    krb5_ui_4 cache_lifetime;
     kdb5_dal_handle *dal_handle = context->dal_handle;
     krb5_ldap_context *ldap_context = dal_handle->db_context;
 
@@ -431,6 +432,31 @@ krb5_ldap_read_server_params(krb5_context context, char *conf_section,
     if (ret)
         return ret;
 
+    /* Read the file used to signal principal changes to KDC caches.  Every
+     * process reads it, since every process which writes must update it. */
+    if (ldap_context->cache_stamp_file == NULL) {
+        ret = prof_get_string_def(context, conf_section,
+                                  KRB5_CONF_LDAP_PRINCIPAL_CACHE_STAMP_FILE,
+                                  &ldap_context->cache_stamp_file);
+        if (ret)
+            return ret;
+    }
+
+    /* Read the principal entry cache lifetime.  Only the KDC uses the cache;
+     * administrative changes must always see the current entry. */
+    ret = prof_get_integer_def(context, conf_section,
+                               KRB5_CONF_LDAP_PRINCIPAL_CACHE_LIFETIME, 0,
+                               &cache_lifetime);
+    if (ret)
+        return ret;
+    if (srv_type == KRB5_KDB_SRV_TYPE_KDC && cache_lifetime > 0 &&
+        ldap_context->princ_cache == NULL) {
+        ret = krb5_ldap_princ_cache_init(context, ldap_context,
+                                         cache_lifetime);
+        if (ret)
+            return ret;
+    }
+
     return prof_get_boolean_def(context, conf_section,
                                 KRB5_CONF_DISABLE_LOCKOUT, FALSE,
                                 &ldap_context->disable_lockout);
@@ -467,8 +493,9 @@ krb5_ldap_free_server_context_params(krb5_ldap_context *ctx)
     free(ctx->bind_dn);
     zapfreestr(ctx->bind_pwd);
     free(ctx->service_password_file);
+    free(ctx->cache_stamp_file);
     ctx->conf_section = ctx->bind_dn = ctx->bind_pwd = NULL;
-    ctx->service_password_file = NULL;
+    ctx->service_password_file = ctx->cache_stamp_file = NULL;
 }
 
 void
@@ -477,6 +504,7 @@ krb5_ldap_free_server_params(krb5_ldap_context *ctx)
     if (ctx == NULL)
         return;
     krb5_ldap_free_server_context_params(ctx);
+    krb5_ldap_princ_cache_free(ctx->kcontext, ctx);
     k5_mutex_destroy(&ctx->hndl_lock);
     free(ctx);
 }
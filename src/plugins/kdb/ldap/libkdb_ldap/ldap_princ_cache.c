@@ -0,0 +1,424 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/kdb/ldap/libkdb_ldap/ldap_princ_cache.c - LDAP principal entry cache */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * When ldap_principal_cache_lifetime is set, krb5_ldap_get_principal() keeps a
+ * copy of each entry it fetches for that many seconds, so that repeated
+ * lookups of the same principals (krbtgt and busy service principals in
+ * particular) do not each wait for a directory round trip.  Entries modified
+ * or removed by this process are discarded immediately.  Only lookups by
+ * canonical name are cached, so that there is at most one cached entry to
+ * discard for a principal.
+ *
+ * Other processes, such as kadmind, kadmin.local, or other KDC worker
+ * processes, cannot reach this cache directly.  Instead, every process which
+ * modifies a principal or ticket policy through this module increments the
+ * change count in a stamp file (ldap_principal_cache_stamp_file), and the cache
+ * is emptied whenever a lookup finds that the count changed.  The count is
+ * updated under a file lock, so no change is lost, and it does not depend on
+ * the clock.
+ *
+ * The lockout attribute updates the KDC makes after each authentication are
+ * not counted, or every KDC process would empty its cache on almost every
+ * request.  The process making such an update discards only its own copy of
+ * the entry; other processes see the new lockout state once their copies
+ * expire.  Changes made by other hosts or directly in the directory are also
+ * seen once the cached copy expires.
+ */
+
+#include "ldap_main.h"
+#include "kdb_ldap.h"
+#include "ldap_principal.h"
+#include "k5-queue.h"
+#include "k5-hashtab.h"
+
+#ifndef PRINC_CACHE_MAX_ENTRIES
+#define PRINC_CACHE_MAX_ENTRIES 65536
+#endif
+
+struct entry {
+    K5_TAILQ_ENTRY(entry) links;
+    char *name;
+    time_t expires;
+    krb5_db_entry *dbent;
+};
+
+K5_TAILQ_HEAD(entry_queue, entry);
+
+struct ldap_princ_cache {
+    k5_mutex_t lock;
+    struct k5_hashtab *table;
+    struct entry_queue queue;   /* In order of expiry */
+    size_t count;
+    krb5_deltat lifetime;
+    krb5_boolean count_valid;   /* True if change_count is current */
+    uint64_t change_count;      /* Stamp file count when last checked */
+};
+
+/* Return the number of key_data_contents elements used by kd. */
+static int
+key_data_count(const krb5_key_data *kd)
+{
+    return (kd->key_data_ver == 1) ? 1 : 2;
+}
+
+/* Make a deep copy of in. */
+static krb5_error_code
+copy_db_entry(krb5_context context, const krb5_db_entry *in,
+              krb5_db_entry **out)
+{
+    krb5_error_code ret;
+    krb5_db_entry *e;
+    krb5_tl_data *tl, **tlp;
+    krb5_key_data *kd;
+    int i, j;
+
+    *out = NULL;
+    e = k5alloc(sizeof(*e), &ret);
+    if (e == NULL)
+        return ret;
+    *e = *in;
+    e->e_data = NULL;
+    e->princ = NULL;
+    e->tl_data = NULL;
+    e->n_key_data = 0;
+    e->key_data = NULL;
+
+    if (in->e_length > 0) {
+        e->e_data = k5memdup(in->e_data, in->e_length, &ret);
+        if (e->e_data == NULL)
+            goto cleanup;
+    }
+
+    ret = krb5_copy_principal(context, in->princ, &e->princ);
+    if (ret)
+        goto cleanup;
+
+    tlp = &e->tl_data;
+    for (tl = in->tl_data; tl != NULL; tl = tl->tl_data_next) {
+        *tlp = k5alloc(sizeof(**tlp), &ret);
+        if (*tlp == NULL)
+            goto cleanup;
+        (*tlp)->tl_data_type = tl->tl_data_type;
+        (*tlp)->tl_data_length = tl->tl_data_length;
+        if (tl->tl_data_length > 0) {
+            (*tlp)->tl_data_contents = k5memdup(tl->tl_data_contents,
+                                                tl->tl_data_length, &ret);
+            if ((*tlp)->tl_data_contents == NULL)
+                goto cleanup;
+        }
+        tlp = &(*tlp)->tl_data_next;
+    }
+
+    if (in->n_key_data > 0) {
+        e->key_data = k5calloc(in->n_key_data, sizeof(*e->key_data), &ret);
+        if (e->key_data == NULL)
+            goto cleanup;
+        for (i = 0; i < in->n_key_data; i++) {
+            kd = &e->key_data[i];
+            *kd = in->key_data[i];
+            kd->key_data_contents[0] = kd->key_data_contents[1] = NULL;
+            e->n_key_data = i + 1;
+            for (j = 0; j < key_data_count(kd); j++) {
+                if (kd->key_data_length[j] == 0)
+                    continue;
+                kd->key_data_contents[j] =
+                    k5memdup(in->key_data[i].key_data_contents[j],
+                             kd->key_data_length[j], &ret);
+                if (kd->key_data_contents[j] == NULL)
+                    goto cleanup;
+            }
+        }
+    }
+
+    *out = e;
+    e = NULL;
+    ret = 0;
+
+cleanup:
+    krb5_db_free_principal(context, e);
+    return ret;
+}
+
+/* Get the cache key for princ, as used by krb5_ldap_get_principal(). */
+static krb5_error_code
+cache_name(krb5_context context, krb5_const_principal princ, char **name_out)
+{
+    krb5_error_code ret;
+    char *name;
+
+    *name_out = NULL;
+    ret = krb5_unparse_name(context, princ, &name);
+    if (ret)
+        return ret;
+    ret = krb5_ldap_unparse_principal_name(name);
+    if (ret) {
+        free(name);
+        return ret;
+    }
+    *name_out = name;
+    return 0;
+}
+
+static void
+discard_entry(krb5_context context, struct ldap_princ_cache *cache,
+              struct entry *entry)
+{
+    k5_hashtab_remove(cache->table, entry->name, strlen(entry->name));
+    K5_TAILQ_REMOVE(&cache->queue, entry, links);
+    cache->count--;
+    krb5_db_free_principal(context, entry->dbent);
+    free(entry->name);
+    free(entry);
+}
+
+static void
+discard_all(krb5_context context, struct ldap_princ_cache *cache)
+{
+    while (!K5_TAILQ_EMPTY(&cache->queue))
+        discard_entry(context, cache, K5_TAILQ_FIRST(&cache->queue));
+}
+
+/*
+ * Empty the cache if another process has modified a principal since the stamp
+ * file was last checked.  If the stamp file cannot be read, empty the cache
+ * and stop adding to it until it can be.
+ */
+static void
+check_stamp(krb5_context context, krb5_ldap_context *ldap_context,
+            struct ldap_princ_cache *cache)
+{
+    uint64_t count;
+
+    if (krb5_db_read_change_count(context, ldap_context->cache_stamp_file,
+                                  &count) != 0) {
+        discard_all(context, cache);
+        cache->count_valid = FALSE;
+        return;
+    }
+    if (!cache->count_valid || count != cache->change_count) {
+        discard_all(context, cache);
+        cache->change_count = count;
+        cache->count_valid = TRUE;
+    }
+}
+
+/* Discard expired entries, which are at the front of the queue. */
+static void
+expire_entries(krb5_context context, struct ldap_princ_cache *cache,
+               time_t now)
+{
+    struct entry *e, *next;
+
+    K5_TAILQ_FOREACH_SAFE(e, &cache->queue, links, next) {
+        if (e->expires > now)
+            break;
+        discard_entry(context, cache, e);
+    }
+}
+
+krb5_error_code
+krb5_ldap_princ_cache_init(krb5_context context,
+                           krb5_ldap_context *ldap_context,
+                           krb5_deltat lifetime)
+{
+    krb5_error_code ret;
+    struct ldap_princ_cache *cache;
+    int fd;
+    /* Cache keys are principal names; collisions only cost speed. */
+    static const uint8_t seed[K5_HASH_SEED_LEN];
+
+    /* Without the stamp file, changes made by kadmind would go unseen. */
+    if (ldap_context->cache_stamp_file == NULL) {
+        k5_setmsg(context, EINVAL, _("%s requires %s"),
+                  KRB5_CONF_LDAP_PRINCIPAL_CACHE_LIFETIME,
+                  KRB5_CONF_LDAP_PRINCIPAL_CACHE_STAMP_FILE);
+        return EINVAL;
+    }
+    fd = open(ldap_context->cache_stamp_file, O_WRONLY | O_CREAT, 0600);
+    if (fd == -1) {
+        ret = errno;
+        k5_setmsg(context, ret, _("Cannot open principal cache stamp file "
+                                  "%s"), ldap_context->cache_stamp_file);
+        return ret;
+    }
+    close(fd);
+
+    cache = k5alloc(sizeof(*cache), &ret);
+    if (cache == NULL)
+        return ret;
+    ret = k5_mutex_init(&cache->lock);
+    if (ret) {
+        free(cache);
+        return ret;
+    }
+    ret = k5_hashtab_create(seed, 1024, &cache->table);
+    if (ret) {
+        k5_mutex_destroy(&cache->lock);
+        free(cache);
+        return ret;
+    }
+    K5_TAILQ_INIT(&cache->queue);
+    cache->lifetime = lifetime;
+    ldap_context->princ_cache = cache;
+    return 0;
+}
+
+void
+krb5_ldap_princ_cache_free(krb5_context context,
+                           krb5_ldap_context *ldap_context)
+{
+    struct ldap_princ_cache *cache = ldap_context->princ_cache;
+    struct entry *e, *next;
+
+    if (cache == NULL)
+        return;
+    K5_TAILQ_FOREACH_SAFE(e, &cache->queue, links, next)
+        discard_entry(context, cache, e);
+    k5_hashtab_free(cache->table);
+    k5_mutex_destroy(&cache->lock);
+    free(cache);
+    ldap_context->princ_cache = NULL;
+}
+
+/* If an unexpired entry for name is cached, set *entry_out to a copy of it and
+ * return true. */
+krb5_boolean
+krb5_ldap_princ_cache_get(krb5_context context,
+                          krb5_ldap_context *ldap_context, const char *name,
+                          krb5_db_entry **entry_out)
+{
+    struct ldap_princ_cache *cache = ldap_context->princ_cache;
+    struct entry *e;
+    krb5_boolean found = FALSE;
+
+    *entry_out = NULL;
+    if (cache == NULL)
+        return FALSE;
+
+    k5_mutex_lock(&cache->lock);
+    check_stamp(context, ldap_context, cache);
+    expire_entries(context, cache, time(NULL));
+    e = k5_hashtab_get(cache->table, name, strlen(name));
+    if (e != NULL)
+        found = (copy_db_entry(context, e->dbent, entry_out) == 0);
+    k5_mutex_unlock(&cache->lock);
+    return found;
+}
+
+/* Cache a copy of entry, which was fetched from the directory under name. */
+void
+krb5_ldap_princ_cache_add(krb5_context context,
+                          krb5_ldap_context *ldap_context, const char *name,
+                          const krb5_db_entry *entry)
+{
+    struct ldap_princ_cache *cache = ldap_context->princ_cache;
+    struct entry *e;
+    time_t now = time(NULL);
+
+    if (cache == NULL)
+        return;
+
+    e = calloc(1, sizeof(*e));
+    if (e == NULL)
+        return;
+    e->name = strdup(name);
+    if (e->name == NULL || copy_db_entry(context, entry, &e->dbent) != 0) {
+        free(e->name);
+        free(e);
+        return;
+    }
+    e->expires = now + cache->lifetime;
+
+    k5_mutex_lock(&cache->lock);
+    if (!cache->count_valid)
+        goto fail;
+    expire_entries(context, cache, now);
+    if (k5_hashtab_get(cache->table, name, strlen(name)) != NULL)
+        goto fail;
+    if (cache->count >= PRINC_CACHE_MAX_ENTRIES)
+        discard_entry(context, cache, K5_TAILQ_FIRST(&cache->queue));
+    if (k5_hashtab_add(cache->table, e->name, strlen(e->name), e) != 0)
+        goto fail;
+    K5_TAILQ_INSERT_TAIL(&cache->queue, e, links);
+    cache->count++;
+    k5_mutex_unlock(&cache->lock);
+    return;
+
+fail:
+    k5_mutex_unlock(&cache->lock);
+    krb5_db_free_principal(context, e->dbent);
+    free(e->name);
+    free(e);
+}
+
+/* If a stamp file is configured, increment its change count so that principal
+ * caches in other processes are emptied. */
+void
+krb5_ldap_princ_cache_changed(krb5_context context,
+                              krb5_ldap_context *ldap_context)
+{
+    if (ldap_context->cache_stamp_file == NULL)
+        return;
+    (void)krb5_db_incr_change_count(context, ldap_context->cache_stamp_file);
+}
+
+/* Discard any cached entry for princ, which is being modified or removed.  If
+ * notify is true, also signal the change to principal caches in other
+ * processes. */
+void
+krb5_ldap_princ_cache_remove(krb5_context context,
+                             krb5_ldap_context *ldap_context,
+                             krb5_const_principal princ, krb5_boolean notify)
+{
+    struct ldap_princ_cache *cache = ldap_context->princ_cache;
+    struct entry *e;
+    char *name;
+
+    if (notify)
+        krb5_ldap_princ_cache_changed(context, ldap_context);
+    if (cache == NULL || princ == NULL)
+        return;
+
+    /* If we can't compute the name, we can't find the entry either; flush
+     * everything rather than risk serving a stale copy. */
+    k5_mutex_lock(&cache->lock);
+    if (cache_name(context, princ, &name) != 0) {
+        discard_all(context, cache);
+    } else {
+        e = k5_hashtab_get(cache->table, name, strlen(name));
+        if (e != NULL)
+            discard_entry(context, cache, e);
+        free(name);
+    }
+    k5_mutex_unlock(&cache->lock);
+}
@@ -331,6 +331,8 @@ krb5_ldap_delete_principal(krb5_context context,
     }
 
 cleanup:
+    krb5_ldap_princ_cache_remove(context, ldap_context, searchfor, TRUE);
+
     if (user)
         free (user);
 
@@ -552,6 +554,8 @@ krb5_ldap_rename_principal(krb5_context context, krb5_const_principal source,
         goto cleanup;
 
 cleanup:
+    krb5_ldap_princ_cache_remove(context, ldap_context, source, TRUE);
+    krb5_ldap_princ_cache_remove(context, ldap_context, target, TRUE);
     free(dn);
     free(suser);
     free(tuser);
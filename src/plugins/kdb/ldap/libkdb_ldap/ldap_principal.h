@@ -92,6 +92,12 @@
  */
 #define KADM5_FAIL_AUTH_COUNT_INCREMENT      0x080000 /* KADM5_CPW_FUNCTION */
 
+/* The attributes krb5_ldap_lockout_audit() may update.  kadm5 modifications
+ * always include KADM5_TL_DATA, so a mask within this one comes from the KDC's
+ * lockout processing. */
+#define LOCKOUT_MASK (KADM5_LAST_SUCCESS | KADM5_LAST_FAILED |          \
+                      KADM5_FAIL_AUTH_COUNT | KADM5_FAIL_AUTH_COUNT_INCREMENT)
+
 extern struct timeval timeout;
 extern char *policyclass[];
 
@@ -149,4 +155,22 @@ berval2tl_data(struct berval *in, krb5_tl_data **out);
 krb5_error_code
 krb5_read_tkt_policy(krb5_context, krb5_ldap_context *, krb5_db_entry *,
                      char *);
+
+krb5_error_code
+krb5_ldap_princ_cache_init(krb5_context, krb5_ldap_context *, krb5_deltat);
+
+void
+krb5_ldap_princ_cache_free(krb5_context, krb5_ldap_context *);
+
+krb5_boolean
+krb5_ldap_princ_cache_get(krb5_context, krb5_ldap_context *, const char *,
+                          krb5_db_entry **);
+
+void
+krb5_ldap_princ_cache_add(krb5_context, krb5_ldap_context *, const char *,
+                          const krb5_db_entry *);
+
+void
+krb5_ldap_princ_cache_remove(krb5_context, krb5_ldap_context *,
+                             krb5_const_principal, krb5_boolean);
 #endif
@@ -144,6 +144,9 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     if ((st=krb5_ldap_unparse_principal_name(user)) != 0)
         goto cleanup;
 
+    if (krb5_ldap_princ_cache_get(context, ldap_context, user, entry_ptr))
+        goto cleanup;
+
     filtuser = ldap_filter_correct(user);
     if (filtuser == NULL) {
         st = ENOMEM;
@@ -214,6 +217,9 @@ krb5_ldap_get_principal(krb5_context context, krb5_const_principal searchfor,
     } /* for (tree=0 ... */
 
     if (found) {
+        /* Only cache lookups by canonical name; see ldap_princ_cache.c. */
+        if (cprinc == NULL)
+            krb5_ldap_princ_cache_add(context, ldap_context, user, entry);
         *entry_ptr = entry;
         entry = NULL;
     } else
@@ -785,6 +791,7 @@ krb5_ldap_put_principal(krb5_context context, krb5_db_entry *entry,
     char                        *polname = NULL;
     OPERATION optype;
     krb5_boolean                found_entry = FALSE;
+    krb5_boolean                lockout_only;
 
     /* Clear the global error string */
     krb5_clear_error_message(context);
@@ -1450,6 +1457,13 @@ krb5_ldap_put_principal(krb5_context context, krb5_db_entry *entry,
     }
 
 cleanup:
+    /* Make sure the next lookup sees the result of the modification.  Don't
+     * make other processes empty their caches for the KDC's lockout
+     * updates. */
+    lockout_only = (entry->mask != 0 && (entry->mask & ~LOCKOUT_MASK) == 0);
+    krb5_ldap_princ_cache_remove(context, ldap_context, entry->princ,
+                                 !lockout_only);
+
     if (user)
         free(user);
 
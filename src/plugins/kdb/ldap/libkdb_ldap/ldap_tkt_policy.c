@@ -183,6 +183,9 @@ krb5_ldap_modify_policy(krb5_context context, krb5_ldap_policy_params *policy,
         goto cleanup;
     }
 
+    /* Cached principal entries include ticket policy values. */
+    krb5_ldap_princ_cache_changed(context, ldap_context);
+
 cleanup:
     if (policy_dn != NULL)
         free(policy_dn);
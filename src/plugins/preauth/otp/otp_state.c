@@ -43,6 +43,7 @@
 #define DEFAULT_SOCKET_FMT KDC_RUN_DIR "/%s.socket"
 #define DEFAULT_TIMEOUT 5
 #define DEFAULT_RETRIES 3
+#define DEFAULT_MAX_SOCKETS 1
 #define MAX_SECRET_LEN 1024
 
 typedef struct token_type_st {
@@ -51,6 +52,7 @@ typedef struct token_type_st {
     char *secret;
     int timeout;
     size_t retries;
+    size_t max_sockets;
     krb5_boolean strip_realm;
     char **indicators;
 } token_type;
@@ -163,6 +165,7 @@ token_type_default(token_type *out)
     out->secret = secret;
     out->timeout = DEFAULT_TIMEOUT * 1000;
     out->retries = DEFAULT_RETRIES;
+    out->max_sockets = DEFAULT_MAX_SOCKETS;
     out->strip_realm = FALSE;
     return 0;
 
@@ -180,7 +183,7 @@ token_type_decode(profile_t profile, const char *name, token_type *out)
     char *server = NULL, *name_copy = NULL, *secret = NULL, *pstr = NULL;
     char **indicators = NULL;
     const char *keys[4];
-    int strip_realm, timeout, retries;
+    int strip_realm, timeout, retries, max_sockets;
     krb5_error_code retval;
 
     memset(out, 0, sizeof(*out));
@@ -249,6 +252,14 @@ token_type_decode(profile_t profile, const char *name, token_type *out)
     if (retval != 0)
         goto cleanup;
 
+    /* Get the number of sockets which may be opened to the server. */
+    retval = profile_get_integer(profile, "otp", name, "max_sockets",
+                                 DEFAULT_MAX_SOCKETS, &max_sockets);
+    if (retval != 0)
+        goto cleanup;
+    if (max_sockets < 1)
+        max_sockets = 1;
+
     /* Get the authentication indicators to assert if this token is used. */
     keys[0] = "otp";
     keys[1] = name;
@@ -265,6 +276,7 @@ token_type_decode(profile_t profile, const char *name, token_type *out)
     out->secret = secret;
     out->timeout = timeout;
     out->retries = retries;
+    out->max_sockets = max_sockets;
     out->strip_realm = strip_realm;
     out->indicators = indicators;
     name_copy = server = secret = NULL;
@@ -693,12 +705,21 @@ otp_state_verify(otp_state *state, verto_ctx *ctx, krb5_const_principal princ,
 {
     krb5_error_code retval;
     request *rqst = NULL;
+    size_t i, max_sockets = DEFAULT_MAX_SOCKETS;
     char *name;
 
     if (state->radius == NULL) {
         retval = krad_client_new(state->ctx, ctx, &state->radius);
         if (retval != 0)
             goto error;
+
+        /* All token types share one client, so use the largest socket
+         * limit among them. */
+        for (i = 0; state->types[i].server != NULL; i++) {
+            if (state->types[i].max_sockets > max_sockets)
+                max_sockets = state->types[i].max_sockets;
+        }
+        krad_client_set_max_sockets(state->radius, max_sockets);
     }
 
     rqst = calloc(1, sizeof(request));
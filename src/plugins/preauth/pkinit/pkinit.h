@@ -68,6 +68,8 @@
 #define KRB5_CONF_PKINIT_ANCHORS                "pkinit_anchors"
 #define KRB5_CONF_PKINIT_INDICATOR              "pkinit_indicator"
 #define KRB5_CONF_PKINIT_CERT_MATCH             "pkinit_cert_match"
+#define KRB5_CONF_PKINIT_DH_KEY_MAX_USES        "pkinit_dh_key_max_uses"
+#define KRB5_CONF_PKINIT_DH_KEY_POOL_SIZE       "pkinit_dh_key_pool_size"
 #define KRB5_CONF_PKINIT_DH_MIN_BITS            "pkinit_dh_min_bits"
 #define KRB5_CONF_PKINIT_EKU_CHECKING           "pkinit_eku_checking"
 #define KRB5_CONF_PKINIT_IDENTITIES             "pkinit_identities"
@@ -152,6 +154,8 @@ typedef struct _pkinit_plg_opts {
     int require_freshness;  /* require freshness token (default is false) */
     int disable_freshness;  /* disable freshness token on client for testing */
     int dh_min_bits;	    /* minimum DH modulus size allowed */
+    int dh_key_pool_size;   /* pre-generated KDC DH keys per group */
+    int dh_key_max_uses;    /* replies per pre-generated DH key */
 } pkinit_plg_opts;
 
 /*
@@ -380,6 +380,29 @@ krb5_error_code server_process_dh
 	unsigned int *server_key_len_out);		/* OUT
 		    receives length of DH secret key */
 
+/*
+ * this function starts a pool of pre-generated KDC DH keys for the
+ * well-known groups, refilled by a background thread, which
+ * server_process_dh() draws from instead of generating a key for each
+ * request.  It does nothing if size is not positive or threads are not
+ * available.
+ */
+krb5_error_code pkinit_init_dh_key_pool
+	(krb5_context context,				/* IN */
+	pkinit_plg_crypto_context plg_cryptoctx,	/* IN */
+	int size,					/* IN
+		    number of keys to keep for each group */
+	int max_uses);					/* IN
+		    number of replies each key may be used for */
+
+/*
+ * this function stops the DH key pool started by pkinit_init_dh_key_pool(),
+ * if any, after tracing its usage counts
+ */
+void pkinit_fini_dh_key_pool
+	(krb5_context context,				/* IN */
+	pkinit_plg_crypto_context plg_cryptoctx);	/* IN */
+
 /*
  * this functions takes in crypto specific representation of
  * supportedCMSTypes and creates a list of
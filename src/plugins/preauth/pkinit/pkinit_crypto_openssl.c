@@ -43,6 +43,7 @@ static void pkinit_fini_pkinit_oids(pkinit_plg_crypto_context );
 
 static krb5_error_code pkinit_init_dh_params(pkinit_plg_crypto_context );
 static void pkinit_fini_dh_params(pkinit_plg_crypto_context );
+static void dh_pool_free(struct dh_key_pool *pool);
 
 static krb5_error_code pkinit_init_certs(pkinit_identity_crypto_context ctx);
 static void pkinit_fini_certs(pkinit_identity_crypto_context ctx);
@@ -223,6 +224,8 @@ static void compat_dh_get0_pqg(const DH *dh, const BIGNUM **p,
         *g = dh->g;
 }
 
+#define DH_up_ref(dh) CRYPTO_add(&(dh)->references, 1, CRYPTO_LOCK_DH)
+
 #define DH_get0_key compat_dh_get0_key
 static void compat_dh_get0_key(const DH *dh, const BIGNUM **pub,
                                const BIGNUM **priv)
@@ -566,6 +569,7 @@ pkinit_fini_plg_crypto(pkinit_plg_crypto_context cryptoctx)
     if (cryptoctx == NULL)
         return;
     pkinit_fini_pkinit_oids(cryptoctx);
+    dh_pool_free(cryptoctx->dh_pool);
     pkinit_fini_dh_params(cryptoctx);
     free(cryptoctx);
 }
@@ -2774,6 +2778,274 @@ dup_dh_params(const DH *src)
     return dh;
 }
 
+/*
+ * The KDC DH key pool holds pre-generated server keys for each well-known
+ * group, so that server_process_dh() can answer a burst of PKINIT requests
+ * without a modular exponentiation per request for the server key.  A group's
+ * pool is activated the first time a client uses that group, and is then
+ * kept full by a background thread.  The thread is also started on first use
+ * rather than at initialization, because the KDC may fork after loading its
+ * preauth modules.  Each pooled key is used for at most max_uses replies
+ * (one by default, so that no two replies share a key).
+ */
+
+#if defined(ENABLE_THREADS) && defined(HAVE_PTHREAD)
+
+#include <pthread.h>
+
+#define DH_POOL_NGROUPS 3
+
+struct dh_pool_group {
+    DH *params;                 /* alias of a plgctx group, not owned */
+    int bits;
+    krb5_boolean active;
+    DH **keys;                  /* stack of size entries, nkeys in use */
+    int *uses;                  /* remaining uses of each key */
+    int nkeys;
+    long hits;
+    long misses;
+    long generated;
+};
+
+struct dh_key_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t wanted;      /* signalled when keys are taken or on stop */
+    pthread_t thread;
+    krb5_boolean thread_started;
+    krb5_boolean stopping;
+    int size;
+    int max_uses;
+    struct dh_pool_group groups[DH_POOL_NGROUPS];
+};
+
+/* Return an active group needing keys, or NULL.  Call with pool->lock held. */
+static struct dh_pool_group *
+dh_pool_group_to_fill(struct dh_key_pool *pool)
+{
+    int i;
+
+    for (i = 0; i < DH_POOL_NGROUPS; i++) {
+        if (pool->groups[i].active && pool->groups[i].nkeys < pool->size)
+            return &pool->groups[i];
+    }
+    return NULL;
+}
+
+static void *
+dh_pool_refill(void *arg)
+{
+    struct dh_key_pool *pool = arg;
+    struct dh_pool_group *group;
+    DH *key;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping) {
+        group = dh_pool_group_to_fill(pool);
+        if (group == NULL) {
+            pthread_cond_wait(&pool->wanted, &pool->lock);
+            continue;
+        }
+
+        /* Generate the key without holding the lock. */
+        pthread_mutex_unlock(&pool->lock);
+        key = dup_dh_params(group->params);
+        if (key != NULL && !DH_generate_key(key)) {
+            DH_free(key);
+            key = NULL;
+        }
+        pthread_mutex_lock(&pool->lock);
+
+        if (key == NULL) {
+            /* Leave this group to inline generation rather than spin. */
+            group->active = FALSE;
+        } else if (pool->stopping || group->nkeys >= pool->size) {
+            DH_free(key);
+        } else {
+            group->keys[group->nkeys] = key;
+            group->uses[group->nkeys] = pool->max_uses;
+            group->nkeys++;
+            group->generated++;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/*
+ * Return a pooled key for the group matching params, with a reference owned
+ * by the caller, or NULL if there is none ready.  Set *bits_out and
+ * *uses_out to describe the group and the key's remaining uses.
+ */
+static DH *
+dh_pool_take(struct dh_key_pool *pool, DH *params, int *bits_out,
+             int *uses_out)
+{
+    struct dh_pool_group *group = NULL;
+    DH *key = NULL;
+    int i;
+
+    *bits_out = *uses_out = 0;
+    for (i = 0; i < DH_POOL_NGROUPS; i++) {
+        if (pkinit_check_dh_params(pool->groups[i].params, params) == 0) {
+            group = &pool->groups[i];
+            break;
+        }
+    }
+    if (group == NULL)
+        return NULL;
+    *bits_out = group->bits;
+
+    pthread_mutex_lock(&pool->lock);
+    if (!pool->thread_started) {
+        if (pthread_create(&pool->thread, NULL, dh_pool_refill, pool) != 0) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        pool->thread_started = TRUE;
+    }
+    group->active = TRUE;
+    if (group->nkeys > 0) {
+        i = group->nkeys - 1;
+        key = group->keys[i];
+        *uses_out = --group->uses[i];
+        if (group->uses[i] > 0) {
+            /* Leave the key in the pool for its remaining uses. */
+            DH_up_ref(key);
+        } else {
+            group->keys[i] = NULL;
+            group->nkeys--;
+        }
+        group->hits++;
+    } else {
+        group->misses++;
+    }
+    pthread_cond_signal(&pool->wanted);
+    pthread_mutex_unlock(&pool->lock);
+    return key;
+}
+
+static void
+dh_pool_free(struct dh_key_pool *pool)
+{
+    int i, j;
+
+    if (pool == NULL)
+        return;
+    if (pool->thread_started) {
+        pthread_mutex_lock(&pool->lock);
+        pool->stopping = TRUE;
+        pthread_cond_signal(&pool->wanted);
+        pthread_mutex_unlock(&pool->lock);
+        pthread_join(pool->thread, NULL);
+    }
+    for (i = 0; i < DH_POOL_NGROUPS; i++) {
+        for (j = 0; j < pool->groups[i].nkeys; j++)
+            DH_free(pool->groups[i].keys[j]);
+        free(pool->groups[i].keys);
+        free(pool->groups[i].uses);
+    }
+    pthread_cond_destroy(&pool->wanted);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+krb5_error_code
+pkinit_init_dh_key_pool(krb5_context context,
+                        pkinit_plg_crypto_context plg_cryptoctx,
+                        int size, int max_uses)
+{
+    struct dh_key_pool *pool;
+    DH *params[DH_POOL_NGROUPS];
+    int i, bits[DH_POOL_NGROUPS] = { 1024, 2048, 4096 };
+
+    if (size <= 0 || plg_cryptoctx->dh_pool != NULL)
+        return 0;
+
+    pool = calloc(1, sizeof(*pool));
+    if (pool == NULL)
+        return ENOMEM;
+    if (pthread_mutex_init(&pool->lock, NULL) != 0) {
+        free(pool);
+        return ENOMEM;
+    }
+    if (pthread_cond_init(&pool->wanted, NULL) != 0) {
+        pthread_mutex_destroy(&pool->lock);
+        free(pool);
+        return ENOMEM;
+    }
+    pool->size = size;
+    pool->max_uses = (max_uses > 0) ? max_uses : 1;
+
+    params[0] = plg_cryptoctx->dh_1024;
+    params[1] = plg_cryptoctx->dh_2048;
+    params[2] = plg_cryptoctx->dh_4096;
+    for (i = 0; i < DH_POOL_NGROUPS; i++) {
+        pool->groups[i].params = params[i];
+        pool->groups[i].bits = bits[i];
+        pool->groups[i].keys = calloc(size, sizeof(*pool->groups[i].keys));
+        pool->groups[i].uses = calloc(size, sizeof(*pool->groups[i].uses));
+        if (pool->groups[i].keys == NULL || pool->groups[i].uses == NULL) {
+            dh_pool_free(pool);
+            return ENOMEM;
+        }
+    }
+
+    plg_cryptoctx->dh_pool = pool;
+    return 0;
+}
+
+void
+pkinit_fini_dh_key_pool(krb5_context context,
+                        pkinit_plg_crypto_context plg_cryptoctx)
+{
+    struct dh_key_pool *pool = plg_cryptoctx->dh_pool;
+    struct dh_pool_group *group;
+    int i;
+
+    if (pool == NULL)
+        return;
+    for (i = 0; i < DH_POOL_NGROUPS; i++) {
+        group = &pool->groups[i];
+        if (group->hits == 0 && group->misses == 0)
+            continue;
+        TRACE_PKINIT_SERVER_DH_POOL_STATS(context, group->bits, group->hits,
+                                          group->misses, group->generated);
+    }
+    dh_pool_free(pool);
+    plg_cryptoctx->dh_pool = NULL;
+}
+
+#else /* !(ENABLE_THREADS && HAVE_PTHREAD) */
+
+static DH *
+dh_pool_take(struct dh_key_pool *pool, DH *params, int *bits_out,
+             int *uses_out)
+{
+    *bits_out = *uses_out = 0;
+    return NULL;
+}
+
+static void
+dh_pool_free(struct dh_key_pool *pool)
+{
+}
+
+krb5_error_code
+pkinit_init_dh_key_pool(krb5_context context,
+                        pkinit_plg_crypto_context plg_cryptoctx,
+                        int size, int max_uses)
+{
+    return 0;
+}
+
+void
+pkinit_fini_dh_key_pool(krb5_context context,
+                        pkinit_plg_crypto_context plg_cryptoctx)
+{
+}
+
+#endif /* !(ENABLE_THREADS && HAVE_PTHREAD) */
+
 /* kdc's dh function */
 krb5_error_code
 server_process_dh(krb5_context context,
@@ -2795,16 +3067,11 @@ server_process_dh(krb5_context context,
     const BIGNUM *server_pubkey;
     unsigned char *dh_pubkey = NULL, *server_key = NULL;
     unsigned int dh_pubkey_len = 0, server_key_len = 0;
+    int pool_bits, pool_uses;
 
     *dh_pubkey_out = *server_key_out = NULL;
     *dh_pubkey_len_out = *server_key_len_out = 0;
 
-    /* get client's received DH parameters that we saved in server_check_dh */
-    dh = cryptoctx->dh;
-    dh_server = dup_dh_params(dh);
-    if (dh_server == NULL)
-        goto cleanup;
-
     /* decode client's public key */
     p = data;
     pub_key = d2i_ASN1_INTEGER(NULL, (const unsigned char **)&p, (int)data_len);
@@ -2815,8 +3082,23 @@ server_process_dh(krb5_context context,
         goto cleanup;
     ASN1_INTEGER_free(pub_key);
 
-    if (!DH_generate_key(dh_server))
-        goto cleanup;
+    /* get client's received DH parameters that we saved in server_check_dh */
+    dh = cryptoctx->dh;
+    if (plg_cryptoctx->dh_pool != NULL) {
+        dh_server = dh_pool_take(plg_cryptoctx->dh_pool, dh, &pool_bits,
+                                 &pool_uses);
+        if (dh_server != NULL)
+            TRACE_PKINIT_SERVER_DH_POOL_HIT(context, pool_bits, pool_uses);
+        else if (pool_bits != 0)
+            TRACE_PKINIT_SERVER_DH_POOL_MISS(context, pool_bits);
+    }
+    if (dh_server == NULL) {
+        dh_server = dup_dh_params(dh);
+        if (dh_server == NULL)
+            goto cleanup;
+        if (!DH_generate_key(dh_server))
+            goto cleanup;
+    }
     DH_get0_key(dh_server, &server_pubkey, NULL);
 
     /* generate DH session key */
@@ -95,10 +95,13 @@ struct _pkinit_identity_crypto_context {
     pkinit_deferred_id *deferred_ids;
 };
 
+struct dh_key_pool;
+
 struct _pkinit_plg_crypto_context {
     DH *dh_1024;
     DH *dh_2048;
     DH *dh_4096;
+    struct dh_key_pool *dh_pool;    /* pre-generated server keys, or NULL */
     ASN1_OBJECT *id_pkinit_authData;
     ASN1_OBJECT *id_pkinit_DHKeyData;
     ASN1_OBJECT *id_pkinit_rkeyData;
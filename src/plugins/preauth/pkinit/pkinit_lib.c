@@ -86,6 +86,8 @@ pkinit_init_plg_opts(pkinit_plg_opts **plgopts)
     opts->disable_freshness = 0;
 
     opts->dh_min_bits = PKINIT_DEFAULT_DH_MIN_BITS;
+    opts->dh_key_pool_size = 0;
+    opts->dh_key_max_uses = 1;
 
     *plgopts = opts;
 
@@ -1131,6 +1131,13 @@ pkinit_init_kdc_profile(krb5_context context, pkinit_kdc_context plgctx)
         plgctx->opts->dh_min_bits = PKINIT_DEFAULT_DH_MIN_BITS;
     }
 
+    pkinit_kdcdefault_integer(context, plgctx->realmname,
+                              KRB5_CONF_PKINIT_DH_KEY_POOL_SIZE, 0,
+                              &plgctx->opts->dh_key_pool_size);
+    pkinit_kdcdefault_integer(context, plgctx->realmname,
+                              KRB5_CONF_PKINIT_DH_KEY_MAX_USES, 1,
+                              &plgctx->opts->dh_key_max_uses);
+
     pkinit_kdcdefault_boolean(context, plgctx->realmname,
                               KRB5_CONF_PKINIT_ALLOW_UPN,
                               0, &plgctx->opts->allow_upn);
@@ -1246,6 +1253,12 @@ pkinit_server_plugin_init_realm(krb5_context context, const char *realmname,
     if (retval)
         goto errout;
 
+    retval = pkinit_init_dh_key_pool(context, plgctx->cryptoctx,
+                                     plgctx->opts->dh_key_pool_size,
+                                     plgctx->opts->dh_key_max_uses);
+    if (retval)
+        goto errout;
+
     retval = pkinit_identity_initialize(context, plgctx->cryptoctx, NULL,
                                         plgctx->idopts, plgctx->idctx,
                                         NULL, NULL, NULL);
@@ -1550,6 +1563,8 @@ pkinit_server_plugin_fini_realm(krb5_context context, pkinit_kdc_context plgctx)
     pkinit_fini_kdc_profile(context, plgctx);
     pkinit_fini_identity_opts(plgctx->idopts);
     pkinit_fini_identity_crypto(plgctx->idctx);
+    if (plgctx->cryptoctx != NULL)
+        pkinit_fini_dh_key_pool(context, plgctx->cryptoctx);
     pkinit_fini_plg_crypto(plgctx->cryptoctx);
     pkinit_fini_plg_opts(plgctx->opts);
     for (sp = plgctx->auth_indicators; sp != NULL && *sp != NULL; sp++)
@@ -96,6 +96,15 @@
 #define TRACE_PKINIT_SERVER_CERT_AUTH(c, modname)                       \
     TRACE(c, "PKINIT server authorizing cert with module {str}",        \
           modname)
+#define TRACE_PKINIT_SERVER_DH_POOL_HIT(c, bits, uses)                  \
+    TRACE(c, "PKINIT server using pooled {int}-bit DH key ({int} uses " \
+          "remaining)", bits, uses)
+#define TRACE_PKINIT_SERVER_DH_POOL_MISS(c, bits)                       \
+    TRACE(c, "PKINIT server DH key pool empty for {int}-bit group, "    \
+          "generating key", bits)
+#define TRACE_PKINIT_SERVER_DH_POOL_STATS(c, bits, hits, misses, gen)   \
+    TRACE(c, "PKINIT server {int}-bit DH key pool: {long} hits, {long} " \
+          "misses, {long} keys generated", bits, hits, misses, gen)
 #define TRACE_PKINIT_SERVER_EKU_REJECT(c)                               \
     TRACE(c, "PKINIT server found no acceptable EKU in client cert")
 #define TRACE_PKINIT_SERVER_EKU_SKIP(c)                                 \
@@ -98,6 +98,12 @@
  *   removed, taking care to check for unused functions in both the 64-bit and
  *   32-bit preprocessor branches.  ge_p3_dbl() is unused here if CONFIG_SMALL
  *   is defined, so it is placed inside #ifndef CONFIG_SMALL.
+ *
+ * - table_select() takes the table row as a parameter, and the body of
+ *   x25519_ge_scalarmult_base() is moved into x25519_ge_scalarmult_precomp()
+ *   so that it can also be used with the M and N tables computed at runtime.
+ *   x25519_ge_scalarmult_small_precomp() and the M and N small precomputation
+ *   tables are only used if CONFIG_SMALL is defined.
  */
 
 // Some of this code is taken from the ref10 version of Ed25519 in SUPERCOP
@@ -821,6 +827,8 @@ static void cmov(ge_precomp *t, const ge_precomp *u, uint8_t b) {
   fe_cmov(&t->xy2d, &u->xy2d, b);
 }
 
+#if defined(CONFIG_SMALL)
+
 static void x25519_ge_scalarmult_small_precomp(
     ge_p3 *h, const uint8_t a[32], const uint8_t precomp_table[15 * 2 * 32]) {
   // precomp_table is first expanded into matching |ge_precomp|
@@ -875,8 +883,6 @@ static void x25519_ge_scalarmult_small_precomp(
   }
 }
 
-#if defined(CONFIG_SMALL)
-
 static void x25519_ge_scalarmult_base(ge_p3 *h, const uint8_t a[32]) {
   x25519_ge_scalarmult_small_precomp(h, a, k25519SmallPrecomp);
 }
@@ -889,20 +895,21 @@ static uint8_t negative(signed char b) {
   return x;
 }
 
-static void table_select(ge_precomp *t, int pos, signed char b) {
+static void table_select(ge_precomp *t, const ge_precomp row[8],
+                         signed char b) {
   ge_precomp minust;
   uint8_t bnegative = negative(b);
   uint8_t babs = b - ((uint8_t)((-bnegative) & b) << 1);
 
   ge_precomp_0(t);
-  cmov(t, &k25519Precomp[pos][0], equal(babs, 1));
-  cmov(t, &k25519Precomp[pos][1], equal(babs, 2));
-  cmov(t, &k25519Precomp[pos][2], equal(babs, 3));
-  cmov(t, &k25519Precomp[pos][3], equal(babs, 4));
-  cmov(t, &k25519Precomp[pos][4], equal(babs, 5));
-  cmov(t, &k25519Precomp[pos][5], equal(babs, 6));
-  cmov(t, &k25519Precomp[pos][6], equal(babs, 7));
-  cmov(t, &k25519Precomp[pos][7], equal(babs, 8));
+  cmov(t, &row[0], equal(babs, 1));
+  cmov(t, &row[1], equal(babs, 2));
+  cmov(t, &row[2], equal(babs, 3));
+  cmov(t, &row[3], equal(babs, 4));
+  cmov(t, &row[4], equal(babs, 5));
+  cmov(t, &row[5], equal(babs, 6));
+  cmov(t, &row[6], equal(babs, 7));
+  cmov(t, &row[7], equal(babs, 8));
   fe_copy_ll(&minust.yplusx, &t->yminusx);
   fe_copy_ll(&minust.yminusx, &t->yplusx);
 
@@ -914,13 +921,14 @@ static void table_select(ge_precomp *t, int pos, signed char b) {
   cmov(t, &minust, bnegative);
 }
 
-// h = a * B
+// h = a * P
 // where a = a[0]+256*a[1]+...+256^31 a[31]
-// B is the Ed25519 base point (x,4/5) with x positive.
+// table[i][j] = (j+1) * 256^i * P.
 //
 // Preconditions:
 //   a[31] <= 127
-static void x25519_ge_scalarmult_base(ge_p3 *h, const uint8_t *a) {
+static void x25519_ge_scalarmult_precomp(ge_p3 *h, const uint8_t *a,
+                                         const ge_precomp table[32][8]) {
   signed char e[64];
   signed char carry;
   ge_p1p1 r;
@@ -947,7 +955,7 @@ static void x25519_ge_scalarmult_base(ge_p3 *h, const uint8_t *a) {
 
   ge_p3_0(h);
   for (i = 1; i < 64; i += 2) {
-    table_select(&t, i / 2, e[i]);
+    table_select(&t, table[i / 2], e[i]);
     ge_madd(&r, h, &t);
     x25519_ge_p1p1_to_p3(h, &r);
   }
@@ -962,12 +970,22 @@ static void x25519_ge_scalarmult_base(ge_p3 *h, const uint8_t *a) {
   x25519_ge_p1p1_to_p3(h, &r);
 
   for (i = 0; i < 64; i += 2) {
-    table_select(&t, i / 2, e[i]);
+    table_select(&t, table[i / 2], e[i]);
     ge_madd(&r, h, &t);
     x25519_ge_p1p1_to_p3(h, &r);
   }
 }
 
+// h = a * B
+// where a = a[0]+256*a[1]+...+256^31 a[31]
+// B is the Ed25519 base point (x,4/5) with x positive.
+//
+// Preconditions:
+//   a[31] <= 127
+static void x25519_ge_scalarmult_base(ge_p3 *h, const uint8_t *a) {
+  x25519_ge_scalarmult_precomp(h, a, k25519Precomp);
+}
+
 #endif
 
 static void cmov_cached(ge_cached *t, ge_cached *u, uint8_t b) {
@@ -1389,6 +1407,8 @@ static void x25519_sc_reduce(uint8_t s[64]) {
  * code is modified to add the subgroup restriction.
  */
 
+#if defined(CONFIG_SMALL)
+
 // The following precomputation tables are for the following
 // points:
 //
@@ -1630,6 +1650,141 @@ static const uint8_t kSpakeMSmallPrecomp[15 * 2 * 32] = {
     0x57, 0x32, 0x14, 0xe6, 0x9e, 0xbf, 0xd1, 0xfb, 0xdf, 0xad, 0x7a, 0x52,
 };
 
+#else
+
+/*
+ * Rather than the small tables used above, build full window tables for M and
+ * N in the layout of k25519Precomp when the group state is initialized, so
+ * that w*M and w*N cost 64 mixed additions instead of 64 additions and 64
+ * doublings.  The group state lives as long as the preauth module, so on the
+ * KDC the tables are built once and shared by every SPAKE request.
+ */
+struct groupdata_st {
+  ge_precomp M[32][8];
+  ge_precomp N[32][8];
+};
+
+/* Set table[i][j] to (j+1) * 256^i * P, where P is decoded from |s|.  P is
+ * public, so variable-time operations are used throughout.  The 256 points
+ * are computed in extended coordinates and then converted to affine
+ * coordinates using a single batched field inversion. */
+static krb5_error_code
+precomp_table_init(ge_precomp table[32][8], const uint8_t s[32])
+{
+  ge_p3 *pts = NULL, base;
+  ge_precomp *out;
+  fe *prods = NULL, inv, zinv, x, y;
+  ge_cached base_cached;
+  ge_p1p1 r;
+  ge_p2 p2;
+  krb5_error_code ret;
+  unsigned i, j, k;
+
+  if (!x25519_ge_frombytes_vartime(&base, s))
+    return EINVAL;
+
+  ret = ENOMEM;
+  pts = calloc(32 * 8, sizeof(*pts));
+  prods = calloc(32 * 8, sizeof(*prods));
+  if (pts == NULL || prods == NULL)
+    goto cleanup;
+
+  for (i = 0; i < 32; i++) {
+    /* Compute the row multiples of base = 256^i * P. */
+    x25519_ge_p3_to_cached(&base_cached, &base);
+    pts[i * 8] = base;
+    for (j = 1; j < 8; j++) {
+      x25519_ge_add(&r, &pts[i * 8 + j - 1], &base_cached);
+      x25519_ge_p1p1_to_p3(&pts[i * 8 + j], &r);
+    }
+
+    /* The last entry is 8 * base; double it five more times to get the base
+     * for the next row. */
+    ge_p3_dbl(&r, &pts[i * 8 + 7]);
+    for (j = 0; j < 4; j++) {
+      x25519_ge_p1p1_to_p2(&p2, &r);
+      ge_p2_dbl(&r, &p2);
+    }
+    x25519_ge_p1p1_to_p3(&base, &r);
+  }
+
+  /* Invert all of the Z coordinates at once. */
+  prods[0] = pts[0].Z;
+  for (k = 1; k < 32 * 8; k++)
+    fe_mul_ttt(&prods[k], &prods[k - 1], &pts[k].Z);
+  fe_invert(&inv, &prods[32 * 8 - 1]);
+
+  for (k = 32 * 8; k-- > 0;) {
+    if (k > 0) {
+      fe_mul_ttt(&zinv, &inv, &prods[k - 1]);
+      fe_mul_ttt(&inv, &inv, &pts[k].Z);
+    } else {
+      zinv = inv;
+    }
+
+    /* Convert to the (y+x, y-x, 2dxy) form used by ge_madd(). */
+    out = &table[k / 8][k % 8];
+    fe_mul_ttt(&x, &pts[k].X, &zinv);
+    fe_mul_ttt(&y, &pts[k].Y, &zinv);
+    fe_add(&out->yplusx, &y, &x);
+    fe_sub(&out->yminusx, &y, &x);
+    fe_mul_ltt(&out->xy2d, &x, &y);
+    fe_mul_llt(&out->xy2d, &out->xy2d, &d2);
+  }
+  ret = 0;
+
+cleanup:
+  free(pts);
+  free(prods);
+  return ret;
+}
+
+static krb5_error_code
+builtin_edwards25519_init(krb5_context context, const groupdef *gdef,
+                          groupdata **gdata_out)
+{
+  groupdata *gd;
+  krb5_error_code ret;
+
+  *gdata_out = NULL;
+
+  gd = malloc(sizeof(*gd));
+  if (gd == NULL)
+    return ENOMEM;
+  ret = precomp_table_init(gd->M, gdef->reg->m);
+  if (!ret)
+    ret = precomp_table_init(gd->N, gdef->reg->n);
+  if (ret) {
+    free(gd);
+    return ret;
+  }
+
+  *gdata_out = gd;
+  return 0;
+}
+
+static void
+builtin_edwards25519_fini(groupdata *gdata)
+{
+  free(gdata);
+}
+
+#endif /* CONFIG_SMALL */
+
+/* Set |h| to w*M if |use_m| is true, or to w*N if it is false.  |w| must be
+ * reduced mod p. */
+static void
+spake_mask(ge_p3 *h, const groupdata *gdata, const uint8_t *w,
+           krb5_boolean use_m)
+{
+#if defined(CONFIG_SMALL)
+  x25519_ge_scalarmult_small_precomp(h, w, use_m ? kSpakeMSmallPrecomp :
+                                     kSpakeNSmallPrecomp);
+#else
+  x25519_ge_scalarmult_precomp(h, w, use_m ? gdata->M : gdata->N);
+#endif
+}
+
 /* left_shift_3 sets |n| to |n|*8, where |n| is represented in little-endian
  * order. */
 static void left_shift_3(uint8_t n[32]) {
@@ -1672,9 +1827,7 @@ builtin_edwards25519_keygen(krb5_context context, groupdata *gdata,
 
   /* Compute the mask, w*M or w*N. */
   ge_p3 mask;
-  x25519_ge_scalarmult_small_precomp(&mask, wreduced,
-                                     use_m ? kSpakeMSmallPrecomp :
-                                     kSpakeNSmallPrecomp);
+  spake_mask(&mask, gdata, wreduced, use_m);
 
   /* Compute the masked point T=w*M+X or S=w*N+Y. */
   ge_cached mask_cached;
@@ -1716,9 +1869,7 @@ builtin_edwards25519_result(krb5_context context, groupdata *gdata,
 
   /* Compute the peer's mask, w*M or w*N. */
   ge_p3 peers_mask;
-  x25519_ge_scalarmult_small_precomp(&peers_mask, wreduced,
-                                     use_m ? kSpakeMSmallPrecomp :
-                                     kSpakeNSmallPrecomp);
+  spake_mask(&peers_mask, gdata, wreduced, use_m);
 
   ge_cached peers_mask_cached;
   x25519_ge_p3_to_cached(&peers_mask_cached, &peers_mask);
@@ -1747,6 +1898,10 @@ builtin_sha256(krb5_context context, groupdata *gdata, const krb5_data *dlist,
 
 groupdef builtin_edwards25519 = {
   .reg = &spake_iana_edwards25519,
+#if !defined(CONFIG_SMALL)
+  .init = builtin_edwards25519_init,
+  .fini = builtin_edwards25519_fini,
+#endif
   .keygen = builtin_edwards25519_keygen,
   .result = builtin_edwards25519_result,
   .hash = builtin_sha256
@@ -293,6 +293,22 @@ cleanup:
     }
 }
 
+/* The METHOD-DATA entry depends only on the client key unless an optimistic
+ * challenge is configured, in which case a new one is made for each request. */
+static int
+spake_flags(krb5_context context, krb5_preauthtype pa_type)
+{
+    char *str = NULL;
+    int flags = PA_CACHEABLE_HINT;
+
+    if (profile_get_string(context->profile, KRB5_CONF_KDCDEFAULTS,
+                           KRB5_CONF_SPAKE_PREAUTH_KDC_CHALLENGE, NULL, NULL,
+                           &str) != 0 || str != NULL)
+        flags = 0;
+    profile_release_string(str);
+    return flags;
+}
+
 /* Generate the METHOD-DATA entry indicating support for SPAKE.  Include an
  * optimistic challenge if configured to do so. */
 static void
@@ -576,6 +592,7 @@ kdcpreauth_spake_initvt(krb5_context context, int maj_ver, int min_ver,
     vt->pa_type_list = pa_types;
     vt->init = spake_init;
     vt->fini = spake_fini;
+    vt->flags = spake_flags;
     vt->edata = spake_edata;
     vt->verify = spake_verify;
     vt->return_padata = spake_return;
@@ -0,0 +1,143 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* plugins/preauth/spake/t_perf.c - SPAKE group operation benchmark */
+/*
+ * Copyright (C) 2021 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program runs the group operations of a SPAKE AS exchange (KDC keygen,
+ * client keygen and result, KDC result) for each supported group, checking
+ * that both sides compute the same result.  With no arguments it runs a few
+ * exchanges per group as a self-test.  Given an iteration count (and
+ * optionally a group name), it reports the exchanges per second:
+ *
+ *     ./t_perf 1000
+ *     ./t_perf 1000 P-256
+ */
+
+#include "k5-int.h"
+#include "groups.h"
+#include "iana.h"
+
+static krb5_context ctx;
+
+static void
+check(krb5_error_code code)
+{
+    const char *errmsg;
+
+    if (code) {
+        errmsg = krb5_get_error_message(ctx, code);
+        fprintf(stderr, "%s\n", errmsg);
+        abort();
+    }
+}
+
+/* Perform the group operations of one SPAKE exchange using group. */
+static void
+exchange(groupstate *kdc, groupstate *client, int32_t group,
+         const krb5_data *wbytes)
+{
+    krb5_data x, T, y, S, kdc_K, client_K;
+
+    check(group_keygen(ctx, kdc, group, wbytes, &x, &T));
+    check(group_keygen(ctx, client, group, wbytes, &y, &S));
+    check(group_result(ctx, client, group, wbytes, &y, &T, &client_K));
+    check(group_result(ctx, kdc, group, wbytes, &x, &S, &kdc_K));
+    assert(data_eq(kdc_K, client_K));
+
+    krb5_free_data_contents(ctx, &x);
+    krb5_free_data_contents(ctx, &T);
+    krb5_free_data_contents(ctx, &y);
+    krb5_free_data_contents(ctx, &S);
+    krb5_free_data_contents(ctx, &kdc_K);
+    krb5_free_data_contents(ctx, &client_K);
+}
+
+static void
+run_group(groupstate *kdc, groupstate *client, const spake_iana *reg,
+          long iterations)
+{
+    struct timespec start, end;
+    krb5_data wbytes;
+    double secs;
+    size_t len;
+    long i;
+
+    check(group_mult_len(reg->id, &len));
+    check(alloc_data(&wbytes, len));
+
+    /* Run a few exchanges with different w values.  This also initializes
+     * any per-group state before timing starts. */
+    for (i = 0; i < 4; i++) {
+        check(krb5_c_random_make_octets(ctx, &wbytes));
+        exchange(kdc, client, reg->id, &wbytes);
+    }
+
+    if (iterations > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < iterations; i++)
+            exchange(kdc, client, reg->id, &wbytes);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        secs = (end.tv_sec - start.tv_sec) +
+            (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("%-12s %ld exchanges in %.3f s: %.0f exchanges/s\n",
+               reg->name, iterations, secs, iterations / secs);
+    }
+    krb5_free_data_contents(ctx, &wbytes);
+}
+
+int
+main(int argc, char **argv)
+{
+    groupstate *kdc, *client;
+    const spake_iana *regs[] = {
+        &spake_iana_edwards25519,
+#ifdef SPAKE_OPENSSL
+        &spake_iana_p256, &spake_iana_p384, &spake_iana_p521,
+#endif
+    };
+    long iterations = (argc > 1) ? atol(argv[1]) : 0;
+    const char *name = (argc > 2) ? argv[2] : NULL;
+    size_t i;
+
+    check(krb5_init_context(&ctx));
+    check(group_init_state(ctx, TRUE, &kdc));
+    check(group_init_state(ctx, FALSE, &client));
+
+    for (i = 0; i < sizeof(regs) / sizeof(*regs); i++) {
+        if (name == NULL || strcasecmp(name, regs[i]->name) == 0)
+            run_group(kdc, client, regs[i], iterations);
+    }
+
+    group_free_state(kdc);
+    group_free_state(client);
+    krb5_free_context(ctx);
+    return 0;
+}
@@ -57,6 +57,24 @@ free_cred_enc_part_whole(krb5_context ctx,
     free(val);
 }
 
+/*
+ * Free an arena-decoded KDC request after filling in the parts the KDC
+ * allocates on the heap: unenc_authdata and the decrypted part of each second
+ * ticket (as for user-to-user and S4U2Proxy requests).
+ */
+static void
+free_arena_kdc_req_decrypted(krb5_context ctx, krb5_kdc_req *val)
+{
+    krb5_ticket **tkt;
+
+    ktest_make_sample_authorization_data(&val->unenc_authdata);
+    for (tkt = val->second_ticket; tkt != NULL && *tkt != NULL; tkt++) {
+        (*tkt)->enc_part2 = ealloc(sizeof(*(*tkt)->enc_part2));
+        ktest_make_sample_enc_tkt_part((*tkt)->enc_part2);
+    }
+    krb5_free_kdc_req(ctx, val);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -326,6 +344,8 @@ main(int argc, char **argv)
         ktest_destroy_enc_data(&(tgsreq.authorization_data));
         leak_test(tgsreq, encode_krb5_tgs_req, decode_krb5_tgs_req,
                   krb5_free_kdc_req);
+        leak_test(tgsreq, encode_krb5_tgs_req, decode_krb5_tgs_req_arena,
+                  free_arena_kdc_req_decrypted);
 
         ktest_destroy_sequence_of_ticket(&(tgsreq.second_ticket));
 #ifndef ISODE_SUCKS
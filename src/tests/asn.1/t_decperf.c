@@ -0,0 +1,221 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/asn.1/t_decperf.c - ASN.1 KDC request decoding benchmark */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program encodes an AS-REQ and a TGS-REQ shaped like those sent by
+ * current MIT clients, then measures the rate at which each can be decoded
+ * and freed using the heap decoders and the arena decoders used by the KDC.
+ * Usage:
+ *
+ *     ./t_decperf count
+ */
+
+#include "k5-int.h"
+#include <sys/time.h>
+
+static krb5_enctype etypes[] = {
+    ENCTYPE_AES256_CTS_HMAC_SHA1_96, ENCTYPE_AES128_CTS_HMAC_SHA1_96,
+    ENCTYPE_AES256_CTS_HMAC_SHA384_192, ENCTYPE_AES128_CTS_HMAC_SHA256_128,
+    ENCTYPE_DES3_CBC_SHA1, ENCTYPE_ARCFOUR_HMAC,
+    ENCTYPE_CAMELLIA128_CTS_CMAC, ENCTYPE_CAMELLIA256_CTS_CMAC
+};
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+/* Set *d to len bytes of filler data. */
+static void
+fill_data(krb5_data *d, unsigned int len)
+{
+    d->magic = KV5M_DATA;
+    d->length = len;
+    d->data = malloc(len);
+    assert(d->data != NULL);
+    memset(d->data, 'x', len);
+}
+
+static void
+fill_enc_data(krb5_enc_data *enc, krb5_kvno kvno, unsigned int len)
+{
+    enc->magic = KV5M_ENC_DATA;
+    enc->enctype = ENCTYPE_AES256_CTS_HMAC_SHA1_96;
+    enc->kvno = kvno;
+    fill_data(&enc->ciphertext, len);
+}
+
+static krb5_pa_data *
+make_padata(krb5_preauthtype type, unsigned int len)
+{
+    krb5_pa_data *pa;
+
+    pa = calloc(1, sizeof(*pa));
+    assert(pa != NULL);
+    pa->magic = KV5M_PA_DATA;
+    pa->pa_type = type;
+    pa->length = len;
+    if (len > 0) {
+        pa->contents = malloc(len);
+        assert(pa->contents != NULL);
+        memset(pa->contents, 'p', len);
+    }
+    return pa;
+}
+
+/* Fill in the request fields common to AS and TGS requests. */
+static void
+init_req(krb5_context ctx, krb5_kdc_req *req, const char *client,
+         const char *server)
+{
+    memset(req, 0, sizeof(*req));
+    req->magic = KV5M_KDC_REQ;
+    req->kdc_options = KDC_OPT_FORWARDABLE | KDC_OPT_CANONICALIZE;
+    if (client != NULL)
+        assert(krb5_parse_name(ctx, client, &req->client) == 0);
+    assert(krb5_parse_name(ctx, server, &req->server) == 0);
+    req->till = 1700000000;
+    req->nonce = 0x12345678;
+    req->ktype = etypes;
+    req->nktypes = sizeof(etypes) / sizeof(*etypes);
+}
+
+static void
+encode_as_req(krb5_context ctx, krb5_data **code_out)
+{
+    krb5_kdc_req req;
+    init_req(ctx, &req, "user@KRBTEST.COM", "krbtgt/KRBTEST.COM@KRBTEST.COM");
+    req.msg_type = KRB5_AS_REQ;
+    req.padata = calloc(3, sizeof(*req.padata));
+    assert(req.padata != NULL);
+    req.padata[0] = make_padata(KRB5_PADATA_ENC_TIMESTAMP, 72);
+    req.padata[1] = make_padata(KRB5_ENCPADATA_REQ_ENC_PA_REP, 0);
+    assert(encode_krb5_as_req(&req, code_out) == 0);
+    krb5_free_pa_data(ctx, req.padata);
+    krb5_free_principal(ctx, req.client);
+    krb5_free_principal(ctx, req.server);
+}
+
+static void
+encode_tgs_req(krb5_context ctx, krb5_data **code_out)
+{
+    krb5_kdc_req req;
+    krb5_ap_req apreq;
+    krb5_ticket ticket;
+    krb5_data *apcode;
+
+    memset(&ticket, 0, sizeof(ticket));
+    ticket.magic = KV5M_TICKET;
+    assert(krb5_parse_name(ctx, "krbtgt/KRBTEST.COM@KRBTEST.COM",
+                           &ticket.server) == 0);
+    fill_enc_data(&ticket.enc_part, 2, 1024);
+
+    memset(&apreq, 0, sizeof(apreq));
+    apreq.magic = KV5M_AP_REQ;
+    apreq.ticket = &ticket;
+    fill_enc_data(&apreq.authenticator, 0, 190);
+    assert(encode_krb5_ap_req(&apreq, &apcode) == 0);
+
+    init_req(ctx, &req, NULL, "host/server.krbtest.com@KRBTEST.COM");
+    req.msg_type = KRB5_TGS_REQ;
+    req.padata = calloc(3, sizeof(*req.padata));
+    assert(req.padata != NULL);
+    req.padata[0] = make_padata(KRB5_PADATA_AP_REQ, 0);
+    req.padata[0]->length = apcode->length;
+    req.padata[0]->contents = (uint8_t *)apcode->data;
+    req.padata[1] = make_padata(KRB5_PADATA_PAC_OPTIONS, 9);
+    assert(encode_krb5_tgs_req(&req, code_out) == 0);
+
+    free(apcode);
+    krb5_free_pa_data(ctx, req.padata);
+    krb5_free_principal(ctx, req.server);
+    krb5_free_principal(ctx, ticket.server);
+    krb5_free_data_contents(ctx, &ticket.enc_part.ciphertext);
+    krb5_free_data_contents(ctx, &apreq.authenticator.ciphertext);
+}
+
+static void
+time_decode(krb5_context ctx, const char *desc, krb5_data *code,
+            krb5_error_code (*decode)(const krb5_data *, krb5_kdc_req **),
+            int count)
+{
+    krb5_kdc_req *req;
+    struct timeval start;
+    double secs;
+    int i;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < count; i++) {
+        assert(decode(code, &req) == 0);
+        krb5_free_kdc_req(ctx, req);
+    }
+    secs = elapsed(&start);
+    if (secs <= 0)
+        secs = 1e-6;
+    printf("%d %s decodes in %.3f s (%.0f/s)\n", count, desc, secs,
+           count / secs);
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    krb5_data *as_code, *tgs_code;
+    int count;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: t_decperf count\n");
+        exit(1);
+    }
+    count = atoi(argv[1]);
+
+    assert(krb5_init_context(&ctx) == 0);
+    encode_as_req(ctx, &as_code);
+    encode_tgs_req(ctx, &tgs_code);
+
+    time_decode(ctx, "AS-REQ heap", as_code, decode_krb5_as_req, count);
+    time_decode(ctx, "AS-REQ arena", as_code, decode_krb5_as_req_arena,
+                count);
+    time_decode(ctx, "TGS-REQ heap", tgs_code, decode_krb5_tgs_req, count);
+    time_decode(ctx, "TGS-REQ arena", tgs_code, decode_krb5_tgs_req_arena,
+                count);
+
+    krb5_free_data(ctx, as_code);
+    krb5_free_data(ctx, tgs_code);
+    krb5_free_context(ctx);
+    return 0;
+}
@@ -0,0 +1,200 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/gssapi/t_iovperf.c - Measure in-place IOV wrap and unwrap throughput */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program measures the throughput of gss_wrap_iov() and
+ * gss_unwrap_iov() on caller-supplied buffers, as used by applications which
+ * protect many messages in place.  Usage:
+ *
+ *     ./t_iovperf [-s] targetname [count [size]]
+ *
+ * count messages of size bytes each are wrapped with confidentiality using
+ * the initiator context, then unwrapped by the acceptor context, first with a
+ * HEADER | DATA | PADDING | TRAILER iov array and then as a single STREAM
+ * buffer.  The default is 10000 messages of 1024 bytes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "common.h"
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+/* Lay out iov over buf as HEADER | DATA | PADDING | TRAILER using the lengths
+ * in lens, and fill the data buffer with a known pattern. */
+static void
+setup_iov(gss_iov_buffer_desc *iov, char *buf, const size_t *lens)
+{
+    static const OM_uint32 types[4] = {
+        GSS_IOV_BUFFER_TYPE_HEADER, GSS_IOV_BUFFER_TYPE_DATA,
+        GSS_IOV_BUFFER_TYPE_PADDING, GSS_IOV_BUFFER_TYPE_TRAILER
+    };
+    size_t i, j;
+
+    for (i = 0; i < 4; i++) {
+        iov[i].type = types[i];
+        iov[i].buffer.value = buf;
+        iov[i].buffer.length = lens[i];
+        buf += lens[i];
+    }
+    for (j = 0; j < lens[1]; j++)
+        ((char *)iov[1].buffer.value)[j] = (char)j;
+}
+
+static void
+check_data(const char *msg, gss_buffer_t data, size_t size)
+{
+    size_t i;
+
+    if (data->length != size)
+        errout(msg);
+    for (i = 0; i < size; i++) {
+        if (((unsigned char *)data->value)[i] != (unsigned char)i)
+            errout(msg);
+    }
+}
+
+static void
+report(const char *tag, int count, size_t size, double secs)
+{
+    if (secs <= 0)
+        secs = 1e-6;
+    printf("%-14s %10.0f msg/s %10.2f MB/s\n", tag, count / secs,
+           count * (double)size / secs / 1000000.0);
+}
+
+int
+main(int argc, char *argv[])
+{
+    OM_uint32 minor, major, flags;
+    gss_OID mech = &mech_krb5;
+    gss_name_t tname;
+    gss_ctx_id_t ictx, actx;
+    gss_iov_buffer_desc iov[4], stiov[2];
+    gss_qop_t qop;
+    struct timeval start;
+    double wrap_time = 0, unwrap_time = 0, stream_time = 0;
+    size_t size = 1024, lens[4], total, i;
+    int count = 10000, n, conf;
+    char *buf;
+
+    /* Parse arguments. */
+    argv++;
+    if (*argv != NULL && strcmp(*argv, "-s") == 0) {
+        mech = &mech_spnego;
+        argv++;
+    }
+    if (*argv == NULL)
+        errout("Usage: t_iovperf [-s] targetname [count [size]]");
+    tname = import_name(*argv++);
+    if (*argv != NULL)
+        count = atoi(*argv++);
+    if (*argv != NULL)
+        size = atoi(*argv++);
+
+    flags = GSS_C_REPLAY_FLAG | GSS_C_SEQUENCE_FLAG | GSS_C_MUTUAL_FLAG |
+        GSS_C_CONF_FLAG;
+    establish_contexts(mech, GSS_C_NO_CREDENTIAL, GSS_C_NO_CREDENTIAL, tname,
+                       flags, &ictx, &actx, NULL, NULL, NULL);
+
+    /* Find the buffer lengths for a message of the given size, and allocate
+     * one buffer to hold the whole token. */
+    memset(lens, 0, sizeof(lens));
+    setup_iov(iov, NULL, lens);
+    iov[1].buffer.length = size;
+    major = gss_wrap_iov_length(&minor, ictx, 1, GSS_C_QOP_DEFAULT, NULL, iov,
+                                4);
+    check_gsserr("gss_wrap_iov_length", major, minor);
+    total = 0;
+    for (i = 0; i < 4; i++) {
+        lens[i] = iov[i].buffer.length;
+        total += lens[i];
+    }
+    buf = malloc(total);
+    if (buf == NULL)
+        errout("malloc failed");
+
+    for (n = 0; n < count; n++) {
+        /* Wrap in place, then unwrap the iov array in place. */
+        setup_iov(iov, buf, lens);
+        gettimeofday(&start, NULL);
+        major = gss_wrap_iov(&minor, ictx, 1, GSS_C_QOP_DEFAULT, &conf, iov,
+                             4);
+        wrap_time += elapsed(&start);
+        check_gsserr("gss_wrap_iov", major, minor);
+        gettimeofday(&start, NULL);
+        major = gss_unwrap_iov(&minor, actx, &conf, &qop, iov, 4);
+        unwrap_time += elapsed(&start);
+        check_gsserr("gss_unwrap_iov", major, minor);
+        if (n == 0)
+            check_data("gss_unwrap_iov data", &iov[1].buffer, size);
+
+        /* Wrap again and unwrap the contiguous token as a stream. */
+        setup_iov(iov, buf, lens);
+        major = gss_wrap_iov(&minor, ictx, 1, GSS_C_QOP_DEFAULT, &conf, iov,
+                             4);
+        check_gsserr("gss_wrap_iov", major, minor);
+        stiov[0].type = GSS_IOV_BUFFER_TYPE_STREAM;
+        stiov[0].buffer.value = buf;
+        stiov[0].buffer.length = total;
+        stiov[1].type = GSS_IOV_BUFFER_TYPE_DATA;
+        stiov[1].buffer.value = NULL;
+        stiov[1].buffer.length = 0;
+        gettimeofday(&start, NULL);
+        major = gss_unwrap_iov(&minor, actx, &conf, &qop, stiov, 2);
+        stream_time += elapsed(&start);
+        check_gsserr("gss_unwrap_iov(stream)", major, minor);
+        if (n == 0)
+            check_data("gss_unwrap_iov(stream) data", &stiov[1].buffer, size);
+    }
+
+    printf("%d messages of %lu bytes\n", count, (unsigned long)size);
+    report("wrap_iov", count, size, wrap_time);
+    report("unwrap_iov", count, size, unwrap_time);
+    report("unwrap_stream", count, size, stream_time);
+
+    free(buf);
+    (void)gss_release_name(&minor, &tname);
+    (void)gss_delete_sec_context(&minor, &ictx, NULL);
+    (void)gss_delete_sec_context(&minor, &actx, NULL);
+    return 0;
+}
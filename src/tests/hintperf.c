@@ -0,0 +1,113 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/hintperf.c - Measure KDC latency for preauth-required replies */
+/*
+ * Copyright (C) 2021 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Usage: hintperf princ count
+ *
+ * This program is invoked from t_preauth.py.  It sends count initial AS
+ * requests without padata for princ, each with a new nonce, and checks that
+ * each reply is a PREAUTH_REQUIRED error.  It prints the mean time the KDC
+ * took to answer, which covers the client lookup and the construction of the
+ * preauth hint list.
+ */
+
+#include "k5-int.h"
+
+static void
+check(krb5_error_code ret, const char *what)
+{
+    if (ret) {
+        com_err("hintperf", ret, "while %s", what);
+        exit(1);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    krb5_principal princ;
+    krb5_init_creds_context icc;
+    krb5_data req, realm, reply = empty_data();
+    krb5_error *err;
+    unsigned int flags;
+    int i, count, primary;
+    struct timeval start, end;
+    double total = 0;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s princ count\n", argv[0]);
+        return 1;
+    }
+    count = atoi(argv[2]);
+    if (count <= 0) {
+        fprintf(stderr, "count must be positive\n");
+        return 1;
+    }
+
+    check(krb5_init_context(&ctx), "initializing context");
+    check(krb5_parse_name(ctx, argv[1], &princ), "parsing principal");
+
+    for (i = 0; i < count; i++) {
+        check(krb5_init_creds_init(ctx, princ, NULL, NULL, 0, NULL, &icc),
+              "initializing init_creds context");
+        req = realm = empty_data();
+        check(krb5_init_creds_step(ctx, icc, &reply, &req, &realm, &flags),
+              "creating request");
+
+        primary = 0;
+        gettimeofday(&start, NULL);
+        check(krb5_sendto_kdc(ctx, &req, &realm, &reply, &primary, 0),
+              "sending request");
+        gettimeofday(&end, NULL);
+        total += (end.tv_sec - start.tv_sec) * 1000000.0 +
+            (end.tv_usec - start.tv_usec);
+
+        check(krb5_rd_error(ctx, &reply, &err), "decoding reply");
+        if (err->error != KDC_ERR_PREAUTH_REQUIRED) {
+            fprintf(stderr, "hintperf: unexpected error %d\n",
+                    (int)err->error);
+            return 1;
+        }
+        krb5_free_error(ctx, err);
+        krb5_free_data_contents(ctx, &reply);
+        krb5_free_data_contents(ctx, &req);
+        krb5_free_data_contents(ctx, &realm);
+        krb5_init_creds_free(ctx, icc);
+    }
+
+    printf("%d preauth-required replies, mean %.1f us\n", count,
+           total / count);
+    krb5_free_principal(ctx, princ);
+    krb5_free_context(ctx);
+    return 0;
+}
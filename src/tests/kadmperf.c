@@ -0,0 +1,227 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/kadmperf.c - Measure kadmind throughput with concurrent clients */
+/*
+ * Copyright (C) 2021 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Usage: kadmperf adminprinc password nclients count
+ *
+ * This program is invoked from t_kadmind_workers.py.  It forks nclients
+ * processes, each of which opens its own kadmin connection as adminprinc and
+ * performs count operations: a mix of get_principal and get_policy calls with
+ * one principal modification and one password change (and so one string-to-key
+ * operation per enctype) in every ten.  The total rate of operations is
+ * printed once all clients have finished.
+ */
+
+#include <k5-int.h>
+#include <kadm5/admin.h>
+#include <sys/wait.h>
+
+#define POLICY_NAME "perfpol"
+
+static void
+check(krb5_error_code ret, const char *what)
+{
+    if (ret) {
+        com_err("kadmperf", ret, "while %s", what);
+        exit(1);
+    }
+}
+
+static void *
+open_handle(krb5_context ctx, char *princ, char *password)
+{
+    kadm5_config_params params = { 0 };
+    void *handle;
+
+    check(kadm5_init_with_password(ctx, princ, password, KADM5_ADMIN_SERVICE,
+                                   &params, KADM5_STRUCT_VERSION,
+                                   KADM5_API_VERSION_4, NULL, &handle),
+          "initializing kadmin handle");
+    return handle;
+}
+
+/* Create the policy and one principal per client, if they don't exist. */
+static void
+setup(krb5_context ctx, char *princ, char *password, int nclients)
+{
+    kadm5_policy_ent_rec pol;
+    kadm5_principal_ent_rec ent;
+    krb5_error_code ret;
+    void *handle;
+    char name[32];
+    int i;
+
+    handle = open_handle(ctx, princ, password);
+    if (kadm5_get_policy(handle, POLICY_NAME, &pol) == 0) {
+        kadm5_free_policy_ent(handle, &pol);
+    } else {
+        memset(&pol, 0, sizeof(pol));
+        pol.policy = POLICY_NAME;
+        check(kadm5_create_policy(handle, &pol, KADM5_POLICY),
+              "creating policy");
+    }
+    for (i = 0; i < nclients; i++) {
+        memset(&ent, 0, sizeof(ent));
+        snprintf(name, sizeof(name), "perf%d", i);
+        check(krb5_parse_name(ctx, name, &ent.principal), "parsing name");
+        ret = kadm5_create_principal(handle, &ent, KADM5_PRINCIPAL, name);
+        if (ret != KADM5_DUP)
+            check(ret, "creating principal");
+        krb5_free_principal(ctx, ent.principal);
+    }
+    kadm5_destroy(handle);
+}
+
+/* Wait for the go-ahead on startfd, then perform count operations. */
+static void
+run_client(krb5_context ctx, char *princ, char *password, int id, int count,
+           int readyfd, int startfd)
+{
+    kadm5_principal_ent_rec ent;
+    kadm5_policy_ent_rec pol;
+    krb5_principal target;
+    void *handle;
+    char name[32], newpw[32], c;
+    int i;
+
+    handle = open_handle(ctx, princ, password);
+    snprintf(name, sizeof(name), "perf%d", id);
+    check(krb5_parse_name(ctx, name, &target), "parsing name");
+    if (write(readyfd, "", 1) != 1 || read(startfd, &c, 1) != 0)
+        exit(1);
+
+    for (i = 0; i < count; i++) {
+        switch (i % 10) {
+        case 8:
+            memset(&ent, 0, sizeof(ent));
+            ent.principal = target;
+            ent.max_life = 3600 + i;
+            check(kadm5_modify_principal(handle, &ent, KADM5_MAX_LIFE),
+                  "modifying principal");
+            break;
+        case 9:
+            snprintf(newpw, sizeof(newpw), "pw%d.%d", id, i);
+            check(kadm5_chpass_principal(handle, target, newpw),
+                  "changing password");
+            break;
+        case 6:
+        case 7:
+            check(kadm5_get_policy(handle, POLICY_NAME, &pol),
+                  "getting policy");
+            kadm5_free_policy_ent(handle, &pol);
+            break;
+        default:
+            check(kadm5_get_principal(handle, target, &ent,
+                                      KADM5_PRINCIPAL_NORMAL_MASK),
+                  "getting principal");
+            kadm5_free_principal_ent(handle, &ent);
+        }
+    }
+
+    krb5_free_principal(ctx, target);
+    kadm5_destroy(handle);
+    exit(0);
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    char *princ, *password, c;
+    int nclients, count, i, status, ok = 1, readyfds[2], startfds[2];
+    struct timeval start, end;
+    double elapsed;
+    pid_t pid;
+
+    if (argc != 5) {
+        fprintf(stderr, "Usage: %s adminprinc password nclients count\n",
+                argv[0]);
+        return 1;
+    }
+    princ = argv[1];
+    password = argv[2];
+    nclients = atoi(argv[3]);
+    count = atoi(argv[4]);
+    if (nclients <= 0 || count <= 0) {
+        fprintf(stderr, "nclients and count must be positive\n");
+        return 1;
+    }
+
+    check(kadm5_init_krb5_context(&ctx), "initializing context");
+    setup(ctx, princ, password, nclients);
+
+    if (pipe(readyfds) != 0 || pipe(startfds) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    for (i = 0; i < nclients; i++) {
+        pid = fork();
+        if (pid == -1) {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0) {
+            close(readyfds[0]);
+            close(startfds[1]);
+            run_client(ctx, princ, password, i, count, readyfds[1],
+                       startfds[0]);
+        }
+    }
+    close(readyfds[1]);
+    close(startfds[0]);
+
+    /* Start the clock once every client has its connection open. */
+    for (i = 0; i < nclients; i++) {
+        if (read(readyfds[0], &c, 1) != 1)
+            break;
+    }
+    gettimeofday(&start, NULL);
+    close(startfds[1]);
+
+    for (i = 0; i < nclients; i++) {
+        if (wait(&status) == -1 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0)
+            ok = 0;
+    }
+    gettimeofday(&end, NULL);
+    if (!ok) {
+        fprintf(stderr, "kadmperf: a client failed\n");
+        return 1;
+    }
+
+    elapsed = (end.tv_sec - start.tv_sec) +
+        (end.tv_usec - start.tv_usec) / 1000000.0;
+    printf("%d clients: %d ops in %.3f s, %.0f ops/s\n", nclients,
+           nclients * count, elapsed, nclients * count / elapsed);
+    krb5_free_context(ctx);
+    return 0;
+}
@@ -0,0 +1,160 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/kdbperf.c - Measure KDB principal lookup cost */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Usage: kdbperf nprincs nlookups
+ *
+ * This program adds nprincs principals named perfN to the realm's database,
+ * then opens the database as the KDC does and performs nlookups lookups of
+ * them through krb5_db_get_principal(), reporting the average latency.  Each
+ * lookup takes and releases the module's database lock, as a KDC lookup
+ * does.  Midway through the lookups, perf0 is changed through a separate
+ * administrative handle, and the lookups which follow must see the change.
+ */
+
+#include "k5-int.h"
+#include <kdb.h>
+#include <sys/time.h>
+
+static void
+check(krb5_context ctx, krb5_error_code code, const char *what)
+{
+    const char *errmsg;
+
+    if (code) {
+        errmsg = krb5_get_error_message(ctx, code);
+        fprintf(stderr, "kdbperf: %s: %s\n", what, errmsg);
+        krb5_free_error_message(ctx, errmsg);
+        exit(1);
+    }
+}
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static krb5_context
+open_db(int mode)
+{
+    krb5_context ctx;
+
+    check(NULL, krb5_init_context_profile(NULL, KRB5_INIT_CONTEXT_KDC, &ctx),
+          "initializing context");
+    check(ctx, krb5_db_open(ctx, NULL, mode), "opening database");
+    return ctx;
+}
+
+/* Store an entry for perfN with the given maximum ticket life. */
+static void
+put_princ(krb5_context ctx, unsigned long n, krb5_deltat max_life)
+{
+    krb5_db_entry ent;
+    char name[64];
+
+    memset(&ent, 0, sizeof(ent));
+    ent.len = KRB5_KDB_V1_BASE_LENGTH;
+    ent.max_life = max_life;
+    snprintf(name, sizeof(name), "perf%lu", n);
+    check(ctx, krb5_parse_name(ctx, name, &ent.princ), "parsing name");
+    check(ctx, krb5_db_put_principal(ctx, &ent), "storing principal");
+    krb5_free_principal(ctx, ent.princ);
+}
+
+/* Look up perfN and return its maximum ticket life. */
+static krb5_deltat
+get_princ(krb5_context ctx, unsigned long n)
+{
+    krb5_principal princ;
+    krb5_db_entry *ent;
+    krb5_deltat max_life;
+    char name[64];
+
+    snprintf(name, sizeof(name), "perf%lu", n);
+    check(ctx, krb5_parse_name(ctx, name, &princ), "parsing name");
+    check(ctx, krb5_db_get_principal(ctx, princ, 0, &ent), name);
+    max_life = ent->max_life;
+    krb5_db_free_principal(ctx, ent);
+    krb5_free_principal(ctx, princ);
+    return max_life;
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context admin, kdc;
+    struct timeval start;
+    double t;
+    unsigned long i, n, nprincs, nlookups;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: kdbperf nprincs nlookups\n");
+        return 1;
+    }
+    nprincs = strtoul(argv[1], NULL, 10);
+    nlookups = strtoul(argv[2], NULL, 10);
+    if (nprincs == 0 || nlookups == 0) {
+        fprintf(stderr, "kdbperf: nprincs and nlookups must be positive\n");
+        return 1;
+    }
+
+    admin = open_db(KRB5_KDB_OPEN_RW | KRB5_KDB_SRV_TYPE_ADMIN);
+    for (i = 0; i < nprincs; i++)
+        put_princ(admin, i, 3600);
+
+    kdc = open_db(KRB5_KDB_OPEN_RO | KRB5_KDB_SRV_TYPE_KDC);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nlookups; i++) {
+        n = (i == nlookups / 2) ? 0 : (i * 2654435761UL) % nprincs;
+        if (i == nlookups / 2)
+            put_princ(admin, 0, 7200);
+        if (get_princ(kdc, n) != ((i >= nlookups / 2 && n == 0) ? 7200 :
+                                  3600)) {
+            fprintf(stderr, "kdbperf: stale entry for perf%lu\n", n);
+            return 1;
+        }
+    }
+    t = elapsed(&start);
+
+    printf("%lu lookups in %lu principals at %.1f us each\n", nlookups,
+           nprincs, t * 1e6 / nlookups);
+    krb5_db_fini(kdc);
+    krb5_db_fini(admin);
+    krb5_free_context(kdc);
+    krb5_free_context(admin);
+    return 0;
+}
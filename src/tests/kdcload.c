@@ -0,0 +1,298 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/kdcload.c - Measure AS latency while other clients flood the KDC */
+/*
+ * Copyright (C) 2021 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Usage: kdcload port princ password floodprinc nflood count
+ *        kdcload port floodprinc count
+ *
+ * This program is invoked from t_ratelimit.py.  In the first form, it forks
+ * nflood processes,
+ * each of which makes AS exchanges for floodprinc with a wrong password as
+ * fast as the KDC answers them.  The flooding processes send their requests
+ * over UDP to the KDC on the loopback address at port, without the backoff or
+ * failover of the library's KDC transport, as an abusive script would.  Once
+ * every flooding process has started, the main process obtains initial
+ * credentials for princ count times, timing each exchange.  It then stops the
+ * flooding processes and prints the mean and maximum latency of its own
+ * exchanges, followed by the number of flood exchanges made and the number
+ * refused with KDC_ERR_SVC_UNAVAILABLE.
+ *
+ * In the second form, the main process makes count such exchanges for
+ * floodprinc one after another, and prints the number refused.
+ */
+
+#include <k5-int.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static void
+check(krb5_error_code ret, const char *what)
+{
+    if (ret) {
+        com_err("kdcload", ret, "while %s", what);
+        exit(1);
+    }
+}
+
+/* Return the number of microseconds since start. */
+static double
+since(struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000000.0 +
+        (now.tv_usec - start->tv_usec);
+}
+
+/* Open a UDP socket connected to the KDC on the loopback address. */
+static int
+open_kdc_socket(int port)
+{
+    struct sockaddr_in sin;
+    struct timeval tv = { 1, 0 };
+    int fd;
+
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(port);
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd == -1 ||
+        connect(fd, (struct sockaddr *)&sin, sizeof(sin)) != 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0) {
+        perror("kdcload: socket");
+        exit(1);
+    }
+    return fd;
+}
+
+/* Perform one AS exchange for princ with a wrong password over fd.  Return
+ * the result of the exchange, or KRB5_KDC_UNREACH if the KDC did not answer
+ * within a second. */
+static krb5_error_code
+flood_exchange(krb5_context ctx, krb5_principal princ, int fd)
+{
+    krb5_error_code ret;
+    krb5_init_creds_context icc;
+    krb5_data reply = empty_data(), req = empty_data(), realm = empty_data();
+    unsigned int flags = 0;
+    char buf[4096];
+    ssize_t len;
+
+    check(krb5_init_creds_init(ctx, princ, NULL, NULL, 0, NULL, &icc),
+          "initializing init_creds context");
+    check(krb5_init_creds_set_password(ctx, icc, "wrong"),
+          "setting password");
+    for (;;) {
+        ret = krb5_init_creds_step(ctx, icc, &reply, &req, &realm, &flags);
+        if (ret || !(flags & KRB5_INIT_CREDS_STEP_FLAG_CONTINUE))
+            break;
+        if (send(fd, req.data, req.length, 0) < 0)
+            check(errno, "sending request");
+        len = recv(fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            ret = KRB5_KDC_UNREACH;
+            break;
+        }
+        reply = make_data(buf, len);
+        krb5_free_data_contents(ctx, &req);
+        krb5_free_data_contents(ctx, &realm);
+    }
+    krb5_free_data_contents(ctx, &req);
+    krb5_free_data_contents(ctx, &realm);
+    krb5_init_creds_free(ctx, icc);
+    return ret;
+}
+
+/* Make AS exchanges for name until stopfd is closed, then write the exchange
+ * and refusal counts to resultfd. */
+static void
+run_flood(krb5_context ctx, int port, const char *name, int readyfd,
+          int stopfd, int resultfd)
+{
+    krb5_principal princ;
+    struct pollfd pfd;
+    int fd, counts[2] = { 0, 0 };
+
+    check(krb5_parse_name(ctx, name, &princ), "parsing flood principal");
+    fd = open_kdc_socket(port);
+    if (write(readyfd, "", 1) != 1)
+        exit(1);
+
+    pfd.fd = stopfd;
+    pfd.events = POLLIN;
+    while (poll(&pfd, 1, 0) == 0) {
+        counts[0]++;
+        if (flood_exchange(ctx, princ, fd) == KRB5KDC_ERR_SVC_UNAVAILABLE)
+            counts[1]++;
+    }
+
+    close(fd);
+    krb5_free_principal(ctx, princ);
+    if (write(resultfd, counts, sizeof(counts)) != sizeof(counts))
+        exit(1);
+    exit(0);
+}
+
+/* Make count AS exchanges for name with a wrong password in sequence, and
+ * print the number refused. */
+static int
+run_sequential(krb5_context ctx, int port, const char *name, int count)
+{
+    krb5_principal princ;
+    int fd, i, nrefused = 0;
+
+    check(krb5_parse_name(ctx, name, &princ), "parsing flood principal");
+    fd = open_kdc_socket(port);
+    for (i = 0; i < count; i++) {
+        if (flood_exchange(ctx, princ, fd) == KRB5KDC_ERR_SVC_UNAVAILABLE)
+            nrefused++;
+    }
+    close(fd);
+    krb5_free_principal(ctx, princ);
+    printf("%d flood exchanges, %d refused\n", count, nrefused);
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_context ctx;
+    krb5_principal princ;
+    krb5_creds creds;
+    char *password, c;
+    int port, nflood, count, i, status, ok = 1, counts[2], ret;
+    int nreqs = 0, nrefused = 0;
+    int readyfds[2], stopfds[2], resultfds[2];
+    struct timeval start;
+    double us, total = 0, max = 0;
+    pid_t pid;
+
+    if (argc == 4) {
+        count = atoi(argv[3]);
+        if (count <= 0) {
+            fprintf(stderr, "count must be positive\n");
+            return 1;
+        }
+        check(krb5_init_context(&ctx), "initializing context");
+        ret = run_sequential(ctx, atoi(argv[1]), argv[2], count);
+        krb5_free_context(ctx);
+        return ret;
+    }
+    if (argc != 7) {
+        fprintf(stderr, "Usage: %s port princ password floodprinc nflood "
+                "count\n       %s port floodprinc count\n", argv[0],
+                argv[0]);
+        return 1;
+    }
+    port = atoi(argv[1]);
+    password = argv[3];
+    nflood = atoi(argv[5]);
+    count = atoi(argv[6]);
+    if (nflood < 0 || count <= 0) {
+        fprintf(stderr, "nflood must be nonnegative and count positive\n");
+        return 1;
+    }
+
+    check(krb5_init_context(&ctx), "initializing context");
+    check(krb5_parse_name(ctx, argv[2], &princ), "parsing principal");
+
+    if (pipe(readyfds) != 0 || pipe(stopfds) != 0 || pipe(resultfds) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    for (i = 0; i < nflood; i++) {
+        pid = fork();
+        if (pid == -1) {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0) {
+            close(readyfds[0]);
+            close(stopfds[1]);
+            close(resultfds[0]);
+            run_flood(ctx, port, argv[4], readyfds[1], stopfds[0],
+                      resultfds[1]);
+        }
+    }
+    close(readyfds[1]);
+    close(stopfds[0]);
+    close(resultfds[1]);
+
+    for (i = 0; i < nflood; i++) {
+        if (read(readyfds[0], &c, 1) != 1)
+            break;
+    }
+
+    for (i = 0; i < count; i++) {
+        gettimeofday(&start, NULL);
+        check(krb5_get_init_creds_password(ctx, &creds, princ, password, NULL,
+                                           NULL, 0, NULL, NULL),
+              "getting initial credentials");
+        us = since(&start);
+        krb5_free_cred_contents(ctx, &creds);
+        total += us;
+        if (us > max)
+            max = us;
+    }
+
+    /* Stop the flooding clients and collect their counts. */
+    close(stopfds[1]);
+    for (i = 0; i < nflood; i++) {
+        if (read(resultfds[0], counts, sizeof(counts)) != sizeof(counts)) {
+            ok = 0;
+            break;
+        }
+        nreqs += counts[0];
+        nrefused += counts[1];
+    }
+    for (i = 0; i < nflood; i++) {
+        if (wait(&status) == -1 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0)
+            ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "kdcload: a flooding client failed\n");
+        return 1;
+    }
+
+    printf("%d requests: mean %.1f ms, max %.1f ms\n", count,
+           total / count / 1000, max / 1000);
+    printf("%d flood exchanges, %d refused\n", nreqs, nrefused);
+    krb5_free_principal(ctx, princ);
+    krb5_free_context(ctx);
+    return 0;
+}
@@ -0,0 +1,162 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/pwdictperf.c - Measure password dictionary load and lookup cost */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Usage: pwdictperf -g count wordfile
+ *        pwdictperf dictfile nlookups
+ *
+ * The first form writes count pseudo-random words to wordfile, for use as a
+ * synthetic breach corpus.  The second form opens dictfile (a text word list
+ * or a file made by "kdb5_util compile_dict") as the dict password quality
+ * module does, performs nlookups lookups of words which may or may not be
+ * present, and reports the time taken to open the dictionary, the average
+ * lookup latency, and the growth in the peak resident set size.
+ */
+
+#include "k5-int.h"
+#include <kadm5/admin.h>
+#include <kadm5/server_internal.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static long
+maxrss_kb(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+    return ru.ru_maxrss;
+}
+
+/* Write the nth pseudo-random word into buf. */
+static void
+make_word(unsigned long n, char *buf, size_t len)
+{
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    uint64_t x = n * 0x9E3779B97F4A7C15ULL + 1;
+    size_t i, wlen;
+
+    wlen = 6 + (x >> 60) % 8;
+    if (wlen > len - 1)
+        wlen = len - 1;
+    for (i = 0; i < wlen; i++) {
+        x ^= x >> 29;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 32;
+        buf[i] = chars[x % (sizeof(chars) - 1)];
+    }
+    buf[wlen] = '\0';
+}
+
+static int
+generate(unsigned long count, const char *path)
+{
+    char word[32];
+    unsigned long i;
+    FILE *fp;
+
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        perror(path);
+        return 1;
+    }
+    for (i = 0; i < count; i++) {
+        make_word(i, word, sizeof(word));
+        fprintf(fp, "%s\n", word);
+    }
+    if (fclose(fp) == EOF) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_error_code ret;
+    k5_pwdict *dict;
+    struct timeval start;
+    double open_time, lookup_time;
+    unsigned long i, nlookups, nfound = 0;
+    long rss_before, rss_open;
+    char word[32];
+
+    if (argc == 4 && strcmp(argv[1], "-g") == 0)
+        return generate(strtoul(argv[2], NULL, 10), argv[3]);
+    if (argc != 3) {
+        fprintf(stderr, "Usage: pwdictperf -g count wordfile\n"
+                "       pwdictperf dictfile nlookups\n");
+        return 1;
+    }
+    nlookups = strtoul(argv[2], NULL, 10);
+
+    rss_before = maxrss_kb();
+    gettimeofday(&start, NULL);
+    ret = k5_pwdict_open(argv[1], &dict);
+    if (ret) {
+        fprintf(stderr, "pwdictperf: %s: %s\n", argv[1], error_message(ret));
+        return 1;
+    }
+    open_time = elapsed(&start);
+    rss_open = maxrss_kb();
+
+    /* Look up words from the start of the generated sequence (so that
+     * half of them are present in a generated corpus of nlookups / 2
+     * words or more) and beyond it. */
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nlookups; i++) {
+        make_word((i % 2) ? i / 2 : ~0UL - i, word, sizeof(word));
+        if (k5_pwdict_contains(dict, word))
+            nfound++;
+    }
+    lookup_time = elapsed(&start);
+
+    printf("open %.3f ms, %lu lookups (%lu found) at %.0f ns each, "
+           "RSS +%ld KB (+%ld KB after lookups)\n", open_time * 1000,
+           nlookups, nfound,
+           nlookups ? lookup_time * 1e9 / nlookups : 0.0,
+           rss_open - rss_before, maxrss_kb() - rss_before);
+    k5_pwdict_close(dict);
+    return 0;
+}
@@ -1,5 +1,6 @@
 from k5test import *
 from filecmp import cmp
+import struct
 
 def dump_compare(realm, opt, srcfile):
     mark('dump comparison against %s' % os.path.basename(srcfile))
@@ -91,4 +92,38 @@ for realm in multidb_realms(start_kdc=False):
     load_dump_check_compare(realm, ['-r13'], srcdump_r13)
     load_dump_check_compare(realm, ['-b7'], srcdump_b7)
 
+# Load a dump into a DB2 database created with a non-default page size
+# and cache size, and check that the page size is recorded in the btree
+# metadata page.  Then check that the KDC (which opens the database
+# read-only) can use it.
+mark('DB2 page_size and cache_size')
+conf = {'dbmodules': {'db': {'page_size': '8192', 'cache_size': '1024'}}}
+realm = K5Realm(create_user=False, create_host=False, start_kdc=False,
+                bdb_only=True, kdc_conf=conf)
+realm.run([kdb5_util, 'load', srcdump])
+realm.run([kdb5_util, 'stash', '-P', 'master'])
+with open(os.path.join(realm.testdir, 'db'), 'rb') as f:
+    magic, version, psize = struct.unpack('=III', f.read(12))
+if psize != 8192:
+    fail('Unexpected DB2 page size %d' % psize)
+realm.run([kadminl, 'getprinc', 'nokeys'], expected_msg='Number of keys: 0')
+realm.run([kadminl, 'addprinc', '-clearpolicy', '-pw', password('pguser'),
+           'pguser'])
+realm.start_kdc()
+realm.kinit('pguser', password('pguser'))
+realm.run([kadminl, 'modprinc', '-allow_tix', 'pguser'])
+realm.kinit('pguser', password('pguser'), expected_code=1,
+            expected_msg='credentials have been revoked')
+realm.stop()
+
+# Time lookups through libkdb5, with a change made midway by another
+# handle.
+realm.run(['./kdbperf', '1000', '10000'], expected_msg='10000 lookups')
+
+conf = {'dbmodules': {'db': {'page_size': '1000'}}}
+realm = K5Realm(create_user=False, create_host=False, start_kdc=False,
+                bdb_only=True, kdc_conf=conf, create_kdb=False)
+realm.run([kdb5_util, 'create', '-s', '-P', 'master'], expected_code=1,
+          expected_msg='Invalid DB2 page size 1000')
+
 success('Dump/load tests')
@@ -53,6 +53,18 @@ test_etinfo('preauthuser', 'rc4 aes256-cts',
 test_etinfo('rc4user', 'des3', [])
 test_etinfo('nokeyuser', 'des3', [])
 
+# The KDC caches the etype-info sent in preauth-required errors.  Verify
+# that the cached value is not used once the client key and salt change.
+realm.run([kadminl, 'cpw', '-e', 'des3-cbc-sha1:norealm', '-pw', 'pw',
+           'preauthuser'])
+test_etinfo('preauthuser', 'rc4-hmac-exp des3 rc4',
+            ['error etype_info2 des3-cbc-sha1 preauthuser',
+             'error etype_info des3-cbc-sha1 preauthuser'])
+realm.run([kadminl, 'modprinc', '+requires_hwauth', 'preauthuser'])
+test_etinfo('preauthuser', 'rc4-hmac-exp des3 rc4',
+            ['error etype_info2 des3-cbc-sha1 preauthuser',
+             'error etype_info des3-cbc-sha1 preauthuser'])
+
 # Verify that etype-info2 is included in a MORE_PREAUTH_DATA_REQUIRED
 # error if the client does optimistic preauth.
 mark('MORE_PREAUTH_DATA_REQUIRED test')
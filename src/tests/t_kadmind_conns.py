@@ -0,0 +1,45 @@
+from k5test import *
+import resource
+import socket
+
+# Hold this many idle kadmin connections open while other clients work.
+# "make check-perf" uses more than FD_SETSIZE (usually 1024) of them, so
+# that kadmind has to serve descriptors which do not fit in an fd_set.
+nidle = 10000 if os.getenv('K5TEST_PERF') is not None else 300
+
+# This process and kadmind each need a descriptor per connection.
+soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+if hard != resource.RLIM_INFINITY and hard < nidle + 200:
+    skip_rest('kadmind connection scaling tests',
+              'descriptor limit too low')
+if soft == resource.RLIM_INFINITY or soft < nidle + 200:
+    resource.setrlimit(resource.RLIMIT_NOFILE, (nidle + 200, hard))
+
+conf = {'realms': {'$realm': {'kadmind_max_connections': str(nidle + 100)}}}
+realm = K5Realm(create_host=False, kdc_conf=conf, start_kadmind=True)
+
+def run_perf(nclients, count):
+    out = realm.run(['./kadmperf', realm.admin_princ, password('admin'),
+                     str(nclients), str(count)])
+    output(out)
+
+mark('active clients alone')
+run_perf(4, 50)
+
+mark('active clients with %d idle connections' % nidle)
+idle = []
+for i in range(nidle):
+    s = socket.create_connection(('127.0.0.1', realm.portbase + 1))
+    idle.append(s)
+run_perf(4, 50)
+realm.prep_kadmin()
+realm.run_kadmin(['getprinc', 'perf0'], expected_msg='Principal: perf0@')
+
+# None of the idle connections should have been dropped.
+for s in idle:
+    s.close()
+with open(os.path.join(realm.testdir, 'kadmind5.log')) as f:
+    if 'too many connections' in f.read():
+        fail('kadmind dropped connections')
+
+success('kadmind connection scaling')
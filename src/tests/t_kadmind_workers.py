@@ -0,0 +1,48 @@
+from k5test import *
+
+realm = K5Realm(create_host=False, start_kadmind=False)
+
+def run_perf(nclients, count):
+    out = realm.run(['./kadmperf', realm.admin_princ, password('admin'),
+                     str(nclients), str(count)])
+    output(out)
+
+def check_kvno(princ, kvno):
+    realm.run([kadminl, 'getprinc', princ], expected_msg='vno %d' % kvno)
+
+# Run ordinary kadmin operations against a kadmind using worker threads.
+realm.start_kadmind(args=['-w', '4'])
+realm.prep_kadmin()
+realm.run_kadmin(['addprinc', '-pw', 'pw1', 'wtest'])
+realm.run_kadmin(['getprinc', 'wtest'], expected_msg='Principal: wtest@')
+realm.run_kadmin(['modprinc', '-maxlife', '1 hour', 'wtest'])
+realm.run_kadmin(['getprinc', 'wtest'],
+                 expected_msg='Maximum ticket life: 0 days 01:00:00')
+realm.run_kadmin(['cpw', '-pw', 'pw2', 'wtest'])
+check_kvno('wtest', 2)
+realm.run_kadmin(['addpol', 'wpol'])
+realm.run_kadmin(['getpol', 'wpol'], expected_msg='Policy: wpol')
+realm.run_kadmin(['listprincs'], expected_msg='wtest@')
+realm.run_kadmin(['delprinc', 'wtest'])
+realm.run_kadmin(['getprinc', 'wtest'], expected_code=1,
+                 expected_msg='Principal does not exist')
+
+# Each kadmperf client changes the password of its own principal once
+# every ten operations.  Make sure no change is lost when several
+# clients run at once.
+mark('concurrent clients with workers')
+run_perf(1, 50)
+run_perf(4, 50)
+check_kvno('perf0', 11)
+check_kvno('perf3', 6)
+realm.stop_kadmind()
+
+# Compare against a kadmind processing requests in its main loop.
+mark('concurrent clients without workers')
+realm.start_kadmind()
+run_perf(1, 50)
+run_perf(4, 50)
+check_kvno('perf0', 21)
+check_kvno('perf3', 11)
+
+success('kadmind worker threads')
@@ -536,6 +536,83 @@ realm.run([kadminl, 'cpw', '-pw', 'password_', 'pwuser'])
 realm.run([kadminl, 'getprinc', 'pwuser'],
           expected_msg='Password expiration date: [never]')
 
+# Test the principal entry cache.  The KDC must keep serving a cached
+# entry after the directory is modified behind its back, but changes
+# made through the KDB module by any process using the same stamp file
+# must take effect immediately.
+mark('LDAP principal cache')
+realm.stop_kdc()
+cache_conf = {'dbmodules': {'ldap': {
+    'ldap_principal_cache_lifetime': '300',
+    'ldap_principal_cache_stamp_file': '$testdir/cachestamp'}}}
+cache_env = realm.special_env('princcache', True, kdc_conf=cache_conf)
+realm.start_kdc(env=cache_env)
+
+def cache_kadmin(args, **kw):
+    return realm.run([kadminl] + args, env=cache_env, **kw)
+
+def stamp_count():
+    with open(os.path.join(realm.testdir, 'cachestamp')) as f:
+        return int(f.read() or '0')
+
+# Get a service ticket for princ with a fresh TGT, so that the KDC looks
+# up princ.
+def cache_kvno(princ, **kw):
+    realm.kinit(realm.user_princ, password('user'))
+    realm.run([kvno, princ], **kw)
+
+# Every kadmin change empties the KDC's cache, so look up each principal
+# just before the change which should discard it.
+for princ in ('cachesvc', 'cachedel', 'cacheold'):
+    cache_kadmin(['addprinc', '-randkey', princ])
+
+# Mark cachesvc as user-to-user only directly in the directory.  The KDC
+# serves its cached copy until a kadmin put discards it.
+cache_kvno('cachesvc')
+ldap_modify('dn: krbPrincipalName=cachesvc@KRBTEST.COM,cn=t1,cn=krb5\n'
+            'changetype: modify\n'
+            'replace: krbTicketFlags\n'
+            'krbTicketFlags: 4096\n')
+cache_kvno('cachesvc')
+cache_kadmin(['modprinc', '-maxlife', '1 hour', 'cachesvc'])
+cache_kvno('cachesvc', expected_code=1,
+           expected_msg='Server principal valid for user2user only')
+
+# Deleting or renaming a cached principal takes effect immediately.
+cache_kvno('cachedel')
+cache_kadmin(['delprinc', 'cachedel'])
+cache_kvno('cachedel', expected_code=1,
+           expected_msg='Server not found in Kerberos database')
+cache_kvno('cacheold')
+cache_kadmin(['renprinc', 'cacheold', 'cachenew'])
+cache_kvno('cacheold', expected_code=1,
+           expected_msg='Server not found in Kerberos database')
+cache_kvno('cachenew')
+
+# Lockout updates made by the KDC itself take effect immediately in the
+# KDC, without changing the stamp file count.
+cache_kadmin(['addpol', '-maxfailure', '2', '-failurecountinterval', '5m',
+              'lockout'])
+count = stamp_count()
+cache_kadmin(['addprinc', '+requires_preauth', '-policy', 'lockout', '-pw',
+              'lockpw', 'lockuser'])
+if stamp_count() <= count:
+    fail('addprinc did not increment the principal cache stamp count')
+count = stamp_count()
+realm.kinit('lockuser', 'lockpw')
+realm.run([kvno, realm.host_princ])
+realm.run([kvno, realm.host_princ])
+msg = 'Password incorrect while getting initial credentials'
+realm.run([kinit, 'lockuser'], input='wrong\n', expected_code=1,
+          expected_msg=msg)
+realm.run([kinit, 'lockuser'], input='wrong\n', expected_code=1,
+          expected_msg=msg)
+msg = 'credentials have been revoked while getting initial credentials'
+realm.run([kinit, 'lockuser'], input='lockpw\n', expected_code=1,
+          expected_msg=msg)
+if stamp_count() != count:
+    fail('KDC lockout updates changed the principal cache stamp count')
+
 realm.stop()
 
 # Test dump and load.  Include a regression test for #8882
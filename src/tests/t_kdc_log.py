@@ -18,4 +18,21 @@ f.close()
 if not found_skew:
     fail('Did not find KDC log line for expired-ticket TGS request')
 
+realm.stop()
+
+# Log through the asynchronous writer, with and without worker processes.
+conf = {'logging': {'async': 'true', 'async_buffer_size': '4096'}}
+for args in ([], ['-w', '2']):
+    realm = K5Realm(kdc_conf=conf, start_kdc=False, get_creds=False)
+    realm.start_kdc(args)
+    for i in range(20):
+        realm.kinit(realm.user_princ, password('user'))
+    realm.stop()
+
+    kdc_logfile = os.path.join(realm.testdir, 'kdc.log')
+    with open(kdc_logfile, 'r') as f:
+        lines = [l for l in f if 'AS_REQ' in l and realm.user_princ in l]
+    if len(lines) != 20:
+        fail('Expected 20 AS_REQ log lines with async logging')
+
 success('KDC logging tests')
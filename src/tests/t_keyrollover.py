@@ -55,6 +55,20 @@ if 'vno 1, aes256-cts' not in out or \
 # Now present the DES3 ticket to the KDC and make sure it's rejected.
 realm.run([kvno, realm.host_princ], expected_code=1)
 
+# The KDC keeps the decrypted contents of TGTs it has seen.  Get a
+# TGT and use it twice, so that the second TGS request is served from
+# the cache.  Then replace the krbtgt key without changing its kvno,
+# and make sure the cached contents are not used for the old TGT.
+realm.run([kadminl, 'cpw', '-randkey', '-e', 'aes256-cts',
+           realm.krbtgt_princ])
+realm.kinit(realm.user_princ, password('user'))
+realm.run([kvno, princ1])
+realm.run([kvno, princ2])
+realm.run([kadminl, 'cpw', '-randkey', '-e', 'aes256-cts',
+           realm.krbtgt_princ])
+realm.run([kadminl, 'modprinc', '-kvno', '2', realm.krbtgt_princ])
+realm.run([kvno, realm.host_princ], expected_code=1)
+
 realm.stop()
 
 # Test a cross-realm TGT key rollover scenario where realm 1 mimics
@@ -0,0 +1,101 @@
+from k5test import *
+
+# Migration is tested from one DB2 database to another; the library
+# code is the same for any pair of modules.
+realm = K5Realm(create_host=False, start_kdc=False, bdb_only=True)
+realm.run([kadminl, 'addpol', '-minlength', '6', 'pol'])
+realm.run([kadminl, 'addprinc', '-pw', 'password', '-policy', 'pol',
+           'polprinc'])
+realm.run([kadminl, 'setstr', 'polprinc', 'key', 'value'])
+
+conf = {'dbmodules': {'db': {'migrate_to': 'newdb'},
+                      'newdb': {'db_library': 'db2',
+                                'database_name': '$testdir/newdb'}}}
+mig = realm.special_env('migrate', True, kdc_conf=conf)
+
+mark('migration target creation')
+realm.run([kadminl, 'getprinc', 'user'], env=mig, expected_code=1,
+          expected_msg='Cannot open migration target database')
+realm.run([kdb5_util, 'migrate', '-v'], env=realm.env, expected_code=1,
+          expected_msg='No migration target is configured')
+realm.run([kdb5_util, 'migrate', '-c'], env=mig)
+realm.run([kdb5_util, 'migrate', '-c'], env=mig, expected_code=1)
+out = realm.run([kdb5_util, 'migrate', '-v'], env=mig, expected_code=1)
+if ('Mismatch: principal user@KRBTEST.COM' not in out or
+    'Mismatch: policy pol' not in out):
+    fail('Expected mismatches not reported for empty target')
+
+mark('initial copy')
+out = realm.run([kdb5_util, 'migrate'], env=mig)
+if 'Copied 1 policy' not in out:
+    fail('Expected copy progress not reported')
+if 'Database and migration target match' not in out:
+    fail('Database and migration target do not match after copy')
+
+mark('dual-write')
+realm.run([kadminl, 'addprinc', '-randkey', 'new'], env=mig)
+realm.run([kadminl, 'modprinc', '-maxlife', '1 hour', 'user'], env=mig)
+realm.run([kadminl, 'cpw', '-pw', 'newpassword', 'polprinc'], env=mig)
+realm.run([kadminl, 'delstr', 'polprinc', 'key'], env=mig)
+realm.run([kadminl, 'renprinc', 'new', 'renamed'], env=mig)
+realm.run([kadminl, 'addpol', '-maxlife', '1 day', 'pol2'], env=mig)
+realm.run([kadminl, 'modpol', '-minlength', '8', 'pol'], env=mig)
+realm.run([kadminl, 'delpol', 'pol2'], env=mig)
+realm.run([kdb5_util, 'migrate', '-v'], env=mig,
+          expected_msg='Database and migration target match')
+
+# A change which cannot be applied to the target (here a read-only test
+# module) is still made in the primary database and logged for iprop.
+mark('target write failure')
+fail_conf = {'realms': {'$realm': {'iprop_enable': 'true',
+                                  'iprop_logfile': '$testdir/db.ulog'}},
+             'dbmodules': {'db': {'migrate_to': 'testdb'},
+                           'testdb': {'db_library': 'test'}}}
+failenv = realm.special_env('failtarget', True, kdc_conf=fail_conf)
+realm.run([kadminl, 'addprinc', '-randkey', 'failprinc'], env=failenv)
+realm.run([kadminl, 'getprinc', 'failprinc'],
+          expected_msg='Principal: failprinc@KRBTEST.COM')
+out = realm.run([kproplog], env=failenv)
+if 'Update operation : Add' not in out:
+    fail('Addition was not logged after target failure')
+realm.run([kadminl, 'delprinc', 'failprinc'], env=failenv)
+realm.run([kadminl, 'getprinc', 'failprinc'], expected_code=1,
+          expected_msg='Principal does not exist')
+out = realm.run([kproplog], env=failenv)
+if 'Update operation : Delete' not in out:
+    fail('Deletion was not logged after target failure')
+
+mark('changes not mirrored to target')
+realm.run([kadminl, 'addprinc', '-randkey', 'extra'])
+realm.run([kadminl, 'delprinc', 'renamed'])
+realm.run([kadminl, 'addpol', 'pol3'])
+out = realm.run([kdb5_util, 'migrate', '-v'], env=mig, expected_code=1)
+if ('Mismatch: principal extra@KRBTEST.COM' not in out or
+    'Mismatch: principal renamed@KRBTEST.COM' not in out or
+    'Mismatch: policy pol3' not in out or
+    '3 objects differ' not in out):
+    fail('Expected mismatches not reported after unmirrored changes')
+realm.run([kdb5_util, 'migrate'], env=mig,
+          expected_msg='Database and migration target match')
+
+mark('cutover')
+cut_conf = {'realms': {'$realm': {'database_module': 'newdb'}},
+            'dbmodules': {'newdb': {'db_library': 'db2',
+                                    'database_name': '$testdir/newdb',
+                                    'migrate_to': 'db'}}}
+cut = realm.special_env('cutover', True, kdc_conf=cut_conf)
+realm.run([kadminl, 'getprinc', 'renamed'], env=cut, expected_code=1,
+          expected_msg='Principal does not exist')
+realm.run([kadminl, 'getpol', 'pol'], env=cut,
+          expected_msg='Minimum password length: 8')
+realm.start_kdc(env=cut)
+realm.kinit(realm.user_princ, password('user'))
+realm.run([kvno, realm.krbtgt_princ])
+realm.kinit('polprinc', 'newpassword')
+realm.run([kadminl, 'delprinc', 'extra'], env=cut)
+realm.run([kadminl, 'getprinc', 'extra'], expected_code=1,
+          expected_msg='Principal does not exist')
+realm.run([kdb5_util, 'migrate', '-v'], env=cut,
+          expected_msg='Database and migration target match')
+
+success('KDB migration')
@@ -1,4 +1,6 @@
 from k5test import *
+import re
+import time
 
 # Skip this test if pkinit wasn't built.
 if not os.path.exists(os.path.join(plugins, 'preauth', 'pkinit.so')):
@@ -189,6 +191,59 @@ realm.kinit(realm.user_princ,
                             'PKINIT client verified RSA reply'))
 realm.klist(realm.user_princ)
 
+# Test the KDC DH key pool.  The first DH request activates the pool
+# for its group; once the pool has filled, requests should be answered
+# with pooled keys.  Report the time taken for a series of requests with
+# and without the pool for comparison.
+mark('DH key pool')
+def time_dh_kinits(n):
+    start = time.time()
+    for i in range(n):
+        realm.kinit(realm.user_princ,
+                    flags=['-X', 'X509_user_identity=%s' % file_identity])
+    return time.time() - start
+
+def read_trace(path):
+    with open(path) as f:
+        return f.read()
+
+nreqs = 10
+elapsed = time_dh_kinits(nreqs)
+output('%d DH requests without key pool: %.3fs\n' % (nreqs, elapsed))
+realm.stop_kdc()
+for max_uses in ('1', '2'):
+    pool_conf = {'realms': {'$realm': {'pkinit_dh_key_pool_size': '4',
+                                       'pkinit_dh_key_max_uses': max_uses}}}
+    pool_env = realm.special_env('dhpool', True, kdc_conf=pool_conf)
+    pool_trace = os.path.join(realm.testdir, 'dhpool.trace')
+    pool_env['KRB5_TRACE'] = pool_trace
+    realm.start_kdc(env=pool_env)
+    time_dh_kinits(1)
+    if 'DH key pool empty for 2048-bit group' not in read_trace(pool_trace):
+        fail('First DH request did not activate key pool')
+    # Keys are generated in the background, so wait until a request is
+    # answered from the pool before measuring.
+    for i in range(60):
+        time_dh_kinits(1)
+        if 'using pooled 2048-bit DH key' in read_trace(pool_trace):
+            break
+    else:
+        fail('DH requests not answered from key pool')
+    elapsed = time_dh_kinits(nreqs)
+    output('%d DH requests with key pool (max uses %s): %.3fs\n' %
+           (nreqs, max_uses, elapsed))
+    realm.stop_kdc()
+    trace = read_trace(pool_trace)
+    os.remove(pool_trace)
+    if max_uses == '2' and '(1 uses remaining)' not in trace:
+        fail('Pooled DH key was not reused')
+    if max_uses == '1' and '(1 uses remaining)' in trace:
+        fail('Single-use pooled DH key was reused')
+    m = re.search(r'2048-bit DH key pool: (\d+) hits', trace)
+    if m is None or int(m.group(1)) == 0:
+        fail('Expected DH key pool statistics not traced')
+realm.start_kdc()
+
 # Test a DH parameter renegotiation by temporarily setting a 4096-bit
 # minimum on the KDC.  (Preauth type 16 is PKINIT PA_PK_AS_REQ;
 # 109 is PKINIT TD_DH_PARAMETERS; 133 is FAST PA-FX-COOKIE.)
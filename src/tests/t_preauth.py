@@ -262,4 +262,12 @@ if out != ('step 1\nstep 2\nstep 3\nstep 1\nfinish 1\nstep 2\nno attr\n'
            'finish 2\n'):
     fail('unexpected output from icinterleave')
 
+# After the first request, the KDC builds preauth-required errors from
+# its hint cache.  The test module's hint is not cacheable and is still
+# generated for each request, using the client key, so the exchange must
+# still succeed afterwards.
+mark('hint cache')
+output(realm.run(['./hintperf', 'u3', '200']))
+realm.run(['./icred', 'u3', 'pw'])
+
 success('Pre-authentication framework tests')
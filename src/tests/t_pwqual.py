@@ -38,6 +38,31 @@ realm.run([kadminl, 'addprinc', '-pw', 'p5', '-policy', 'pol', 'p5'],
 realm.run([kadminl, 'addprinc', '-pw', 'birdsoranges', 'p6'], expected_code=1,
           expected_msg='Password may not be a pair of dictionary words')
 
+mark('compiled dictionary')
+
+# Compile the dictionary in place as a sorted index.  Lookups should be
+# case-insensitive like those in a text dictionary.
+textfile = dictfile + '.txt'
+shutil.copyfile(dictfile, textfile)
+realm.run([kdb5_util, 'compile_dict', textfile, dictfile])
+realm.run([kadminl, 'addprinc', '-pw', 'Oranges', '-policy', 'pol', 'p7'],
+          expected_code=1,
+          expected_msg='Password is in the password dictionary')
+realm.run([kadminl, 'addprinc', '-pw', 'orange', '-policy', 'pol', 'p7'])
+
+# Compile it as a Bloom filter.
+realm.run([kdb5_util, 'compile_dict', '-f', '0.001', textfile, dictfile])
+realm.run([kadminl, 'cpw', '-pw', 'BEES', 'p7'], expected_code=1,
+          expected_msg='Password is in the password dictionary')
+realm.run([kadminl, 'cpw', '-pw', 'pears', 'p7'])
+
+# Exercise the benchmark program on each kind of dictionary.
+for f in (textfile, dictfile):
+    realm.run(['./pwdictperf', f, '100'], expected_msg='100 lookups')
+
+realm.run([kdb5_util, 'compile_dict', '-f', '2', textfile, dictfile],
+          expected_code=1, expected_msg='invalid false positive rate')
+
 # These plugin ordering tests aren't specifically related to the
 # password quality interface, but are convenient to put here.
 
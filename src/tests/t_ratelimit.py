@@ -0,0 +1,138 @@
+from k5test import *
+import re
+import socket
+
+def read_metrics(path):
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(path)
+    out = b''
+    while True:
+        data = s.recv(4096)
+        if not data:
+            break
+        out += data
+    s.close()
+    return out.decode()
+
+def throttled(realm, limit):
+    text = read_metrics(os.path.join(realm.testdir, 'metrics.sock'))
+    m = re.search(r'^kdc_throttled_requests_total\{limit="%s"\} (\d+)$' %
+                  limit, text, re.MULTILINE)
+    if m is None:
+        fail('No throttled request count for %s limit' % limit)
+    return int(m.group(1))
+
+def check_log(realm, msg):
+    with open(os.path.join(realm.testdir, 'kdc.log')) as f:
+        if msg not in f.read():
+            fail('Expected KDC log message: ' + msg)
+
+# Make count wrong-password AS exchanges for the flood principal one after
+# another, and return the number refused.  Each refused exchange ends with
+# the refused request, so the KDC's throttled request count should match.
+def run_sequential(realm, count):
+    out = realm.run(['./kdcload', str(realm.portbase), 'flood', str(count)])
+    m = re.search(r'(\d+) flood exchanges, (\d+) refused', out)
+    if m is None:
+        fail('Unexpected kdcload output')
+    return int(m.group(2))
+
+# Run kdcload with nflood flooding clients and return the mean latency of
+# the good client's exchanges in milliseconds and the number of flood
+# requests refused.
+def run_load(realm, nflood, count):
+    out = realm.run(['./kdcload', str(realm.portbase), realm.user_princ,
+                     password('user'), 'flood', str(nflood), str(count)])
+    output(out)
+    m = re.search(r'mean ([\d.]+) ms.*\n(\d+) flood exchanges, (\d+) refused',
+                  out)
+    if m is None:
+        fail('Unexpected kdcload output')
+    return float(m.group(1)), int(m.group(3))
+
+def make_realm(limits):
+    conf = {'kdcdefaults': dict(limits, kdc_metrics_socket=
+                                '$testdir/metrics.sock')}
+    realm = K5Realm(kdc_conf=conf, create_host=False, get_creds=False)
+    realm.run([kadminl, 'addprinc', '+requires_preauth', '-pw', 'pw', 'flood'])
+    realm.run([kadminl, 'modprinc', '+requires_preauth', realm.user_princ])
+    return realm
+
+# With a per-principal limit of one request per second and a burst of four,
+# most of twenty rapid exchanges for the flood principal are refused, while
+# other clients are served.
+mark('principal limit')
+realm = make_realm({'kdc_principal_rate_limit': '1',
+                    'kdc_principal_rate_burst': '4',
+                    'kdc_rate_limit_action': 'error'})
+refused = run_sequential(realm, 20)
+if refused == 0:
+    fail('No flood requests were refused')
+if throttled(realm, 'principal') != refused:
+    fail('Throttled request count does not match refusals')
+if throttled(realm, 'address') != 0:
+    fail('Expected no address-throttled requests')
+check_log(realm, 'Throttling AS requests for flood@KRBTEST.COM')
+realm.kinit(realm.user_princ, password('user'))
+if throttled(realm, 'principal') != refused:
+    fail('Requests for another principal were throttled')
+
+mark('principal limit with workers')
+realm.stop_kdc()
+realm.start_kdc(['-w', '2'])
+refused = run_sequential(realm, 20)
+if refused == 0:
+    fail('No flood requests were refused')
+if throttled(realm, 'principal') != refused:
+    fail('Throttled request count does not match refusals')
+realm.stop()
+
+# With a per-address limit, all requests from the loopback address share a
+# bucket.
+mark('address limit')
+realm = make_realm({'kdc_address_rate_limit': '1',
+                    'kdc_address_rate_burst': '3',
+                    'kdc_rate_limit_action': 'error'})
+refused = run_sequential(realm, 20)
+if refused == 0:
+    fail('No requests were refused')
+if throttled(realm, 'address') != refused:
+    fail('Throttled request count does not match refusals')
+if throttled(realm, 'principal') != 0:
+    fail('Expected no principal-throttled requests')
+check_log(realm, 'Throttling requests from 127.0.0.1/32')
+realm.stop()
+
+# Compare the latency of a good client while other clients flood the KDC
+# with bad-password requests, with and without a principal limit.  Latency
+# depends on machine load, so this only runs in "make check-perf".
+def flood_tests():
+    # Without limits, flooding clients compete with a good client.
+    mark('flood without limits')
+    realm = make_realm({})
+    base, refused = run_load(realm, 0, 20)
+    unlimited, refused = run_load(realm, 4, 20)
+    realm.stop()
+
+    # With a per-principal limit, AS requests for the principal being flooded
+    # are refused cheaply, while other clients are served.  The good client
+    # makes two requests per exchange, within its burst.
+    mark('flood with a principal limit')
+    realm = make_realm({'kdc_principal_rate_limit': '20',
+                        'kdc_principal_rate_burst': '50',
+                        'kdc_rate_limit_action': 'error'})
+    limited, refused = run_load(realm, 4, 20)
+    if refused == 0:
+        fail('No flood requests were refused')
+    output('Mean latency: %.1f ms idle, %.1f ms under flood without limits, '
+           '%.1f ms with a principal limit\n' % (base, unlimited, limited))
+    # Only catch gross starvation.
+    if limited > base * 10 + 100:
+        fail('Good client latency %.1f ms under flood, %.1f ms without' %
+             (limited, base))
+    realm.stop()
+
+if os.getenv('K5TEST_PERF') is not None:
+    flood_tests()
+
+success('KDC rate limits')
@@ -30,6 +30,12 @@ if out.count('alice@KRBTEST.COM') != 2:
 # Try u2u against the client user.
 realm.run([kvno, '--u2u', realm.ccache, realm.user_princ])
 
+# Make a u2u request without FAST, so that the KDC decrypts the second
+# ticket into the arena-decoded request.  Run with VALGRIND set to check
+# the KDC for leaks.
+realm.run(['./u2ureq', u2u_ccache, 'alice'],
+          expected_msg='u2u ticket for user@KRBTEST.COM')
+
 realm.run([klist])
 
 realm.stop()
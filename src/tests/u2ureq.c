@@ -0,0 +1,182 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* tests/u2ureq.c - Make a user-to-user TGS request without FAST */
+/*
+ * Copyright (C) 2021 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Usage: u2ureq ccache2 servername
+ *
+ * Using the TGT in the default ccache, request a user-to-user ticket for
+ * servername with the TGT in ccache2 as the second ticket.  The library's TGS
+ * requests are always wrapped in FAST, which makes the KDC decode the inner
+ * request on the heap; this program sends the request unwrapped, as older and
+ * non-MIT clients do, so that the KDC processes the arena-decoded request.
+ * Decrypt the issued ticket with the second ticket's session key and display
+ * its client principal name.
+ */
+
+#include "k5-int.h"
+
+static krb5_context ctx;
+
+static void
+check(krb5_error_code code)
+{
+    const char *errmsg;
+
+    if (code) {
+        errmsg = krb5_get_error_message(ctx, code);
+        fprintf(stderr, "%s\n", errmsg);
+        krb5_free_error_message(ctx, errmsg);
+        exit(1);
+    }
+}
+
+/* Retrieve the local TGT from ccache. */
+static krb5_creds *
+get_tgt(krb5_ccache ccache)
+{
+    krb5_principal client, tgtname;
+    krb5_creds mcred, *tgt;
+
+    check(krb5_cc_get_principal(ctx, ccache, &client));
+    check(krb5_build_principal_ext(ctx, &tgtname, client->realm.length,
+                                   client->realm.data, KRB5_TGS_NAME_SIZE,
+                                   KRB5_TGS_NAME, client->realm.length,
+                                   client->realm.data, 0));
+    memset(&mcred, 0, sizeof(mcred));
+    mcred.client = client;
+    mcred.server = tgtname;
+    check(krb5_get_credentials(ctx, KRB5_GC_CACHED, ccache, &mcred, &tgt));
+    krb5_free_principal(ctx, client);
+    krb5_free_principal(ctx, tgtname);
+    return tgt;
+}
+
+int
+main(int argc, char **argv)
+{
+    krb5_ccache ccache, ccache2;
+    krb5_creds *tgt, *tgt2;
+    krb5_ticket *ticket, *ticket2, *tickets[2];
+    krb5_kdc_req req;
+    krb5_authenticator auth;
+    krb5_ap_req apreq;
+    krb5_pa_data pa, *padata[2];
+    krb5_checksum cksum;
+    krb5_data *body, *authdata, *apreq_asn1, *req_asn1, reply;
+    krb5_data realm, nonce_data;
+    krb5_kdc_rep *rep;
+    krb5_error *err;
+    krb5_int32 nonce;
+    char *name;
+    int primary = 0;
+
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s ccache2 servername\n", argv[0]);
+        exit(1);
+    }
+    check(krb5_init_context(&ctx));
+    check(krb5_cc_default(ctx, &ccache));
+    check(krb5_cc_resolve(ctx, argv[1], &ccache2));
+    tgt = get_tgt(ccache);
+    tgt2 = get_tgt(ccache2);
+    check(decode_krb5_ticket(&tgt->ticket, &ticket));
+    check(decode_krb5_ticket(&tgt2->ticket, &ticket2));
+
+    /* Make the request body, with the second TGT as the additional ticket. */
+    memset(&req, 0, sizeof(req));
+    req.msg_type = KRB5_TGS_REQ;
+    req.kdc_options = KDC_OPT_ENC_TKT_IN_SKEY;
+    check(krb5_parse_name(ctx, argv[2], &req.server));
+    req.till = tgt->times.endtime;
+    nonce_data = make_data(&nonce, sizeof(nonce));
+    check(krb5_c_random_make_octets(ctx, &nonce_data));
+    req.nonce = nonce & 0x7fffffff;
+    req.ktype = &tgt->keyblock.enctype;
+    req.nktypes = 1;
+    tickets[0] = ticket2;
+    tickets[1] = NULL;
+    req.second_ticket = tickets;
+    check(encode_krb5_kdc_req_body(&req, &body));
+
+    /* Make a PA-TGS-REQ AP-REQ authenticating the body with the first TGT. */
+    check(krb5_c_make_checksum(ctx, 0, &tgt->keyblock,
+                               KRB5_KEYUSAGE_TGS_REQ_AUTH_CKSUM, body,
+                               &cksum));
+    memset(&auth, 0, sizeof(auth));
+    auth.client = tgt->client;
+    auth.checksum = &cksum;
+    check(krb5_us_timeofday(ctx, &auth.ctime, &auth.cusec));
+    check(encode_krb5_authenticator(&auth, &authdata));
+    memset(&apreq, 0, sizeof(apreq));
+    apreq.ticket = ticket;
+    check(krb5_encrypt_helper(ctx, &tgt->keyblock, KRB5_KEYUSAGE_TGS_REQ_AUTH,
+                              authdata, &apreq.authenticator));
+    check(encode_krb5_ap_req(&apreq, &apreq_asn1));
+    pa.magic = KV5M_PA_DATA;
+    pa.pa_type = KRB5_PADATA_AP_REQ;
+    pa.length = apreq_asn1->length;
+    pa.contents = (krb5_octet *)apreq_asn1->data;
+    padata[0] = &pa;
+    padata[1] = NULL;
+    req.padata = padata;
+    check(encode_krb5_tgs_req(&req, &req_asn1));
+
+    realm = tgt->server->realm;
+    check(krb5_sendto_kdc(ctx, req_asn1, &realm, &reply, &primary, 0));
+    if (decode_krb5_error(&reply, &err) == 0) {
+        fprintf(stderr, "KDC error %d\n", (int)err->error);
+        exit(1);
+    }
+    check(decode_krb5_tgs_rep(&reply, &rep));
+    check(krb5_decrypt_tkt_part(ctx, &tgt2->keyblock, rep->ticket));
+    check(krb5_unparse_name(ctx, rep->ticket->enc_part2->client, &name));
+    printf("u2u ticket for %s\n", name);
+
+    krb5_free_unparsed_name(ctx, name);
+    krb5_free_kdc_rep(ctx, rep);
+    krb5_free_data_contents(ctx, &reply);
+    krb5_free_data(ctx, req_asn1);
+    krb5_free_data(ctx, apreq_asn1);
+    krb5_free_data_contents(ctx, &apreq.authenticator.ciphertext);
+    krb5_free_data(ctx, authdata);
+    krb5_free_checksum_contents(ctx, &cksum);
+    krb5_free_data(ctx, body);
+    krb5_free_principal(ctx, req.server);
+    krb5_free_ticket(ctx, ticket);
+    krb5_free_ticket(ctx, ticket2);
+    krb5_free_creds(ctx, tgt);
+    krb5_free_creds(ctx, tgt2);
+    krb5_cc_close(ctx, ccache);
+    krb5_cc_close(ctx, ccache2);
+    krb5_free_context(ctx);
+    return 0;
+}
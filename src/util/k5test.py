@@ -275,8 +275,9 @@ Scripts may use the following realm methods and attributes:
 * realm.stop_kdc(): Stop the krb5kdc process.  Errors if no KDC is
   running.
 
-* realm.start_kadmind(env=None): Start a kadmind process.  Errors if a
-  kadmind is already running.
+* realm.start_kadmind(env=None, args=[]): Start a kadmind process.
+  Errors if a kadmind is already running.  If args is given, it
+  contains a list of additional kadmind arguments.
 
 * realm.stop_kadmind(): Stop the kadmind process.  Errors if no
   kadmind is running.
@@ -1032,7 +1033,7 @@ class K5Realm(object):
         stop_daemon(self._kdc_proc)
         self._kdc_proc = None
 
-    def start_kadmind(self, env=None):
+    def start_kadmind(self, env=None, args=[]):
         global krb5kdc
         if env is None:
             env = self.env
@@ -1040,7 +1041,7 @@ class K5Realm(object):
         dump_path = os.path.join(self.testdir, 'dump')
         self._kadmind_proc = _start_daemon([kadmind, '-nofork', '-W',
                                             '-p', kdb5_util, '-K', kprop,
-                                            '-F', dump_path], env,
+                                            '-F', dump_path] + args, env,
                                            'starting...')
 
     def stop_kadmind(self):
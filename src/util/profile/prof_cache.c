@@ -0,0 +1,361 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* util/profile/prof_cache.c - Compiled profile cache */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * If KRB5_CONFIG_CACHEDIR is set in the environment (and the process is not
+ * privileged), the parsed tree of each profile file is saved there in binary
+ * form after a successful parse, and later processes read it back instead of
+ * parsing the text again.  Along with the tree, the cache records every file
+ * and include directory read while parsing, identified by inode number, size,
+ * and modification time; the cached tree is used only if all of them still
+ * match.  On any mismatch or error the file is parsed as usual.
+ *
+ * A cache file has the following format, with all integers in big-endian byte
+ * order:
+ *
+ *     magic "K5PRFC01" (8 bytes)
+ *     source count (4 bytes)
+ *     reserved, zero (4 bytes)
+ *     body length (8 bytes)
+ *     siphash of the body (8 bytes)
+ *
+ * The body contains the sources, each as a 4-byte path length, the path, and
+ * 8-byte inode, 8-byte size, 8-byte mtime seconds, and 4-byte mtime
+ * nanoseconds, followed by the tree as encoded by profile_encode_tree().
+ */
+
+#include "prof_int.h"
+#include "k5-buf.h"
+#include "k5-input.h"
+#include "k5-hashtab.h"
+
+#ifndef _WIN32
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+#define CACHE_MAGIC "K5PRFC01"
+#define CACHE_HEADER_LEN 32
+
+/* The siphash seed is fixed; it only needs to detect damaged files. */
+static const uint8_t cache_seed[K5_HASH_SEED_LEN];
+
+static void set_source_stat(struct profile_source *src, const struct stat *st)
+{
+    src->ino = st->st_ino;
+    src->size = st->st_size;
+    src->mtime = st->st_mtime;
+#if defined HAVE_STRUCT_STAT_ST_MTIMENSEC
+    src->mtime_nsec = st->st_mtimensec;
+#elif defined HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC
+    src->mtime_nsec = st->st_mtimespec.tv_nsec;
+#elif defined HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    src->mtime_nsec = st->st_mtim.tv_nsec;
+#else
+    src->mtime_nsec = 0;
+#endif
+}
+
+/* Return the cache directory, or NULL if the cache is not enabled. */
+static const char *cache_dir(void)
+{
+    const char *dir = secure_getenv("KRB5_CONFIG_CACHEDIR");
+
+    return (dir != NULL && *dir != '\0') ? dir : NULL;
+}
+
+/* Return the allocated name of the cache file for filespec, or NULL. */
+static char *cache_filename(const char *filespec)
+{
+    const char *dir = cache_dir();
+    uint64_t h;
+    char *path;
+
+    if (dir == NULL)
+        return NULL;
+    h = k5_siphash24((const uint8_t *)filespec, strlen(filespec), cache_seed);
+    if (asprintf(&path, "%s/profile-%016llx", dir, (unsigned long long)h) < 0)
+        return NULL;
+    return path;
+}
+
+int profile_cache_enabled(void)
+{
+    return cache_dir() != NULL;
+}
+
+void profile_add_source(struct profile_sources *sources, const char *path,
+                        const struct stat *st)
+{
+    struct profile_source *list, *src;
+
+    list = realloc(sources->list, (sources->count + 1) * sizeof(*list));
+    if (list == NULL) {
+        sources->failed = 1;
+        return;
+    }
+    sources->list = list;
+    src = &list[sources->count];
+    src->path = strdup(path);
+    if (src->path == NULL) {
+        sources->failed = 1;
+        return;
+    }
+    set_source_stat(src, st);
+    sources->count++;
+    if (!(st->st_mode & S_IROTH))
+        sources->private = 1;
+}
+
+void profile_free_sources(struct profile_sources *sources)
+{
+    size_t i;
+
+    for (i = 0; i < sources->count; i++)
+        free(sources->list[i].path);
+    free(sources->list);
+    sources->list = NULL;
+    sources->count = 0;
+}
+
+/* Read one source record from in and return true if the file it names is
+ * unchanged. */
+static int source_current(struct k5input *in)
+{
+    const unsigned char *path;
+    struct profile_source rec, cur;
+    struct stat st;
+    uint32_t len;
+    char *pathstr;
+    int ret;
+
+    len = k5_input_get_uint32_be(in);
+    path = k5_input_get_bytes(in, len);
+    rec.ino = k5_input_get_uint64_be(in);
+    rec.size = k5_input_get_uint64_be(in);
+    rec.mtime = k5_input_get_uint64_be(in);
+    rec.mtime_nsec = k5_input_get_uint32_be(in);
+    if (in->status || memchr(path, '\0', len) != NULL)
+        return 0;
+
+    pathstr = malloc(len + 1);
+    if (pathstr == NULL)
+        return 0;
+    memcpy(pathstr, path, len);
+    pathstr[len] = '\0';
+    ret = stat(pathstr, &st);
+    free(pathstr);
+    if (ret != 0)
+        return 0;
+    set_source_stat(&cur, &st);
+    return cur.ino == rec.ino && cur.size == rec.size &&
+        cur.mtime == rec.mtime && cur.mtime_nsec == rec.mtime_nsec;
+}
+
+/* Return true if st describes a file we should trust as a cache: a regular
+ * file owned by us or by root, writable by nobody else. */
+static int trusted_file(const struct stat *st)
+{
+    return S_ISREG(st->st_mode) &&
+        (st->st_uid == geteuid() || st->st_uid == 0) &&
+        !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
+
+errcode_t profile_cache_load(const char *filespec, struct profile_node **root)
+{
+    errcode_t retval = ENOENT;
+    struct k5input in;
+    struct stat st;
+    const unsigned char *map = MAP_FAILED;
+    uint64_t bodylen;
+    uint32_t nsources, i;
+    size_t size = 0;
+    char *path;
+    int fd;
+
+    *root = NULL;
+    path = cache_filename(filespec);
+    if (path == NULL)
+        return ENOENT;
+    fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0)
+        return ENOENT;
+    set_cloexec_fd(fd);
+    if (fstat(fd, &st) != 0 || !trusted_file(&st) ||
+        (uint64_t)st.st_size < CACHE_HEADER_LEN ||
+        (uint64_t)st.st_size > SIZE_MAX)
+        goto cleanup;
+    size = st.st_size;
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        goto cleanup;
+
+    if (memcmp(map, CACHE_MAGIC, 8) != 0 || load_32_be(map + 12) != 0)
+        goto cleanup;
+    nsources = load_32_be(map + 8);
+    bodylen = load_64_be(map + 16);
+    if (bodylen != size - CACHE_HEADER_LEN ||
+        k5_siphash24(map + CACHE_HEADER_LEN, bodylen,
+                     cache_seed) != load_64_be(map + 24))
+        goto cleanup;
+
+    k5_input_init(&in, map + CACHE_HEADER_LEN, bodylen);
+    for (i = 0; i < nsources; i++) {
+        if (!source_current(&in))
+            goto cleanup;
+    }
+    retval = profile_decode_tree(in.ptr, in.len, root);
+    if (!retval) {
+        retval = profile_verify_node(*root);
+        if (retval) {
+            profile_free_node(*root);
+            *root = NULL;
+        }
+    }
+
+cleanup:
+    if (map != MAP_FAILED)
+        (void)munmap((void *)map, size);
+    close(fd);
+    return retval;
+}
+
+void profile_cache_store(const char *filespec, struct profile_node *root,
+                         struct profile_sources *sources)
+{
+    struct k5buf buf;
+    struct profile_source *src;
+    unsigned char *hdr, *body;
+    char *path = NULL, *tmpname = NULL;
+    const char *p;
+    size_t i, len, bodylen;
+    ssize_t nwritten;
+    int fd = -1;
+
+    if (sources->failed)
+        return;
+    path = cache_filename(filespec);
+    if (path == NULL)
+        return;
+
+    k5_buf_init_dynamic(&buf);
+    k5_buf_add_len(&buf, CACHE_MAGIC, 8);
+    k5_buf_add_uint32_be(&buf, sources->count);
+    k5_buf_add_uint32_be(&buf, 0);
+    k5_buf_add_uint64_be(&buf, 0);
+    k5_buf_add_uint64_be(&buf, 0);
+    for (i = 0; i < sources->count; i++) {
+        src = &sources->list[i];
+        k5_buf_add_uint32_be(&buf, strlen(src->path));
+        k5_buf_add(&buf, src->path);
+        k5_buf_add_uint64_be(&buf, src->ino);
+        k5_buf_add_uint64_be(&buf, src->size);
+        k5_buf_add_uint64_be(&buf, src->mtime);
+        k5_buf_add_uint32_be(&buf, src->mtime_nsec);
+    }
+    profile_encode_tree(root, &buf);
+    if (k5_buf_status(&buf) != 0)
+        goto cleanup;
+
+    hdr = buf.data;
+    body = hdr + CACHE_HEADER_LEN;
+    bodylen = buf.len - CACHE_HEADER_LEN;
+    store_64_be(bodylen, hdr + 16);
+    store_64_be(k5_siphash24(body, bodylen, cache_seed), hdr + 24);
+
+    /* Write to a temporary file and rename it into place, so that readers
+     * never see a partial cache file. */
+    if (asprintf(&tmpname, "%s.XXXXXX", path) < 0) {
+        tmpname = NULL;
+        goto cleanup;
+    }
+    fd = mkstemp(tmpname);
+    if (fd < 0)
+        goto cleanup;
+    (void)fchmod(fd, sources->private ? 0600 : 0644);
+    for (p = buf.data, len = buf.len; len > 0; p += nwritten, len -= nwritten) {
+        nwritten = write(fd, p, len);
+        if (nwritten <= 0)
+            goto cleanup;
+    }
+    if (close(fd) != 0) {
+        fd = -1;
+        goto cleanup;
+    }
+    fd = -1;
+    if (rename(tmpname, path) == 0) {
+        free(tmpname);
+        tmpname = NULL;
+    }
+
+cleanup:
+    if (fd >= 0)
+        close(fd);
+    if (tmpname != NULL) {
+        (void)unlink(tmpname);
+        free(tmpname);
+    }
+    free(path);
+    k5_buf_free(&buf);
+}
+
+#else /* _WIN32 */
+
+int profile_cache_enabled(void)
+{
+    return 0;
+}
+
+void profile_add_source(struct profile_sources *sources, const char *path,
+                        const struct stat *st)
+{
+    sources->failed = 1;
+}
+
+void profile_free_sources(struct profile_sources *sources)
+{
+}
+
+errcode_t profile_cache_load(const char *filespec, struct profile_node **root)
+{
+    *root = NULL;
+    return ENOENT;
+}
+
+void profile_cache_store(const char *filespec, struct profile_node *root,
+                         struct profile_sources *sources)
+{
+}
+
+#endif /* _WIN32 */
@@ -272,6 +272,7 @@ errcode_t profile_update_file_data_locked(prf_data_t data, char **ret_modspec)
 #endif
     FILE *f;
     int isdir = 0;
+    struct profile_sources sources = { NULL, 0, 0, 0 }, *srcp = NULL;
 
     if ((data->flags & PROFILE_FILE_NO_RELOAD) && data->root != NULL)
         return 0;
@@ -320,12 +321,28 @@ errcode_t profile_update_file_data_locked(prf_data_t data, char **ret_modspec)
 
 #ifdef HAVE_STAT
     isdir = S_ISDIR(st.st_mode);
+
+    /* Use the compiled cache if it is enabled and current.  Otherwise record
+     * the files we parse so that we can create it afterwards. */
+    if (!(data->flags & PROFILE_FILE_NO_RELOAD) && profile_cache_enabled()) {
+        if (profile_cache_load(data->filespec, &data->root) == 0) {
+            data->upd_serial++;
+            data->flags &= ~PROFILE_FILE_DIRTY;
+            data->timestamp = st.st_mtime;
+            data->frac_ts = frac;
+            return 0;
+        }
+        srcp = &sources;
+        profile_add_source(srcp, data->filespec, &st);
+    }
 #endif
     if (!isdir) {
         errno = 0;
         f = fopen(data->filespec, "r");
-        if (f == NULL)
+        if (f == NULL) {
+            profile_free_sources(&sources);
             return (errno != 0) ? errno : ENOENT;
+        }
         set_cloexec_file(f);
     }
 
@@ -333,15 +350,19 @@ errcode_t profile_update_file_data_locked(prf_data_t data, char **ret_modspec)
     data->flags &= ~PROFILE_FILE_DIRTY;
 
     if (isdir) {
-        retval = profile_process_directory(data->filespec, &data->root);
+        retval = profile_process_directory(data->filespec, &data->root, srcp);
     } else {
-        retval = profile_parse_file(f, &data->root, ret_modspec);
+        retval = profile_parse_file(f, &data->root, ret_modspec, srcp);
         (void)fclose(f);
     }
     if (retval) {
+        profile_free_sources(&sources);
         return retval;
     }
     assert(data->root != NULL);
+    if (srcp != NULL)
+        profile_cache_store(data->filespec, data->root, srcp);
+    profile_free_sources(&sources);
 #ifdef HAVE_STAT
     data->timestamp = st.st_mtime;
     data->frac_ts = frac;
@@ -315,6 +315,54 @@ profile_copy(profile_t old_profile, profile_t *new_profile)
     return err;
 }
 
+/*
+ * Return true if profile and other read the same shared file data, in the same
+ * order.  Profiles using a vtable or containing modified data never match.
+ */
+int
+profile_same_files(profile_t profile, profile_t other)
+{
+    prf_file_t f1, f2;
+    int shared;
+
+    if (profile->vt != NULL || other->vt != NULL)
+        return 0;
+    for (f1 = profile->first_file, f2 = other->first_file;
+         f1 != NULL && f2 != NULL; f1 = f1->next, f2 = f2->next) {
+        if (f1->data != f2->data)
+            return 0;
+        k5_mutex_lock(&f1->data->lock);
+        shared = (f1->data->flags & PROFILE_FILE_SHARED) &&
+            !(f1->data->flags & PROFILE_FILE_DIRTY);
+        k5_mutex_unlock(&f1->data->lock);
+        if (!shared)
+            return 0;
+    }
+    return f1 == NULL && f2 == NULL;
+}
+
+/*
+ * Return the sum of the update serials of profile's files.  Each file's serial
+ * is incremented whenever it is reloaded, so for profiles with the same files
+ * (see profile_same_files()), a change in this value means that the contents
+ * may have changed.
+ */
+unsigned long
+profile_get_data_serial(profile_t profile)
+{
+    prf_file_t file;
+    unsigned long serial = 0;
+
+    if (profile->vt != NULL)
+        return 0;
+    for (file = profile->first_file; file != NULL; file = file->next) {
+        k5_mutex_lock(&file->data->lock);
+        serial += file->data->upd_serial;
+        k5_mutex_unlock(&file->data->lock);
+    }
+    return serial;
+}
+
 errcode_t KRB5_CALLCONV
 profile_init_path(const_profile_filespec_list_t filepath,
                   profile_t *ret_profile)
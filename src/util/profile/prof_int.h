@@ -115,13 +115,35 @@ struct _profile_t {
 
 #define	PROFILE_LAST_FILESPEC(x) (((x) == NULL) || ((x)[0] == '\0'))
 
+/*
+ * A file or directory read while parsing a profile.  The compiled profile
+ * cache (prof_cache.c) records these so that it can tell whether a cached
+ * tree is still current.
+ */
+struct profile_source {
+	char		*path;
+	uint64_t	ino;
+	uint64_t	size;
+	int64_t		mtime;
+	uint32_t	mtime_nsec;
+};
+
+struct profile_sources {
+	struct profile_source *list;
+	size_t		count;
+	int		failed;		/* a source could not be recorded */
+	int		private;	/* a source is not world-readable */
+};
+
 /* profile_parse.c */
 
 errcode_t profile_parse_file
-	(FILE *f, struct profile_node **root, char **ret_modspec);
+	(FILE *f, struct profile_node **root, char **ret_modspec,
+	 struct profile_sources *sources);
 
 errcode_t profile_process_directory
-	(const char *dirname, struct profile_node **root);
+	(const char *dirname, struct profile_node **root,
+	 struct profile_sources *sources);
 
 errcode_t profile_write_tree_file
 	(struct profile_node *root, FILE *dstfile);
@@ -206,10 +228,41 @@ errcode_t profile_set_relation_value
 errcode_t profile_rename_node
 	(struct profile_node *node, const char *new_name);
 
+struct k5buf;
+void profile_encode_tree
+	(struct profile_node *node, struct k5buf *buf);
+
+errcode_t profile_decode_tree
+	(const void *ptr, size_t len, struct profile_node **root);
+
+/* prof_cache.c */
+
+int profile_cache_enabled
+	(void);
+
+struct stat;
+void profile_add_source
+	(struct profile_sources *sources, const char *path,
+	 const struct stat *st);
+
+void profile_free_sources
+	(struct profile_sources *sources);
+
+errcode_t profile_cache_load
+	(const char *filespec, struct profile_node **root);
+
+void profile_cache_store
+	(const char *filespec, struct profile_node *root,
+	 struct profile_sources *sources);
+
 /* prof_file.c */
 
 errcode_t KRB5_CALLCONV profile_copy (profile_t, profile_t *);
 
+int profile_same_files (profile_t, profile_t);
+
+unsigned long profile_get_data_serial (profile_t);
+
 errcode_t profile_open_file
 	(const_profile_filespec_t file, prf_file_t *ret_prof,
 	 char **ret_modspec);
@@ -12,6 +12,9 @@
 #ifndef _WIN32
 #include <dirent.h>
 #endif
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
 
 #define SECTION_SEP_CHAR '/'
 
@@ -24,6 +27,7 @@ struct parse_state {
     int     group_level;
     struct profile_node *root_section;
     struct profile_node *current_section;
+    struct profile_sources *sources;
 };
 
 static errcode_t parse_file(FILE *f, struct parse_state *state,
@@ -200,11 +204,15 @@ static errcode_t parse_std_line(char *line, struct parse_state *state)
 
 /* Open and parse an included profile file. */
 static errcode_t parse_include_file(const char *filename,
-                                    struct profile_node *root_section)
+                                    struct profile_node *root_section,
+                                    struct profile_sources *sources)
 {
     FILE    *fp;
     errcode_t retval = 0;
     struct parse_state state;
+#ifdef HAVE_STAT
+    struct stat st;
+#endif
 
     /* Create a new state so that fragments are syntactically independent but
      * share a root section. */
@@ -212,10 +220,19 @@ static errcode_t parse_include_file(const char *filename,
     state.group_level = 0;
     state.root_section = root_section;
     state.current_section = NULL;
+    state.sources = sources;
 
     fp = fopen(filename, "r");
     if (fp == NULL)
         return PROF_FAIL_INCLUDE_FILE;
+#ifdef HAVE_STAT
+    if (sources != NULL) {
+        if (fstat(fileno(fp), &st) == 0)
+            profile_add_source(sources, filename, &st);
+        else
+            sources->failed = 1;
+    }
+#endif
     retval = parse_file(fp, &state, NULL);
     fclose(fp);
     return retval;
@@ -249,11 +266,24 @@ static int valid_name(const char *filename)
  * files, and the like.  Files are processed in alphanumeric order.
  */
 static errcode_t parse_include_dir(const char *dirname,
-                                   struct profile_node *root_section)
+                                   struct profile_node *root_section,
+                                   struct profile_sources *sources)
 {
     errcode_t retval = 0;
     char **fnames, *pathname;
     int i;
+#ifdef HAVE_STAT
+    struct stat st;
+
+    /* Record the directory before listing it, so that a file added while we
+     * read it invalidates any cached result. */
+    if (sources != NULL) {
+        if (stat(dirname, &st) == 0)
+            profile_add_source(sources, dirname, &st);
+        else
+            sources->failed = 1;
+    }
+#endif
 
     if (k5_dir_filenames(dirname, &fnames) != 0)
         return PROF_FAIL_INCLUDE_DIR;
@@ -265,7 +295,7 @@ static errcode_t parse_include_dir(const char *dirname,
             retval = ENOMEM;
             break;
         }
-        retval = parse_include_file(pathname, root_section);
+        retval = parse_include_file(pathname, root_section, sources);
         free(pathname);
         if (retval)
             break;
@@ -282,12 +312,12 @@ static errcode_t parse_line(char *line, struct parse_state *state,
     if (strncmp(line, "include", 7) == 0 && isspace(line[7])) {
         cp = skip_over_blanks(line + 7);
         strip_line(cp);
-        return parse_include_file(cp, state->root_section);
+        return parse_include_file(cp, state->root_section, state->sources);
     }
     if (strncmp(line, "includedir", 10) == 0 && isspace(line[10])) {
         cp = skip_over_blanks(line + 10);
         strip_line(cp);
-        return parse_include_dir(cp, state->root_section);
+        return parse_include_dir(cp, state->root_section, state->sources);
     }
     switch (state->state) {
     case STATE_INIT_COMMENT:
@@ -398,7 +428,8 @@ static errcode_t parse_file(FILE *f, struct parse_state *state,
 }
 
 errcode_t profile_parse_file(FILE *f, struct profile_node **root,
-                             char **ret_modspec)
+                             char **ret_modspec,
+                             struct profile_sources *sources)
 {
     struct parse_state state;
     errcode_t retval;
@@ -409,6 +440,7 @@ errcode_t profile_parse_file(FILE *f, struct profile_node **root,
     state.state = STATE_INIT_COMMENT;
     state.group_level = 0;
     state.current_section = NULL;
+    state.sources = sources;
     retval = profile_create_node("(root)", 0, &state.root_section);
     if (retval)
         return retval;
@@ -423,7 +455,8 @@ errcode_t profile_parse_file(FILE *f, struct profile_node **root,
 }
 
 errcode_t profile_process_directory(const char *dirname,
-                                    struct profile_node **root)
+                                    struct profile_node **root,
+                                    struct profile_sources *sources)
 {
     errcode_t retval;
     struct profile_node *node;
@@ -432,7 +465,7 @@ errcode_t profile_process_directory(const char *dirname,
     retval = profile_create_node("(root)", 0, &node);
     if (retval)
         return retval;
-    retval = parse_include_dir(dirname, node);
+    retval = parse_include_dir(dirname, node, sources);
     if (retval) {
         profile_free_node(node);
         return retval;
@@ -19,6 +19,8 @@
 
 
 #include "prof_int.h"
+#include "k5-buf.h"
+#include "k5-input.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -698,3 +700,142 @@ errcode_t profile_rename_node(struct profile_node *node, const char *new_name)
     node->name = new_string;
     return 0;
 }
+
+/*
+ * Append a compact binary encoding of the tree rooted at node to buf, for use
+ * by the compiled profile cache.  Each node is encoded as a flags byte, a
+ * 4-byte name length and the name, a 4-byte value length and the value (only
+ * present for relations), and a 4-byte child count followed by the children in
+ * list order.  Deleted nodes are omitted.
+ */
+void profile_encode_tree(struct profile_node *node, struct k5buf *buf)
+{
+    struct profile_node *p;
+    unsigned char flags = node->final ? 1 : 0;
+    uint32_t count = 0;
+
+    for (p = node->first_child; p != NULL; p = p->next)
+        count += !p->deleted;
+
+    k5_buf_add_len(buf, &flags, 1);
+    k5_buf_add_uint32_be(buf, strlen(node->name));
+    k5_buf_add(buf, node->name);
+    if (node->value != NULL) {
+        k5_buf_add_uint32_be(buf, strlen(node->value) + 1);
+        k5_buf_add(buf, node->value);
+    } else {
+        k5_buf_add_uint32_be(buf, 0);
+    }
+    k5_buf_add_uint32_be(buf, count);
+    for (p = node->first_child; p != NULL; p = p->next) {
+        if (!p->deleted)
+            profile_encode_tree(p, buf);
+    }
+}
+
+#define MAX_DECODE_DEPTH 64
+
+/* Return an allocated copy of the next len bytes of in, or NULL if they are
+ * unavailable, contain a zero byte, or cannot be copied. */
+static char *decode_string(struct k5input *in, size_t len)
+{
+    const unsigned char *bytes = k5_input_get_bytes(in, len);
+    char *str;
+
+    if (bytes == NULL || memchr(bytes, '\0', len) != NULL)
+        return NULL;
+    str = malloc(len + 1);
+    if (str == NULL)
+        return NULL;
+    memcpy(str, bytes, len);
+    str[len] = '\0';
+    return str;
+}
+
+static errcode_t decode_node(struct k5input *in, struct profile_node *parent,
+                             int depth, struct profile_node **node_out)
+{
+    struct profile_node *node, *child, *last = NULL;
+    unsigned char flags;
+    uint32_t len, count, i;
+    errcode_t retval;
+
+    *node_out = NULL;
+    if (depth > MAX_DECODE_DEPTH)
+        return PROF_BAD_GROUP_LVL;
+
+    node = calloc(1, sizeof(*node));
+    if (node == NULL)
+        return ENOMEM;
+    node->magic = PROF_MAGIC_NODE;
+    node->parent = parent;
+    node->group_level = (parent == NULL) ? 0 : parent->group_level + 1;
+
+    flags = k5_input_get_byte(in);
+    node->final = (flags & 1);
+    len = k5_input_get_uint32_be(in);
+    node->name = decode_string(in, len);
+    if (node->name == NULL)
+        goto bad;
+    len = k5_input_get_uint32_be(in);
+    if (len > 0) {
+        node->value = decode_string(in, len - 1);
+        if (node->value == NULL)
+            goto bad;
+    }
+    count = k5_input_get_uint32_be(in);
+    if (in->status || flags > 1 || (node->value != NULL && count > 0))
+        goto bad;
+
+    /* Children were written in list order, so append them without the sorted
+     * insertion done by profile_add_node(), but check that the order is
+     * still one profile_add_node() could have produced. */
+    for (i = 0; i < count; i++) {
+        retval = decode_node(in, node, depth + 1, &child);
+        if (retval) {
+            profile_free_node(node);
+            return retval;
+        }
+        if (last != NULL && strcmp(last->name, child->name) > 0) {
+            profile_free_node(child);
+            goto bad;
+        }
+        child->prev = last;
+        if (last != NULL)
+            last->next = child;
+        else
+            node->first_child = child;
+        last = child;
+    }
+
+    *node_out = node;
+    return 0;
+
+bad:
+    profile_free_node(node);
+    return PROF_BAD_LINK_LIST;
+}
+
+/*
+ * Decode a tree written by profile_encode_tree() from the len bytes at ptr
+ * into a newly allocated tree in *root.  The whole input must be consumed.
+ */
+errcode_t profile_decode_tree(const void *ptr, size_t len,
+                              struct profile_node **root)
+{
+    struct k5input in;
+    struct profile_node *node;
+    errcode_t retval;
+
+    *root = NULL;
+    k5_input_init(&in, ptr, len);
+    retval = decode_node(&in, NULL, 0, &node);
+    if (retval)
+        return retval;
+    if (in.len != 0 || node->value != NULL) {
+        profile_free_node(node);
+        return PROF_BAD_LINK_LIST;
+    }
+    *root = node;
+    return 0;
+}
@@ -0,0 +1,258 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/* util/profile/test_cache.c - Test and measure the compiled profile cache */
+/*
+ * Copyright (C) 2026 by the Massachusetts Institute of Technology.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * This program builds a large profile spread over an included directory,
+ * checks that loading it through the compiled cache produces the same tree as
+ * parsing it, checks that changes to an included file, new files in the
+ * included directory, and damage to the cache file are all noticed, and
+ * reports how fast the profile can be opened with and without the cache.
+ * Usage:
+ *
+ *     ./test_cache count
+ */
+
+#include "k5-platform.h"
+#include "profile.h"
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <dirent.h>
+
+#define TOPDIR "test_cache_dir"
+#define INCDIR TOPDIR "/inc"
+#define CACHEDIR TOPDIR "/cache"
+#define MAINFILE TOPDIR "/krb5.conf"
+#define NFILES 20
+#define NDOMAINS 100
+
+static double
+elapsed(struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) +
+        (end.tv_usec - start->tv_usec) / 1000000.0;
+}
+
+static void
+set_mtime(const char *path, time_t mtime)
+{
+    struct timeval times[2];
+
+    times[0].tv_sec = times[1].tv_sec = mtime;
+    times[0].tv_usec = times[1].tv_usec = 0;
+    assert(utimes(path, times) == 0);
+}
+
+/* Write included file number n, naming kdcname as the KDC of its realm. */
+static void
+write_include(int n, const char *kdcname, time_t mtime)
+{
+    FILE *fp;
+    char *path;
+    int i;
+
+    assert(asprintf(&path, "%s/realm%02d.conf", INCDIR, n) >= 0);
+    fp = fopen(path, "w");
+    assert(fp != NULL);
+    fprintf(fp, "[realms]\n\tR%02d.EXAMPLE = {\n", n);
+    fprintf(fp, "\t\tkdc = %s\n\t\tadmin_server = admin%02d\n\t}\n", kdcname,
+            n);
+    fprintf(fp, "[domain_realm]\n");
+    for (i = 0; i < NDOMAINS; i++)
+        fprintf(fp, "\thost%02d-%03d.example = R%02d.EXAMPLE\n", n, i, n);
+    fclose(fp);
+    set_mtime(path, mtime);
+    free(path);
+}
+
+static char *
+get_kdc(profile_t profile, int n)
+{
+    char *realm, *val;
+
+    assert(asprintf(&realm, "R%02d.EXAMPLE", n) >= 0);
+    assert(profile_get_string(profile, "realms", realm, "kdc", NULL,
+                              &val) == 0);
+    free(realm);
+    return val;
+}
+
+/* Open the profile and check the KDC of realm n.  Return a dump of the tree if
+ * dump_out is not null. */
+static void
+check_profile(int n, const char *kdcname, char **dump_out)
+{
+    profile_t profile;
+    char *val;
+
+    assert(profile_init_path(MAINFILE, &profile) == 0);
+    val = get_kdc(profile, n);
+    assert(val != NULL && strcmp(val, kdcname) == 0);
+    profile_release_string(val);
+    if (dump_out != NULL)
+        assert(profile_flush_to_buffer(profile, dump_out) == 0);
+    profile_release(profile);
+}
+
+static int
+count_cache_files(void)
+{
+    DIR *dir;
+    struct dirent *ent;
+    int count = 0;
+
+    dir = opendir(CACHEDIR);
+    assert(dir != NULL);
+    while ((ent = readdir(dir)) != NULL)
+        count += (ent->d_name[0] != '.');
+    closedir(dir);
+    return count;
+}
+
+/* Flip a byte in the middle of the single cache file. */
+static void
+damage_cache(void)
+{
+    DIR *dir;
+    struct dirent *ent;
+    struct stat st;
+    char *path = NULL, c;
+    int fd;
+
+    dir = opendir(CACHEDIR);
+    assert(dir != NULL);
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] != '.')
+            assert(asprintf(&path, "%s/%s", CACHEDIR, ent->d_name) >= 0);
+    }
+    closedir(dir);
+    assert(path != NULL);
+    fd = open(path, O_RDWR);
+    assert(fd >= 0 && fstat(fd, &st) == 0);
+    assert(pread(fd, &c, 1, st.st_size / 2) == 1);
+    c ^= 1;
+    assert(pwrite(fd, &c, 1, st.st_size / 2) == 1);
+    close(fd);
+    free(path);
+}
+
+static void
+time_opens(const char *desc, int count)
+{
+    profile_t profile;
+    struct timeval start;
+    double secs;
+    char *val;
+    int i;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < count; i++) {
+        assert(profile_init_path(MAINFILE, &profile) == 0);
+        val = get_kdc(profile, i % NFILES);
+        assert(val != NULL);
+        profile_release_string(val);
+        profile_release(profile);
+    }
+    secs = elapsed(&start);
+    if (secs <= 0)
+        secs = 1e-6;
+    printf("%s: %d opens in %.3f s (%.0f/s)\n", desc, count, secs,
+           count / secs);
+}
+
+int
+main(int argc, char **argv)
+{
+    FILE *fp;
+    char *parsed, *cached;
+    time_t now = time(NULL);
+    int count, i;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: test_cache count\n");
+        exit(1);
+    }
+    count = atoi(argv[1]);
+
+    assert(system("rm -rf " TOPDIR) == 0);
+    assert(mkdir(TOPDIR, 0755) == 0);
+    assert(mkdir(INCDIR, 0755) == 0);
+    assert(mkdir(CACHEDIR, 0755) == 0);
+    fp = fopen(MAINFILE, "w");
+    assert(fp != NULL);
+    fprintf(fp, "[libdefaults]\n\tdefault_realm = R00.EXAMPLE\n");
+    fprintf(fp, "includedir %s\n", INCDIR);
+    fclose(fp);
+    set_mtime(MAINFILE, now - 100);
+    for (i = 0; i < NFILES; i++)
+        write_include(i, "kdc.example", now - 100);
+    set_mtime(INCDIR, now - 100);
+
+    /* Parse the profile without the cache for reference. */
+    unsetenv("KRB5_CONFIG_CACHEDIR");
+    check_profile(5, "kdc.example", &parsed);
+    time_opens("parsed", count);
+    assert(count_cache_files() == 0);
+
+    /* The first open writes the cache and later opens read it. */
+    setenv("KRB5_CONFIG_CACHEDIR", CACHEDIR, 1);
+    check_profile(5, "kdc.example", NULL);
+    assert(count_cache_files() == 1);
+    check_profile(5, "kdc.example", &cached);
+    assert(strcmp(parsed, cached) == 0);
+    profile_free_buffer(NULL, cached);
+    time_opens("cached", count);
+
+    /* A modified included file is noticed. */
+    write_include(5, "newkdc.example", now - 50);
+    check_profile(5, "newkdc.example", NULL);
+    check_profile(5, "newkdc.example", NULL);
+
+    /* A new file in the included directory is noticed. */
+    write_include(NFILES, "extra.example", now - 50);
+    set_mtime(INCDIR, now - 50);
+    check_profile(NFILES, "extra.example", NULL);
+    check_profile(NFILES, "extra.example", NULL);
+
+    /* A damaged cache file is ignored and replaced. */
+    damage_cache();
+    check_profile(NFILES, "extra.example", NULL);
+    check_profile(NFILES, "extra.example", &cached);
+    assert(count_cache_files() == 1);
+    profile_free_buffer(NULL, cached);
+
+    profile_free_buffer(NULL, parsed);
+    assert(system("rm -rf " TOPDIR) == 0);
+    return 0;
+}
@@ -576,25 +576,31 @@ k5_json_number_value(k5_json_number number)
 
 static const char quotemap_json[] = "\"\\/bfnrt";
 static const char quotemap_c[] = "\"\\/\b\f\n\r\t";
-static const char needs_quote[] = "\\\"\1\2\3\4\5\6\7\10\11\12\13\14\15\16\17"
-    "\20\21\22\23\24\25\26\27\30\31\32\33\34\35\36\37";
 
 static int encode_value(struct k5buf *buf, k5_json_value val);
 
+/* Encode up to len bytes of str, stopping at the first zero byte. */
 static void
-encode_string(struct k5buf *buf, const char *str)
+encode_string_len(struct k5buf *buf, const char *str, size_t len)
 {
+    const char *end, *p;
     size_t n;
-    const char *p;
 
-    k5_buf_add(buf, "\"");
-    while (*str != '\0') {
-        n = strcspn(str, needs_quote);
+    p = memchr(str, '\0', len);
+    end = (p != NULL) ? p : str + len;
+    k5_buf_add_len(buf, "\"", 1);
+    while (str < end) {
+        /* Copy the longest run of characters which need no quoting. */
+        for (n = 0; str + n < end; n++) {
+            if ((unsigned char)str[n] < 0x20 || str[n] == '"' ||
+                str[n] == '\\')
+                break;
+        }
         k5_buf_add_len(buf, str, n);
         str += n;
-        if (*str == '\0')
+        if (str == end)
             break;
-        k5_buf_add(buf, "\\");
+        k5_buf_add_len(buf, "\\", 1);
         p = strchr(quotemap_c, *str);
         if (p != NULL)
             k5_buf_add_len(buf, quotemap_json + (p - quotemap_c), 1);
@@ -602,7 +608,32 @@ encode_string(struct k5buf *buf, const char *str)
             k5_buf_add_fmt(buf, "u00%02X", (unsigned int)*str);
         str++;
     }
-    k5_buf_add(buf, "\"");
+    k5_buf_add_len(buf, "\"", 1);
+}
+
+static void
+encode_string(struct k5buf *buf, const char *str)
+{
+    encode_string_len(buf, str, strlen(str));
+}
+
+/* Format number in decimal, with the same output as the "%lld" format. */
+static void
+encode_number(struct k5buf *buf, long long number)
+{
+    char digits[32], *p = digits + sizeof(digits);
+    unsigned long long u;
+
+    u = number;
+    if (number < 0)
+        u = 0 - u;
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+    if (number < 0)
+        *--p = '-';
+    k5_buf_add_len(buf, p, digits + sizeof(digits) - p);
 }
 
 struct obj_ctx {
@@ -667,7 +698,7 @@ encode_value(struct k5buf *buf, k5_json_value val)
         return 0;
 
     case K5_JSON_TID_NUMBER:
-        k5_buf_add_fmt(buf, "%lld", k5_json_number_value(val));
+        encode_number(buf, k5_json_number_value(val));
         return 0;
 
     case K5_JSON_TID_NULL:
@@ -702,6 +733,111 @@ k5_json_encode(k5_json_value val, char **json_out)
     return 0;
 }
 
+/*** Streaming JSON encoding ***/
+
+void
+k5_json_writer_init(k5_json_writer *w, struct k5buf *buf)
+{
+    w->buf = buf;
+    w->need_comma = 0;
+}
+
+/* Add a separator if a value has already been written at this level. */
+static inline void
+writer_sep(k5_json_writer *w)
+{
+    if (w->need_comma)
+        k5_buf_add_len(w->buf, ",", 1);
+}
+
+static inline void
+writer_open(k5_json_writer *w, const char *c)
+{
+    writer_sep(w);
+    k5_buf_add_len(w->buf, c, 1);
+    w->need_comma = 0;
+}
+
+static inline void
+writer_close(k5_json_writer *w, const char *c)
+{
+    k5_buf_add_len(w->buf, c, 1);
+    w->need_comma = 1;
+}
+
+void
+k5_json_write_begin_object(k5_json_writer *w)
+{
+    writer_open(w, "{");
+}
+
+void
+k5_json_write_end_object(k5_json_writer *w)
+{
+    writer_close(w, "}");
+}
+
+void
+k5_json_write_begin_array(k5_json_writer *w)
+{
+    writer_open(w, "[");
+}
+
+void
+k5_json_write_end_array(k5_json_writer *w)
+{
+    writer_close(w, "]");
+}
+
+void
+k5_json_write_key(k5_json_writer *w, const char *key)
+{
+    writer_sep(w);
+    encode_string(w->buf, key);
+    k5_buf_add_len(w->buf, ":", 1);
+    w->need_comma = 0;
+}
+
+void
+k5_json_write_null(k5_json_writer *w)
+{
+    writer_sep(w);
+    k5_buf_add_len(w->buf, "null", 4);
+    w->need_comma = 1;
+}
+
+void
+k5_json_write_bool(k5_json_writer *w, int b)
+{
+    writer_sep(w);
+    k5_buf_add(w->buf, b ? "true" : "false");
+    w->need_comma = 1;
+}
+
+void
+k5_json_write_number(k5_json_writer *w, long long number)
+{
+    writer_sep(w);
+    encode_number(w->buf, number);
+    w->need_comma = 1;
+}
+
+void
+k5_json_write_string(k5_json_writer *w, const char *str)
+{
+    writer_sep(w);
+    encode_string(w->buf, str);
+    w->need_comma = 1;
+}
+
+void
+k5_json_write_string_len(k5_json_writer *w, const void *data, size_t len)
+{
+    writer_sep(w);
+    encode_string_len(w->buf, data, len);
+    w->need_comma = 1;
+}
+
 /*** JSON decoding ***/
 
 struct decode_ctx {
@@ -69,6 +69,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <k5-platform.h>
+#include <k5-buf.h>
 #include <k5-json.h>
 
 static void
@@ -318,6 +320,58 @@ test_json(void)
     }
 }
 
+static void
+test_writer(void)
+{
+    static const char expected[] =
+        "{\"k1\":\"s1\",\"k2\":[1,-9223372036854775808,null,true,false,"
+        "{},[]],\"k\\\"3\":{\"k4\":\"a\\u0001\\n\"},\"k5\":\"ab\"}";
+    struct k5buf buf;
+    k5_json_writer w;
+    k5_json_value v;
+    char *enc, *enc2;
+
+    k5_buf_init_dynamic(&buf);
+    k5_json_writer_init(&w, &buf);
+    k5_json_write_begin_object(&w);
+    k5_json_write_key(&w, "k1");
+    k5_json_write_string(&w, "s1");
+    k5_json_write_key(&w, "k2");
+    k5_json_write_begin_array(&w);
+    k5_json_write_number(&w, 1);
+    k5_json_write_number(&w, -9223372036854775807LL - 1);
+    k5_json_write_null(&w);
+    k5_json_write_bool(&w, 1);
+    k5_json_write_bool(&w, 0);
+    k5_json_write_begin_object(&w);
+    k5_json_write_end_object(&w);
+    k5_json_write_begin_array(&w);
+    k5_json_write_end_array(&w);
+    k5_json_write_end_array(&w);
+    k5_json_write_key(&w, "k\"3");
+    k5_json_write_begin_object(&w);
+    k5_json_write_key(&w, "k4");
+    k5_json_write_string_len(&w, "a\1\nxyz", 3);
+    k5_json_write_end_object(&w);
+    k5_json_write_key(&w, "k5");
+    k5_json_write_string_len(&w, "ab\0cd", 5);
+    k5_json_write_end_object(&w);
+    if (k5_buf_status(&buf) != 0)
+        err("Failure to write JSON");
+    enc = buf.data;
+    check(strcmp(enc, expected) == 0, "writer output differs");
+
+    /* The writer's output should be identical to the tree encoder's. */
+    if (k5_json_decode(enc, &v))
+        err("Failure to decode writer output");
+    if (k5_json_encode(v, &enc2))
+        err("Failure to encode decoded writer output");
+    check(strcmp(enc, enc2) == 0, "writer and encoder outputs differ");
+    k5_json_release(v);
+    free(enc);
+    free(enc2);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -325,5 +379,6 @@ main(int argc, char **argv)
     test_object();
     test_string();
     test_json();
+    test_writer();
     return 0;
 }
@@ -125,6 +125,11 @@ struct tsd_block {
 # pragma weak pthread_key_delete
 # pragma weak pthread_create
 # pragma weak pthread_join
+# pragma weak pthread_rwlock_init
+# pragma weak pthread_rwlock_destroy
+# pragma weak pthread_rwlock_rdlock
+# pragma weak pthread_rwlock_wrlock
+# pragma weak pthread_rwlock_unlock
 # define K5_PTHREADS_LOADED     (krb5int_pthread_loaded())
 static volatile int flag_pthread_loaded = -1;
 static void loaded_test_aux(void)
@@ -555,6 +560,96 @@ k5_os_mutex_unlock(k5_os_mutex *m)
         return 0;
 }
 
+#ifdef HAVE_PTHREAD_RWLOCK_INIT
+
+int
+k5_os_rwlock_init(k5_os_rwlock *l)
+{
+    if (krb5int_pthread_loaded())
+        return pthread_rwlock_init(l, 0);
+    else
+        return 0;
+}
+
+int
+k5_os_rwlock_destroy(k5_os_rwlock *l)
+{
+    if (krb5int_pthread_loaded())
+        return pthread_rwlock_destroy(l);
+    else
+        return 0;
+}
+
+int
+k5_os_rwlock_rdlock(k5_os_rwlock *l)
+{
+    if (krb5int_pthread_loaded())
+        return pthread_rwlock_rdlock(l);
+    else
+        return 0;
+}
+
+int
+k5_os_rwlock_wrlock(k5_os_rwlock *l)
+{
+    if (krb5int_pthread_loaded())
+        return pthread_rwlock_wrlock(l);
+    else
+        return 0;
+}
+
+int
+k5_os_rwlock_unlock(k5_os_rwlock *l)
+{
+    if (krb5int_pthread_loaded())
+        return pthread_rwlock_unlock(l);
+    else
+        return 0;
+}
+
+#else /* HAVE_PTHREAD_RWLOCK_INIT */
+
+#undef k5_os_rwlock_init
+#undef k5_os_rwlock_destroy
+#undef k5_os_rwlock_rdlock
+#undef k5_os_rwlock_wrlock
+#undef k5_os_rwlock_unlock
+
+int k5_os_rwlock_init(k5_os_rwlock *l);
+int k5_os_rwlock_destroy(k5_os_rwlock *l);
+int k5_os_rwlock_rdlock(k5_os_rwlock *l);
+int k5_os_rwlock_wrlock(k5_os_rwlock *l);
+int k5_os_rwlock_unlock(k5_os_rwlock *l);
+
+/* Without rwlocks, an rwlock is a mutex. */
+int
+k5_os_rwlock_init(k5_os_rwlock *l)
+{
+    return k5_os_mutex_init(l);
+}
+int
+k5_os_rwlock_destroy(k5_os_rwlock *l)
+{
+    return k5_os_mutex_destroy(l);
+}
+int
+k5_os_rwlock_rdlock(k5_os_rwlock *l)
+{
+    return k5_os_mutex_lock(l);
+}
+int
+k5_os_rwlock_wrlock(k5_os_rwlock *l)
+{
+    return k5_os_mutex_lock(l);
+}
+int
+k5_os_rwlock_unlock(k5_os_rwlock *l)
+{
+    return k5_os_mutex_unlock(l);
+}
+
+#endif /* HAVE_PTHREAD_RWLOCK_INIT */
+
 int
 k5_once(k5_once_t *once, void (*fn)(void))
 {
@@ -570,12 +665,22 @@ k5_once(k5_once_t *once, void (*fn)(void))
 #undef k5_os_mutex_destroy
 #undef k5_os_mutex_lock
 #undef k5_os_mutex_unlock
+#undef k5_os_rwlock_init
+#undef k5_os_rwlock_destroy
+#undef k5_os_rwlock_rdlock
+#undef k5_os_rwlock_wrlock
+#undef k5_os_rwlock_unlock
 #undef k5_once
 
 int k5_os_mutex_init(k5_os_mutex *m);
 int k5_os_mutex_destroy(k5_os_mutex *m);
 int k5_os_mutex_lock(k5_os_mutex *m);
 int k5_os_mutex_unlock(k5_os_mutex *m);
+int k5_os_rwlock_init(k5_os_rwlock *l);
+int k5_os_rwlock_destroy(k5_os_rwlock *l);
+int k5_os_rwlock_rdlock(k5_os_rwlock *l);
+int k5_os_rwlock_wrlock(k5_os_rwlock *l);
+int k5_os_rwlock_unlock(k5_os_rwlock *l);
 int k5_once(k5_once_t *once, void (*fn)(void));
 
 /* Stub functions */
@@ -600,6 +705,31 @@ k5_os_mutex_unlock(k5_os_mutex *m)
     return 0;
 }
 int
+k5_os_rwlock_init(k5_os_rwlock *l)
+{
+    return 0;
+}
+int
+k5_os_rwlock_destroy(k5_os_rwlock *l)
+{
+    return 0;
+}
+int
+k5_os_rwlock_rdlock(k5_os_rwlock *l)
+{
+    return 0;
+}
+int
+k5_os_rwlock_wrlock(k5_os_rwlock *l)
+{
+    return 0;
+}
+int
+k5_os_rwlock_unlock(k5_os_rwlock *l)
+{
+    return 0;
+}
+int
 k5_once(k5_once_t *once, void (*fn)(void))
 {
     return 0;